@@ -9,7 +9,7 @@
 
 #define protected_constructor(classname) \
 protected: \
-    classname() {}; \
+    classname() = default; \
 \
 public:
 
@@ -89,7 +89,81 @@ class APU {
     friend IO_Bus;
 
 public:
-    explicit APU(bool bootrom_enabled);
+    struct channel_1_t:
+        public _volume_envelope,
+        public _programmable_timer,
+        public _length_counter,
+        public _duty_cycle_generator { };
+
+    struct channel_2_t:
+        public _volume_envelope,
+        public _programmable_timer,
+        public _length_counter,
+        public _duty_cycle_generator { };
+
+    struct channel_3_t: public _generic_channel, public _programmable_timer, public _length_counter {
+        u8 wave_pos;
+    };
+
+    struct channel_4_t:
+        public _volume_envelope,
+        public _configurable_timer,
+        public _length_counter,
+        public _prn_generator { };
+
+    struct registers_t {
+        u8 NR10;
+        u8 NR11;
+        u8 NR12;
+        u8 NR13;
+        u8 NR14;
+
+        u8 NR20; // unused
+        u8 NR21;
+        u8 NR22;
+        u8 NR23;
+        u8 NR24;
+
+        u8 NR30;
+        u8 NR31;
+        u8 NR32;
+        u8 NR33;
+        u8 NR34;
+
+        u8 NR40; // unused
+        u8 NR41;
+        u8 NR42;
+        u8 NR43;
+        u8 NR44;
+
+        u8 NR50;
+        u8 NR51;
+        u8 NR52;
+    };
+
+    /**
+     * Frame sequencer, channels, registers and wave RAM, everything a snapshot of the APU needs
+     */
+    struct state_t {
+        u32         tick_counter;
+        u16         frame_sequence_cntr;
+
+        channel_1_t channel_1;
+        channel_2_t channel_2;
+        channel_3_t channel_3;
+        channel_4_t channel_4;
+
+        registers_t registers;
+
+        u8          wav_ram[WAVRAM_LEN];
+    };
+
+    APU(state_t *state, bool bootrom_enabled);
+
+    /**
+     * Fork constructor, the copy runs on `state`, which must already hold other's state
+     */
+    APU(APU const &other, state_t *state);
     ~APU();
 
     void tick();
@@ -103,13 +177,12 @@ public:
     void write_wavram(u8 loc, u8 data);
 
 private:
-    u32 tick_counter        = 0;
-    u16 frame_sequence_cntr = 0;
-
-    struct: public _volume_envelope, public _programmable_timer, public _length_counter, public _duty_cycle_generator {
-    } channel_1;
+    state_t *state; // lives in the core's machine_state_t
 
-#define reg(X) (registers.X)
+    /**
+     * Channel 1
+     **/
+#define reg(X) (state->registers.X)
     inline u8  ch1_sweep_rt() { return (reg(NR10) >> 4) & 7; }
     inline u8  ch1_sweep_dir() { return Bit::test(reg(NR10), 3); }
     inline u8  ch1_sweep_shft_amt() { return reg(NR10) & 3; }
@@ -129,10 +202,7 @@ private:
     /**
      * Channel 2
      **/
-    struct: public _volume_envelope, public _programmable_timer, public _length_counter, public _duty_cycle_generator {
-    } channel_2;
-
-#define reg(X) (registers.X)
+#define reg(X) (state->registers.X)
     inline u8  ch2_wav_patt_duty() { return reg(NR21) >> 6; }
     inline u8  ch2_snd_len() { return reg(NR21) & 0x3F; }
 
@@ -148,11 +218,7 @@ private:
     /**
      * Channel 3
      **/
-    struct: public _generic_channel, public _programmable_timer, public _length_counter {
-        u8 wave_pos;
-    } channel_3;
-
-#define reg(X) (registers.X)
+#define reg(X) (state->registers.X)
     inline u8  ch3_mstr_en() { return Bit::test(reg(NR30), 7); }
 
     inline u8  ch3_snd_len() { return reg(NR31); }
@@ -167,14 +233,7 @@ private:
     /**
      * channel 4
      **/
-    struct _channel_4:
-        public _volume_envelope,
-        public _configurable_timer,
-        public _length_counter,
-        public _prn_generator {
-    } channel_4;
-
-#define reg(X) (registers.X)
+#define reg(X) (state->registers.X)
     inline u8 ch4_wav_patt_duty() { return reg(NR41) >> 6; }
     inline u8 ch4_snd_len() { return reg(NR41) & 0x3F; }
 
@@ -192,7 +251,7 @@ private:
 /**
  *Control
  **/
-#define reg(X) (registers.X)
+#define reg(X) (state->registers.X)
     inline bool ch1_L_dac_en() { return Bit::test(reg(NR51), 4); }
     inline bool ch1_R_dac_en() { return Bit::test(reg(NR51), 0); }
     inline bool ch2_L_dac_en() { return Bit::test(reg(NR51), 5); }
@@ -205,37 +264,6 @@ private:
     inline bool snd_en() { return Bit::test(reg(NR52), 7); }
 #undef reg
 
-    struct __registers {
-        u8 NR10;
-        u8 NR11;
-        u8 NR12;
-        u8 NR13;
-        u8 NR14;
-
-        u8 NR20; // unused
-        u8 NR21;
-        u8 NR22;
-        u8 NR23;
-        u8 NR24;
-
-        u8 NR30;
-        u8 NR31;
-        u8 NR32;
-        u8 NR33;
-        u8 NR34;
-
-        u8 NR40; // unused
-        u8 NR41;
-        u8 NR42;
-        u8 NR43;
-        u8 NR44;
-
-        u8 NR50;
-        u8 NR51;
-        u8 NR52;
-    } registers;
-
-    u8        wav_ram[WAVRAM_LEN];
 
     inline u8 getDivisor(u8 i) {
         const u8 t[8] = {8, 16, 32, 48, 64, 80, 96, 112};
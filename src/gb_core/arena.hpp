@@ -0,0 +1,156 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+#include "util/types/primitives.hpp"
+
+#include "apu.hpp"
+#include "cart.hpp"
+#include "io.hpp"
+#include "joy.hpp"
+#include "mem.hpp"
+#include "ppu.hpp"
+
+#define ARENA_ALIGNMENT 64 // one cache line
+
+/**
+ * CPU register file and sequencing state
+ */
+struct cpu_state_t {
+    union {
+        struct {
+            u8 F;
+            u8 A;
+        } b_AF;
+
+        u16 i_AF;
+    } AF;
+
+    union {
+        struct {
+            u8 C;
+            u8 B;
+        } b_BC;
+
+        u16 i_BC;
+    } BC;
+
+    union {
+        struct {
+            u8 E;
+            u8 D;
+        } b_DE;
+
+        u16 i_DE;
+    } DE;
+
+    union {
+        struct {
+            u8 L;
+            u8 H;
+        } b_HL;
+
+        u16 i_HL;
+    } HL;
+
+    u16  SP;
+    u16  PC;
+
+    u8   inst_clocks;
+
+    // clocks run since power on, both halves count in double speed
+    u64  clocks;
+
+    // globally track div values because writes to the TIMA register
+    u16  old_div, new_div;
+
+    bool IME, is_halted, halt_bug, is_stopped, ei_ime_enable;
+
+    // an invalid opcode hangs the CPU for good, interrupts included
+    bool is_locked;
+};
+
+/**
+ * Everything that makes up the state of the emulated machine, laid out at fixed offsets in a single block: the CPU,
+ * the IO registers and the state behind them (timers and DMA, PPU, APU, joypad, cartridge banking and RTC) and all of
+ * the RAM.
+ *
+ * Every region starts on its own cache line so the hot ones (CPU, IO registers, HRAM, OAM) never share a line with the
+ * bulk RAM. The whole struct is trivially copyable: a snapshot, restore or diff of the machine is a single memcpy/XOR.
+ *
+ * Regions are sized for the largest supported device; DMG cores and smaller carts only use a prefix of each.
+ */
+struct alignas(ARENA_ALIGNMENT) machine_state_t {
+    alignas(ARENA_ALIGNMENT) cpu_state_t cpu;
+    alignas(ARENA_ALIGNMENT) Memory::io_registers_t io;
+
+    alignas(ARENA_ALIGNMENT) IO_Bus::state_t bus;
+    alignas(ARENA_ALIGNMENT) PPU::state_t ppu;
+    alignas(ARENA_ALIGNMENT) APU::state_t apu;
+    alignas(ARENA_ALIGNMENT) Joypad::state_t joypad;
+    alignas(ARENA_ALIGNMENT) MemoryBankController::state_t mbc;
+
+    alignas(ARENA_ALIGNMENT) u8 high_ram[HIGH_RAM_SIZE];
+    alignas(ARENA_ALIGNMENT) u8 oam_ram[OAM_RAM_SIZE];
+    alignas(ARENA_ALIGNMENT) u8 work_ram[GBC_WORK_RAM_SIZE];
+    alignas(ARENA_ALIGNMENT) u8 ppu_ram[GBC_VRAM_SIZE];
+    alignas(ARENA_ALIGNMENT) u8 cart_ram[Cartridge_Constants::RAM_SZ_128K];
+
+    std::span<u8>       bytes() { return {reinterpret_cast<u8 *>(this), sizeof(*this)}; }
+
+    std::span<const u8> bytes() const { return {reinterpret_cast<const u8 *>(this), sizeof(*this)}; }
+
+    /**
+     * XOR this state against other into delta, applying the same delta to either side gets you the other back.
+     * @return count of 64-bit words that differ, 0 means the states are identical
+     */
+    size_t              diff(machine_state_t const &other, machine_state_t *delta = nullptr) const {
+        static_assert(sizeof(machine_state_t) % sizeof(u64) == 0);
+
+        const u64 *a     = reinterpret_cast<const u64 *>(this);
+        const u64 *b     = reinterpret_cast<const u64 *>(&other);
+        u64       *d     = reinterpret_cast<u64 *>(delta);
+        size_t     words = sizeof(machine_state_t) / sizeof(u64), changed = 0;
+
+        for(size_t i = 0; i < words; i++) {
+            u64 x = a[i] ^ b[i];
+            changed += (x != 0);
+            if(d) {
+                d[i] = x;
+            }
+        }
+
+        return changed;
+    }
+
+    /**
+     * Where `p` lands in this state if it points into `from`, anything else (cartridge ROM, the boot ROM) is returned
+     * as is. For the views and in-flight transfers of a forked core
+     */
+    template<typename T>
+    T *rebase(T *p, machine_state_t const &from) {
+        auto addr = reinterpret_cast<uintptr_t>(p);
+        auto base = reinterpret_cast<uintptr_t>(&from);
+        if(addr < base || addr >= base + sizeof(machine_state_t)) {
+            return p;
+        }
+        return reinterpret_cast<T *>(reinterpret_cast<uintptr_t>(this) + (addr - base));
+    }
+
+    void apply_delta(machine_state_t const &delta) {
+        u64       *a     = reinterpret_cast<u64 *>(this);
+        const u64 *d     = reinterpret_cast<const u64 *>(&delta);
+        size_t     words = sizeof(machine_state_t) / sizeof(u64);
+
+        for(size_t i = 0; i < words; i++) {
+            a[i] ^= d[i];
+        }
+    }
+};
+
+static_assert(std::is_trivially_copyable_v<machine_state_t>, "machine state must be snapshot-able with memcpy");
+static_assert(alignof(machine_state_t) == ARENA_ALIGNMENT);
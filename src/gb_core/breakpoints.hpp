@@ -0,0 +1,167 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "util/types/primitives.hpp"
+
+enum class BreakReason : u8 {
+    None,  // ran to completion
+    Exec,  // stopped right before executing an instruction at a breakpoint
+    Read,  // the last instruction read a watched address
+    Write, // the last instruction wrote a watched address
+};
+
+struct break_hit_t {
+    BreakReason reason = BreakReason::None;
+    u16         addr   = 0; // PC for breakpoints, the accessed address for watchpoints
+    u16         bank   = 0; // ROM bank mapped at addr, breakpoints only
+    u8          value  = 0; // byte read or written, watchpoints only
+};
+
+/**
+ * PC breakpoints, bank:PC breakpoints and memory read/write watchpoints.
+ *
+ * Each kind is a 64K-bit bitmap indexed by address so a check is a single bit test, and the core only runs the checking
+ * variant of its tick loop while at least one of them is non-empty. Bank-qualified breakpoints have a bitmap of which
+ * PCs have any, the bank:PC pairs themselves are only searched when that bit is set.
+ */
+class BreakpointSet {
+public:
+    class Bitmap {
+    public:
+        bool test(u16 addr) const { return (bits[addr >> 6] >> (addr & 63)) & 1; }
+
+        void set(u16 addr, bool en) {
+            if(test(addr) == en) {
+                return;
+            }
+
+            bits[addr >> 6] ^= 1ull << (addr & 63);
+            count += en ? 1 : -1;
+        }
+
+        bool empty() const { return count == 0; }
+
+        void clear() {
+            std::fill(std::begin(bits), std::end(bits), 0);
+            count = 0;
+        }
+
+    private:
+        u64 bits[0x10000 / 64] = {0};
+        u32 count              = 0;
+    };
+
+    /**
+     * Breakpoints
+     */
+    void add_breakpoint(u16 pc) { exec.set(pc, true); }
+
+    void remove_breakpoint(u16 pc) { exec.set(pc, false); }
+
+    bool has_breakpoint(u16 pc) const { return exec.test(pc); }
+
+    void add_breakpoint(u16 bank, u16 pc) {
+        u32  key = make_key(bank, pc);
+        auto it  = std::lower_bound(banked.begin(), banked.end(), key);
+        if(it == banked.end() || *it != key) {
+            banked.insert(it, key);
+        }
+        exec_banked.set(pc, true);
+    }
+
+    void remove_breakpoint(u16 bank, u16 pc) {
+        u32  key = make_key(bank, pc);
+        auto it  = std::lower_bound(banked.begin(), banked.end(), key);
+        if(it != banked.end() && *it == key) {
+            banked.erase(it);
+        }
+
+        bool others = std::any_of(banked.begin(), banked.end(), [pc](u32 k) { return (u16)k == pc; });
+        exec_banked.set(pc, others);
+    }
+
+    bool has_breakpoint(u16 bank, u16 pc) const {
+        return exec_banked.test(pc) && std::binary_search(banked.begin(), banked.end(), make_key(bank, pc));
+    }
+
+    /**
+     * Watchpoints
+     */
+    void add_watchpoint(u16 addr, bool on_read, bool on_write) {
+        if(on_read) {
+            read.set(addr, true);
+        }
+        if(on_write) {
+            write.set(addr, true);
+        }
+    }
+
+    void remove_watchpoint(u16 addr) {
+        read.set(addr, false);
+        write.set(addr, false);
+    }
+
+    void clear() {
+        exec.clear();
+        exec_banked.clear();
+        read.clear();
+        write.clear();
+        banked.clear();
+    }
+
+    bool empty() const { return exec.empty() && exec_banked.empty() && read.empty() && write.empty(); }
+
+    bool watching_reads() const { return !read.empty(); }
+
+    bool watching_writes() const { return !write.empty(); }
+
+    /**
+     * @param bank_of called only for PCs that have a bank-qualified breakpoint, returns the ROM bank mapped at pc
+     */
+    template<typename F>
+    bool check_exec(u16 pc, F &&bank_of) const {
+        if(exec.test(pc)) {
+            return true;
+        }
+        return exec_banked.test(pc) && std::binary_search(banked.begin(), banked.end(), make_key(bank_of(), pc));
+    }
+
+    bool check_read(u16 addr) const { return read.test(addr); }
+
+    bool check_write(u16 addr) const { return write.test(addr); }
+
+    /**
+     * Hit reporting, the first hit is kept until the core takes it
+     */
+    void report(break_hit_t const &hit) {
+        if(!pending) {
+            last    = hit;
+            pending = true;
+        }
+    }
+
+    bool hit_pending() const { return pending; }
+
+    break_hit_t const &last_hit() const { return last; }
+
+    BreakReason take_hit() {
+        pending = false;
+        return last.reason;
+    }
+
+private:
+    static u32       make_key(u16 bank, u16 pc) { return ((u32)bank << 16) | pc; }
+
+    Bitmap           exec;
+    Bitmap           exec_banked;
+    Bitmap           read;
+    Bitmap           write;
+
+    // sorted bank << 16 | pc
+    std::vector<u32> banked;
+
+    break_hit_t      last;
+    bool             pending = false;
+};
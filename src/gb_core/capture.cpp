@@ -0,0 +1,335 @@
+#include "capture.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "util/log.hpp"
+
+namespace {
+    // how long the writer sleeps between passes over the rings
+    constexpr auto writer_period = std::chrono::milliseconds(10);
+
+    // 4194304 Hz / 70224 clocks per frame, exact
+    constexpr u32  frame_rate_num = 4194304;
+    constexpr u32  frame_rate_den = 70224;
+
+    constexpr u32  wav_header_size = 44;
+
+    FILE          *open_output(const char *path, bool &close) {
+        std::string_view name(path);
+        close = true;
+        if(name == "-") {
+            close = false;
+#if defined(_WIN32)
+            _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            return stdout;
+        }
+
+        if(name.starts_with("fd:")) {
+            int fd = std::atoi(path + 3);
+#if defined(_WIN32)
+            _setmode(fd, _O_BINARY);
+            return _fdopen(fd, "wb");
+#else
+            return fdopen(fd, "wb");
+#endif
+        }
+
+        return fopen(path, "wb");
+    }
+
+    void put_le(u8 *out, u32 value, u32 bytes) {
+        for(u32 i = 0; i < bytes; i++) {
+            out[i] = value >> (i * 8);
+        }
+    }
+
+    // 32-bit float mono, the sizes are filled in by finish_wav()
+    void make_wav_header(u8 *out, u32 sample_rate, u32 data_size) {
+        memcpy(out, "RIFF", 4);
+        put_le(out + 4, wav_header_size - 8 + data_size, 4);
+        memcpy(out + 8, "WAVEfmt ", 8);
+        put_le(out + 16, 16, 4);              // fmt chunk size
+        put_le(out + 20, 3, 2);               // WAVE_FORMAT_IEEE_FLOAT
+        put_le(out + 22, 1, 2);               // channels
+        put_le(out + 24, sample_rate, 4);
+        put_le(out + 28, sample_rate * 4, 4); // bytes per second
+        put_le(out + 32, 4, 2);               // block align
+        put_le(out + 34, 32, 2);              // bits per sample
+        memcpy(out + 36, "data", 4);
+        put_le(out + 40, data_size, 4);
+    }
+} // namespace
+
+namespace Silver {
+    Capture::~Capture() { stop(); }
+
+    bool Capture::start(const char *video_path, VideoFormat format, const char *audio_path, u32 sample_rate) {
+        DebugCheck(!writer.joinable()) << "Capture::start while already capturing";
+
+        this->format      = format;
+        this->sample_rate = sample_rate;
+
+        if(video_path) {
+            video = open_output(video_path, close_video);
+            if(!video) {
+                LogError("Capture") << "failed to open " << video_path;
+                return false;
+            }
+        }
+        if(audio_path) {
+            audio = fopen(audio_path, "wb");
+            if(!audio) {
+                LogError("Capture") << "failed to open " << audio_path;
+                if(video && close_video) {
+                    fclose(video);
+                }
+                video = nullptr;
+                return false;
+            }
+        }
+
+        frames  = std::make_unique<frame_slot_t[]>(frame_slots);
+        samples = std::make_unique<float[]>(audio_capacity);
+        encoded.reserve(frame_pixels * 4 + 6);
+
+        frame_head      = 0;
+        frame_tail      = 0;
+        sample_head     = 0;
+        sample_tail     = 0;
+        frames_written  = 0;
+        frames_dropped  = 0;
+        samples_written = 0;
+        samples_dropped = 0;
+        video_failed    = false;
+        audio_failed    = false;
+        pending_drops   = 0;
+        silence_written = 0;
+        encoded.clear();
+
+        if(video && format == VideoFormat::Y4M) {
+            char header[96];
+            int  len = snprintf(header, sizeof(header), "YUV4MPEG2 W%u H%u F%u:%u Ip A1:1 C444\n", PPU::native_width,
+                                PPU::native_height, frame_rate_num, frame_rate_den);
+            write_video(header, len);
+        }
+        if(audio) {
+            u8 header[wav_header_size];
+            make_wav_header(header, sample_rate, 0);
+            write_audio(header, sizeof(header));
+        }
+
+        stopping = false;
+        writer   = std::thread([this]() { writer_main(); });
+        return true;
+    }
+
+    void Capture::stop() {
+        if(!writer.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+
+        // frames dropped after the last one queued, nothing can be pushed any more so they're written from here
+        for(; pending_drops && !encoded.empty(); pending_drops--) {
+            write_video(encoded.data(), encoded.size());
+            frames_written.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        if(audio) {
+            finish_wav();
+            fclose(audio);
+            audio = nullptr;
+        }
+        if(video) {
+            if(close_video) {
+                fclose(video);
+            } else {
+                fflush(video);
+            }
+            video = nullptr;
+        }
+    }
+
+    void Capture::push_frame(std::span<const Pixel> pixels) {
+        if(!video || pixels.size() != frame_pixels || video_failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        u64 head = frame_head.load(std::memory_order_relaxed);
+        if(head - frame_tail.load(std::memory_order_acquire) >= frame_slots) {
+            pending_drops++;
+            frames_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        frame_slot_t &slot = frames[head % frame_slots];
+        memcpy(slot.pixels, pixels.data(), sizeof(slot.pixels));
+        slot.dropped_before = pending_drops;
+        pending_drops       = 0;
+        frame_head.store(head + 1, std::memory_order_release);
+    }
+
+    void Capture::push_audio(std::span<const float> in) {
+        if(!audio || audio_failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+
+        u64    head  = sample_head.load(std::memory_order_relaxed);
+        size_t space = audio_capacity - (head - sample_tail.load(std::memory_order_acquire));
+        size_t count = std::min(in.size(), space);
+
+        size_t first = std::min(count, audio_capacity - head % audio_capacity);
+        memcpy(&samples[head % audio_capacity], in.data(), first * sizeof(float));
+        memcpy(&samples[0], in.data() + first, (count - first) * sizeof(float));
+        sample_head.store(head + count, std::memory_order_release);
+
+        if(count != in.size()) {
+            samples_dropped.fetch_add(in.size() - count, std::memory_order_relaxed);
+        }
+    }
+
+    Capture::stats_t Capture::stats() const {
+        return {
+            .frames_written  = frames_written.load(std::memory_order_relaxed),
+            .frames_dropped  = frames_dropped.load(std::memory_order_relaxed),
+            .samples_written = samples_written.load(std::memory_order_relaxed),
+            .samples_dropped = samples_dropped.load(std::memory_order_relaxed),
+            .video_failed    = video_failed.load(std::memory_order_relaxed),
+            .audio_failed    = audio_failed.load(std::memory_order_relaxed),
+        };
+    }
+
+    void Capture::writer_main() {
+        std::unique_lock lock(mutex);
+        while(true) {
+            wake.wait_for(lock, writer_period, [this]() { return stopping; });
+            bool stop = stopping;
+
+            lock.unlock();
+            drain();
+            lock.lock();
+
+            if(stop) {
+                return;
+            }
+        }
+    }
+
+    void Capture::drain() {
+        if(video) {
+            drain_video();
+        }
+        if(audio) {
+            drain_audio();
+        }
+    }
+
+    void Capture::drain_video() {
+        u64 tail = frame_tail.load(std::memory_order_relaxed);
+        u64 head = frame_head.load(std::memory_order_acquire);
+        for(; tail != head; tail++) {
+            frame_slot_t const &slot = frames[tail % frame_slots];
+            if(!encoded.empty()) {
+                for(u32 i = 0; i < slot.dropped_before; i++) {
+                    write_video(encoded.data(), encoded.size());
+                }
+                frames_written.fetch_add(slot.dropped_before, std::memory_order_relaxed);
+            }
+
+            encode_frame(slot.pixels);
+            write_video(encoded.data(), encoded.size());
+            frames_written.fetch_add(1, std::memory_order_relaxed);
+        }
+        frame_tail.store(tail, std::memory_order_release);
+    }
+
+    void Capture::drain_audio() {
+        u64 tail = sample_tail.load(std::memory_order_relaxed);
+        u64 head = sample_head.load(std::memory_order_acquire);
+        while(tail != head) {
+            size_t count = std::min<u64>(head - tail, audio_capacity - tail % audio_capacity);
+            write_audio(&samples[tail % audio_capacity], count * sizeof(float));
+            samples_written.fetch_add(count, std::memory_order_relaxed);
+            tail += count;
+        }
+        sample_tail.store(tail, std::memory_order_release);
+
+        // keep the track as long as the video, the silence lands near where the samples were lost
+        static constexpr float silence[1024] = {};
+        u64                    dropped       = samples_dropped.load(std::memory_order_relaxed);
+        while(silence_written != dropped) {
+            size_t count = std::min<u64>(dropped - silence_written, std::size(silence));
+            write_audio(silence, count * sizeof(float));
+            silence_written += count;
+        }
+    }
+
+    void Capture::encode_frame(const Pixel *pixels) {
+        if(format == VideoFormat::Raw) {
+            encoded.assign(reinterpret_cast<const u8 *>(pixels), reinterpret_cast<const u8 *>(pixels + frame_pixels));
+            return;
+        }
+
+        // BT.601 studio swing, the colorspace Y4M players assume
+        encoded.resize(6 + frame_pixels * 3);
+        memcpy(encoded.data(), "FRAME\n", 6);
+        u8 *y_plane = encoded.data() + 6;
+        u8 *u_plane = y_plane + frame_pixels;
+        u8 *v_plane = u_plane + frame_pixels;
+        for(u32 i = 0; i < frame_pixels; i++) {
+            int r = pixels[i].r;
+            int g = pixels[i].g;
+            int b = pixels[i].b;
+
+            y_plane[i] = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+            u_plane[i] = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+            v_plane[i] = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+        }
+    }
+
+    void Capture::write_video(const void *data, size_t size) {
+        if(video_failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if(fwrite(data, 1, size, video) != size) {
+            // a pipe whose reader went away or a full disk, neither gets better by retrying
+            LogError("Capture") << "video write failed, no more frames will be written";
+            video_failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    void Capture::write_audio(const void *data, size_t size) {
+        if(audio_failed.load(std::memory_order_relaxed)) {
+            return;
+        }
+        if(fwrite(data, 1, size, audio) != size) {
+            LogError("Capture") << "audio write failed, no more samples will be written";
+            audio_failed.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    void Capture::finish_wav() {
+        u64 data_size = (samples_written.load() + silence_written) * sizeof(float);
+        u8  header[wav_header_size];
+        make_wav_header(header, sample_rate, u32(std::min<u64>(data_size, UINT32_MAX - wav_header_size)));
+        if(fseek(audio, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), audio) != sizeof(header)) {
+            LogError("Capture") << "failed to finish the WAV header";
+        }
+    }
+} // namespace Silver
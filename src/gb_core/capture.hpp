@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "util/types/pixel.hpp"
+#include "util/types/primitives.hpp"
+
+#include "ppu.hpp"
+
+namespace Silver {
+
+    /**
+     * Records a core's frames and audio to disk, or pipes the frames to an external encoder.
+     *
+     * The core hands each finished frame and audio buffer to push_frame()/push_audio() (see Core::setCapture()), which
+     * copy them into preallocated single-producer single-consumer rings and return. Everything else, colorspace
+     * conversion and file IO included, happens on the capture's own thread. When the writer falls behind a frame is
+     * dropped rather than waited for, and the writer repeats the previous frame in its place so the video keeps its
+     * frame rate and stays in sync with the audio. Audio that doesn't fit is dropped and made up with silence.
+     *
+     * Video is either Y4M (4:4:4, full frame rate) or raw RGBA frames back to back, for e.g.
+     * `ffmpeg -f rawvideo -pix_fmt rgba -s 160x144 -r 59.7275 -i -`. Audio is mono 32-bit float WAV at
+     * Core::audio_sample_rate.
+     */
+    class Capture {
+    public:
+        enum class VideoFormat : u8 { Y4M, Raw };
+
+        struct stats_t {
+            u64  frames_written;
+            u64  frames_dropped;  // written as repeats of the frame before
+            u64  samples_written;
+            u64  samples_dropped; // made up with silence
+            bool video_failed;    // the output was closed or ran out of space, nothing more is written to it
+            bool audio_failed;
+        };
+
+        Capture() = default;
+        ~Capture();
+
+        Capture(const Capture &)             = delete;
+        Capture &operator= (const Capture &) = delete;
+
+        /**
+         * Open the outputs and start the writer. `video_path` may be "-" for stdout or "fd:N" for an inherited
+         * descriptor, either path may be null to leave that stream out
+         * @return false if an output couldn't be opened
+         */
+        bool    start(const char *video_path, VideoFormat format, const char *audio_path, u32 sample_rate);
+
+        /**
+         * Write out everything queued, finish the files and stop the writer. Call it from the thread that pushes, or
+         * once that has stopped
+         */
+        void    stop();
+
+        /**
+         * Queue a frame, never blocks. Frames other than a full RGBA pixel buffer are ignored
+         */
+        void    push_frame(std::span<const Pixel> pixels);
+        /**
+         * Queue audio samples, never blocks
+         */
+        void    push_audio(std::span<const float> samples);
+
+        stats_t stats() const;
+
+    private:
+        static constexpr size_t frame_slots    = 8;       // ~130 ms of video
+        static constexpr size_t audio_capacity = 1 << 16; // ~1.4 s of audio
+        static constexpr u32    frame_pixels   = PPU::native_pixel_count;
+
+        struct frame_slot_t {
+            Pixel pixels[frame_pixels];
+            u32   dropped_before; // frames dropped between the previous slot and this one
+        };
+
+        void                            writer_main();
+        void                            drain();
+        void                            drain_video();
+        void                            drain_audio();
+        void                            encode_frame(const Pixel *pixels);
+        void                            write_video(const void *data, size_t size);
+        void                            write_audio(const void *data, size_t size);
+        void                            finish_wav();
+
+        FILE                           *video       = nullptr;
+        FILE                           *audio       = nullptr;
+        bool                            close_video = true; // false for stdout
+        VideoFormat                     format      = VideoFormat::Y4M;
+        u32                             sample_rate = 0;
+
+        // the emulation thread only moves the heads and the writer only moves the tails
+        std::unique_ptr<frame_slot_t[]> frames;
+        std::atomic<u64>                frame_head {0}, frame_tail {0};
+        u32                             pending_drops = 0; // emulation thread only
+
+        std::unique_ptr<float[]>        samples;
+        std::atomic<u64>                sample_head {0}, sample_tail {0};
+
+        std::atomic<u64>                frames_written {0}, frames_dropped {0};
+        std::atomic<u64>                samples_written {0}, samples_dropped {0};
+        std::atomic<bool>               video_failed {false}, audio_failed {false};
+
+        // writer thread only
+        std::vector<u8>                 encoded; // the last frame as written, repeated for dropped ones
+        u64                             silence_written = 0;
+
+        std::mutex                      mutex;
+        std::condition_variable         wake;
+        bool                            stopping = false;
+        std::thread                     writer;
+    };
+} // namespace Silver
@@ -1,6 +1,7 @@
 #include "cart.hpp"
 
 #include <cassert>
+#include <cstring>
 #include <numeric>
 #include <vector>
 
@@ -18,7 +19,13 @@
  */
 std::string get_ram_file_name(const std::string &rom_file_name) {
     std::string ram_file_name = rom_file_name;
-    auto        ext           = rom_file_name.find_last_of('.') + 1;
+
+    // game.gb.gz should save to game.sav, not game.gb.sav
+    if(ram_file_name.size() > 3 && ram_file_name.compare(ram_file_name.size() - 3, 3, ".gz") == 0) {
+        ram_file_name.erase(ram_file_name.size() - 3);
+    }
+
+    auto ext = ram_file_name.find_last_of('.') + 1;
 
     ram_file_name.erase(ext, std::string::npos);
     ram_file_name.append("sav");
@@ -26,7 +33,7 @@ std::string get_ram_file_name(const std::string &rom_file_name) {
     return ram_file_name;
 }
 
-bool Cartridge::loadRAMFile(const std::string &ram_file_name, std::vector<u8> &ram_buffer) {
+bool Cartridge::loadRAMFile(const std::string &ram_file_name, std::span<u8> ram_buffer) {
     if(!Silver::File::fileExists(ram_file_name)) {
         LogWarn("Cartridge") << ram_file_name << " does not exist";
         return false;
@@ -43,14 +50,14 @@ bool Cartridge::loadRAMFile(const std::string &ram_file_name, std::vector<u8> &r
         return false;
     }
 
-    ram_file->toVector(ram_buffer);
+    ram_file->getBuffer(0, ram_buffer.data(), ram_buffer.size());
     delete ram_file;
 
     LogInfo("Cartridge") << ram_file_name << " loaded";
     return true;
 }
 
-bool Cartridge::saveRAMFile(const std::string &ram_file_name, std::vector<u8> const &ram_buffer) {
+bool Cartridge::saveRAMFile(const std::string &ram_file_name, std::span<const u8> ram_buffer) {
     Silver::File *ram_file;
     if(Silver::File::fileExists(ram_file_name)) {
         ram_file = Silver::File::openFile(ram_file_name, true, true);
@@ -64,24 +71,35 @@ bool Cartridge::saveRAMFile(const std::string &ram_file_name, std::vector<u8> co
     }
 
     LogInfo("Cartridge") << ram_file_name << " saved";
-    ram_file->fromVector(ram_buffer);
+    ram_file->setBuffer(0, (void *)ram_buffer.data(), ram_buffer.size());
     delete ram_file;
 
     return true;
 }
 
-Cartridge::Cartridge(const std::shared_ptr<Silver::File> &f) :
+Cartridge::Cartridge(
+        const std::shared_ptr<Silver::File> &f, std::span<u8> ram_backing, MemoryBankController::state_t *bank_state) :
     rom_file(f),
     cart_type(Cartridge_Constants::cart_type_t::getCartType(rom_file->getByte(Cartridge_Constants::CART_TYPE_OFFSET))) {
-    std::vector<u8> rom;
-    std::vector<u8> ram;
+    std::span<u8> ram;
 
-    f->toVector(rom);
+    // controllers only set up the fields they use
+    memset(bank_state, 0, sizeof(*bank_state));
+
+    // archives are already inflated into memory, hold on to that instead of copying it
+    rom_data = f->getSharedBuffer();
+    if(!rom_data) {
+        auto copy = std::make_shared<std::vector<u8>>();
+        f->toVector(*copy);
+        rom_data = std::move(copy);
+    }
+    auto const &rom = *rom_data;
     assert(rom.size() == getROMSize());
 
     // open ram info
     if(cart_type.RAM && getRAMSize() > 0) {
-        ram.resize(getRAMSize());
+        assert(ram_backing.size() >= (size_t)getRAMSize());
+        ram = ram_backing.first(getRAMSize());
 
         if(cart_type.BATTERY) {
             loadRAMFile(get_ram_file_name(rom_file->getFilename()), ram);
@@ -89,16 +107,16 @@ Cartridge::Cartridge(const std::shared_ptr<Silver::File> &f) :
     }
 
     if(cart_type.ROM) {
-        controller = std::make_shared<ROM_Controller>(cart_type, rom, ram);
+        controller = std::make_shared<ROM_Controller>(cart_type, rom, ram, bank_state);
     } else if(cart_type.MBC1) {
-        controller = std::make_shared<MBC1_Controller>(cart_type, rom, ram);
+        controller = std::make_shared<MBC1_Controller>(cart_type, rom, ram, bank_state);
     } else if(cart_type.MBC2) {
         LogFatal("Cartridge") << "MBC2 not supported, emulator will now crash";
-        // controller = new MBC2_Controller(cart_type, rom, ram);
+        // controller = new MBC2_Controller(cart_type, rom, ram, bank_state);
     } else if(cart_type.MBC3) {
-        controller = std::make_shared<MBC3_Controller>(cart_type, rom, ram);
+        controller = std::make_shared<MBC3_Controller>(cart_type, rom, ram, bank_state);
     } else if(cart_type.MBC5) {
-        controller = std::make_shared<MBC5_Controller>(cart_type, rom, ram);
+        controller = std::make_shared<MBC5_Controller>(cart_type, rom, ram, bank_state);
     } else if(cart_type.MBC6) {
         LogFatal("Cartridge") << "MBC6 not supported, emulator will now crash";
     } else if(cart_type.MBC7) {
@@ -115,7 +133,8 @@ Cartridge::Cartridge(const std::shared_ptr<Silver::File> &f) :
     }
 
     // debug info
-    LogInfo("Cartridge") << "loaded cartridge: " << rom_file->getFilename();
+    LogInfo("Cartridge") << "loaded cartridge: " << rom_file->getFilename()
+                         << (rom_file->isInMemory() ? " (compressed)" : "");
     LogInfo("Cartridge") << "cart title: " << getCartTitle();
     LogInfo("Cartridge") << "cart type: " << (std::string)getCartType();
     LogInfo("Cartridge") << "cart rom:  " << getROMSize();
@@ -124,8 +143,14 @@ Cartridge::Cartridge(const std::shared_ptr<Silver::File> &f) :
     }
 }
 
+Cartridge::Cartridge(Cartridge const &other, std::span<u8> ram_backing, MemoryBankController::state_t *bank_state) :
+    rom_file(other.rom_file), rom_data(other.rom_data), cart_type(other.cart_type), is_fork(true) {
+    controller = other.controller->clone(ram_backing.first(other.controller->ram_data.size()), bank_state);
+}
+
 Cartridge::~Cartridge() {
-    if(cart_type.BATTERY) {
+    // the .sav belongs to the core that loaded it
+    if(cart_type.BATTERY && !is_fork) {
         saveRAMFile(get_ram_file_name(rom_file->getFilename()), controller->ram_data);
     }
 };
@@ -248,3 +273,9 @@ bool Cartridge::checkGlobalChecksum() const {
 // forward IO calls to controller interface
 u8   Cartridge::read(u16 offset) { return controller->read(offset); }
 void Cartridge::write(u16 offset, u8 data) { controller->write(offset, data); }
+
+const u8 *Cartridge::map_read(u16 offset, u16 len) { return controller->map_read(offset, len); }
+
+u16       Cartridge::getROMBank(u16 offset) {
+    return offset <= CART_ROM_BANK1_END ? controller->get_rom_bank(offset) : 0;
+}
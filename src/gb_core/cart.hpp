@@ -1,12 +1,16 @@
 #pragma once
 
 #include <memory>
+#include <span>
 #include <string>
+#include <vector>
 
 #include "util/file.hpp"
 #include "util/types/primitives.hpp"
 #include "util/types/vector.hpp"
 
+#include "defs.hpp"
+
 #if !defined(_MSC_VER)
 #define return_cart_type(...) \
     { return (__cart_type_t) {__VA_ARGS__}; }
@@ -252,30 +256,100 @@ namespace Cartridge_Constants {
 struct MemoryBankController {
     friend class Cartridge;
 
+    /**
+     * Banking registers and the MBC3 clock, lives in the core's machine_state_t. One layout for every controller, each
+     * only uses its own fields
+     */
+    struct state_t {
+        bool ram_enable;
+        u16  ram_bank, rom_bank, rom_0_bank;
+
+        // MBC1, the upper ROM bank bits or the RAM bank depending on the banking mode
+        u8   addl_bank_num;
+
+        // MBC3
+        union rtc_t {
+            struct rtc_regs {
+                u8  seconds;
+                u8  minutes;
+                u8  hours;
+                u16 days  : 9;
+                u8  __pad : 5;
+                u8  halt  : 1;
+                u8  carry : 1;
+            } regs;
+            u8 data[5];
+        };
+
+        u8    active_reg;
+        bool  read_ram, latch;
+        u32   rtc_cntr;
+        rtc_t active, latched;
+
+        // MBC5
+        bool  rumble_state;
+    };
+
     virtual u8   read(u16 offset)           = 0;
     virtual void write(u16 offset, u8 data) = 0;
     virtual void tick() { };
 
+    /**
+     * Pointer to the len bytes currently mapped at offset, for bulk transfers
+     * @return nullptr if the range isn't plain memory in the current banking state (RTC registers, disabled RAM, ...)
+     */
+    virtual const u8 *map_read(u16 offset, u16 len) { return nullptr; }
+
+    /**
+     * ROM bank currently mapped at offset (0x0000-0x7FFF)
+     */
+    virtual u16       get_rom_bank(u16 offset) { return offset > CART_ROM_BANK0_END ? 1 : 0; }
+
+    /**
+     * Copy of this controller on the same ROM, with its RAM in `ram` and its banking state in `state`. Both must
+     * already hold copies of this controller's
+     */
+    virtual std::shared_ptr<MemoryBankController> clone(std::span<u8> ram, state_t *state) const = 0;
+
 protected:
     MemoryBankController(
-            Cartridge_Constants::cart_type_t const &cart_type, Silver::vector<u8> const &rom_data,
-            Silver::vector<u8> const &ram_data) :
-        cart_type(cart_type), rom_data(rom_data), ram_data(ram_data) { }
+            Cartridge_Constants::cart_type_t const &cart_type, std::span<const u8> rom_data, std::span<u8> ram_data,
+            state_t *state) :
+        cart_type(cart_type), rom_data(rom_data), ram_data(ram_data), state(state) { }
     virtual ~MemoryBankController() { }
 
+    template<typename T>
+    static std::shared_ptr<MemoryBankController> clone_as(T const &self, std::span<u8> ram, state_t *state) {
+        auto copy      = std::make_shared<T>(self);
+        copy->ram_data = ram;
+        copy->state    = state;
+        return copy;
+    }
+
     Cartridge_Constants::cart_type_t cart_type;
 
-    Silver::vector<u8>               rom_data;
-    Silver::vector<u8>               ram_data;
+    std::span<const u8>              rom_data; // owned by the Cartridge, shared by its forks
+    std::span<u8>                    ram_data; // backed by the core's machine_state_t
+    state_t                         *state;    // lives in the core's machine_state_t
 };
 
 class Cartridge {
 public:
-    explicit Cartridge(const std::shared_ptr<Silver::File> &f);
+    /**
+     * @param ram_backing storage for cartridge RAM, must hold at least getRAMSize() bytes
+     * @param bank_state storage for the MBC's registers
+     */
+    Cartridge(const std::shared_ptr<Silver::File> &f, std::span<u8> ram_backing,
+              MemoryBankController::state_t *bank_state);
+    /**
+     * Fork of `other` with its RAM in `ram_backing` and its banking state in `bank_state`, both copies of `other`'s.
+     * The ROM is shared. Forks never write battery RAM back to disk
+     */
+    Cartridge(Cartridge const &other, std::span<u8> ram_backing, MemoryBankController::state_t *bank_state);
     ~Cartridge();
 
-    bool                             loadRAMFile(const std::string &ram_file_name, std::vector<u8> &ram_buffer);
-    bool                             saveRAMFile(const std::string &ram_file_name, std::vector<u8> const &ram_buffer);
+    bool                             loadRAMFile(const std::string &ram_file_name, std::span<u8> ram_buffer);
+    bool                             saveRAMFile(const std::string &ram_file_name, std::span<const u8> ram_buffer);
 
     bool                             checkMagicNumber() const;
 
@@ -305,10 +379,19 @@ public:
     u8                               read(u16 offset);
     void                             write(u16 offset, u8 data);
 
+    const u8                        *map_read(u16 offset, u16 len);
+
+    /**
+     * ROM bank mapped at offset, 0 for anything outside of cartridge ROM
+     */
+    u16                              getROMBank(u16 offset);
+
 private:
-    std::shared_ptr<Silver::File>         rom_file;
+    std::shared_ptr<Silver::File>          rom_file;
+    std::shared_ptr<const std::vector<u8>> rom_data;
 
-    std::shared_ptr<MemoryBankController> controller;
+    std::shared_ptr<MemoryBankController>  controller;
 
-    Cartridge_Constants::cart_type_t      cart_type;
+    Cartridge_Constants::cart_type_t       cart_type;
+    bool                                   is_fork = false;
 };
\ No newline at end of file
@@ -10,12 +10,18 @@
 
 struct MBC1_Controller: public MBC1_Base {
     MBC1_Controller(
-            Cartridge_Constants::cart_type_t const &cart_type, std::vector<u8> const &rom, std::vector<u8> const &ram) :
-        MBC1_Base(cart_type, rom, ram), addl_bank_num(0) {
+            Cartridge_Constants::cart_type_t const &cart_type, std::span<const u8> rom, std::span<u8> ram,
+            state_t *state) :
+        MBC1_Base(cart_type, rom, ram, state) {
+        state->addl_bank_num = 0;
         MBC1_Base::set_rom_0_bank(0);
         MBC1_Base::set_rom_bank(1);
     }
 
+    std::shared_ptr<MemoryBankController> clone(std::span<u8> ram, state_t *state) const override {
+        return clone_as(*this, ram, state);
+    }
+
     u8 read(u16 offset) override {
         if(bounded(offset, 0x0000_u16, 0x7FFF_u16)) {
             return MBC1_Base::read(offset);
@@ -37,14 +43,14 @@ struct MBC1_Controller: public MBC1_Base {
             }
             MBC1_Base::set_rom_bank(rom_bank_num);
         } else if(bounded(offset, 0x4000_u16, 0x5FFF_u16)) {
-            addl_bank_num = data & 0x03;
+            state->addl_bank_num = data & 0x03;
         } else if(bounded(offset, 0x6000_u16, 0x7FFF_u16)) {
             bool set = Bit::test(data, 0);
 
             if(rom_data.size() >= Cartridge_Constants::ROM_SZ_1M) {
-                set_rom_0_bank((set) ? (addl_bank_num << 6) : 0);
+                set_rom_0_bank((set) ? (state->addl_bank_num << 6) : 0);
             } else if(ram_data.size() > Cartridge_Constants::RAM_SZ_8K) {
-                set_ram_bank((set) ? addl_bank_num : 0);
+                set_ram_bank((set) ? state->addl_bank_num : 0);
             }
         } else if(bounded(offset, 0xA000_u16, 0xBFFF_u16)) {
             MBC1_Base::write(offset, data);
@@ -52,7 +58,4 @@ struct MBC1_Controller: public MBC1_Base {
             LogError("MBC1") << "write out of bounds: " << offset;
         }
     }
-
-private:
-    u8 addl_bank_num;
 };
\ No newline at end of file
@@ -14,14 +14,25 @@
  */
 struct MBC2_Controller: public MemoryBankController {
     MBC2_Controller(
-            Cartridge_Constants::cart_type_t const &cart_type, std::vector<u8> const &rom, std::vector<u8> const &ram) :
-        MemoryBankController(cart_type, rom, ram) {
+            Cartridge_Constants::cart_type_t const &cart_type, std::span<const u8> rom, std::span<u8> ram,
+            state_t *state) :
+        MemoryBankController(cart_type, rom, ram, state) {
         LogError("MBC2") << "MBC2 not yet implemented. Will probably crash now";
         if(cart_type.RAM) {
             this->ram = ram;
         }
 
-        ram_enable = false;
+        state->ram_enable = false;
+    }
+
+    std::shared_ptr<MemoryBankController> clone(std::span<u8> ram, state_t *state) const override {
+        auto copy      = std::make_shared<MBC2_Controller>(*this);
+        copy->ram_data = ram;
+        copy->state    = state;
+        if(cart_type.RAM) {
+            copy->ram = ram;
+        }
+        return copy;
     }
 
     u8   read(u16 offset) override { return 0; }
@@ -29,9 +40,8 @@ struct MBC2_Controller: public MemoryBankController {
     void write(u16 offset, u8 data) override { }
 
 private:
-    std::vector<u8>  ram;
+    std::span<u8>    ram;
 
-    bool             ram_enable;
     u8               rom_bank_num  = 0;
     // true = ram_banking, false = rom_banking
     bool             mode_select   = false;
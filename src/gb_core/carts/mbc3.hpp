@@ -14,17 +14,29 @@
  */
 struct MBC3_Controller: public MBC1_Base {
     MBC3_Controller(
-            Cartridge_Constants::cart_type_t const &cart_type, std::vector<u8> const &rom, std::vector<u8> const &ram) :
-        MBC1_Base(cart_type, rom, ram) { }
+            Cartridge_Constants::cart_type_t const &cart_type, std::span<const u8> rom, std::span<u8> ram,
+            state_t *state) :
+        MBC1_Base(cart_type, rom, ram, state) {
+        state->active_reg = 0;
+        state->read_ram   = true;
+        state->latch      = false;
+        state->rtc_cntr   = 0;
+        state->active     = {};
+        state->latched    = {};
+    }
+
+    std::shared_ptr<MemoryBankController> clone(std::span<u8> ram, state_t *state) const override {
+        return clone_as(*this, ram, state);
+    }
 
     u8 read(u16 offset) override {
         if(bounded(offset, 0x0000_u16, 0x7FFF_u16)) {
             return MBC1_Base::read(offset);
         } else if(bounded(offset, 0xA000_u16, 0xBFFF_u16)) {
-            if(read_ram) {
+            if(state->read_ram) {
                 return MBC1_Base::read(offset);
             } else {
-                return latched.data[active_reg];
+                return state->latched.data[state->active_reg];
             }
         } else {
             LogError("MBC3") << "read out of bounds: " << offset;
@@ -32,6 +44,14 @@ struct MBC3_Controller: public MBC1_Base {
         }
     }
 
+    const u8 *map_read(u16 offset, u16 len) override {
+        // the RTC registers aren't backed by memory
+        if(bounded(offset, 0xA000_u16, 0xBFFF_u16) && !state->read_ram) {
+            return nullptr;
+        }
+        return MBC1_Base::map_read(offset, len);
+    }
+
     void write(u16 offset, u8 data) override {
         if(bounded(offset, 0_u16, 0x1FFF_u16)) {
             MBC1_Base::set_ram_enable((data & 0xf) == 0xA);
@@ -43,21 +63,19 @@ struct MBC3_Controller: public MBC1_Base {
             MBC1_Base::set_rom_bank(rom_bank_num);
         } else if(bounded(offset, 0x4000_u16, 0x5FFF_u16)) {
             if(Bit::test(data, 3) && data <= 0xC) {
-                read_ram   = false;
-                active_reg = data - 0x8;
+                state->read_ram   = false;
+                state->active_reg = data - 0x8;
             } else {
-                read_ram = true;
+                state->read_ram = true;
                 set_ram_bank(data & 0x7);
             }
         } else if(bounded(offset, 0x6000_u16, 0x7FFF_u16)) {
-            static bool latch     = false;
-
             // simulate rising edge detection;
-            bool        new_latch = Bit::test(data, 0);
-            if(!latch && new_latch) {
-                latched = active;
+            bool new_latch = Bit::test(data, 0);
+            if(!state->latch && new_latch) {
+                state->latched = state->active;
             }
-            latch = new_latch;
+            state->latch = new_latch;
 
         } else if(bounded(offset, 0xA000_u16, 0xBFFF_u16)) {
             MBC1_Base::write(offset, data);
@@ -67,53 +85,35 @@ struct MBC3_Controller: public MBC1_Base {
     }
 
     void tick() override {
-        static u32 cntr = 0;
-
-        if(!active.regs.halt) {
-            cntr++;
+        auto &rtc = state->active.regs;
+        if(!rtc.halt) {
+            state->rtc_cntr++;
         }
 
         // only tick once per second
-        if(cntr == 4194304) {
-            cntr = 0;
+        if(state->rtc_cntr == 4194304) {
+            state->rtc_cntr = 0;
 
-            active.regs.seconds++;
-            if(active.regs.seconds == 60) {
-                active.regs.seconds = 0;
+            rtc.seconds++;
+            if(rtc.seconds == 60) {
+                rtc.seconds = 0;
 
-                active.regs.minutes++;
-                if(active.regs.minutes == 60) {
-                    active.regs.minutes = 0;
+                rtc.minutes++;
+                if(rtc.minutes == 60) {
+                    rtc.minutes = 0;
 
-                    active.regs.hours++;
-                    if(active.regs.hours == 24) {
-                        active.regs.hours = 0;
+                    rtc.hours++;
+                    if(rtc.hours == 24) {
+                        rtc.hours = 0;
 
-                        active.regs.days++;
-                        if(active.regs.days == 0x1FF) {
-                            active.regs.days  = 0;
-                            active.regs.carry = 1;
+                        rtc.days++;
+                        if(rtc.days == 0x1FF) {
+                            rtc.days  = 0;
+                            rtc.carry = 1;
                         }
                     }
                 }
             }
         }
     }
-
-private:
-    int  active_reg;
-    bool read_ram;
-
-    union {
-        struct rtc_regs {
-            u8  seconds;
-            u8  minutes;
-            u8  hours;
-            u16 days  : 9;
-            u8  __pad : 5;
-            u8  halt  : 1;
-            u8  carry : 1;
-        } regs;
-        u8 data[5];
-    } active = {{0}}, latched = {{0}};
 };
\ No newline at end of file
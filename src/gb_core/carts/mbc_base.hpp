@@ -10,25 +10,26 @@
 
 struct MBC1_Base: public MemoryBankController {
     MBC1_Base(
-            Cartridge_Constants::cart_type_t const &cart_type, std::vector<u8> const &rom, std::vector<u8> const &ram) :
-        MemoryBankController(cart_type, rom, ram) {
-        ram_enable = false;
-        ram_bank   = 0;
-        rom_bank   = 0;
-        rom_0_bank = 0;
+            Cartridge_Constants::cart_type_t const &cart_type, std::span<const u8> rom, std::span<u8> ram,
+            state_t *state) :
+        MemoryBankController(cart_type, rom, ram, state) {
+        state->ram_enable = false;
+        state->ram_bank   = 0;
+        state->rom_bank   = 0;
+        state->rom_0_bank = 0;
     }
 
-    virtual void set_rom_0_bank(u16 rom_bank) { this->rom_0_bank = rom_bank; }
+    virtual void set_rom_0_bank(u16 rom_bank) { state->rom_0_bank = rom_bank; }
 
-    virtual void set_rom_bank(u16 rom_bank) { this->rom_bank = rom_bank; }
+    virtual void set_rom_bank(u16 rom_bank) { state->rom_bank = rom_bank; }
 
-    virtual void set_ram_bank(u16 ram_bank) { this->ram_bank = ram_bank; }
+    virtual void set_ram_bank(u16 ram_bank) { state->ram_bank = ram_bank; }
 
-    virtual void set_ram_enable(bool ram_enable = true) { this->ram_enable = ram_enable; }
+    virtual void set_ram_enable(bool ram_enable = true) { state->ram_enable = ram_enable; }
 
     u8           read(u16 offset) override {
         if(bounded(offset, CART_ROM_BANK0_START, CART_ROM_BANK0_END)) {
-            u32 addr = (u32)offset + (rom_0_bank * ROM_BANK_SIZE);
+            u32 addr = (u32)offset + (state->rom_0_bank * ROM_BANK_SIZE);
 
             if(addr < rom_data.size()) {
                 return rom_data[addr];
@@ -38,7 +39,7 @@ struct MBC1_Base: public MemoryBankController {
         } else if(bounded(offset, CART_ROM_BANK1_START, CART_ROM_BANK1_END)) {
             offset -= CART_ROM_BANK1_START;
 
-            u32 addr = (u32)offset + (rom_bank * ROM_BANK_SIZE);
+            u32 addr = (u32)offset + (state->rom_bank * ROM_BANK_SIZE);
 
             if(addr < rom_data.size()) {
                 return rom_data[addr];
@@ -48,9 +49,9 @@ struct MBC1_Base: public MemoryBankController {
         } else if(bounded(offset, CART_RAM_START, CART_RAM_END)) {
             offset -= CART_RAM_START;
 
-            u32 addr = (u32)offset + (ram_bank * RAM_BANK_SIZE);
+            u32 addr = (u32)offset + (state->ram_bank * RAM_BANK_SIZE);
 
-            if(cart_type.RAM && ram_enable && addr < ram_data.size()) {
+            if(cart_type.RAM && state->ram_enable && addr < ram_data.size()) {
                 return ram_data[addr];
             } else {
                 return 0;
@@ -61,13 +62,31 @@ struct MBC1_Base: public MemoryBankController {
         }
     }
 
+    u16 get_rom_bank(u16 offset) override {
+        return offset <= CART_ROM_BANK0_END ? state->rom_0_bank : state->rom_bank;
+    }
+
+    const u8 *map_read(u16 offset, u16 len) override {
+        if(bounded(offset, CART_ROM_BANK0_START, CART_ROM_BANK0_END)) {
+            u32 addr = (u32)offset + (state->rom_0_bank * ROM_BANK_SIZE);
+            return (addr + len <= rom_data.size()) ? &rom_data[addr] : nullptr;
+        } else if(bounded(offset, CART_ROM_BANK1_START, CART_ROM_BANK1_END)) {
+            u32 addr = (u32)(offset - CART_ROM_BANK1_START) + (state->rom_bank * ROM_BANK_SIZE);
+            return (addr + len <= rom_data.size()) ? &rom_data[addr] : nullptr;
+        } else if(bounded(offset, CART_RAM_START, CART_RAM_END)) {
+            u32 addr = (u32)(offset - CART_RAM_START) + (state->ram_bank * RAM_BANK_SIZE);
+            return (cart_type.RAM && state->ram_enable && addr + len <= ram_data.size()) ? &ram_data[addr] : nullptr;
+        }
+        return nullptr;
+    }
+
     void write(u16 offset, u8 data) override {
         if(bounded(offset, CART_RAM_START, CART_RAM_END)) {
             offset -= CART_RAM_START;
 
-            u32 addr = (u32)offset + (ram_bank * RAM_BANK_SIZE);
+            u32 addr = (u32)offset + (state->ram_bank * RAM_BANK_SIZE);
 
-            if(cart_type.RAM && ram_enable && addr < ram_data.size()) {
+            if(cart_type.RAM && state->ram_enable && addr < ram_data.size()) {
                 ram_data[addr] = data;
             }
         } else {
@@ -78,7 +97,4 @@ struct MBC1_Base: public MemoryBankController {
 protected:
     static const u16 ROM_BANK_SIZE = 0x4000;
     static const u16 RAM_BANK_SIZE = 0x2000;
-
-    bool             ram_enable    = false;
-    u16              ram_bank = 0, rom_bank = 0, rom_0_bank = 0;
 };
\ No newline at end of file
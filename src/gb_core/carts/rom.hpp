@@ -11,15 +11,20 @@
  */
 struct ROM_Controller: public MemoryBankController {
     ROM_Controller(
-            Cartridge_Constants::cart_type_t const &cart_type, std::vector<u8> const &rom, std::vector<u8> const &ram) :
-        MemoryBankController(cart_type, rom, ram) { }
+            Cartridge_Constants::cart_type_t const &cart_type, std::span<const u8> rom, std::span<u8> ram,
+            state_t *state) :
+        MemoryBankController(cart_type, rom, ram, state) { }
+
+    std::shared_ptr<MemoryBankController> clone(std::span<u8> ram, state_t *state) const override {
+        return clone_as(*this, ram, state);
+    }
 
     u8 read(u16 offset) override {
         if(offset <= CART_ROM_BANK1_END) {
             return MemoryBankController::rom_data[offset];
         } else if(offset >= CART_RAM_START && offset <= CART_RAM_END) {
             offset -= CART_RAM_START;
-            if(cart_type.RAM) {
+            if(cart_type.RAM && offset < ram_data.size()) {
                 return ram_data[offset];
             } else {
                 return 0;
@@ -30,10 +35,21 @@ struct ROM_Controller: public MemoryBankController {
         }
     }
 
+    const u8 *map_read(u16 offset, u16 len) override {
+        if(offset <= CART_ROM_BANK1_END) {
+            return (offset + len <= rom_data.size()) ? &rom_data[offset] : nullptr;
+        } else if(offset >= CART_RAM_START && offset <= CART_RAM_END) {
+            offset -= CART_RAM_START;
+            return (cart_type.RAM && offset + len <= ram_data.size()) ? &ram_data[offset] : nullptr;
+        }
+        return nullptr;
+    }
+
     void write(u16 offset, u8 data) override {
         if(offset >= CART_RAM_START && offset <= CART_RAM_END) {
             offset -= CART_RAM_START;
-            if(cart_type.RAM) {
+            // the header can declare less RAM than the 8KB window, or none at all
+            if(cart_type.RAM && offset < ram_data.size()) {
                 MemoryBankController::ram_data[offset] = data;
             }
         } else {
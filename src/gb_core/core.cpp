@@ -2,13 +2,17 @@
 
 #include <algorithm>
 #include <array>
+#include <bit>
 #include <chrono>
+#include <cstring>
 #include <vector>
 
 #include "util/bit.hpp"
 #include "util/log.hpp"
+#include "util/timeline.hpp"
 #include "util/types/pixel.hpp"
 
+#include "capture.hpp"
 #include "defs.hpp"
 #include "joy.hpp"
 #include "ppu.hpp"
@@ -18,7 +22,7 @@ using namespace jnk0le;
 namespace Silver {
     Core::Core(
             const std::shared_ptr<Silver::File> &rom, const std::optional<std::shared_ptr<Silver::File>> &bootrom,
-            gb_device_t device) :
+            gb_device_t device, PPU::output_mode_t output) :
         device(device) {
         // the Audio buffering system is threaded because it's simpler
         // luckily we have a single audio producer(main thread) and a single consumer(audio thread)
@@ -50,83 +54,173 @@ namespace Silver {
         //    +----------+-------------------+-> | MEM |
         //                                       +-----+
 
+        // all of the machine's state, RAM and registers included, lives in one cache-aligned block, the components
+        // below only hold views into it
+        state = new machine_state_t {};
+
         // TOOD: switch to smart pointers
-        cart = new Cartridge(rom);
-        mem  = new Memory(device, bootrom.has_value());
+        cart  = new Cartridge(rom, state->cart_ram, &state->mbc);
+        mem   = new Memory(state, device, bootrom.has_value());
+
+        apu  = new APU(&state->apu, bootrom.has_value());
+        ppu  = new PPU(cart, mem, &state->ppu, device, bootrom.has_value(), output);
+        joy  = new Joypad(mem, &state->joypad);
+
+        io   = new IO_Bus(mem, apu, ppu, joy, cart, &state->bus, device, bootrom);
+        cpu  = new CPU(mem, io, &state->cpu, &breakpoints, device, bootrom.has_value());
+
+        attach_perf_counters();
+    }
+
+    Core::Core(Core const &parent) :
+        device(parent.device), frame_ready(parent.frame_ready), audio_vector(parent.audio_vector),
+        audio_tick_cntr(parent.audio_tick_cntr), exec_path(parent.exec_path) {
+        audio_queue = new Ringbuffer<std::array<float, 2048>, 4>();
+        audio_vector.reserve(2048);
+
+        // copied whole rather than page by page on first write, it's ~180KB and a copy-on-write check would sit on
+        // every RAM store
+        state = new machine_state_t(*parent.state);
 
-        apu  = new APU(bootrom.has_value());
-        ppu  = new PPU(cart, mem, device, bootrom.has_value());
-        joy  = new Joypad(mem);
+        cart  = new Cartridge(*parent.cart, state->cart_ram, &state->mbc);
+        mem   = new Memory(*parent.mem, state, *parent.state);
 
-        io   = new IO_Bus(mem, apu, ppu, joy, cart, device, bootrom);
-        cpu  = new CPU(mem, io, device, bootrom.has_value());
+        apu  = new APU(*parent.apu, &state->apu);
+        ppu  = new PPU(*parent.ppu, cart, mem, &state->ppu);
+        joy  = new Joypad(*parent.joy, mem, &state->joypad);
+
+        io   = new IO_Bus(*parent.io, mem, apu, ppu, joy, cart, state, *parent.state);
+        cpu  = new CPU(*parent.cpu, mem, io, &state->cpu, &breakpoints);
+
+        attach_perf_counters();
+    }
+
+    std::unique_ptr<Core> Core::fork() const { return std::unique_ptr<Core>(new Core(*this)); }
+
+    void                  Core::attach_perf_counters() {
+        if constexpr(perf_counters_enabled) {
+            cpu->set_perf_counters(&perf_frame);
+            io->set_perf_counters(&perf_frame);
+            ppu->set_perf_counters(&perf_frame);
+        }
     }
 
     Core::~Core() {
+        delete vram_view;
+        delete profiler;
+        delete trace;
         delete cpu;
         delete io;
         delete joy;
         delete ppu;
         delete apu;
         delete mem;
-        delete cart;
+        delete cart; // saves battery RAM out of the arena, so must go first
+        delete state;
         delete audio_queue;
     }
 
     /**
      * Tick Functions
      */
-    void Core::tick_once() {
-        // can't check breakpoints on single tick functions
-        cpu->tick();
-        apu->tick();
-        this->frame_ready = ppu->tick();
+    template<bool Debug>
+    BreakReason Core::run(int clocks) {
+        do {
+            perf_sampler.begin();
+            cpu->tick<Debug>();
+            perf_sampler.lap(perf_frame.cpu_ns);
+
+            if constexpr(Debug) {
+                // the CPU stopped right before an instruction fetch, the rest of this clock runs when it resumes
+                if(cpu->stopped_at_breakpoint()) {
+                    return breakpoints.take_hit();
+                }
+            }
+
+            apu->tick();
+            perf_sampler.lap(perf_frame.apu_ns);
+            this->frame_ready = ppu->tick();
+            perf_sampler.lap(perf_frame.ppu_ns);
+            sample_audio();
+
+            if(this->frame_ready) {
+                end_perf_frame();
+                if(capture) {
+                    capture->push_frame(ppu->getPixelBuffer());
+                }
+            }
+
+            if constexpr(Debug) {
+                // watchpoints let the instruction finish
+                if(breakpoints.hit_pending()) {
+                    return breakpoints.take_hit();
+                }
+            }
+        } while(clocks < 0 ? !this->frame_ready : --clocks > 0);
+
+        return BreakReason::None;
     }
 
-    void Core::tick_instr() {
-        for(int i = 0; i < 4; i++) {
-            tick_once();
+    void Core::sample_audio() {
+        // TODO: this should be dynamic. probably adjusting the live sampling rate to keep the buffer from over or
+        // underflowing.
+        //  90 tends to underflow every couple frames, while 85 keeps buffer sizes at 2-3x higher than the callback
+        //  copy size. the ideal rate right now seems to be 87, it will underflow every couple seconds
+        if(audio_tick_cntr++ == 87) {
+            float left, right;
+            apu->sample(&left, &right);
+            audio_vector.push_back(left);
+            audio_tick_cntr = 0;
+        }
+
+        if(audio_vector.size() == audio_buffer_sz) {
+            if(capture) {
+                capture->push_audio(audio_vector);
+            }
+
+            AudioBuffer buf;
+            std::copy(audio_vector.begin(), audio_vector.end(), buf.begin());
+            audio_vector.clear();
+
+            audio_queue->insert(buf);
         }
+    }
 
-        if(cpu->getRegisters().PC == breakpoint && bp_active) {
-            bp_active = false;
-            throw breakpoint_exception();
+    BreakReason Core::dispatch_run(int clocks) {
+        // a stopped CPU has to finish its clock through the same path it stopped on
+        if(!breakpoints.empty() || cpu->stopped_at_breakpoint() || exec_path == ExecPath::Accurate) {
+            return run<true>(clocks);
         }
+        return run<false>(clocks);
     }
 
-    void Core::tick_frame() {
-        u8   tick_cntr = 0;
-        bool instr_completed;
+    BreakReason Core::tick_once() { return dispatch_run(1); }
 
+    BreakReason Core::tick_instr() {
+        // the instruction executes on its first clock, run out the rest so the next call starts on a fetch. In double
+        // speed an instruction can start on the second half of a clock, there is no such point then and this stops on
+        // the clock that executed the next instruction instead
+        BreakReason reason;
+        bool        frame_done = false, fetched = false;
         do {
-            instr_completed = cpu->tick();
-            apu->tick();
-            this->frame_ready = ppu->tick();
-
-            if(bp_active && instr_completed && cpu->getRegisters().PC == breakpoint) {
-                bp_active = false;
-                throw breakpoint_exception();
-            }
+            u8 clocks_left  = state->cpu.inst_clocks;
+            reason          = dispatch_run(1);
+            frame_done     |= this->frame_ready;
 
-            // TODO: this should be dynamic. probably adjusting the live sampling rate to keep the buffer from over or
-            // underflowing.
-            //  90 tends to underflow every couple frames, while 85 keeps buffer sizes at 2-3x higher than the callback
-            //  copy size. the ideal rate right now seems to be 87, it will underflow every couple seconds
-            if(tick_cntr++ == 87) {
-                float left, right;
-                apu->sample(&left, &right);
-                audio_vector.push_back(left);
-                tick_cntr = 0;
+            if(clocks_left && state->cpu.inst_clocks > clocks_left) {
+                break;
             }
+            fetched |= !clocks_left;
+        } while(reason == BreakReason::None && !(fetched && cpu->at_instruction_boundary()));
 
-            if(audio_vector.size() == audio_buffer_sz) {
-                AudioBuffer buf;
-                std::copy(audio_vector.begin(), audio_vector.end(), buf.begin());
-                audio_vector.clear();
+        // report a frame that finished on any of the instruction's clocks, not just the last one
+        this->frame_ready = frame_done;
+        return reason;
+    }
 
-                audio_queue->insert(buf);
-            }
-        } while(!this->frame_ready);
+    BreakReason Core::tick_frame() {
+        TimelineSpan("Core::tick_frame");
+        return dispatch_run(-1);
     }
 
     // TODO: check this implementation later
@@ -164,6 +258,9 @@ namespace Silver {
 
     void Core::do_audio_callback(float *buff, int copy_cnt) {
         if(audio_queue->isEmpty()) {
+            if constexpr(perf_counters_enabled) {
+                audio_underflows.fetch_add(1, std::memory_order_relaxed);
+            }
             LogWarn("Core") << "audio buffer underflow";
             memset(buff, 0, copy_cnt * 4);
         } else {
@@ -180,6 +277,18 @@ namespace Silver {
 
     const std::vector<Silver::Pixel> &Core::getPixelBuffer() { return this->ppu->getPixelBuffer(); }
 
+    std::span<const u8>               Core::getOutputBuffer() const { return this->ppu->getOutputBuffer(); }
+
+    PPU::output_mode_t const         &Core::getOutputMode() const { return this->ppu->getOutputMode(); }
+
+    std::span<const u64, Core::native_height> Core::getLineHashes() const { return this->ppu->getLineHashes(); }
+
+    u64 Core::getFrameHash() const { return this->ppu->getFrameHash(); }
+
+    std::string const &Core::getSerialOutput() const { return this->io->serial_output(); }
+
+    void Core::clearSerialOutput() { this->io->clear_serial_output(); }
+
     /**
      * Util Functions
      */
@@ -191,8 +300,39 @@ namespace Silver {
 
     CPU::registers_t       Core::getRegistersFromCPU() { return cpu->getRegisters(); }
 
+    void                   Core::setRegistersInCPU(CPU::registers_t const &regs) { cpu->setRegisters(regs); }
+
     Memory::io_registers_t Core::getregistersfromIO() { return mem->registers; }
 
+    u8                     Core::getByteFromIO(u16 addr) { return io->read(addr, true); }
+
+    void                   Core::setByteInIO(u16 addr, u8 value) { io->write(addr, value, true); }
+
+    u8                     Core::disassemble(u16 addr, char *buf, size_t buf_len) {
+        auto read_bytes = [this, addr](u8 *bytes) {
+            for(u16 i = 0; i < 3; i++) {
+                bytes[i] = io->read(addr + i, true);
+            }
+        };
+
+        // the boot ROM overlays the cartridge while it's mapped, so only cache what's really ROM, and not the last two
+        // bytes of a window whose operands come from whatever is mapped after it
+        constexpr u16 window_mask = DisassemblyCache::bank_size - 1;
+        if(addr < 0x8000 && (addr & window_mask) < window_mask - 1 && !io->bootrom_mapped()) {
+            auto const &line = disassembly_cache.get(cart->getROMBank(addr), addr, read_bytes);
+            if(buf_len) {
+                size_t len = std::min(strlen(line.text), buf_len - 1);
+                memcpy(buf, line.text, len);
+                buf[len] = '\0';
+            }
+            return line.length;
+        }
+
+        u8 bytes[3];
+        read_bytes(bytes);
+        return ::disassemble(addr, bytes, buf, buf_len);
+    }
+
     std::vector<u8>        Core::getOAMEntry(int index) {
         if(index >= 40) {
             return {};
@@ -222,18 +362,98 @@ namespace Silver {
         return ret_vec;
     }
 
+    /**
+     * State Functions
+     */
+    machine_state_t const &Core::getState() const {
+        mem->sync_oam_dma();
+        return *state;
+    }
+
+    void Core::saveState(machine_state_t &out) const {
+        mem->sync_oam_dma();
+        memcpy(&out, state, sizeof(machine_state_t));
+    }
+
+    void                   Core::loadState(machine_state_t const &in) {
+        memcpy(state, &in, sizeof(machine_state_t));
+        // saveState() applied the transferred bytes, a running DMA picks up from there
+        io->forget_dma_source();
+        mem->rebuild_sprite_index();
+        mem->vram_dirty.mark_all();
+        ppu->resync_output();
+    }
+
     /**
      * Breakpoint Functions
      */
-    void Core::set_bp(u16 bp, bool en) {
-        breakpoint = bp;
-        set_bp_active(en);
+    BreakpointSet &Core::getBreakpoints() { return breakpoints; }
+
+    /**
+     * Performance Counter Functions
+     */
+    void Core::end_perf_frame() {
+        if constexpr(perf_counters_enabled) {
+            perf_frame.frames = perf_last.frames + 1;
+            perf_last         = perf_frame;
+            perf_frame        = {};
+        }
+    }
+
+    perf_counters_t Core::getPerfCounters() const {
+        if constexpr(!perf_counters_enabled) {
+            return {};
+        }
+
+        perf_counters_t counters  = perf_last;
+        counters.audio_underflows = audio_underflows.load(std::memory_order_relaxed);
+        counters.audio_queue_fill = audio_queue->readAvailable();
+        return counters;
+    }
+
+    /**
+     * Profiler Functions
+     */
+    void           Core::setProfilingEnabled(bool enabled) {
+        if(enabled == (profiler != nullptr)) {
+            return;
+        }
+
+        if(enabled) {
+            profiler = new Profiler(cart);
+        } else {
+            delete profiler;
+            profiler = nullptr;
+        }
+        cpu->set_profiler(profiler);
+    }
+
+    Profiler *Core::getProfiler() { return profiler; }
+
+    /**
+     * Trace Functions
+     */
+    void      Core::setTracingEnabled(bool enabled, size_t entries) {
+        if(trace && (!enabled || trace->capacity() != std::bit_ceil(entries))) {
+            cpu->set_trace(nullptr);
+            delete trace;
+            trace = nullptr;
+        }
+
+        if(enabled && !trace) {
+            trace = new TraceBuffer(entries);
+            cpu->set_trace(trace);
+        }
     }
 
-    u16  Core::get_bp() { return breakpoint; }
+    TraceBuffer *Core::getTrace() { return trace; }
 
-    void Core::set_bp_active(bool en) { bp_active = en; }
-    bool Core::get_bp_active() { return bp_active; }
+    void         Core::setExecPath(ExecPath path) {
+        exec_path = path;
+        io->set_block_transfers(path == ExecPath::Fast);
+    }
+
+    void Core::setCapture(Capture *capture) { this->capture = capture; }
 
 #define Y_FLIP_BIT         6
 #define X_FLIP_BIT         5
@@ -302,10 +522,10 @@ namespace Silver {
                 u8 byte_1, byte_2;
                 std::tie(byte_1, byte_2)             = getTileLineByAddr(addr, vramBank);
 
-                std::array<PPU::fifo_color_t, 8> arr = {0};
+                std::array<PPU::fifo_color_t, 8> arr;
                 ppu->process_tile_line(arr, byte_1, byte_2, 0);
                 for(const auto &color : arr) {
-                    auto pixel = Silver::Pixel::makeFromRGB15(color.palette->colors[color.color_idx]);
+                    auto pixel = Silver::Pixel::makeFromRGB15(ppu->resolve_color(color));
                     vec.push_back(pixel);
                 }
             }
@@ -323,16 +543,165 @@ namespace Silver {
                 u8 byte_1, byte_2;
                 std::tie(byte_1, byte_2)             = getTileLineByAddr(tile_addr, BG_VRAM_BANK(bg_attr));
 
-                std::array<PPU::fifo_color_t, 8> arr = {0};
+                std::array<PPU::fifo_color_t, 8> arr;
                 ppu->process_tile_line(arr, byte_1, byte_2, bg_attr);
                 for(const auto &color : arr) {
-                    auto pixel = Silver::Pixel::makeFromRGB15(color.palette->colors[color.color_idx]);
+                    auto pixel = Silver::Pixel::makeFromRGB15(ppu->resolve_color(color));
                     vec.push_back(pixel);
                 }
             }
         }
     }
 
+    namespace {
+        // what drawing VRAM takes, from the live core or a vram_snapshot_t
+        struct tile_source_t {
+            u8 const             *vram; // both banks back to back
+            u8                    lcdc;
+            u8                    bgp;
+            bool                  gbc;  // CGB attributes and palettes, not in DMG compatibility mode
+            PPU::palette_t const *palettes;
+        };
+
+        struct map_entry_t {
+            u32 tile; // of the 384 in a bank
+            u8  bank;
+            u8  bg_attr;
+        };
+
+        // BG map entry `entry` of the map LCDC selects, with the same addressing as calcTileAddrForCoordinate
+        map_entry_t map_entry(tile_source_t const &src, u32 entry) {
+            u16 offset   = 0x1800 + (Bit::test(src.lcdc, 3) ? 0x400 : 0) + entry;
+            u8  tile_idx = src.vram[offset];
+            u8  bg_attr  = src.gbc ? src.vram[DMG_VRAM_SIZE + offset] : 0;
+
+            u32 tile     = Bit::test(tile_idx, 7) ? 0x80 + (tile_idx & 0x7F)
+                         : Bit::test(src.lcdc, 4) ? tile_idx
+                                                  : 0x100 + tile_idx;
+            return {tile, static_cast<u8>(src.gbc ? BG_VRAM_BANK(bg_attr) : 0), bg_attr};
+        }
+
+        // one tile the way PPU::process_tile_line() and resolve_color() would draw it, rows `stride` pixels apart
+        void decode_tile(tile_source_t const &src, u32 bank, u32 tile, u8 bg_attr, Pixel *out, u32 stride) {
+            bool                  x_flip  = src.gbc && BG_X_FLIP(bg_attr);
+            bool                  y_flip  = src.gbc && BG_Y_FLIP(bg_attr);
+            PPU::palette_t const &palette = src.palettes[src.gbc ? BG_PALETTE(bg_attr) : 0];
+            u8 const             *data    = src.vram + bank * DMG_VRAM_SIZE + tile * 16;
+
+            for(u32 line = 0; line < 8; line++) {
+                u8 const *bytes = data + (y_flip ? 7 - line : line) * 2;
+                for(int i = 0; i < 8; i++) {
+                    u8 x_pixel = x_flip ? i : 7 - i;
+                    u8 color   = ((bytes[0] >> x_pixel) & 1) | (((bytes[1] >> x_pixel) & 1) << 1);
+                    if(!src.gbc) {
+                        color = (src.bgp >> (color << 1)) & 0x3;
+                    }
+                    out[line * stride + i] = Pixel::makeFromRGB15(palette.colors[color]);
+                }
+            }
+        }
+
+        tile_source_t source_of(Core::vram_snapshot_t const &snap) {
+            return {snap.vram, snap.lcdc, snap.bgp, snap.gbc, snap.palettes};
+        }
+    } // namespace
+
+    bool Core::refreshVRAMView() {
+        bool full = !vram_view;
+        if(full) {
+            vram_view = new vram_view_t();
+        }
+
+        vram_view_t          &view  = *vram_view;
+        Memory::vram_dirty_t &dirty = mem->vram_dirty;
+
+        memset(view.changed_tile_rows, 0, sizeof(view.changed_tile_rows));
+        memset(view.changed_map_rows, 0, sizeof(view.changed_map_rows));
+
+        full = full || view.lcdc != reg(LCDC) || view.bgp != reg(BGP)
+            || memcmp(view.palettes, state->ppu.bg_palettes, sizeof(view.palettes)) != 0;
+        if(full) {
+            view.lcdc = reg(LCDC);
+            view.bgp  = reg(BGP);
+            memcpy(view.palettes, state->ppu.bg_palettes, sizeof(view.palettes));
+            dirty.mark_all();
+        }
+
+        bool          changed = false;
+        tile_source_t src     = {state->ppu_ram, reg(LCDC), reg(BGP), dev_is_GBC(device) && !mem->get_dmg_compat_mode(),
+                                 state->ppu.bg_palettes};
+
+        // tiles, drawn with the first BG palette
+        u64  redrawn[2][Memory::vram_dirty_t::tiles_per_bank / 64];
+        memcpy(redrawn, dirty.tiles, sizeof(redrawn));
+
+        for(int bank = 0; bank < 2; bank++) {
+            for(u32 word = 0; word < std::size(dirty.tiles[bank]); word++) {
+                for(u64 bits = dirty.tiles[bank][word]; bits; bits &= bits - 1) {
+                    u32    tile   = word * 64 + std::countr_zero(bits);
+                    u32    tile_x = tile & 15, tile_y = tile >> 4;
+                    Pixel *out    = &view.tiles[bank][(tile_y * 8) * vram_view_t::tiles_width + tile_x * 8];
+                    decode_tile(src, bank, tile, 0, out, vram_view_t::tiles_width);
+
+                    view.changed_tile_rows[bank][tile_y] |= 1 << tile_x;
+                    changed = true;
+                }
+            }
+        }
+
+        // the BG map LCDC points at, an entry is redrawn if it or the tile it shows changed
+        u16 map_base = Bit::test(reg(LCDC), 3) ? 0x400 : 0;
+
+        for(u16 entry = 0; entry < 32 * 32; entry++) {
+            map_entry_t map         = map_entry(src, entry);
+            u16         map_bit     = map_base + entry;
+            bool        entry_dirty = (dirty.map[map_bit >> 6] >> (map_bit & 63)) & 1;
+            bool        tile_dirty  = (redrawn[map.bank][map.tile >> 6] >> (map.tile & 63)) & 1;
+            if(!entry_dirty && !tile_dirty) {
+                continue;
+            }
+
+            u32    tile_x = entry & 31, tile_y = entry >> 5;
+            Pixel *out    = &view.map[(tile_y * 8) * vram_view_t::map_size + tile_x * 8];
+            decode_tile(src, map.bank, map.tile, map.bg_attr, out, vram_view_t::map_size);
+
+            view.changed_map_rows[tile_y] |= 1u << tile_x;
+            changed = true;
+        }
+
+        dirty.clear();
+        return changed;
+    }
+
+    Core::vram_view_t const &Core::getVRAMView() const { return *vram_view; }
+
+    void                     Core::snapshotVRAM(vram_snapshot_t &out) {
+        memcpy(out.vram, state->ppu_ram, sizeof(out.vram));
+        out.lcdc = reg(LCDC);
+        out.bgp  = reg(BGP);
+        out.gbc  = dev_is_GBC(device) && !mem->get_dmg_compat_mode();
+        memcpy(out.palettes, state->ppu.bg_palettes, sizeof(out.palettes));
+    }
+
+    void Core::decodeTiles(vram_snapshot_t const &snap, bool bank1, Pixel *out) {
+        tile_source_t src = source_of(snap);
+        for(u32 tile = 0; tile < 384; tile++) {
+            u32 tile_x = tile & 15, tile_y = tile >> 4;
+            decode_tile(src, bank1, tile, 0, &out[(tile_y * 8) * vram_view_t::tiles_width + tile_x * 8],
+                        vram_view_t::tiles_width);
+        }
+    }
+
+    void Core::decodeBGMap(vram_snapshot_t const &snap, Pixel *out) {
+        tile_source_t src = source_of(snap);
+        for(u32 entry = 0; entry < 32 * 32; entry++) {
+            map_entry_t map    = map_entry(src, entry);
+            u32         tile_x = entry & 31, tile_y = entry >> 5;
+            decode_tile(src, map.bank, map.tile, map.bg_attr, &out[(tile_y * 8) * vram_view_t::map_size + tile_x * 8],
+                        vram_view_t::map_size);
+        }
+    }
+
     // void Core::getWNDBuffer(std::vector<Pixel> &vec) {
     //     for(int y = 0; y < 256; y++) {
     //         for(int x_tile = 0; x_tile < 32; x_tile++) {
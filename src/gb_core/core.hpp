@@ -1,30 +1,43 @@
 #pragma once
 
+#include <atomic>
+#include <memory>
+
 #include "util/file.hpp"
 #include "util/types/pixel.hpp"
 #include "util/types/ringbuffer.hpp"
 
+#include "arena.hpp"
+#include "breakpoints.hpp"
 #include "cpu.hpp"
+#include "cpu_disassem.hpp"
 #include "defs.hpp"
 #include "io.hpp"
+#include "perf_counters.hpp"
 #include "ppu.hpp"
-
-struct breakpoint_exception {
-    breakpoint_exception() = default;
-};
+#include "profiler.hpp"
+#include "trace.hpp"
 
 namespace Silver {
 
+    class Capture;
+
     class Core {
     public:
         static constexpr u32 native_width       = PPU::native_width;
         static constexpr u32 native_height      = PPU::native_height;
         static constexpr u32 native_pixel_count = PPU::native_pixel_count;
+        // one mono sample every 88 clocks, see sample_audio()
+        static constexpr u32 audio_sample_rate  = 4194304 / 88;
 
+        /**
+         * @param output what the PPU draws into, see PPU::output_mode_t. Fixed for the core's lifetime and its forks
+         */
         explicit Core(
                 const std::shared_ptr<Silver::File>                &rom,
                 const std::optional<std::shared_ptr<Silver::File>> &bootrom = std::nullopt,
-                gb_device_t                                         device  = device_GBC);
+                gb_device_t                                         device  = device_GBC,
+                PPU::output_mode_t                                  output  = {});
         ~Core();
 
         // void                              init_thread(bool paused = true);
@@ -34,9 +47,16 @@ namespace Silver {
         // void                              stop_thread();
         // void                              run_thread();
 
-        void                              tick_once();
-        void                              tick_instr();
-        void                              tick_frame();
+        /**
+         * Run the machine, stopping early if a breakpoint or watchpoint is hit. tick_instr() runs until one
+         * instruction has executed and the next clock would fetch the one after it, is_frame_ready() is then set if a
+         * frame finished on any of its clocks
+         * @return BreakReason::None if the requested clocks ran to completion, otherwise why it stopped. See
+         * getBreakpoints().last_hit() for the details
+         */
+        BreakReason                       tick_once();
+        BreakReason                       tick_instr();
+        BreakReason                       tick_frame();
         void                              tick_delta_or_frame();
         //    void tick_audio_buffer(u8* buf, int buf_len);
 
@@ -45,10 +65,39 @@ namespace Silver {
         void                              set_input_state(Joypad::button_states_t const &state);
         void                              do_audio_callback(float *buff, int copy_cnt);
         const std::vector<Silver::Pixel> &getPixelBuffer();
+        std::span<const u8>               getOutputBuffer() const;
+        PPU::output_mode_t const         &getOutputMode() const;
+
+        /**
+         * Per-line and whole-frame hashes of the pixel buffer, see PPU::getLineHashes(). Redraws and uploads can be
+         * skipped while they don't change, and the frame hash can be compared across runs.
+         */
+        std::span<const u64, native_height> getLineHashes() const;
+        u64                                 getFrameHash() const;
+
+        /**
+         * Everything the game sent over the serial port so far, see IO_Bus::serial_output()
+         */
+        std::string const                &getSerialOutput() const;
+        void                              clearSerialOutput();
 
         CPU::registers_t                  getRegistersFromCPU();
+        void                              setRegistersInCPU(CPU::registers_t const &regs);
         Memory::io_registers_t            getregistersfromIO();
+
+        /**
+         * Debugger access to the bus as the CPU sees it, ignoring the OAM DMA lockout and not counted in the perf
+         * counters. Writes still have their side effects (MBC bank switches, IO registers)
+         */
         u8                                getByteFromIO(u16 addr);
+        void                              setByteInIO(u16 addr, u8 value);
+
+        /**
+         * Disassemble the instruction at `addr` as currently mapped into `buf`, lines in ROM are decoded once and
+         * cached after that
+         * @return the instruction's length in bytes
+         */
+        u8                                disassemble(u16 addr, char *buf, size_t buf_len);
 
         std::pair<u8, u8>                 getTileLineByAddr(u16 addr, bool bank1);
         void               parseTileLine(std::array<Silver::Pixel, 8> &arr, u8 byte_1, u8 byte_2, u8 bg_attr);
@@ -59,12 +108,143 @@ namespace Silver {
         void               getBGBuffer(std::vector<Pixel> &vec);
         // void getWNDBuffer(u8 *buf);
 
-        void               set_bp(u16 bp, bool en = false);
-        u16                get_bp();
-        void               set_bp_active(bool en);
-        bool               get_bp_active();
+        /**
+         * Decoded tile data and BG map for the debug viewers, see refreshVRAMView()
+         */
+        struct vram_view_t {
+            static constexpr u32 tiles_width  = 128; // 16 x 24 tiles per bank
+            static constexpr u32 tiles_height = 192;
+            static constexpr u32 map_size     = 256; // 32 x 32 tiles
+
+            std::vector<Pixel>   tiles[2] = {std::vector<Pixel>(tiles_width * tiles_height),
+                                             std::vector<Pixel>(tiles_width * tiles_height)};
+            std::vector<Pixel>   map      = std::vector<Pixel>(map_size * map_size);
+
+            // what the last refresh re-decoded, bit x of a row is the x'th tile across
+            u16                  changed_tile_rows[2][tiles_height / 8];
+            u32                  changed_map_rows[map_size / 8];
+
+            // what the views were decoded with, a change to any of them redraws everything
+            u8                   lcdc;
+            u8                   bgp;
+            PPU::palette_t       palettes[8];
+        };
+
+        /**
+         * Re-decode the tiles and BG map entries written since the last call, or everything if the BG palettes or
+         * LCDC changed. The change masks in the view say what was redrawn.
+         * @return false if nothing changed
+         */
+        bool               refreshVRAMView();
+        vram_view_t const &getVRAMView() const;
+
+        /**
+         * Raw VRAM and what drawing it takes, a copy cheap enough to take every frame. The decode functions only look
+         * at the snapshot, so the views can be drawn on another thread while the core runs on, see Screenshots
+         */
+        struct vram_snapshot_t {
+            u8             vram[GBC_VRAM_SIZE];
+            u8             lcdc;
+            u8             bgp;
+            bool           gbc; // CGB attributes and palettes, not in DMG compatibility mode
+            PPU::palette_t palettes[8];
+        };
+
+        void               snapshotVRAM(vram_snapshot_t &out);
+        /**
+         * Draw one bank's tiles into vram_view_t::tiles_width x tiles_height pixels, with the first BG palette
+         */
+        static void        decodeTiles(vram_snapshot_t const &snap, bool bank1, Pixel *out);
+        /**
+         * Draw the BG map LCDC selects into vram_view_t::map_size x map_size pixels
+         */
+        static void        decodeBGMap(vram_snapshot_t const &snap, Pixel *out);
+
+        /**
+         * Whole-machine state, see machine_state_t: the CPU, RAM and IO registers, the timers and DMA, the PPU and APU
+         * pipelines, the joypad select bits and the cartridge's banking registers and RTC. A restore picks up on the
+         * clock the state was taken on. Not part of it are the buttons held, which belong to the frontend, and the
+         * screen: lines already drawn keep their pixels until the PPU gets back to them.
+         */
+        machine_state_t const &getState() const;
+        void                   saveState(machine_state_t &out) const;
+        void                   loadState(machine_state_t const &in);
+
+        /**
+         * A new core that carries on from exactly where this one is, PPU and APU pipelines included. The cartridge ROM
+         * is shared rather than copied, everything else is the child's own so parent and children can run on separate
+         * threads from here on. Breakpoints, profiling and tracing aren't carried over and a forked battery cart
+         * doesn't write its RAM back to disk.
+         *
+         * Not thread safe against this core running, fork between ticks.
+         */
+        std::unique_ptr<Core>  fork() const;
+
+        BreakpointSet     &getBreakpoints();
+
+        /**
+         * Per-(bank, PC) cycle profiling, off by default. Enabling starts from empty counts, disabling discards them
+         */
+        void               setProfilingEnabled(bool enabled);
+        /**
+         * @return the active profiler, nullptr while profiling is disabled
+         */
+        Profiler          *getProfiler();
+
+        /**
+         * Binary trace of the last `entries` executed instructions, off by default. See TraceBuffer::dump() and
+         * the trace_decode tool
+         */
+        void               setTracingEnabled(bool enabled, size_t entries = default_trace_entries);
+        /**
+         * @return the active trace, nullptr while tracing is disabled
+         */
+        TraceBuffer       *getTrace();
+
+        static constexpr size_t default_trace_entries = 1 << 20;
+
+        /**
+         * Which implementation runs where the core has more than one. Fast takes the block copies for DMA and skips
+         * the breakpoint checks while none are set, Accurate always goes the byte-by-byte, checked way. Both have to
+         * end up in the same machine state, gb_headless --lockstep runs one of each side by side to catch where they
+         * don't. New fast paths should be switched off under Accurate.
+         */
+        enum class ExecPath : u8 { Fast, Accurate };
+
+        void               setExecPath(ExecPath path);
+        ExecPath           getExecPath() const { return exec_path; }
+
+        /**
+         * Counters for the last completed frame, plus a few running totals. All zero when the counters are compiled
+         * out, see perf_counters_enabled
+         */
+        perf_counters_t    getPerfCounters() const;
+
+        /**
+         * Hand every finished frame and audio buffer to `capture` from here on, nullptr stops. The capture is owned
+         * by the caller and has to outlive the core or be detached first. Not carried over to forks
+         */
+        void               setCapture(Capture *capture);
 
     private:
+        // see fork()
+        explicit Core(Core const &parent);
+
+        void                 attach_perf_counters();
+
+        /**
+         * Run `clocks` clocks, or until the end of the frame if negative. Instantiated with and without the breakpoint
+         * checks so a core with none set doesn't pay for them
+         */
+        template<bool Debug>
+        BreakReason          run(int clocks);
+        BreakReason          dispatch_run(int clocks);
+
+        void                 sample_audio();
+        void                 end_perf_frame();
+
+        machine_state_t     *state;
+
         Memory              *mem;
         Cartridge           *cart;
         APU                 *apu;
@@ -78,12 +258,23 @@ namespace Silver {
         static constexpr u32 audio_buffer_sz            = 2048;
         using AudioBuffer                               = std::array<float, audio_buffer_sz>;
 
-        bool                                frame_ready = false;
-        jnk0le::Ringbuffer<AudioBuffer, 4> *audio_queue = nullptr;
+        bool                                frame_ready     = false;
+        jnk0le::Ringbuffer<AudioBuffer, 4> *audio_queue     = nullptr;
         std::vector<float>                  audio_vector;
+        u8                                  audio_tick_cntr = 0;
+
+        BreakpointSet                       breakpoints;
+        DisassemblyCache                    disassembly_cache;
+        Profiler                           *profiler        = nullptr;
+        TraceBuffer                        *trace           = nullptr;
+        vram_view_t                        *vram_view       = nullptr;
+        ExecPath                            exec_path       = ExecPath::Fast;
+        Capture                            *capture         = nullptr;
 
-        u16                                 breakpoint = 0;
-        bool                                bp_active  = false;
+        perf_counters_t                     perf_frame {};
+        perf_counters_t                     perf_last {};
+        PerfSampler                         perf_sampler;
+        std::atomic<u64>                    audio_underflows = 0;
     };
 
 } // namespace Silver
\ No newline at end of file
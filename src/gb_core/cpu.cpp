@@ -2,9 +2,9 @@
 
 #include "util/bit.hpp"
 #include "util/flags.hpp"
+#include "util/log.hpp"
 
 #include "defs.hpp"
-#include "log.hpp"
 #include "mem.hpp"
 
 // TODO: these are good enough but to be completely accurate it can be made into
@@ -28,60 +28,21 @@ static const struct {
     {0x1100, 0x6200, 0x0008, 0x007C, 0xFFFE, 0x0100}  // CGB_AGB
 };
 
-// Registers
-union {
-    struct {
-        u8 F;
-        u8 A;
-    } b_AF;
-
-    u16 i_AF;
-} AF;
-
-union {
-    struct {
-        u8 C;
-        u8 B;
-    } b_BC;
-
-    u16 i_BC;
-} BC;
-
-union {
-    struct {
-        u8 E;
-        u8 D;
-    } b_DE;
-
-    u16 i_DE;
-} DE;
-
-union {
-    struct {
-        u8 L;
-        u8 H;
-    } b_HL;
-
-    u16 i_HL;
-} HL;
-
-u16 SP;
-u16 PC;
-
-#define A_REG                     AF.b_AF.A
-#define F_REG                     AF.b_AF.F
-#define B_REG                     BC.b_BC.B
-#define C_REG                     BC.b_BC.C
-#define D_REG                     DE.b_DE.D
-#define E_REG                     DE.b_DE.E
-#define H_REG                     HL.b_HL.H
-#define L_REG                     HL.b_HL.L
-#define AF_REG                    AF.i_AF
-#define BC_REG                    BC.i_BC
-#define DE_REG                    DE.i_DE
-#define HL_REG                    HL.i_HL
-#define SP_REG                    SP
-#define PC_REG                    PC
+// Registers live in the core's machine_state_t
+#define A_REG                     state->AF.b_AF.A
+#define F_REG                     state->AF.b_AF.F
+#define B_REG                     state->BC.b_BC.B
+#define C_REG                     state->BC.b_BC.C
+#define D_REG                     state->DE.b_DE.D
+#define E_REG                     state->DE.b_DE.E
+#define H_REG                     state->HL.b_HL.H
+#define L_REG                     state->HL.b_HL.L
+#define AF_REG                    state->AF.i_AF
+#define BC_REG                    state->BC.i_BC
+#define DE_REG                    state->DE.i_DE
+#define HL_REG                    state->HL.i_HL
+#define SP_REG                    state->SP
+#define PC_REG                    state->PC
 
 #define BOOL(x)                   (!(!(x)))
 #define BitTest(arg, posn)        BOOL((arg) & (1L << (posn)))
@@ -91,11 +52,11 @@ u16 PC;
 #define BitFlip(arg, posn)        ((arg) ^ (1L << (posn)))
 
 #define make_reg_funcs(name, bit) \
-    __force_inline bool get_##name() { return BitTest(F_REG, bit); } \
-    __force_inline void set_##name() { F_REG = BitSet(F_REG, bit); } \
-    __force_inline void change_##name(bool state) { F_REG = BitChange(F_REG, bit, (u8)state); } \
-    __force_inline void reset_##name() { F_REG = BitReset(F_REG, bit); } \
-    __force_inline void flip_##name() { F_REG = BitFlip(F_REG, bit); };
+    __force_inline bool CPU::get_##name() { return BitTest(F_REG, bit); } \
+    __force_inline void CPU::set_##name() { F_REG = BitSet(F_REG, bit); } \
+    __force_inline void CPU::change_##name(bool s) { F_REG = BitChange(F_REG, bit, (u8)s); } \
+    __force_inline void CPU::reset_##name() { F_REG = BitReset(F_REG, bit); } \
+    __force_inline void CPU::flip_##name() { F_REG = BitFlip(F_REG, bit); };
 
 make_reg_funcs(C_FLAG, 4);
 make_reg_funcs(H_FLAG, 5);
@@ -111,9 +72,12 @@ __force_inline bool check_half_carry_16(u16 x, u16 y, u16 z, u32 r) { return (x
 __force_inline bool check_carry_16(u16 x, u16 y, u32 r) { return (x ^ y ^ r) & 0x10000; }
 __force_inline bool check_carry_16(u16 x, u16 y, u16 z, u32 r) { return (x ^ y ^ z ^ r) & 0x10000; }
 
-CPU::CPU(Memory *mem, IO_Bus *io, gb_device_t device, bool bootrom_enabled = false) :
-    mem(mem), io(io), inst_clocks(0), cpu_counter(0) {
-    IME = true;
+CPU::CPU(
+        Memory *mem, IO_Bus *io, cpu_state_t *state, BreakpointSet *breakpoints, gb_device_t device,
+        bool bootrom_enabled = false) :
+    mem(mem), io(io), state(state), breakpoints(breakpoints) {
+    *state     = {};
+    state->IME = true;
 
     if(bootrom_enabled) {
         AF_REG = 0x0000;
@@ -132,6 +96,18 @@ CPU::CPU(Memory *mem, IO_Bus *io, gb_device_t device, bool bootrom_enabled = fal
     }
 }
 
+CPU::CPU(CPU const &other, Memory *mem, IO_Bus *io, cpu_state_t *state, BreakpointSet *breakpoints) :
+    CPU(other) {
+    this->mem         = mem;
+    this->io          = io;
+    this->state       = state;
+    this->breakpoints = breakpoints;
+    profiler          = nullptr;
+    trace             = nullptr;
+    trace_flags       = 0;
+    perf              = nullptr;
+}
+
 CPU::~CPU() { }
 
 CPU::registers_t CPU::getRegisters() {
@@ -145,135 +121,259 @@ CPU::registers_t CPU::getRegisters() {
 #endif
 }
 
+void CPU::setRegisters(registers_t const &regs) {
+    AF_REG = regs.AF & 0xFFF0; // the low nibble of F doesn't exist
+    BC_REG = regs.BC;
+    DE_REG = regs.DE;
+    HL_REG = regs.HL;
+    SP_REG = regs.SP;
+    PC_REG = regs.PC;
+}
+
 #define is_input_pressed()     (io->joy->read() & 0xF)
 #define prepare_speed_switch() (Bit::test(io->mem->registers.KEY1, 0))
 #define exec_speed_switch() \
     do { \
-        Bit::set(io->mem->registers.KEY1, 7); \
-        Bit::reset(io->mem->registers.KEY1, 0); \
+        Bit::set(&io->mem->registers.KEY1, 7); \
+        Bit::reset(&io->mem->registers.KEY1, 0); \
     } while(0)
 #define is_double_speed() (Bit::test(io->mem->registers.KEY1, 7)) // TODO: demagic?
 
+template<bool Debug>
 bool CPU::tick() {
-    io->gdma_tick();
-    io->hdma_tick();
+    // a breakpoint stopped the previous call right before an instruction fetch, pick up from exactly that point
+    tick_resume_t resume = RESUME_NONE;
+    if constexpr(Debug) {
+        resume       = resume_point;
+        resume_point = RESUME_NONE;
+    }
+
+    if(resume == RESUME_NONE) {
+        io->gdma_tick();
+        io->hdma_tick();
+    }
 
     if(is_double_speed()) {
-        single_tick();
-        single_tick();
-        return false;
-        // TODO: this disables breakpoints, need to track if we're in the middle of a double-speed tick to fix
+        if(resume != RESUME_SECOND) {
+            single_tick<Debug>(resume == RESUME_FIRST);
+            if(Debug && break_at_fetch) {
+                break_at_fetch = false;
+                resume_point   = RESUME_FIRST;
+                return false;
+            }
+        }
+
+        bool completed = single_tick<Debug>(resume == RESUME_SECOND);
+        if(Debug && break_at_fetch) {
+            break_at_fetch = false;
+            resume_point   = RESUME_SECOND;
+            return false;
+        }
+        return completed;
     } else {
-        return single_tick();
+        bool completed = single_tick<Debug>(resume == RESUME_FIRST);
+        if(Debug && break_at_fetch) {
+            break_at_fetch = false;
+            resume_point   = RESUME_FIRST;
+            return false;
+        }
+        return completed;
     }
 }
 
-// TODO: stop
-bool CPU::single_tick() {
+/**
+ * Take the highest priority pending interrupt, if any
+ * @return true if an ISR transfer was started and the clock shouldn't fetch
+ */
+bool CPU::dispatch_interrupt() {
     using Interrupt = Memory::Interrupt;
 
-    io->dma_tick();
-
-    new_div = ++io->div_cnt;
-    if(Bit::fallen(old_div, new_div, 3)) {
-        on_div(16);
-    }
-    if(Bit::fallen(old_div, new_div, 5)) {
-        on_div(64);
-    }
-    if(Bit::fallen(old_div, new_div, 7)) {
-        on_div(256);
+    u8        int_pc = 0, int_val = 0;
+
+    Interrupt curr_interrupts = check_interrupts();
+    if(curr_interrupts & Interrupt::VBLANK_INT) {
+        int_pc  = VBLANK_INT_OFFSET;
+        int_val = Interrupt::VBLANK_INT;
+    } else if(curr_interrupts & Interrupt::LCD_STAT_INT) {
+        int_pc  = LCD_STAT_INT_OFFSET;
+        int_val = Interrupt::LCD_STAT_INT;
+    } else if(curr_interrupts & Interrupt::TIMER_INT) {
+        int_pc  = TIMER_INT_OFFSET;
+        int_val = Interrupt::TIMER_INT;
+    } else if(curr_interrupts & Interrupt::SERIAL_INT) {
+        int_pc  = SERIAL_INT_OFFSET;
+        int_val = Interrupt::SERIAL_INT;
+    } else if(curr_interrupts & Interrupt::JOYPAD_INT) {
+        int_pc  = JOYPAD_INT_OFFSET;
+        int_val = Interrupt::JOYPAD_INT;
     }
-    if(Bit::fallen(old_div, new_div, 9)) {
-        on_div(1024);
-    }
-    old_div = new_div;
 
-    if(io->gdma_active) {
-        return false;
+    // TODO: check logic of stop with ints enabled
+    if(int_val && !io->state->hdma_active && !state->is_stopped) {
+        if(state->is_halted) {
+            state->is_halted = false;
+        }
+
+        // ISR transfer summary:
+        //  disable Interrupts
+        //  push the PC
+        //  set the PC to the interrupt offset
+        //  unset the interrupt flag
+        //  set clocks for ISR transfer
+        if(state->IME) {
+            state->IME = 0;
+            stack_push(PC_REG);
+            PC_REG = int_pc;
+            unset_interrupt((Interrupt)int_val);
+            state->inst_clocks = 20;
+            if(profiler) {
+                profiler->on_interrupt(int_val, SP_REG, 20);
+            }
+            trace_flags |= TRACE_FLAG_INTERRUPT;
+            return true;
+        }
     }
 
-    if(!inst_clocks) {
-        // used to properly time the instruction execution
-        u8        int_pc = 0, int_val = 0;
-        bool      int_set         = false;
-
-        Interrupt curr_interrupts = check_interrupts();
-        if(curr_interrupts & Interrupt::VBLANK_INT) {
-            int_pc  = VBLANK_INT_OFFSET;
-            int_val = Interrupt::VBLANK_INT;
-        } else if(curr_interrupts & Interrupt::LCD_STAT_INT) {
-            int_pc  = LCD_STAT_INT_OFFSET;
-            int_val = Interrupt::LCD_STAT_INT;
-        } else if(curr_interrupts & Interrupt::TIMER_INT) {
-            int_pc  = TIMER_INT_OFFSET;
-            int_val = Interrupt::TIMER_INT;
-        } else if(curr_interrupts & Interrupt::SERIAL_INT) {
-            int_pc  = SERIAL_INT_OFFSET;
-            int_val = Interrupt::SERIAL_INT;
-        } else if(curr_interrupts & Interrupt::JOYPAD_INT) {
-            int_pc  = JOYPAD_INT_OFFSET;
-            int_val = Interrupt::JOYPAD_INT;
+    return false;
+}
+
+/**
+ * @param resume continue a clock that was stopped right before its instruction fetch, everything up to the fetch has
+ * already happened
+ */
+// TODO: stop
+template<bool Debug>
+bool CPU::single_tick(bool resume) {
+    if(!resume) {
+        state->clocks++;
+        io->dma_tick();
+
+        state->new_div = ++io->state->div_cnt;
+        if(Bit::fallen(state->old_div, state->new_div, 3)) {
+            on_div(16);
+        }
+        if(Bit::fallen(state->old_div, state->new_div, 5)) {
+            on_div(64);
+        }
+        if(Bit::fallen(state->old_div, state->new_div, 7)) {
+            on_div(256);
+        }
+        if(Bit::fallen(state->old_div, state->new_div, 9)) {
+            on_div(1024);
         }
+        // internal serial clock, 8192Hz
+        if(io->state->serial_bits && Bit::fallen(state->old_div, state->new_div, 8)) {
+            io->serial_shift();
+        }
+        state->old_div = state->new_div;
 
-        // TODO: check logic of stop with ints enabled
-        if(int_val && !io->hdma_active && !is_stopped) {
-            if(is_halted) {
-                is_halted = false;
-            }
+        if(io->state->gdma_active) {
+            return false;
+        }
+    }
 
-            // ISR transfer summary:
-            //  disable Interrupts
-            //  push the PC
-            //  set the PC to the interrupt offset
-            //  unset the interrupt flag
-            //  set clocks for ISR transfer
-            if(IME) {
-                IME = 0;
-                stack_push(PC_REG);
-                PC_REG = int_pc;
-                unset_interrupt((Interrupt)int_val);
-                inst_clocks = 20;
-                int_set     = true;
+    if(!state->inst_clocks) {
+        // used to properly time the instruction execution
+        bool int_set = !resume && !state->is_locked && dispatch_interrupt();
+
+        if(!int_set && !state->is_halted && !state->is_locked) {
+            if constexpr(Debug) {
+                auto bank_of = [this]() { return io->cart->getROMBank(PC_REG); };
+                if(!resume && breakpoints->check_exec(PC_REG, bank_of)) {
+                    breakpoints->report({BreakReason::Exec, PC_REG, bank_of(), 0});
+                    break_at_fetch = true;
+                    return false;
+                }
             }
-        }
 
-        if(!int_set && !is_halted) {
-            bool old_ei_ime_enable = ei_ime_enable;
+            bool old_ei_ime_enable = state->ei_ime_enable;
 
-            inst_clocks            = decode(fetch_8());
+            if(trace) {
+                record_trace();
+            }
+
+            u16  op_pc             = PC_REG;
+            u8   op                = fetch_8();
+            state->inst_clocks     = decode(op);
+            PerfCount(perf, instructions++);
+            DebugCheck(clocks_match_table(op_pc, op, state->inst_clocks))
+                    << "clocks for opcode " << as_hex(op) << " at " << as_hex(op_pc) << " don't match opcode_table";
+            if(profiler) {
+                profiler->on_instruction(op_pc, op, state->inst_clocks, PC_REG, SP_REG);
+            }
 
-            if(old_ei_ime_enable && ei_ime_enable) {
-                ei_ime_enable = false;
-                IME           = 1;
+            if(old_ei_ime_enable && state->ei_ime_enable) {
+                state->ei_ime_enable = false;
+                state->IME           = 1;
             }
         }
 
         // prevent inst_clocks from underflowing during HALTs and STOPs.
         // also keep CPU operating on proper M cycles.
-        if(is_stopped) {
+        if(state->is_stopped) {
             if(prepare_speed_switch()) {
                 exec_speed_switch();
             }
 
             if(is_input_pressed()) {
-                is_stopped = false;
+                state->is_stopped = false;
             } else {
-                inst_clocks = 4;
+                state->inst_clocks = 4;
             }
         }
 
-        if(is_halted) {
-            inst_clocks = 4;
+        if(state->is_halted || state->is_locked) {
+            state->inst_clocks = 4;
+            if(profiler) {
+                profiler->on_idle(4);
+            }
         }
     }
-    inst_clocks--;
+    state->inst_clocks--;
 
     // if inst_clocks is 0 here, then the next clock will execute an instruction
-    return inst_clocks == 0;
+    return state->inst_clocks == 0;
+}
+
+template bool CPU::tick<false>();
+template bool CPU::tick<true>();
+
+bool          CPU::stopped_at_breakpoint() const { return resume_point != RESUME_NONE; }
+
+bool          CPU::at_instruction_boundary() const { return state->inst_clocks == 0 && !stopped_at_breakpoint(); }
+
+void          CPU::set_profiler(Profiler *profiler) { this->profiler = profiler; }
+
+void          CPU::set_trace(TraceBuffer *trace) { this->trace = trace; }
+
+void          CPU::set_perf_counters(perf_counters_t *counters) { perf = counters; }
+
+bool          CPU::clocks_match_table(u16 op_pc, u8 op, u8 clocks) {
+    u8                   bytes[2] = {op, op == 0xCB ? io->read(op_pc + 1, true) : (u8)0};
+    opcode_info_t const &info     = opcode_info(bytes);
+    return clocks == info.clocks || (info.conditional() && clocks == info.clocks_taken);
 }
 
-u16 CPU::get_TAC_cs() {
+void          CPU::record_trace() {
+    trace_entry_t entry {};
+    entry.clock    = state->clocks;
+    entry.PC       = PC_REG;
+    entry.AF       = AF_REG;
+    entry.BC       = BC_REG;
+    entry.DE       = DE_REG;
+    entry.HL       = HL_REG;
+    entry.SP       = SP_REG;
+    entry.bank     = io->cart->getROMBank(PC_REG);
+    entry.bytes[0] = io->read(PC_REG, true);
+    entry.bytes[1] = io->read(PC_REG + 1, true);
+    entry.bytes[2] = io->read(PC_REG + 2, true);
+    entry.flags    = trace_flags;
+    trace_flags    = 0;
+
+    trace->record(entry);
+}
+
+u16           CPU::get_TAC_cs() {
     // return the Timer Control Speed if enabled
     if(mem->registers.TAC & 4) {
         switch(mem->registers.TAC & 3) {
@@ -309,8 +409,6 @@ void CPU::unset_interrupt(Memory::Interrupt i) {
 }
 
 u8 CPU::decode(u8 op) {
-    //  LogDebug("CPU") << "I: 0x" << as_hex(PC_REG-1) << ": " << getOpString(PC_REG-1);
-
     switch(op) {
     case 0x00: return no_op();                        //   4  NOP
     case 0x01: return load_rr_nn(&BC_REG);            //  12  LD BC, yyxx
@@ -664,9 +762,24 @@ u8 CPU::decode(u8 op) {
     return 0;                                        // to silence the warnings
 }
 
+__force_inline u8 CPU::read_mem(u16 loc) {
+    u8 data = io->read(loc);
+    if(breakpoints->watching_reads() && breakpoints->check_read(loc)) {
+        breakpoints->report({BreakReason::Read, loc, 0, data});
+    }
+    return data;
+}
+
+__force_inline void CPU::write_mem(u16 loc, u8 data) {
+    if(breakpoints->watching_writes() && breakpoints->check_write(loc)) {
+        breakpoints->report({BreakReason::Write, loc, 0, data});
+    }
+    io->write(loc, data);
+}
+
 u8 CPU::fetch_8() {
-    if(halt_bug) {
-        halt_bug = false;
+    if(state->halt_bug) {
+        state->halt_bug = false;
         return io->read(PC_REG);
     } else {
         return io->read(PC_REG++);
@@ -680,13 +793,13 @@ u16 CPU::fetch_16() {
 }
 
 void CPU::stack_push(u16 n) {
-    io->write(--SP_REG, n >> 8);
-    io->write(--SP_REG, (u8)n);
+    write_mem(--SP_REG, n >> 8);
+    write_mem(--SP_REG, (u8)n);
 }
 
 u16 CPU::stack_pop() {
-    u8 q1 = io->read(SP_REG++);
-    u8 q2 = io->read(SP_REG++);
+    u8 q1 = read_mem(SP_REG++);
+    u8 q2 = read_mem(SP_REG++);
     return (u16)q2 << 8 | q1;
 }
 
@@ -709,35 +822,35 @@ u8 CPU::load_r_r(u8 *r1, u8 *r2) {
 }
 
 u8 CPU::load_r_ll(u8 *r1, u16 loc) {
-    *r1 = io->read(loc);
+    *r1 = read_mem(loc);
     return 8;
 }
 
 u8 CPU::load_rr_nn(u16 *r1) {
     *r1 = fetch_16();
-    return 16;
+    return 12;
 }
 
 u8 CPU::loadi_rr_r(u16 *r1, u8 *r2) {
-    io->write(*r1, *r2);
+    write_mem(*r1, *r2);
     (*r1)++;
     return 8;
 }
 
 u8 CPU::loadi_r_rr(u8 *r1, u16 *r2) {
-    *r1 = io->read(*r2);
+    *r1 = read_mem(*r2);
     (*r2)++;
     return 8;
 }
 
 u8 CPU::loadd_rr_r(u16 *r1, u8 *r2) {
-    io->write(*r1, *r2);
+    write_mem(*r1, *r2);
     (*r1)--;
     return 8;
 }
 
 u8 CPU::loadd_r_rr(u8 *r1, u16 *r2) {
-    *r1 = io->read(*r2);
+    *r1 = read_mem(*r2);
     (*r2)--;
     return 8;
 }
@@ -748,44 +861,44 @@ u8 CPU::load_rr_rr(u16 *r1, u16 *r2) {
 }
 
 u8 CPU::load_llnn_r(u8 *r1) {
-    io->write(fetch_16(), *r1);
+    write_mem(fetch_16(), *r1);
     return 16;
 }
 
 u8 CPU::load_llnn_rr(u16 *r1) {
     u16 addr = fetch_16();
-    io->write(addr++, *r1 & 0xFF);
-    io->write(addr, *r1 >> 8);
+    write_mem(addr++, *r1 & 0xFF);
+    write_mem(addr, *r1 >> 8);
     return 20;
 }
 
 u8 CPU::load_ll_n(u16 loc) {
-    io->write(loc, fetch_8());
+    write_mem(loc, fetch_8());
     return 12;
 }
 
 u8 CPU::load_ll_r(u16 loc, u8 *r1) {
-    io->write(loc, *r1);
+    write_mem(loc, *r1);
     return 8;
 }
 
 u8 CPU::load_lln_r(u8 *r1) {
-    io->write(0xFF00 + fetch_8(), *r1);
+    write_mem(0xFF00 + fetch_8(), *r1);
     return 12;
 }
 
 u8 CPU::load_llr_r(u8 *r1, u8 *r2) {
-    io->write(0xFF00 + *r1, *r2);
+    write_mem(0xFF00 + *r1, *r2);
     return 8;
 }
 
 u8 CPU::load_r_lln(u8 *r1) {
-    *r1 = io->read(0xFF00 + fetch_8());
+    *r1 = read_mem(0xFF00 + fetch_8());
     return 12;
 }
 
 u8 CPU::load_r_llr(u8 *r1, u8 *r2) {
-    *r1 = io->read(0xFF00 + *r2);
+    *r1 = read_mem(0xFF00 + *r2);
     return 8;
 }
 
@@ -805,7 +918,7 @@ u8 CPU::load_rr_rrn(u16 *r1, u16 *r2) {
 }
 
 u8 CPU::load_r_llnn(u8 *r1) {
-    *r1 = io->read(fetch_16());
+    *r1 = read_mem(fetch_16());
     return 16;
 }
 
@@ -844,25 +957,25 @@ u8 CPU::dec_rr(u16 *r1) {
 
 u8 CPU::inc_ll(u16 loc) {
     // HNZ
-    u8 r1 = io->read(loc);
+    u8 r1 = read_mem(loc);
 
     change_Z_FLAG(!(u8)(r1 + 1));
     change_H_FLAG(check_half_carry_8(1, r1, (u16)(r1 + 1)));
     reset_N_FLAG();
 
-    io->write(loc, r1 + 1);
+    write_mem(loc, r1 + 1);
     return 12;
 }
 
 u8 CPU::dec_ll(u16 loc) {
     // HNZ
-    u8 r1 = io->read(loc);
+    u8 r1 = read_mem(loc);
 
     change_Z_FLAG(!(r1 - 1));
     change_H_FLAG(check_half_carry_8(r1, 1, (r1 - 1)));
     set_N_FLAG();
 
-    io->write(loc, r1 - 1);
+    write_mem(loc, r1 - 1);
     return 12;
 }
 
@@ -894,7 +1007,7 @@ u8 CPU::add_r_r(u8 *r1, u8 *r2) {
 
 u8 CPU::add_r_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2 = io->read(loc);
+    u8 r2 = read_mem(loc);
 
     change_Z_FLAG(!(u8)(*r1 + r2));
     change_H_FLAG(check_half_carry_8(*r1, r2, (u16)*r1 + r2));
@@ -964,7 +1077,7 @@ u8 CPU::adc_r_r(u8 *r1, u8 *r2) {
 
 u8 CPU::adc_r_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2    = io->read(loc);
+    u8 r2    = read_mem(loc);
 
     u8 old_c = get_C_FLAG(); // save the old C_FLAG so we can set the flags first
 
@@ -1007,7 +1120,7 @@ u8 CPU::sub_r(u8 *r1, u8 *r2) {
 
 u8 CPU::sub_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2 = io->read(loc);
+    u8 r2 = read_mem(loc);
 
     change_Z_FLAG(!(u8)(*r1 - r2));
     change_H_FLAG(check_half_carry_8(*r1, r2, (u16)*r1 - r2));
@@ -1055,7 +1168,7 @@ u8 CPU::sbc_r_r(u8 *r1, u8 *r2) {
 
 u8 CPU::sbc_r_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2    = io->read(loc);
+    u8 r2    = read_mem(loc);
 
     u8 old_c = get_C_FLAG(); // save the old C_FLAG so we can set the flags first
 
@@ -1099,7 +1212,7 @@ u8 CPU::and_r_r(u8 *r1, u8 *r2) {
 
 u8 CPU::and_r_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2 = io->read(loc);
+    u8 r2 = read_mem(loc);
 
     change_Z_FLAG(!(*r1 & r2));
     set_H_FLAG();
@@ -1139,7 +1252,7 @@ u8 CPU::or_r_r(u8 *r1, u8 *r2) {
 
 u8 CPU::or_r_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2 = io->read(loc);
+    u8 r2 = read_mem(loc);
 
     change_Z_FLAG(!(*r1 | r2));
     reset_H_FLAG();
@@ -1179,7 +1292,7 @@ u8 CPU::xor_r_r(u8 *r1, u8 *r2) {
 
 u8 CPU::xor_r_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2 = io->read(loc);
+    u8 r2 = read_mem(loc);
 
     change_Z_FLAG(!(*r1 ^ r2));
     reset_N_FLAG();
@@ -1217,7 +1330,7 @@ u8 CPU::cp_r_r(u8 *r1, u8 *r2) {
 
 u8 CPU::cp_r_ll(u8 *r1, u16 loc) {
     // CHNZ
-    u8 r2 = io->read(loc);
+    u8 r2 = read_mem(loc);
 
     change_Z_FLAG(!(*r1 - r2));
     change_H_FLAG(check_half_carry_8(*r1, r2, (u16)*r1 - r2));
@@ -1316,7 +1429,7 @@ u8 CPU::rlc_r(u8 *r1) {
 
 u8 CPU::rlc_ll(u16 loc) {
     // CHNZ
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
 
     change_C_FLAG(Bit::test(r, 7));
     reset_H_FLAG();
@@ -1326,7 +1439,7 @@ u8 CPU::rlc_ll(u16 loc) {
 
     change_Z_FLAG(!r);
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1347,7 +1460,7 @@ u8 CPU::rrc_r(u8 *r1) {
 
 u8 CPU::rrc_ll(u16 loc) {
     // CHNZ
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
 
     change_C_FLAG(Bit::test(r, 0));
     reset_H_FLAG();
@@ -1357,9 +1470,9 @@ u8 CPU::rrc_ll(u16 loc) {
 
     change_Z_FLAG(!r);
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
-    return 4;
+    return 16;
 }
 
 u8 CPU::rl_r(u8 *r1) {
@@ -1380,7 +1493,7 @@ u8 CPU::rl_r(u8 *r1) {
 
 u8 CPU::rl_ll(u16 loc) {
     // CHNZ
-    u8 r     = io->read(loc);
+    u8 r     = read_mem(loc);
     u8 old_c = get_C_FLAG();
 
     change_C_FLAG(Bit::test(r, 7));
@@ -1392,7 +1505,7 @@ u8 CPU::rl_ll(u16 loc) {
 
     change_Z_FLAG(!r);
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1415,7 +1528,7 @@ u8 CPU::rr_r(u8 *r1) {
 
 u8 CPU::rr_ll(u16 loc) {
     // CHNZ
-    u8 r     = io->read(loc);
+    u8 r     = read_mem(loc);
     u8 old_c = get_C_FLAG();
 
     change_C_FLAG(Bit::test(r, 0));
@@ -1427,7 +1540,7 @@ u8 CPU::rr_ll(u16 loc) {
 
     change_Z_FLAG(!r);
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1450,7 +1563,7 @@ u8 CPU::sla_r(u8 *r1) {
 
 u8 CPU::sla_ll(u16 loc) {
     // CHNZ
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
 
     change_C_FLAG(Bit::test(r, 7));
     reset_H_FLAG();
@@ -1460,7 +1573,7 @@ u8 CPU::sla_ll(u16 loc) {
 
     change_Z_FLAG(!r);
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1483,7 +1596,7 @@ u8 CPU::sra_r(u8 *r1) {
 
 u8 CPU::sra_ll(u16 loc) {
     // CHNZ
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
     u8 a = r & 0x80; // save eight bit for arithmetic shift
 
     change_C_FLAG(Bit::test(r, 0));
@@ -1495,7 +1608,7 @@ u8 CPU::sra_ll(u16 loc) {
 
     change_Z_FLAG(!r);
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1517,7 +1630,7 @@ u8 CPU::srl_r(u8 *r1) {
 
 u8 CPU::srl_ll(u16 loc) {
     // CHNZ
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
 
     change_C_FLAG(Bit::test(r, 0));
     reset_H_FLAG();
@@ -1528,7 +1641,7 @@ u8 CPU::srl_ll(u16 loc) {
 
     change_Z_FLAG(!r);
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1550,7 +1663,7 @@ u8 CPU::swap_r(u8 *r1) {
 }
 
 u8 CPU::swap_ll(u16 loc) {
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
     u8 t = r >> 4;
 
     reset_C_FLAG();
@@ -1560,7 +1673,7 @@ u8 CPU::swap_ll(u16 loc) {
 
     r = (r << 4) | t;
 
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1580,7 +1693,7 @@ u8 CPU::bit_b_r(u8 bit, u8 *r1) {
 
 u8 CPU::bit_b_ll(u8 bit, u16 loc) {
     // HNZ
-    u8 r1 = io->read(loc);
+    u8 r1 = read_mem(loc);
 
     set_H_FLAG();
     reset_N_FLAG();
@@ -1598,10 +1711,10 @@ u8 CPU::res_b_r(u8 bit, u8 *reg) {
 }
 
 u8 CPU::res_b_ll(u8 bit, u16 loc) {
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
 
     Bit::reset(&r, bit);
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1615,10 +1728,10 @@ u8 CPU::set_b_r(u8 bit, u8 *reg) {
 }
 
 u8 CPU::set_b_ll(u8 bit, u16 loc) {
-    u8 r = io->read(loc);
+    u8 r = read_mem(loc);
 
     Bit::set(&r, bit);
-    io->write(loc, r);
+    write_mem(loc, r);
 
     return 16;
 }
@@ -1699,17 +1812,17 @@ u8 CPU::ccf() {
 // Halt/Stop
 //====================
 u8 CPU::halt() {
-    if(!IME && check_interrupts()) {
-        halt_bug = true;
+    if(!state->IME && check_interrupts()) {
+        state->halt_bug = true;
     } else {
-        is_halted = true;
+        state->is_halted = true;
     }
 
     return 4;
 }
 
 u8 CPU::stop() {
-    is_stopped = true;
+    state->is_stopped = true;
     return 4;
 }
 
@@ -1717,14 +1830,14 @@ u8 CPU::stop() {
 // Enable/Disable Interrupts
 //====================
 u8 CPU::ei() {
-    if(!ei_ime_enable) {
-        ei_ime_enable = true;
+    if(!state->ei_ime_enable) {
+        state->ei_ime_enable = true;
     }
     return 4;
 }
 
 u8 CPU::di() {
-    IME = 0;
+    state->IME = 0;
     return 4;
 }
 
@@ -1808,8 +1921,8 @@ u8 CPU::ret() {
 }
 
 u8 CPU::reti() {
-    PC_REG = stack_pop();
-    IME    = 1; // re-enable interrupts
+    PC_REG     = stack_pop();
+    state->IME = 1; // re-enable interrupts
     return 16;
 }
 
@@ -1826,7 +1939,8 @@ u8 CPU::ret_cond(bool cond) {
 // Invalid Op
 //====================
 u8 CPU::invalid_op(u8 op) {
-    LogFatal("CPU") << "Invalid OP";
-    PC_REG--; // to make the game freeze
+    LogFatal("CPU") << "Invalid OP " << as_hex(op) << " at " << as_hex((u16)(PC_REG - 1));
+    PC_REG--; // leave the PC on it for the debugger
+    state->is_locked = true;
     return 0;
 }
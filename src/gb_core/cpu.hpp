@@ -2,7 +2,12 @@
 
 #include "util/util.hpp"
 
+#include "arena.hpp"
+#include "breakpoints.hpp"
 #include "io.hpp"
+#include "opcodes.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
 
 #define DIV_MAX 1024
 
@@ -18,39 +23,99 @@ public:
         u16 PC;
     };
 
-    CPU(Memory *mem, IO_Bus *io, gb_device_t device, bool bootrom_enabled);
+    CPU(Memory *mem, IO_Bus *io, cpu_state_t *state, BreakpointSet *breakpoints, gb_device_t device,
+        bool bootrom_enabled);
+    /**
+     * Fork of `other` on the forked core's bus, `state` already holds a copy of its registers. Profiling and tracing
+     * stay with the original
+     */
+    CPU(CPU const &other, Memory *mem, IO_Bus *io, cpu_state_t *state, BreakpointSet *breakpoints);
     ~CPU();
 
+    /**
+     * Advance one clock.
+     * The Debug variant stops right before fetching an instruction at a breakpoint, the next call then resumes the
+     * same clock from that point without checking the breakpoint again.
+     * @return true if the next clock will execute an instruction
+     */
+    template<bool Debug = false>
     bool        tick();
 
+    /**
+     * The last tick stopped at a breakpoint and the clock hasn't been finished yet
+     */
+    bool        stopped_at_breakpoint() const;
+
+    /**
+     * The last instruction has used up all of its clocks, the next clock fetches (or dispatches an interrupt)
+     */
+    bool        at_instruction_boundary() const;
+
     u8          decode(u8 op);
     std::string getOpString(u16 PC);
     std::string getCBOpString(u16 PC);
 
     registers_t getRegisters();
+    void        setRegisters(registers_t const &regs);
+
+    /**
+     * Account every executed instruction and interrupt dispatch to `profiler`, nullptr to stop
+     */
+    void        set_profiler(Profiler *profiler);
+
+    /**
+     * Record every executed instruction into `trace`, nullptr to stop
+     */
+    void        set_trace(TraceBuffer *trace);
+
+    void        set_perf_counters(perf_counters_t *counters);
 
 private:
     void        on_div(u16 val);
 
-    bool        single_tick();
+    template<bool Debug>
+    bool        single_tick(bool resume);
+    bool        dispatch_interrupt();
 
     void        inc_TIMA();
     u16         get_TAC_cs();
     Interrupt   check_interrupts();
     void        unset_interrupt(Interrupt i);
 
-    // used for disassembly
-    std::string i8(u16 PC);
-    std::string i16(u16 PC);
-    std::string format(std::string fmt, u16 PC);
+    Memory      *mem;
+    IO_Bus      *io;
+
+    // registers, flags and sequencing state, lives in the core's machine_state_t
+    cpu_state_t *state;
+
+    // owned by the core, watchpoints are checked on every data access while any are set
+    BreakpointSet *breakpoints;
+
+    // owned by the core, only set while profiling
+    Profiler      *profiler = nullptr;
+
+    // owned by the core, only set while tracing
+    TraceBuffer   *trace       = nullptr;
+    u8             trace_flags = 0;
+
+    perf_counters_t *perf = nullptr;
+
+    void           record_trace();
+
+    // debug builds check every instruction's clocks against opcode_table
+    bool           clocks_match_table(u16 op_pc, u8 op, u8 clocks);
+
+    enum tick_resume_t : u8 {
+        RESUME_NONE,
+        RESUME_FIRST,  // stopped in the only (or first double speed) half of the clock
+        RESUME_SECOND, // stopped in the second double speed half of the clock
+    };
 
-    Memory     *mem;
-    IO_Bus     *io;
+    tick_resume_t resume_point   = RESUME_NONE;
+    bool          break_at_fetch = false;
 
-    u8          inst_clocks;
-    u16         cpu_counter;
-    // globally track div values because writes to the TIMA register
-    u16         old_div = 0, new_div = 0;
+    u8            read_mem(u16 loc);
+    void          write_mem(u16 loc, u8 data);
 
     u8          fetch_8();
     u16         fetch_16();
@@ -58,8 +123,19 @@ private:
     void        stack_push(u16 n);
     u16         stack_pop();
 
-    // CPU Flags
-    bool        IME = 0, is_halted = false, halt_bug = false, is_stopped = false, ei_ime_enable = false;
+    // F register helpers
+#define declare_reg_funcs(name) \
+    bool get_##name(); \
+    void set_##name(); \
+    void change_##name(bool s); \
+    void reset_##name(); \
+    void flip_##name();
+
+    declare_reg_funcs(C_FLAG);
+    declare_reg_funcs(H_FLAG);
+    declare_reg_funcs(N_FLAG);
+    declare_reg_funcs(Z_FLAG);
+#undef declare_reg_funcs
 
     // Op Functions
     //============
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "util/types/primitives.hpp"
+
+#include "opcodes.hpp"
+
+/**
+ * Format one instruction into `out` without allocating. The text is always NUL-terminated and truncated to fit.
+ * @param pc address of bytes[0], relative jumps are shown as their target
+ * @param bytes the instruction, 3 bytes must be readable whatever its length
+ * @return the instruction's length in bytes
+ */
+u8 disassemble(u16 pc, const u8 *bytes, char *out, size_t out_len);
+
+/**
+ * Decoded lines for cartridge ROM, which can't change under us, keyed by bank, the 16KB window it's mapped in and
+ * offset. The window is part of the key since relative jump targets are printed as absolute addresses, and some
+ * MBCs can map the same bank at both. Storage is allocated a bank and window at a time as they get disassembled.
+ */
+class DisassemblyCache {
+public:
+    struct line_t {
+        char text[31];
+        u8   length; // 0 until decoded
+    };
+
+    static constexpr size_t bank_size = 0x4000;
+    static constexpr size_t windows   = 2; // 0x0000 and 0x4000
+
+    /**
+     * @param read_bytes called on a miss as read_bytes(u8 bytes[3]) to fetch the instruction at pc
+     */
+    template<typename F>
+    line_t const &get(u16 bank, u16 pc, F &&read_bytes) {
+        size_t index = bank * windows + (pc / bank_size) % windows;
+        if(index >= banks.size()) {
+            banks.resize(index + 1);
+        }
+        if(!banks[index]) {
+            banks[index] = std::make_unique<line_t[]>(bank_size);
+        }
+
+        line_t &line = banks[index][pc & (bank_size - 1)];
+        if(!line.length) {
+            u8 bytes[3];
+            read_bytes(bytes);
+            line.length = disassemble(pc, bytes, line.text, sizeof(line.text));
+        }
+        return line;
+    }
+
+    void clear() { banks.clear(); }
+
+private:
+    std::vector<std::unique_ptr<line_t[]>> banks;
+};
@@ -0,0 +1,191 @@
+#include <algorithm>
+
+#include "util/log.hpp"
+
+#include "env_batch.hpp"
+
+namespace Silver {
+    std::vector<EnvBatch::span_t> EnvBatch::make_spans(u32 src, u32 dst) {
+        std::vector<span_t> spans(dst);
+        for(u32 i = 0; i < dst; i++) {
+            u32 begin      = i * src / dst;
+            u32 end        = (i + 1) * src / dst;
+            spans[i].begin = begin;
+            spans[i].end   = std::max(end, begin + 1); // upscaling repeats pixels
+        }
+        return spans;
+    }
+
+    EnvBatch::EnvBatch(const std::shared_ptr<Silver::File> &rom, config_t config) :
+        config(std::move(config)) {
+        DebugCheck(this->config.count > 0) << "EnvBatch needs at least one core";
+        DebugCheck(this->config.obs_width > 0 && this->config.obs_height > 0) << "EnvBatch observation is empty";
+
+        PPU::output_mode_t output;
+        if(this->config.grayscale) {
+            output.format = PPU::output_mode_t::Luminance;
+        }
+        if(this->config.grayscale && this->config.decimate) {
+            output.x_step = std::clamp<u32>(Core::native_width / this->config.obs_width, 1, 255);
+            output.y_step = std::clamp<u32>(Core::native_height / this->config.obs_height, 1, 255);
+        }
+
+        power_on = std::make_unique<Core>(rom, std::nullopt, this->config.device, output);
+        cores.reserve(this->config.count);
+        for(u32 i = 0; i < this->config.count; i++) {
+            cores.push_back(power_on->fork());
+        }
+
+        obs_stride = size_t(this->config.obs_width) * this->config.obs_height * (this->config.grayscale ? 1 : 3);
+
+        // RGB observations are taken from the pixel buffer, which is always full size
+        u32 src_width  = this->config.grayscale ? output.width() : Core::native_width;
+        u32 src_height = this->config.grayscale ? output.height() : Core::native_height;
+        x_spans        = make_spans(src_width, this->config.obs_width);
+        y_spans        = make_spans(src_height, this->config.obs_height);
+
+        u32 threads = this->config.threads ? this->config.threads : std::max(1u, std::thread::hardware_concurrency());
+        threads     = std::min<u32>(threads, this->config.count);
+        for(u32 i = 1; i < threads; i++) {
+            workers.emplace_back(&EnvBatch::worker_main, this);
+        }
+    }
+
+    EnvBatch::~EnvBatch() {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        job_posted.notify_all();
+        for(auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    void EnvBatch::reset(size_t index) {
+        DebugCheck(index < cores.size()) << "EnvBatch::reset index out of range";
+        // a fork rather than a state load, which would leave the last episode's screen up until it was redrawn
+        cores[index] = power_on->fork();
+    }
+
+    void EnvBatch::step(const Joypad::button_states_t *actions, u8 *obs, u8 *ram) {
+        job_actions = actions;
+        job_obs     = obs;
+        job_ram     = ram;
+        job_tick    = true;
+        run_jobs();
+    }
+
+    void EnvBatch::observe(u8 *obs, u8 *ram) {
+        job_actions = nullptr;
+        job_obs     = obs;
+        job_ram     = ram;
+        job_tick    = false;
+        run_jobs();
+    }
+
+    void EnvBatch::run_jobs() {
+        remaining = cores.size();
+        next_env  = 0;
+        if(!workers.empty()) {
+            {
+                std::lock_guard lock(mutex);
+                generation++;
+            }
+            job_posted.notify_all();
+        }
+
+        for(size_t i; (i = next_env.fetch_add(1)) < cores.size();) {
+            run_env(i);
+        }
+
+        std::unique_lock lock(mutex);
+        job_done.wait(lock, [&]() { return remaining == 0; });
+    }
+
+    void EnvBatch::worker_main() {
+        u64 seen = 0;
+        while(true) {
+            {
+                std::unique_lock lock(mutex);
+                job_posted.wait(lock, [&]() { return stopping || generation != seen; });
+                if(stopping) {
+                    return;
+                }
+                seen = generation;
+            }
+
+            for(size_t i; (i = next_env.fetch_add(1)) < cores.size();) {
+                run_env(i);
+            }
+        }
+    }
+
+    void EnvBatch::run_env(size_t index) {
+        Core &core = *cores[index];
+        if(job_tick) {
+            core.set_input_state(job_actions[index]);
+            for(u32 f = 0; f < config.frame_skip; f++) {
+                core.tick_frame();
+            }
+        }
+        write_observation(index);
+
+        if(remaining.fetch_sub(1) == 1) {
+            std::lock_guard lock(mutex);
+            job_done.notify_all();
+        }
+    }
+
+    void EnvBatch::write_observation(size_t index) {
+        Core &core = *cores[index];
+
+        if(job_ram) {
+            u8 *out = job_ram + index * config.ram_addrs.size();
+            for(u16 addr: config.ram_addrs) {
+                *out++ = core.getByteFromIO(addr);
+            }
+        }
+
+        if(!job_obs) {
+            return;
+        }
+
+        u8 *out = job_obs + index * obs_stride;
+        if(config.grayscale) {
+            std::span<const u8> luma  = core.getOutputBuffer();
+            u32                 width = core.getOutputMode().width();
+            for(span_t const &ys: y_spans) {
+                for(span_t const &xs: x_spans) {
+                    u32 area = u32(ys.end - ys.begin) * (xs.end - xs.begin), sum = 0;
+                    for(u32 y = ys.begin; y < ys.end; y++) {
+                        for(u32 x = xs.begin; x < xs.end; x++) {
+                            sum += luma[y * width + x];
+                        }
+                    }
+                    *out++ = sum / area;
+                }
+            }
+            return;
+        }
+
+        auto const &pixels = core.getPixelBuffer();
+        for(span_t const &ys: y_spans) {
+            for(span_t const &xs: x_spans) {
+                u32 area = u32(ys.end - ys.begin) * (xs.end - xs.begin);
+                u32 r = 0, g = 0, b = 0;
+                for(u32 y = ys.begin; y < ys.end; y++) {
+                    Pixel const *row = &pixels[y * Core::native_width];
+                    for(u32 x = xs.begin; x < xs.end; x++) {
+                        r += row[x].r;
+                        g += row[x].g;
+                        b += row[x].b;
+                    }
+                }
+                *out++ = r / area;
+                *out++ = g / area;
+                *out++ = b / area;
+            }
+        }
+    }
+} // namespace Silver
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util/file.hpp"
+#include "util/types/primitives.hpp"
+
+#include "core.hpp"
+#include "joy.hpp"
+
+namespace Silver {
+
+    /**
+     * A batch of cores running the same ROM, stepped together for agents that learn from many games at once.
+     *
+     * Each step() holds one action per core for frame_skip frames, then writes every core's observation into the
+     * caller's buffers: the screen, box-filtered down to obs_width x obs_height as luminance or RGB, laid out
+     * [core][y][x][channel], and the RAM bytes at ram_addrs laid out [core][addr]. The cores are spread over a pool
+     * of threads started with the batch, the calling thread takes a share too. Nothing is allocated per step.
+     *
+     * For grayscale observations the cores run with the PPU writing luminance straight out (see PPU::output_mode_t).
+     * With `decimate` set the PPU also drops whole lines and columns where the observation is at most half the native
+     * size, which is cheaper but point samples those steps instead of averaging them.
+     *
+     * Cores are forked from one core at power on and share its ROM, nothing else, so a core's frames are the same
+     * whichever thread runs it and however many cores the batch has.
+     */
+    class EnvBatch {
+    public:
+        struct config_t {
+            u32              count      = 1;
+            u32              frame_skip = 4;
+            u32              obs_width  = Core::native_width;
+            u32              obs_height = Core::native_height;
+            bool             grayscale  = true;
+            bool             decimate   = false; // grayscale only, see above
+            std::vector<u16> ram_addrs;
+            u32              threads    = 0; // including the caller's, 0 picks the hardware threads
+            gb_device_t      device     = device_GBC;
+        };
+
+        EnvBatch(const std::shared_ptr<Silver::File> &rom, config_t config);
+        ~EnvBatch();
+
+        EnvBatch(const EnvBatch &)             = delete;
+        EnvBatch &operator= (const EnvBatch &) = delete;
+
+        size_t    count() const { return cores.size(); }
+        /**
+         * @return bytes per core in the observation and RAM buffers
+         */
+        size_t    obs_size() const { return obs_stride; }
+        size_t    ram_size() const { return config.ram_addrs.size(); }
+
+        /**
+         * Start core `index` over from power on, the next step() runs it from there
+         */
+        void      reset(size_t index);
+
+        /**
+         * Run every core for frame_skip frames with its action held, then fill in the observations
+         * @param actions count() entries
+         * @param obs count() * obs_size() bytes, may be null
+         * @param ram count() * ram_size() bytes, may be null
+         */
+        void      step(const Joypad::button_states_t *actions, u8 *obs, u8 *ram);
+
+        /**
+         * Fill in the observations without running anything, for the first step after a reset
+         */
+        void      observe(u8 *obs, u8 *ram);
+
+        Core     &core(size_t index) { return *cores[index]; }
+
+    private:
+        struct span_t {
+            u16 begin, end; // source pixels [begin, end) averaged into one observation pixel
+        };
+
+        static std::vector<span_t> make_spans(u32 src, u32 dst);
+
+        void run_jobs();
+        void worker_main();
+        void run_env(size_t index);
+        void write_observation(size_t index);
+
+        config_t                           config;
+        std::unique_ptr<Core>              power_on; // never run, every core is forked from it
+        std::vector<std::unique_ptr<Core>> cores;
+
+        size_t                             obs_stride;
+        std::vector<span_t>                x_spans, y_spans;
+
+        // the job the pool is working on, set before the generation is bumped
+        const Joypad::button_states_t     *job_actions = nullptr;
+        u8                                *job_obs     = nullptr;
+        u8                                *job_ram     = nullptr;
+        bool                               job_tick    = false;
+
+        std::vector<std::thread>           workers;
+        std::mutex                         mutex;
+        std::condition_variable            job_posted, job_done;
+        u64                                generation = 0;
+        bool                               stopping   = false;
+        std::atomic<size_t>                next_env   = 0;
+        std::atomic<size_t>                remaining  = 0;
+    };
+} // namespace Silver
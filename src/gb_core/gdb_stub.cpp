@@ -0,0 +1,653 @@
+#include "gdb_stub.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+#if !defined(_WIN32)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "util/log.hpp"
+
+#include "core.hpp"
+
+namespace {
+    constexpr int poll_timeout_ms = 100;
+
+    // while the target is stopped, keep answering requests for up to this long per service() call
+    constexpr auto halted_budget = std::chrono::milliseconds(8);
+
+    constexpr const char *target_xml = R"(<?xml version="1.0"?>
+<!DOCTYPE target SYSTEM "gdb-target.dtd">
+<target version="1.0">
+  <feature name="org.silvergb.sm83">
+    <reg name="af" bitsize="16" type="int"/>
+    <reg name="bc" bitsize="16" type="int"/>
+    <reg name="de" bitsize="16" type="int"/>
+    <reg name="hl" bitsize="16" type="int"/>
+    <reg name="sp" bitsize="16" type="data_ptr"/>
+    <reg name="pc" bitsize="16" type="code_ptr"/>
+  </feature>
+</target>
+)";
+
+    constexpr int register_count = 6;
+
+    void          appendHex(std::string &out, u8 byte) {
+        constexpr const char *digits = "0123456789abcdef";
+        out += digits[byte >> 4];
+        out += digits[byte & 0xF];
+    }
+
+    // registers and memory go over the wire little endian
+    void appendHex16(std::string &out, u16 value) {
+        appendHex(out, value & 0xFF);
+        appendHex(out, value >> 8);
+    }
+
+    int hexDigit(char c) {
+        if(c >= '0' && c <= '9') {
+            return c - '0';
+        } else if(c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        } else if(c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    /**
+     * Parse a big endian hex number up to the next character that isn't a hex digit
+     * @return false if there were no digits
+     */
+    bool parseHex(std::string_view &str, u32 &out) {
+        out         = 0;
+        size_t used = 0;
+        for(; used < str.size() && hexDigit(str[used]) >= 0; used++) {
+            out = (out << 4) | hexDigit(str[used]);
+        }
+        str.remove_prefix(used);
+        return used > 0;
+    }
+
+    bool parseHexBytes(std::string_view str, u8 *out, size_t count) {
+        if(str.size() < count * 2) {
+            return false;
+        }
+        for(size_t i = 0; i < count; i++) {
+            int hi = hexDigit(str[i * 2]), lo = hexDigit(str[i * 2 + 1]);
+            if(hi < 0 || lo < 0) {
+                return false;
+            }
+            out[i] = (hi << 4) | lo;
+        }
+        return true;
+    }
+
+    bool expect(std::string_view &str, char c) {
+        if(str.empty() || str.front() != c) {
+            return false;
+        }
+        str.remove_prefix(1);
+        return true;
+    }
+
+    u16 &registerRef(CPU::registers_t &regs, int idx) {
+        u16 *order[register_count] = {&regs.AF, &regs.BC, &regs.DE, &regs.HL, &regs.SP, &regs.PC};
+        return *order[idx];
+    }
+} // namespace
+
+#if defined(_WIN32)
+Silver::GdbStub::~GdbStub() = default;
+
+bool Silver::GdbStub::listen(const std::string &address) {
+    LogError("GdbStub") << "The GDB stub isn't supported on Windows yet";
+    return false;
+}
+
+void Silver::GdbStub::serverMain() { }
+
+void Silver::GdbStub::clientMain() { }
+
+void Silver::GdbStub::sendRaw(const char *data, size_t len) { }
+#else
+Silver::GdbStub::~GdbStub() {
+    this->stopping = true;
+    if(this->server.joinable()) {
+        this->server.join();
+    }
+
+    if(this->listen_fd >= 0) {
+        close(this->listen_fd);
+    }
+    if(!this->unix_path.empty()) {
+        unlink(this->unix_path.c_str());
+    }
+}
+
+bool Silver::GdbStub::listen(const std::string &address) {
+    bool is_port = !address.empty() && address.find_first_not_of("0123456789") == std::string::npos;
+
+    u32  port    = 0;
+    if(is_port) {
+        auto [end, ec] = std::from_chars(address.data(), address.data() + address.size(), port);
+        if(ec != std::errc() || port < 1 || port > 65535) {
+            LogError("GdbStub") << "Invalid port: " << address;
+            return false;
+        }
+    }
+
+    int fd = socket(is_port ? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) {
+        LogError("GdbStub") << "socket() failed: " << strerror(errno);
+        return false;
+    }
+
+    int bound;
+    if(is_port) {
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+        sockaddr_in addr {};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bound                = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+    } else {
+        sockaddr_un addr {};
+        if(address.size() >= sizeof(addr.sun_path)) {
+            LogError("GdbStub") << "Socket path too long: " << address;
+            close(fd);
+            return false;
+        }
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, address.c_str());
+
+        // a stale socket from a previous run would fail the bind, but anything else at that path isn't ours to delete
+        struct stat existing;
+        if(lstat(address.c_str(), &existing) == 0) {
+            if(!S_ISSOCK(existing.st_mode)) {
+                LogError("GdbStub") << "Not a socket, refusing to replace it: " << address;
+                close(fd);
+                return false;
+            }
+            unlink(address.c_str());
+        }
+        bound = bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+        if(bound == 0) {
+            this->unix_path = address;
+        }
+    }
+
+    if(bound != 0 || ::listen(fd, 1) != 0) {
+        LogError("GdbStub") << "Failed to listen on " << address << ": " << strerror(errno);
+        close(fd);
+        return false;
+    }
+
+    this->listen_fd = fd;
+    this->server    = std::thread([this]() { this->serverMain(); });
+    LogInfo("GdbStub") << "Waiting for a debugger on " << (is_port ? "127.0.0.1:" : "") << address;
+    return true;
+}
+
+void Silver::GdbStub::serverMain() {
+    while(!this->stopping) {
+        pollfd pfd = {this->listen_fd, POLLIN, 0};
+        if(poll(&pfd, 1, poll_timeout_ms) <= 0) {
+            continue;
+        }
+
+        int fd = accept(this->listen_fd, nullptr, nullptr);
+        if(fd < 0) {
+            continue;
+        }
+
+        int nodelay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+#if defined(SO_NOSIGPIPE)
+        int nosigpipe = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &nosigpipe, sizeof(nosigpipe));
+#endif
+
+        {
+            std::lock_guard lock(this->send_mutex);
+            this->client_fd = fd;
+            this->no_ack    = false;
+        }
+        LogInfo("GdbStub") << "Debugger attached";
+        this->post({request_t::Attach, {}});
+
+        this->clientMain();
+
+        {
+            std::lock_guard lock(this->send_mutex);
+            this->client_fd = -1;
+        }
+        close(fd);
+        LogInfo("GdbStub") << "Debugger detached";
+        this->post({request_t::Detach, {}});
+    }
+}
+
+void Silver::GdbStub::clientMain() {
+    std::string buf;
+    char        chunk[4096];
+
+    while(!this->stopping) {
+        pollfd pfd = {this->client_fd, POLLIN, 0};
+        if(poll(&pfd, 1, poll_timeout_ms) <= 0) {
+            continue;
+        }
+
+        ssize_t n = recv(this->client_fd, chunk, sizeof(chunk), 0);
+        if(n <= 0) {
+            return;
+        }
+        buf.append(chunk, n);
+
+        while(!buf.empty()) {
+            char c = buf.front();
+            if(c == '\x03') {
+                // ^C, stop the target
+                this->post({request_t::Interrupt, {}});
+                buf.erase(0, 1);
+                continue;
+            } else if(c != '$') {
+                // acks, or noise between packets
+                buf.erase(0, 1);
+                continue;
+            }
+
+            size_t hash = buf.find('#');
+            if(hash == std::string::npos || buf.size() < hash + 3) {
+                break;
+            }
+
+            u8 checksum = 0, expected;
+            for(size_t i = 1; i < hash; i++) {
+                checksum += (u8)buf[i];
+            }
+            bool valid = parseHexBytes(std::string_view(buf).substr(hash + 1, 2), &expected, 1) && checksum == expected;
+
+            std::string packet;
+            for(size_t i = 1; i < hash; i++) {
+                // '}' escapes the next character
+                packet += buf[i] == '}' && i + 1 < hash ? buf[++i] ^ 0x20 : buf[i];
+            }
+            buf.erase(0, hash + 3);
+
+            if(!this->no_ack) {
+                this->sendRaw(valid ? "+" : "-", 1);
+            }
+            if(valid && !this->handleLocally(packet)) {
+                this->post({request_t::Packet, std::move(packet)});
+            }
+        }
+    }
+}
+
+void Silver::GdbStub::sendRaw(const char *data, size_t len) {
+    std::lock_guard lock(this->send_mutex);
+    if(this->client_fd < 0) {
+        return;
+    }
+
+#if defined(MSG_NOSIGNAL)
+    constexpr int flags = MSG_NOSIGNAL;
+#else
+    constexpr int flags = 0;
+#endif
+    while(len) {
+        ssize_t n = send(this->client_fd, data, len, flags);
+        if(n <= 0) {
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+#endif
+
+void Silver::GdbStub::sendPacket(std::string const &data) {
+    std::string packet = "$";
+    u8          checksum = 0;
+    for(char c: data) {
+        if(c == '$' || c == '#' || c == '}' || c == '*') {
+            packet += '}';
+            checksum += '}';
+            c ^= 0x20;
+        }
+        packet += c;
+        checksum += (u8)c;
+    }
+    packet += '#';
+    appendHex(packet, checksum);
+
+    this->sendRaw(packet.data(), packet.size());
+}
+
+void Silver::GdbStub::post(request_t &&request) {
+    std::lock_guard lock(this->requests_mutex);
+    if(request.kind == request_t::Attach) {
+        this->attached.store(true, std::memory_order_release);
+    }
+    this->requests.push_back(std::move(request));
+    this->requests_posted.notify_one();
+}
+
+bool Silver::GdbStub::handleLocally(std::string const &packet) {
+    std::string_view p = packet;
+
+    if(p.starts_with("qSupported")) {
+        this->sendPacket("PacketSize=4000;qXfer:features:read+;QStartNoAckMode+");
+    } else if(p == "QStartNoAckMode") {
+        this->sendPacket("OK");
+        this->no_ack = true;
+    } else if(p.starts_with("qXfer:features:read:target.xml:")) {
+        std::string_view args = p.substr(strlen("qXfer:features:read:target.xml:"));
+        u32              offset, length;
+        if(!parseHex(args, offset) || !expect(args, ',') || !parseHex(args, length)) {
+            this->sendPacket("E01");
+            return true;
+        }
+
+        std::string_view xml   = target_xml;
+        std::string_view chunk = offset < xml.size() ? xml.substr(offset, length) : std::string_view();
+        this->sendPacket((offset + chunk.size() < xml.size() ? "m" : "l") + std::string(chunk));
+    } else if(p == "qAttached") {
+        this->sendPacket("1");
+    } else if(p == "qC") {
+        this->sendPacket("QC1");
+    } else if(p == "qfThreadInfo") {
+        this->sendPacket("m1");
+    } else if(p == "qsThreadInfo") {
+        this->sendPacket("l");
+    } else if(p.starts_with("H") || p.starts_with("T")) {
+        // there's only the one thread
+        this->sendPacket("OK");
+    } else if(!p.empty() && strchr("?gGpPmMcsZzDk", p.front())) {
+        return false;
+    } else {
+        // empty reply, unsupported
+        this->sendPacket("");
+    }
+    return true;
+}
+
+void Silver::GdbStub::service(Core &core) {
+    auto             deadline = std::chrono::steady_clock::now() + halted_budget;
+    std::unique_lock lock(this->requests_mutex);
+
+    while(true) {
+        while(!this->requests.empty()) {
+            request_t request = std::move(this->requests.front());
+            this->requests.pop_front();
+            lock.unlock();
+
+            switch(request.kind) {
+            case request_t::Packet: this->handle(core, request.data); break;
+            case request_t::Interrupt:
+                if(this->running) {
+                    this->stop(core, BreakReason::None);
+                }
+                break;
+            case request_t::Attach:
+                // the debugger expects the target stopped when it connects
+                this->running   = false;
+                this->last_stop = "S05";
+                break;
+            case request_t::Detach: this->detach(core); break;
+            }
+
+            lock.lock();
+        }
+
+        if(this->running || !this->attached.load(std::memory_order_relaxed)) {
+            break;
+        }
+
+        // a debugger sends its next request as soon as it has our reply, keep answering for a bit so a burst of
+        // requests doesn't cost a frame each
+        if(!this->requests_posted.wait_until(lock, deadline, [this]() { return !this->requests.empty(); })) {
+            break;
+        }
+    }
+    lock.unlock();
+
+    if(this->running) {
+        BreakReason reason = core.tick_frame();
+        if(reason != BreakReason::None) {
+            this->stop(core, reason);
+        }
+    }
+}
+
+void Silver::GdbStub::handle(Core &core, std::string const &packet) {
+    std::string_view args = std::string_view(packet).substr(1);
+    std::string      reply;
+
+    switch(packet.front()) {
+    case '?': reply = this->last_stop; break;
+
+    case 'g': {
+        CPU::registers_t regs = core.getRegistersFromCPU();
+        for(int i = 0; i < register_count; i++) {
+            appendHex16(reply, registerRef(regs, i));
+        }
+        break;
+    }
+
+    case 'G': {
+        CPU::registers_t regs;
+        u8               bytes[register_count * 2];
+        if(!parseHexBytes(args, bytes, sizeof(bytes))) {
+            reply = "E01";
+            break;
+        }
+        for(int i = 0; i < register_count; i++) {
+            registerRef(regs, i) = bytes[i * 2] | (bytes[i * 2 + 1] << 8);
+        }
+        core.setRegistersInCPU(regs);
+        reply = "OK";
+        break;
+    }
+
+    case 'p':
+    case 'P': {
+        u32 idx;
+        if(!parseHex(args, idx) || idx >= register_count) {
+            reply = "E01";
+            break;
+        }
+
+        CPU::registers_t regs = core.getRegistersFromCPU();
+        if(packet.front() == 'p') {
+            appendHex16(reply, registerRef(regs, idx));
+            break;
+        }
+
+        u8 bytes[2];
+        if(!expect(args, '=') || !parseHexBytes(args, bytes, 2)) {
+            reply = "E01";
+            break;
+        }
+        registerRef(regs, idx) = bytes[0] | (bytes[1] << 8);
+        core.setRegistersInCPU(regs);
+        reply = "OK";
+        break;
+    }
+
+    case 'm':
+    case 'M': {
+        u32 addr, len;
+        if(!parseHex(args, addr) || !expect(args, ',') || !parseHex(args, len) || addr > 0xFFFF) {
+            reply = "E01";
+            break;
+        }
+        // reads past the end of the address space come back short
+        len = std::min<u32>(len, 0x10000 - addr);
+
+        if(packet.front() == 'm') {
+            for(u32 i = 0; i < len; i++) {
+                appendHex(reply, core.getByteFromIO(addr + i));
+            }
+            break;
+        }
+
+        if(!expect(args, ':')) {
+            reply = "E01";
+            break;
+        }
+        for(u32 i = 0; i < len; i++) {
+            u8 byte;
+            if(!parseHexBytes(args.substr(i * 2), &byte, 1)) {
+                reply = "E01";
+                break;
+            }
+            core.setByteInIO(addr + i, byte);
+        }
+        if(reply.empty()) {
+            reply = "OK";
+        }
+        break;
+    }
+
+    case 'c':
+    case 's': {
+        u32 addr;
+        if(parseHex(args, addr)) {
+            CPU::registers_t regs = core.getRegistersFromCPU();
+            regs.PC               = addr;
+            core.setRegistersInCPU(regs);
+        }
+
+        if(packet.front() == 'c') {
+            // the stop reply goes out once something stops the target
+            this->running = true;
+            return;
+        }
+
+        BreakReason reason = core.tick_instr();
+        this->stop(core, reason == BreakReason::None ? BreakReason::Exec : reason);
+        return;
+    }
+
+    case 'Z':
+    case 'z': this->handleBreakpoint(core, packet); return;
+
+    case 'D':
+        this->detach(core);
+        reply = "OK";
+        break;
+
+    case 'k':
+        // no reply, the debugger closes the connection
+        this->detach(core);
+        return;
+    }
+
+    this->sendPacket(reply);
+}
+
+void Silver::GdbStub::handleBreakpoint(Core &core, std::string const &packet) {
+    bool             insert = packet.front() == 'Z';
+    std::string_view args   = std::string_view(packet).substr(1);
+    u32              type, addr, len;
+    if(!parseHex(args, type) || !expect(args, ',') || !parseHex(args, addr) || !expect(args, ',')
+       || !parseHex(args, len)) {
+        this->sendPacket("E01");
+        return;
+    }
+
+    BreakpointSet &set = core.getBreakpoints();
+
+    if(type <= 1) {
+        // software and hardware breakpoints are the same thing here
+        u8 &count = this->breakpoints[addr];
+        if(insert ? count++ == 0 : count && --count == 0) {
+            u16 bank = addr >> 16, pc = addr & 0xFFFF;
+            if(addr > 0xFFFF) {
+                insert ? set.add_breakpoint(bank, pc) : set.remove_breakpoint(bank, pc);
+            } else {
+                insert ? set.add_breakpoint(pc) : set.remove_breakpoint(pc);
+            }
+        }
+        if(!count) {
+            this->breakpoints.erase(addr);
+        }
+    } else if(type <= 4 && addr <= 0xFFFF) {
+        u8 kind = type == 2 ? WATCH_WRITE : type == 3 ? WATCH_READ : WATCH_READ | WATCH_WRITE;
+        for(u32 a = addr; a < addr + std::max<u32>(len, 1) && a <= 0xFFFF; a++) {
+            u8 &bits = this->watchpoints[a];
+            bits     = insert ? bits | kind : bits & ~kind;
+
+            set.remove_watchpoint(a);
+            set.add_watchpoint(a, bits & WATCH_READ, bits & WATCH_WRITE);
+            if(!bits) {
+                this->watchpoints.erase(a);
+            }
+        }
+    } else {
+        this->sendPacket("");
+        return;
+    }
+
+    this->sendPacket("OK");
+}
+
+void Silver::GdbStub::stop(Core &core, BreakReason reason) {
+    this->running = false;
+
+    break_hit_t const &hit = core.getBreakpoints().last_hit();
+    switch(reason) {
+    case BreakReason::None: this->last_stop = "S02"; break; // SIGINT
+    case BreakReason::Exec: this->last_stop = "S05"; break; // SIGTRAP
+    case BreakReason::Read:
+    case BreakReason::Write: {
+        auto        it   = this->watchpoints.find(hit.addr);
+        u8          bits = it == this->watchpoints.end() ? 0 : it->second;
+        const char *kind = bits == (WATCH_READ | WATCH_WRITE) ? "awatch"
+                         : reason == BreakReason::Read        ? "rwatch"
+                                                              : "watch";
+
+        this->last_stop  = std::string("T05") + kind + ":";
+        appendHex(this->last_stop, hit.addr >> 8);
+        appendHex(this->last_stop, hit.addr & 0xFF);
+        this->last_stop += ";";
+        break;
+    }
+    }
+
+    this->sendPacket(this->last_stop);
+}
+
+void Silver::GdbStub::detach(Core &core) {
+    BreakpointSet &set = core.getBreakpoints();
+    for(auto [addr, count]: this->breakpoints) {
+        addr > 0xFFFF ? set.remove_breakpoint(addr >> 16, addr & 0xFFFF) : set.remove_breakpoint(addr);
+    }
+    for(auto [addr, bits]: this->watchpoints) {
+        set.remove_watchpoint(addr);
+    }
+    this->breakpoints.clear();
+    this->watchpoints.clear();
+    this->running = false;
+
+    // a new connection may already be waiting behind this request
+    std::lock_guard lock(this->requests_mutex);
+    bool            reconnected = std::any_of(this->requests.begin(), this->requests.end(), [](request_t const &r) {
+        return r.kind == request_t::Attach;
+    });
+    this->attached.store(reconnected, std::memory_order_release);
+}
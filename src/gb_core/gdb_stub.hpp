@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "util/types/primitives.hpp"
+
+#include "breakpoints.hpp"
+
+namespace Silver {
+    class Core;
+
+    /**
+     * GDB remote serial protocol stub, listening on a local TCP port or Unix socket.
+     *
+     * The socket is served from the stub's own thread, which only parses packets. Anything that touches the core is
+     * queued and carried out by the thread that runs the core when it calls service(), between instructions. While no
+     * debugger is attached the emulation thread keeps calling Core::tick_frame() itself and never sees the stub.
+     *
+     * Registers are AF, BC, DE, HL, SP, PC in that order, 16 bits each (see CPU::registers_t), described to the
+     * debugger through target.xml. Breakpoint addresses above 0xFFFF are bank << 16 | PC and only hit with that ROM
+     * bank mapped.
+     */
+    class GdbStub {
+    public:
+        GdbStub() = default;
+        ~GdbStub();
+
+        GdbStub(const GdbStub &)             = delete;
+        GdbStub &operator= (const GdbStub &) = delete;
+
+        /**
+         * Start listening, `address` is a TCP port on 127.0.0.1 or the path of a Unix socket
+         * @return false if the socket couldn't be set up
+         */
+        bool listen(const std::string &address);
+
+        /**
+         * A debugger is connected and in control of the core, the emulation thread should call service() instead of
+         * running frames itself
+         */
+        bool isAttached() const { return attached.load(std::memory_order_acquire); }
+
+        /**
+         * Called by the thread that runs `core` once per frame while attached. Carries out the debugger's requests,
+         * runs a frame if the debugger has resumed the target and reports a stop if it hits a breakpoint.
+         */
+        void service(Core &core);
+
+    private:
+        struct request_t {
+            enum { Packet, Interrupt, Attach, Detach } kind;
+            std::string data;
+        };
+
+        void        serverMain();
+        void        clientMain();
+        void        post(request_t &&request);
+
+        /**
+         * @return true if the packet needed the core, otherwise its reply has already been sent
+         */
+        bool        handleLocally(std::string const &packet);
+        void        handle(Core &core, std::string const &packet);
+        void        handleBreakpoint(Core &core, std::string const &packet);
+        void        stop(Core &core, BreakReason reason);
+        void        detach(Core &core);
+
+        void        sendPacket(std::string const &data);
+        void        sendRaw(const char *data, size_t len);
+
+        int                     listen_fd = -1;
+        int                     client_fd = -1; // written under send_mutex
+        bool                    no_ack    = false;
+        std::string             unix_path;
+
+        std::thread             server;
+        std::atomic<bool>       stopping {false};
+        std::atomic<bool>       attached {false};
+
+        std::mutex              send_mutex;
+
+        std::mutex              requests_mutex;
+        std::condition_variable requests_posted;
+        std::deque<request_t>   requests;
+
+        // emulation thread only
+        enum watch_kind_t : u8 { WATCH_WRITE = 1, WATCH_READ = 2 };
+
+        bool                    running = false;
+        std::string             last_stop;
+        std::map<u32, u8>       breakpoints; // address (bank << 16 | PC when banked) -> insert count
+        std::map<u16, u8>       watchpoints; // address -> watch_kind_t bits
+    };
+} // namespace Silver
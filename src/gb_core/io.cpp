@@ -1,9 +1,12 @@
 #include "io.hpp"
 
+#include <cstring>
+
 #include "util/bit.hpp"
 #include "util/log.hpp"
 #include "util/util.hpp"
 
+#include "arena.hpp"
 #include "defs.hpp"
 #include "mem.hpp"
 
@@ -16,77 +19,114 @@
 #define check_ppu_mode(x) ((reg(STAT) & 0x3) == x)
 
 IO_Bus::IO_Bus(
-        Memory *mem, APU *apu, PPU *ppu, Joypad *joy, Cartridge *cart, gb_device_t device,
+        Memory *mem, APU *apu, PPU *ppu, Joypad *joy, Cartridge *cart, state_t *state, gb_device_t device,
         const std::optional<std::shared_ptr<Silver::File>> &bootrom) :
-    mem(mem), apu(apu), ppu(ppu), joy(joy), cart(cart), device(device), bootrom_mode(bootrom.has_value()) {
+    mem(mem), apu(apu), ppu(ppu), joy(joy), cart(cart), device(device), state(state) {
+    memset(state, 0, sizeof(*state));
+    state->bootrom_mode = bootrom.has_value();
+
     if(!bootrom.has_value()) {
-        reg(P1)             = default_reg_values[0][get_default_idx(device)];
-        reg(SB)             = default_reg_values[1][get_default_idx(device)];
-        reg(SC)             = default_reg_values[2][get_default_idx(device)];
-        reg(DIV)            = default_reg_values[3][get_default_idx(device)];
-        reg(TIMA)           = default_reg_values[4][get_default_idx(device)];
-        reg(TMA)            = default_reg_values[5][get_default_idx(device)];
-        reg(TAC)            = default_reg_values[6][get_default_idx(device)];
-        reg(IF)             = default_reg_values[7][get_default_idx(device)];
-        apu->registers.NR10 = default_reg_values[8][get_default_idx(device)];
-        apu->registers.NR11 = default_reg_values[9][get_default_idx(device)];
-        apu->registers.NR12 = default_reg_values[10][get_default_idx(device)];
-        apu->registers.NR13 = default_reg_values[11][get_default_idx(device)];
-        apu->registers.NR14 = default_reg_values[12][get_default_idx(device)];
-        apu->registers.NR21 = default_reg_values[13][get_default_idx(device)];
-        apu->registers.NR22 = default_reg_values[14][get_default_idx(device)];
-        apu->registers.NR23 = default_reg_values[15][get_default_idx(device)];
-        apu->registers.NR24 = default_reg_values[16][get_default_idx(device)];
-        apu->registers.NR30 = default_reg_values[17][get_default_idx(device)];
-        apu->registers.NR31 = default_reg_values[18][get_default_idx(device)];
-        apu->registers.NR32 = default_reg_values[19][get_default_idx(device)];
-        apu->registers.NR33 = default_reg_values[20][get_default_idx(device)];
-        apu->registers.NR34 = default_reg_values[21][get_default_idx(device)];
-        apu->registers.NR41 = default_reg_values[22][get_default_idx(device)];
-        apu->registers.NR42 = default_reg_values[23][get_default_idx(device)];
-        apu->registers.NR43 = default_reg_values[24][get_default_idx(device)];
-        apu->registers.NR44 = default_reg_values[25][get_default_idx(device)];
-        apu->registers.NR50 = default_reg_values[26][get_default_idx(device)];
-        apu->registers.NR51 = default_reg_values[27][get_default_idx(device)];
-        apu->registers.NR52 = default_reg_values[28][get_default_idx(device)];
-        reg(LCDC)           = default_reg_values[29][get_default_idx(device)];
-        reg(STAT)           = default_reg_values[30][get_default_idx(device)];
-        reg(SCY)            = default_reg_values[31][get_default_idx(device)];
-        reg(SCX)            = default_reg_values[32][get_default_idx(device)];
-        reg(LY)             = default_reg_values[33][get_default_idx(device)];
-        reg(LYC)            = default_reg_values[34][get_default_idx(device)];
-        reg(DMA)            = default_reg_values[35][get_default_idx(device)];
-        reg(BGP)            = default_reg_values[36][get_default_idx(device)];
-        reg(OBP0)           = default_reg_values[37][get_default_idx(device)];
-        reg(OBP1)           = default_reg_values[38][get_default_idx(device)];
-        reg(WY)             = default_reg_values[39][get_default_idx(device)];
-        reg(WX)             = default_reg_values[40][get_default_idx(device)];
-        reg(KEY1)           = default_reg_values[41][get_default_idx(device)];
-        reg(VBK)            = default_reg_values[42][get_default_idx(device)];
-        reg(HDMA1)          = default_reg_values[43][get_default_idx(device)];
-        reg(HDMA2)          = default_reg_values[44][get_default_idx(device)];
-        reg(HDMA3)          = default_reg_values[45][get_default_idx(device)];
-        reg(HDMA4)          = default_reg_values[46][get_default_idx(device)];
-        reg(HDMA5)          = default_reg_values[47][get_default_idx(device)];
-        reg(RP)             = default_reg_values[48][get_default_idx(device)];
-        reg(BCPS)           = default_reg_values[49][get_default_idx(device)];
-        reg(BCPD)           = default_reg_values[50][get_default_idx(device)];
-        reg(OCPS)           = default_reg_values[51][get_default_idx(device)];
-        reg(OCPD)           = default_reg_values[52][get_default_idx(device)];
-        reg(SVBK)           = default_reg_values[53][get_default_idx(device)];
-        reg(IE)             = default_reg_values[54][get_default_idx(device)];
+        reg(P1)                    = default_reg_values[0][get_default_idx(device)];
+        reg(SB)                    = default_reg_values[1][get_default_idx(device)];
+        reg(SC)                    = default_reg_values[2][get_default_idx(device)];
+        reg(DIV)                   = default_reg_values[3][get_default_idx(device)];
+        reg(TIMA)                  = default_reg_values[4][get_default_idx(device)];
+        reg(TMA)                   = default_reg_values[5][get_default_idx(device)];
+        reg(TAC)                   = default_reg_values[6][get_default_idx(device)];
+        reg(IF)                    = default_reg_values[7][get_default_idx(device)];
+        apu->state->registers.NR10 = default_reg_values[8][get_default_idx(device)];
+        apu->state->registers.NR11 = default_reg_values[9][get_default_idx(device)];
+        apu->state->registers.NR12 = default_reg_values[10][get_default_idx(device)];
+        apu->state->registers.NR13 = default_reg_values[11][get_default_idx(device)];
+        apu->state->registers.NR14 = default_reg_values[12][get_default_idx(device)];
+        apu->state->registers.NR21 = default_reg_values[13][get_default_idx(device)];
+        apu->state->registers.NR22 = default_reg_values[14][get_default_idx(device)];
+        apu->state->registers.NR23 = default_reg_values[15][get_default_idx(device)];
+        apu->state->registers.NR24 = default_reg_values[16][get_default_idx(device)];
+        apu->state->registers.NR30 = default_reg_values[17][get_default_idx(device)];
+        apu->state->registers.NR31 = default_reg_values[18][get_default_idx(device)];
+        apu->state->registers.NR32 = default_reg_values[19][get_default_idx(device)];
+        apu->state->registers.NR33 = default_reg_values[20][get_default_idx(device)];
+        apu->state->registers.NR34 = default_reg_values[21][get_default_idx(device)];
+        apu->state->registers.NR41 = default_reg_values[22][get_default_idx(device)];
+        apu->state->registers.NR42 = default_reg_values[23][get_default_idx(device)];
+        apu->state->registers.NR43 = default_reg_values[24][get_default_idx(device)];
+        apu->state->registers.NR44 = default_reg_values[25][get_default_idx(device)];
+        apu->state->registers.NR50 = default_reg_values[26][get_default_idx(device)];
+        apu->state->registers.NR51 = default_reg_values[27][get_default_idx(device)];
+        apu->state->registers.NR52 = default_reg_values[28][get_default_idx(device)];
+        reg(LCDC)                  = default_reg_values[29][get_default_idx(device)];
+        reg(STAT)                  = default_reg_values[30][get_default_idx(device)];
+        reg(SCY)                   = default_reg_values[31][get_default_idx(device)];
+        reg(SCX)                   = default_reg_values[32][get_default_idx(device)];
+        reg(LY)                    = default_reg_values[33][get_default_idx(device)];
+        reg(LYC)                   = default_reg_values[34][get_default_idx(device)];
+        reg(DMA)                   = default_reg_values[35][get_default_idx(device)];
+        reg(BGP)                   = default_reg_values[36][get_default_idx(device)];
+        reg(OBP0)                  = default_reg_values[37][get_default_idx(device)];
+        reg(OBP1)                  = default_reg_values[38][get_default_idx(device)];
+        reg(WY)                    = default_reg_values[39][get_default_idx(device)];
+        reg(WX)                    = default_reg_values[40][get_default_idx(device)];
+        reg(KEY1)                  = default_reg_values[41][get_default_idx(device)];
+        reg(VBK)                   = default_reg_values[42][get_default_idx(device)];
+        reg(HDMA1)                 = default_reg_values[43][get_default_idx(device)];
+        reg(HDMA2)                 = default_reg_values[44][get_default_idx(device)];
+        reg(HDMA3)                 = default_reg_values[45][get_default_idx(device)];
+        reg(HDMA4)                 = default_reg_values[46][get_default_idx(device)];
+        reg(HDMA5)                 = default_reg_values[47][get_default_idx(device)];
+        reg(RP)                    = default_reg_values[48][get_default_idx(device)];
+        reg(BCPS)                  = default_reg_values[49][get_default_idx(device)];
+        reg(BCPD)                  = default_reg_values[50][get_default_idx(device)];
+        reg(OCPS)                  = default_reg_values[51][get_default_idx(device)];
+        reg(OCPD)                  = default_reg_values[52][get_default_idx(device)];
+        reg(SVBK)                  = default_reg_values[53][get_default_idx(device)];
+        reg(IE)                    = default_reg_values[54][get_default_idx(device)];
     } else {
         LogWarn("IO_Bus") << "Bootrom enabled";
         bootrom->get()->toVector(bootrom_buffer);
     }
 }
 
+#if defined(SILVER_FLAT_TEST_BUS)
+IO_Bus::IO_Bus(Memory *mem, Joypad *joy, state_t *state, flat_bus_t *flat) :
+    mem(mem), apu(nullptr), ppu(nullptr), joy(joy), cart(nullptr), flat(flat), device(device_GB), state(state) {
+    memset(state, 0, sizeof(*state));
+}
+#endif
+
+IO_Bus::IO_Bus(
+        IO_Bus const &other, Memory *mem, APU *apu, PPU *ppu, Joypad *joy, Cartridge *cart, machine_state_t *state,
+        machine_state_t const &other_state) :
+    IO_Bus(other) {
+    this->mem   = mem;
+    this->apu   = apu;
+    this->ppu   = ppu;
+    this->joy   = joy;
+    this->cart  = cart;
+    this->state = &state->bus;
+    perf        = nullptr;
+    dma_src     = state->rebase(other.dma_src, other_state);
+}
+
 IO_Bus::~IO_Bus() { }
 
 u8 IO_Bus::read(u16 offset, bool bypass) {
+#if defined(SILVER_FLAT_TEST_BUS)
+    if(flat) {
+        if(!bypass) {
+            flat->log.push_back({offset, flat->ram[offset], false});
+        }
+        return flat->ram[offset];
+    }
+#endif
+
+    if(!bypass) {
+        PerfCount(perf, mem_reads[mem_region_of(offset)]++);
+    }
+
     // TODO: this is technically not accurate
     // see future_work/failing_tests/dma/read_read
-    if(dma_active && !bypass) {
+    if(state->dma_active && !bypass) {
         if(bounded(offset, HIGH_RAM_START, HIGH_RAM_END)) {
             return mem->read_hram(offset);
         } else {
@@ -96,7 +136,7 @@ u8 IO_Bus::read(u16 offset, bool bypass) {
 
     if(offset <= CART_ROM_BANK0_END) {
         // 16KB ROM bank 00
-        if(bootrom_mode) {
+        if(state->bootrom_mode) {
             // the gameboy maps its bootrom data from 0x0000 to 0x00FF.
             // The gameboy color maps its bootrom data from 0x0000 to 0x08FF with a fallthrough from 0x100 to 0x1FF for
             // the cartridge header.
@@ -146,9 +186,22 @@ u8 IO_Bus::read(u16 offset, bool bypass) {
     return 0;
 }
 
-void IO_Bus::write(u16 offset, u8 data) {
-    // TODO: do we need a bypass?
-    if(dma_active) {
+void IO_Bus::write(u16 offset, u8 data, bool bypass) {
+#if defined(SILVER_FLAT_TEST_BUS)
+    if(flat) {
+        if(!bypass) {
+            flat->log.push_back({offset, data, true});
+        }
+        flat->ram[offset] = data;
+        return;
+    }
+#endif
+
+    if(!bypass) {
+        PerfCount(perf, mem_writes[mem_region_of(offset)]++);
+    }
+
+    if(state->dma_active && !bypass) {
         if(offset >= 0xFF80 && offset < 0xFFFF) {
             return mem->write_hram(offset, data);
         } else {
@@ -216,7 +269,7 @@ u8 IO_Bus::read_reg(u8 loc) {
     case P1_REG:   return P1_DEFAULTS | joy->read();
 
     // Timer Registers
-    case DIV_REG:  return div_cnt >> 8;
+    case DIV_REG:  return state->div_cnt >> 8;
 
     // Sound Registers
     case NR10_REG:
@@ -240,6 +293,23 @@ u8 IO_Bus::read_reg(u8 loc) {
     case NR50_REG:
     case NR51_REG:
     case NR52_REG: return apu->read_reg(loc);
+
+    case 0x30:
+    case 0x31:
+    case 0x32:
+    case 0x33:
+    case 0x34:
+    case 0x35:
+    case 0x36:
+    case 0x37:
+    case 0x38:
+    case 0x39:
+    case 0x3A:
+    case 0x3B:
+    case 0x3C:
+    case 0x3D:
+    case 0x3E:
+    case 0x3F:     return apu->read_wavram(loc - 0x30);
     case BCPD_REG: return ppu->read_bg_color_data();
     case OCPD_REG: return ppu->read_obj_color_data();
     }
@@ -256,7 +326,16 @@ void IO_Bus::write_reg(u8 loc, u8 data) {
 
         joy->write(data & P1_WRITE_MASK);
         return;
-    case DIV_REG:  div_cnt = 0; return;
+    case DIV_REG:  state->div_cnt = 0; return;
+    case SC_REG:
+        // only the internal clock drives a transfer, an external one never comes without a link partner
+        if(Bit::test(data, 7) && Bit::test(data, 0)) {
+            state->serial_bits = 8;
+            state->serial_byte = reg(SB);
+        } else {
+            state->serial_bits = 0;
+        }
+        break;
 
     // Sound Registers
     case NR10_REG:
@@ -298,24 +377,24 @@ void IO_Bus::write_reg(u8 loc, u8 data) {
     case 0x3C:
     case 0x3D:
     case 0x3E:
-    case 0x3F:     return apu->write_wavram(loc, data);
+    case 0x3F:     return apu->write_wavram(loc - 0x30, data);
     case LCDC_REG:
         // TODO: this can be moved to ppu.cpp or removed
         if(!Bit::test(data, 7) && !check_ppu_mode(MODE_VBLANK)) {
             LogError("IO_Bus") << "LCD Disable outside VBLANK";
         }
         break;
-    case DMA_REG: dma_start = true; break;
+    case DMA_REG: state->dma_start = true; break;
     case ROMEN_REG:
         LogDebug("IO_Bus") << "Boot rom disabled";
-        bootrom_mode = false;
+        state->bootrom_mode = false;
         return;
     case HDMA5_REG:
-        if(hdma_active) {
-            hdma_active = false;
+        if(state->hdma_active) {
+            state->hdma_active = false;
             if(Bit::test(data, 7)) {
                 LogDebug("IO_Bus") << "restarting HDMA";
-                hdma_start = true;
+                state->hdma_start = true;
             } else {
                 LogDebug("IO_Bus") << "stopping HDMA";
                 data |= 0x80;
@@ -323,10 +402,10 @@ void IO_Bus::write_reg(u8 loc, u8 data) {
         } else {
             if(Bit::test(data, 7)) {
                 LogDebug("IO_Bus") << "starting HDMA";
-                hdma_start = true;
+                state->hdma_start = true;
             } else {
                 LogDebug("IO_Bus") << "starting GDMA";
-                gdma_start = true;
+                state->gdma_start = true;
             }
         }
         break;
@@ -349,78 +428,158 @@ void IO_Bus::write_reg(u8 loc, u8 data) {
     mem->write_reg(loc, data);
 }
 
+/**
+ * Resolve a DMA source range to its backing store, mirroring read(offset, true).
+ * DMA sources are page/block aligned so the range never straddles two banks of the same region.
+ * @return nullptr if the range isn't plain memory, the caller falls back to byte-wise reads
+ */
+const u8 *IO_Bus::map_dma_source(u16 offset, u16 len) {
+    u16 last = offset + len - 1;
+
+    if(!block_transfers || (state->bootrom_mode && offset <= GBC_BOOTROM_END)) {
+        return nullptr;
+    } else if(last <= CART_ROM_BANK1_END) {
+        return cart->map_read(offset, len);
+    } else if(bounded(offset, VIDEO_RAM_START, VIDEO_RAM_END) && last <= VIDEO_RAM_END) {
+        return mem->map_vram(offset);
+    } else if(bounded(offset, CART_RAM_START, CART_RAM_END) && last <= CART_RAM_END) {
+        return cart->map_read(offset, len);
+    } else if(bounded(offset, WORK_RAM_BANK0_START, ECHO_RAM_END) && last <= ECHO_RAM_END) {
+        if(offset >= ECHO_RAM_START) {
+            offset -= ECHO_RAM_START - WORK_RAM_BANK0_START;
+            last -= ECHO_RAM_START - WORK_RAM_BANK0_START;
+        }
+
+        // both halves have to sit in the same bank
+        if((offset <= WORK_RAM_BANK0_END) != (last <= WORK_RAM_BANK0_END)) {
+            return nullptr;
+        }
+        return mem->map_ram(offset);
+    }
+
+    return nullptr;
+}
+
+/**
+ * One clock of an internal-clock transfer: shift SB out MSB first and an open line (1s) in. After 8 bits the byte that
+ * went out is captured and the transfer ends with the serial interrupt.
+ */
+void IO_Bus::serial_shift() {
+    reg(SB) = (reg(SB) << 1) | 1;
+
+    if(--state->serial_bits) {
+        return;
+    }
+
+    reg(SC) = Bit::reset(reg(SC), 7);
+    mem->request_interrupt(Interrupt::SERIAL_INT);
+
+    // keep the most recent output around without growing forever
+    if(serial_buffer.size() >= 0x10000) {
+        serial_buffer.erase(0, serial_buffer.size() / 2);
+    }
+    serial_buffer.push_back((char)state->serial_byte);
+}
+
+void IO_Bus::forget_dma_source() {
+    if(dma_src) {
+        mem->forget_oam_dma();
+        dma_src = nullptr;
+    }
+}
+
 void IO_Bus::dma_tick() {
-    if(dma_active) {
-        if(dma_tick_cnt % 4 == 0) {
-            u16 src = (u16)reg(DMA) << 8 | dma_byte_cnt, dest = 0xFE00 | dma_byte_cnt;
-            mem->write_oam(dest, read(src, true));
-            dma_byte_cnt++;
+    if(state->dma_active) {
+        if(state->dma_tick_cnt % 4 == 0) {
+            if(dma_src) {
+                mem->advance_oam_dma();
+            } else {
+                u16 src = (u16)reg(DMA) << 8 | state->dma_byte_cnt, dest = 0xFE00 | state->dma_byte_cnt;
+                mem->write_oam(dest, read(src, true));
+            }
+            state->dma_byte_cnt++;
+            PerfCount(perf, dma_bytes++);
         }
-        dma_tick_cnt++;
+        state->dma_tick_cnt++;
 
-        if(dma_byte_cnt == 0xa0) {
-            dma_active = false;
+        if(state->dma_byte_cnt == 0xa0) {
+            state->dma_active = false;
+            if(dma_src) {
+                mem->end_oam_dma();
+                dma_src = nullptr;
+            }
         }
     }
 
     // delay start by 1 dma tick
-    if(dma_start_active) {
-        dma_start_active = false;
-        dma_active       = true;
+    if(state->dma_start_active) {
+        state->dma_start_active = false;
+        state->dma_active       = true;
+
+        // restarted mid-transfer, the old one has to land before this one can go byte by byte
+        if(dma_src) {
+            mem->end_oam_dma();
+        }
+
+        // the CPU can only touch HRAM until the transfer ends, so the source can't change (or be banked out) under us
+        dma_src = map_dma_source((u16)reg(DMA) << 8, OAM_RAM_SIZE);
+        if(dma_src) {
+            mem->begin_oam_dma(dma_src);
+        }
     }
 
-    if(dma_start) {
-        dma_start        = false;
-        dma_start_active = true;
-        dma_tick_cnt     = 0;
-        dma_byte_cnt     = 0;
+    if(state->dma_start) {
+        state->dma_start        = false;
+        state->dma_start_active = true;
+        state->dma_tick_cnt     = 0;
+        state->dma_byte_cnt     = 0;
     }
 }
 
 void IO_Bus::gdma_tick() {
-    if(gdma_active) {
-        if(gdma_tick_cnt % 32 == 0) {
+    if(state->gdma_active) {
+        if(state->gdma_tick_cnt % 32 == 0) {
             gbc_dma_copy_block();
         }
-        gdma_tick_cnt++;
+        state->gdma_tick_cnt++;
 
         if(reg(HDMA5) == 0xFF) {
-            gdma_active   = false;
-            gdma_tick_cnt = 0;
+            state->gdma_active   = false;
+            state->gdma_tick_cnt = 0;
         }
     }
 
-    if(gdma_start) {
-        if(gdma_tick_cnt % 4 == 0) {
-            gdma_start    = false;
-            gdma_active   = true;
-            gdma_tick_cnt = 0;
+    if(state->gdma_start) {
+        if(state->gdma_tick_cnt % 4 == 0) {
+            state->gdma_start    = false;
+            state->gdma_active   = true;
+            state->gdma_tick_cnt = 0;
         }
-        gdma_tick_cnt++;
+        state->gdma_tick_cnt++;
     }
 }
 
 void IO_Bus::hdma_tick() {
-    if(hdma_active) {
+    if(state->hdma_active) {
         if(check_ppu_mode(MODE_HBLANK)) {
-            if(hdma_can_copy) {
-                hdma_can_copy = false;
+            if(state->hdma_can_copy) {
+                state->hdma_can_copy = false;
                 gbc_dma_copy_block();
             }
         } else {
-            hdma_can_copy = true;
+            state->hdma_can_copy = true;
         }
 
         if(reg(HDMA5) == 0xFF) {
-            hdma_active = false;
+            state->hdma_active = false;
         }
     }
 
-    if(hdma_start) {
+    if(state->hdma_start) {
         reg(HDMA5) &= 0x7F;
-        hdma_start    = false;
-        hdma_active   = true;
-        hdma_can_copy = true;
+        state->hdma_start    = false;
+        state->hdma_active   = true;
+        state->hdma_can_copy = true;
     }
 }
 
@@ -433,15 +592,24 @@ void IO_Bus::gbc_dma_copy_block() {
         reg(L)         = _D & 0xFF; \
     } while(0)
 
-    u16 src  = regs_to_u16(HDMA1, HDMA2);
-    u16 dest = regs_to_u16(HDMA3, HDMA4);
-    for(int i = 0; i < 0x10; i++) {
-        write(0x8000 + dest + i, read(src + i, true));
+    u16       src    = regs_to_u16(HDMA1, HDMA2);
+    u16       dest   = regs_to_u16(HDMA3, HDMA4);
+    u16       target = 0x8000 + dest;
+
+    // write() drops everything while OAM DMA is running, so only take the fast path when it wouldn't
+    const u8 *block  = state->dma_active ? nullptr : map_dma_source(src, 0x10);
+    if(block && target >= VIDEO_RAM_START && target <= VIDEO_RAM_END - 0xF) {
+        mem->write_vram_block(target, block, 0x10);
+    } else {
+        for(int i = 0; i < 0x10; i++) {
+            write(0x8000 + dest + i, read(src + i, true));
+        }
     }
     regs_from_u16(HDMA1, HDMA2, src + 0x10);
     regs_from_u16(HDMA3, HDMA4, dest + 0x10);
 
     reg(HDMA5) -= 1;
+    PerfCount(perf, dma_bytes += 0x10);
 
 #undef regs_from_u16
 #undef regs_to_u16
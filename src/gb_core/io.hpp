@@ -1,6 +1,7 @@
 #pragma once
 
 #include <optional>
+#include <string>
 #include <vector>
 
 #include "util/types/primitives.hpp"
@@ -8,6 +9,7 @@
 #include "apu.hpp"
 #include "cart.hpp"
 #include "joy.hpp"
+#include "perf_counters.hpp"
 #include "ppu.hpp"
 
 // Interupt Offsets
@@ -21,16 +23,63 @@ using Interrupt = Memory::Interrupt;
 
 class CPU;
 
+#if defined(SILVER_FLAT_TEST_BUS)
+/**
+ * Test-only bus contents: 64KB of plain RAM with no cart, PPU, APU or IO registers behind it, and a log of every
+ * access the CPU makes. Lets the CPU run on its own against single-instruction test vectors. Only compiled into the
+ * gb_core_flat_bus build of the core that gb_cpu_tests links, never into gb_core.
+ */
+struct flat_bus_t {
+    struct access_t {
+        u16  addr;
+        u8   data;
+        bool write;
+    };
+
+    u8                    ram[0x10000] = {};
+    std::vector<access_t> log;
+};
+#endif
+
 class IO_Bus {
     friend CPU;
 
 public:
-    IO_Bus(Memory *mem, APU *apu, PPU *ppu, Joypad *joy, Cartridge *cart, gb_device_t device,
+    /**
+     * Boot ROM mapping, the DMA/GDMA/HDMA transfers, the DIV counter and the serial shifter
+     */
+    struct state_t {
+        bool bootrom_mode;
+
+        bool dma_start, dma_start_active, dma_active, gdma_start, gdma_active, hdma_start, hdma_active, hdma_can_copy;
+        u16  dma_tick_cnt, dma_byte_cnt, gdma_tick_cnt;
+
+        u16  div_cnt;
+
+        u8   serial_bits, serial_byte;
+    };
+
+    IO_Bus(Memory *mem, APU *apu, PPU *ppu, Joypad *joy, Cartridge *cart, state_t *state, gb_device_t device,
            const std::optional<std::shared_ptr<Silver::File>> &bootrom = std::nullopt);
+
+#if defined(SILVER_FLAT_TEST_BUS)
+    /**
+     * Route every access to `flat` instead, see flat_bus_t. `mem` still holds the CPU's interrupt and speed registers
+     * and `joy` is only read to leave STOP.
+     */
+    IO_Bus(Memory *mem, Joypad *joy, state_t *state, flat_bus_t *flat);
+#endif
+
+    /**
+     * Fork of `other` on the forked core's components, in-flight DMA carries on from the copy of its source in
+     * `state`
+     */
+    IO_Bus(IO_Bus const &other, Memory *mem, APU *apu, PPU *ppu, Joypad *joy, Cartridge *cart,
+           machine_state_t *state, machine_state_t const &other_state);
     ~IO_Bus();
 
     u8   read(u16 offset, bool bypass = false);
-    void write(u16 offset, u8 data);
+    void write(u16 offset, u8 data, bool bypass = false);
 
     u8   read_reg(u8 loc);
     void write_reg(u8 loc, u8 data);
@@ -39,8 +88,32 @@ public:
     void gdma_tick();
     void hdma_tick();
 
+    bool bootrom_mapped() const { return state->bootrom_mode; }
+
+    void set_perf_counters(perf_counters_t *counters) { perf = counters; }
+
+    /**
+     * Copy DMA sources straight out of their backing memory, off to go through read() one byte at a time
+     */
+    void set_block_transfers(bool enabled) { block_transfers = enabled; }
+
+    /**
+     * Forget the resolved source of a running OAM DMA, the rest of it goes through read(). For after the machine state
+     * was swapped out from under the bus
+     */
+    void forget_dma_source();
+
+    /**
+     * Bytes shifted out over the serial port with the internal clock, with nothing connected on the other end. Test
+     * ROMs print their results this way.
+     */
+    std::string const &serial_output() const { return serial_buffer; }
+    void               clear_serial_output() { serial_buffer.clear(); }
+
 private:
     void            gbc_dma_copy_block();
+    void            serial_shift();
+    const u8       *map_dma_source(u16 offset, u16 len);
 
     Memory         *mem;
     APU            *apu;
@@ -50,13 +123,20 @@ private:
     Cartridge      *cart;
     std::vector<u8> bootrom_buffer;
 
+    perf_counters_t *perf = nullptr;
+#if defined(SILVER_FLAT_TEST_BUS)
+    flat_bus_t      *flat = nullptr;
+#endif
+
     gb_device_t     device;
-    bool            bootrom_mode = false;
+    bool            block_transfers = true;
+
+    state_t        *state; // lives in the core's machine_state_t
 
-    bool dma_start = false, dma_start_active = false, dma_active = false, gdma_start = false, gdma_active = false,
-         hdma_start = false, hdma_active = false, hdma_can_copy = false;
-    u16 dma_tick_cnt = 0, dma_byte_cnt = 0, gdma_tick_cnt = 0;
+    // resolved source of the running OAM DMA, null when it has to go through read() byte by byte
+    const u8 *dma_src = nullptr;
 
     u16 bank_offset;
-    u16 div_cnt = 0;
+
+    std::string serial_buffer;
 };
\ No newline at end of file
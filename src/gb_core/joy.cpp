@@ -2,24 +2,30 @@
 
 #include "util/bit.hpp"
 
-Joypad::Joypad(Memory *mem) :
-    mem(mem) {
-    read_dir_keys    = false;
-    read_button_keys = false;
+Joypad::Joypad(Memory *mem, state_t *state) :
+    state(state), mem(mem) {
+    state->read_dir_keys    = false;
+    state->read_button_keys = false;
+}
+
+Joypad::Joypad(Joypad const &other, Memory *mem, state_t *state) :
+    Joypad(other) {
+    this->mem   = mem;
+    this->state = state;
 }
 
 Joypad::~Joypad() { }
 
-void Joypad::set_input_state(button_states_t state) {
-    current_state = state;
+void Joypad::set_input_state(button_states_t buttons) {
+    current_state = buttons;
 
-    if(read_dir_keys) {
+    if(state->read_dir_keys) {
         if(current_state.down || current_state.up || current_state.left || current_state.right) {
             mem->request_interrupt(Memory::Interrupt::JOYPAD_INT);
         }
     }
 
-    if(read_dir_keys) {
+    if(state->read_dir_keys) {
         if(current_state.start || current_state.select || current_state.b || current_state.a) {
             mem->request_interrupt(Memory::Interrupt::JOYPAD_INT);
         }
@@ -31,18 +37,18 @@ Joypad::button_states_t Joypad::get_input_state() { return current_state; }
 u8                      Joypad::read() {
     u8 bits = 0;
 
-    if(read_dir_keys) {
+    if(state->read_dir_keys) {
         Bit::set(&bits, 4);
     }
-    if(read_button_keys) {
+    if(state->read_button_keys) {
         Bit::set(&bits, 5);
     }
 
-    if(read_dir_keys) {
+    if(state->read_dir_keys) {
         bits |= current_state.down << 3 | current_state.up << 2 | current_state.left << 1 | current_state.right << 0;
     }
 
-    if(read_button_keys) {
+    if(state->read_button_keys) {
         bits |= current_state.start << 3 | current_state.select << 2 | current_state.b << 1 | current_state.a << 0;
     }
 
@@ -50,6 +56,6 @@ u8                      Joypad::read() {
 }
 
 void Joypad::write(u8 data) {
-    read_dir_keys    = Bit::test(data, 5);
-    read_button_keys = Bit::test(data, 4);
+    state->read_dir_keys    = Bit::test(data, 5);
+    state->read_button_keys = Bit::test(data, 4);
 }
@@ -19,17 +19,25 @@ public:
         }
     };
 
-    Joypad(Memory *mem);
+    /**
+     * Which half of the buttons P1 selects, lives in the core's machine_state_t
+     */
+    struct state_t {
+        bool read_dir_keys, read_button_keys;
+    };
+
+    Joypad(Memory *mem, state_t *state);
+    Joypad(Joypad const &other, Memory *mem, state_t *state);
     ~Joypad();
 
-    void                    set_input_state(button_states_t state);
+    void                    set_input_state(button_states_t buttons);
     Joypad::button_states_t get_input_state();
 
     u8                      read();
     void                    write(u8 data);
 
 private:
-    bool            read_dir_keys, read_button_keys;
+    state_t        *state;
     button_states_t current_state;
     Memory         *mem;
 };
\ No newline at end of file
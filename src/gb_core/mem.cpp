@@ -4,6 +4,7 @@
 #include "util/log.hpp"
 #include "util/util.hpp"
 
+#include "arena.hpp"
 #include "defs.hpp"
 
 #define MODE_HBLANK   0
@@ -12,18 +13,18 @@
 #define MODE_VRAM     3
 #define check_mode(x) ((registers.STAT & 0x3) == x)
 
-Memory::Memory(gb_device_t device, bool bootrom_enabled) :
-    device(device) {
+Memory::Memory(machine_state_t *state, gb_device_t device, bool bootrom_enabled) :
+    registers(state->io), device(device) {
     if(dev_is_GBC(device)) {
-        work_ram.resize(GBC_WORK_RAM_SIZE);
-        ppu_ram.resize(GBC_VRAM_SIZE);
+        work_ram = {state->work_ram, GBC_WORK_RAM_SIZE};
+        ppu_ram  = {state->ppu_ram, GBC_VRAM_SIZE};
     } else {
-        work_ram.resize(DMG_WORK_RAM_SIZE);
-        ppu_ram.resize(DMG_VRAM_SIZE);
+        work_ram = {state->work_ram, DMG_WORK_RAM_SIZE};
+        ppu_ram  = {state->ppu_ram, DMG_VRAM_SIZE};
     }
 
-    high_ram.resize(HIGH_RAM_SIZE);
-    oam_ram.resize(OAM_RAM_SIZE);
+    high_ram = {state->high_ram, HIGH_RAM_SIZE};
+    oam_ram  = {state->oam_ram, OAM_RAM_SIZE};
 
     if(!bootrom_enabled) {
         if(dev_is_GBC(device)) {
@@ -36,6 +37,19 @@ Memory::Memory(gb_device_t device, bool bootrom_enabled) :
         // TODO:
         registers = {};
     }
+
+    rebuild_sprite_index();
+}
+
+Memory::Memory(Memory const &other, machine_state_t *state, machine_state_t const &other_state) :
+    Memory(state, other.device, true) {
+    bank_offset         = other.bank_offset;
+    vram_dirty          = other.vram_dirty;
+    sprite_index        = other.sprite_index;
+
+    oam_dma_src         = state->rebase(other.oam_dma_src, other_state);
+    oam_dma_copied      = other.oam_dma_copied;
+    oam_dma_transferred = other.oam_dma_transferred;
 }
 
 Memory::~Memory() { }
@@ -273,13 +287,16 @@ void Memory::write_vram(u16 offset, u8 data, bool bypass, bool bypass_bank1) {
 
     if(bypass) {
         ppu_ram[(DMG_VRAM_SIZE * (bypass_bank1 ? 1 : 0)) + offset] = data;
+        vram_dirty.mark(offset, bypass_bank1);
         return;
     }
 
     if(dev_is_GBC(device) && !get_dmg_compat_mode() && (registers.VBK & VBK_WRITE_MASK)) {
         ppu_ram[DMG_VRAM_SIZE + offset] = data;
+        vram_dirty.mark(offset, true);
     } else {
         ppu_ram[offset] = data;
+        vram_dirty.mark(offset, false);
     }
 }
 
@@ -289,6 +306,8 @@ void Memory::write_vram(u16 offset, u8 data, bool bypass, bool bypass_bank1) {
 u8 Memory::read_oam(u16 offset, bool bypass) {
     DebugCheck(bounded(offset, OBJECT_RAM_START, OBJECT_RAM_END)) << "read_oam OOB: " << as_hex(offset);
 
+    sync_oam_dma();
+
     if((check_mode(MODE_OAM) || check_mode(MODE_VRAM)) && !bypass) {
         return 0xFF;
     }
@@ -301,9 +320,56 @@ void Memory::write_oam(u16 offset, u8 data) {
     DebugCheck(bounded(offset, OBJECT_RAM_START, OBJECT_RAM_END)) << "write_oam OOB: " << as_hex(offset);
 
     offset -= OBJECT_RAM_START;
+
+    // byte 0 of each entry is the sprite's Y position
+    if((offset & 0x3) == 0) {
+        sprite_index.update(offset >> 2, oam_ram[offset], data);
+    }
     oam_ram[offset] = data;
 }
 
+int Memory::get_line_sprites(int line, bool tall_sprites, u8 (&out)[MAX_SPRITES_PER_LINE]) {
+    sync_oam_dma();
+    return sprite_index.lookup(line, tall_sprites, oam_ram.data(), out);
+}
+
+void Memory::rebuild_sprite_index() { sprite_index.rebuild(oam_ram.data()); }
+
+void Memory::begin_oam_dma(const u8 *src) {
+    // a restart cuts the running transfer short, whatever it got through stays
+    sync_oam_dma();
+    oam_dma_src         = src;
+    oam_dma_copied      = 0;
+    oam_dma_transferred = 0;
+}
+
+void Memory::end_oam_dma() {
+    sync_oam_dma();
+    oam_dma_src         = nullptr;
+    oam_dma_copied      = 0;
+    oam_dma_transferred = 0;
+}
+
+void Memory::forget_oam_dma() {
+    oam_dma_src         = nullptr;
+    oam_dma_copied      = 0;
+    oam_dma_transferred = 0;
+}
+
+void Memory::flush_oam_dma() {
+    DebugCheck(oam_dma_src != nullptr) << "OAM DMA flush without a source";
+
+    u8 from = oam_dma_copied, to = oam_dma_transferred;
+
+    // keep the sprite index in step for every Y byte in the range, before OAM loses the old values
+    for(u8 i = (from + 3) & ~3; i < to; i += 4) {
+        sprite_index.update(i >> 2, oam_ram[i], oam_dma_src[i]);
+    }
+
+    memcpy(&oam_ram[from], oam_dma_src + from, to - from);
+    oam_dma_copied = to;
+}
+
 /**
  * RAM
  **/
@@ -347,6 +413,36 @@ void Memory::write_ram(u16 offset, u8 data) {
     }
 }
 
+u8 *Memory::map_ram(u16 offset) {
+    DebugCheck(bounded(offset, WORK_RAM_BANK0_START, WORK_RAM_BANK1_END)) << "map_ram OOB: " << as_hex(offset);
+
+    offset -= WORK_RAM_BANK0_START;
+    if(offset >= WORK_RAM_BANK_SIZE && dev_is_GBC(device)) {
+        offset -= WORK_RAM_BANK_SIZE;
+        u16 bank_mult = ((registers.SVBK == 0) ? 1 : registers.SVBK) & SVBK_READ_MASK;
+        offset += bank_mult * WORK_RAM_BANK_SIZE;
+    }
+    return &work_ram[offset];
+}
+
+u8 *Memory::map_vram(u16 offset, bool bank1) {
+    DebugCheck(bounded(offset, VIDEO_RAM_START, VIDEO_RAM_END)) << "map_vram OOB: " << as_hex(offset);
+
+    return &ppu_ram[(DMG_VRAM_SIZE * (bank1 ? 1 : 0)) + (offset - VIDEO_RAM_START)];
+}
+
+void Memory::write_vram_block(u16 offset, const u8 *data, u16 len) {
+    DebugCheck(bounded(offset, VIDEO_RAM_START, VIDEO_RAM_END) && offset + len - 1 <= VIDEO_RAM_END)
+            << "write_vram_block OOB: " << as_hex(offset);
+
+    bool bank1 = dev_is_GBC(device) && !get_dmg_compat_mode() && (registers.VBK & VBK_WRITE_MASK);
+    memmove(map_vram(offset, bank1), data, len);
+
+    for(u16 i = 0; i < len; i++) {
+        vram_dirty.mark(offset - VIDEO_RAM_START + i, bank1);
+    }
+}
+
 /**
  * HRAM
  **/
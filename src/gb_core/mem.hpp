@@ -1,10 +1,13 @@
 #pragma once
 
-#include <vector>
+#include <cstring>
+#include <span>
 
+#include "util/flags.hpp"
 #include "util/types/primitives.hpp"
 
 #include "defs.hpp"
+#include "sprite_index.hpp"
 
 #define HIGH_RAM_SIZE      0x7f
 
@@ -20,6 +23,7 @@
 
 class Core;
 class IO_Bus;
+struct machine_state_t;
 
 class Memory {
     friend Core;
@@ -34,7 +38,11 @@ public:
         JOYPAD_INT   = 1 << 4,
     };
 
-    Memory(gb_device_t device, bool bootrom_enabled);
+    Memory(machine_state_t *state, gb_device_t device, bool bootrom_enabled);
+    /**
+     * Fork of `other`, whose state `state` is a copy of
+     */
+    Memory(Memory const &other, machine_state_t *state, machine_state_t const &other_state);
     ~Memory();
 
     u8   read_reg(u8 loc);
@@ -52,6 +60,49 @@ public:
     u8   read_hram(u16 loc);
     void write_hram(u16 loc, u8 data);
 
+    /**
+     * Backing store for loc, for the DMA engines. Banking follows read_ram and read_vram(loc, true, bank1)
+     */
+    u8  *map_ram(u16 loc);
+    u8  *map_vram(u16 loc, bool bank1 = false);
+
+    /**
+     * Copy a block into VRAM through the currently selected bank, as if by len calls to write_vram
+     */
+    void write_vram_block(u16 loc, const u8 *data, u16 len);
+
+    /**
+     * OAM DMA from a plain memory source.
+     *
+     * The transfer engine only counts bytes as they would be transferred, the actual copy into OAM (and the sprite
+     * index update) is deferred until something looks at OAM, so most transfers end up as a single memcpy.
+     * src must stay valid and unchanged for the duration of the transfer, which holds since the CPU can't write
+     * anything but HRAM while OAM DMA is running.
+     */
+    void begin_oam_dma(const u8 *src);
+    void end_oam_dma();
+    /**
+     * Drop the in-flight transfer without applying the rest of it, for when OAM has been replaced wholesale
+     */
+    void forget_oam_dma();
+
+    __force_inline void advance_oam_dma() { oam_dma_transferred++; }
+
+    /**
+     * Apply any OAM DMA bytes that have been transferred but not yet copied
+     */
+    __force_inline void sync_oam_dma() {
+        if(oam_dma_copied != oam_dma_transferred) {
+            flush_oam_dma();
+        }
+    }
+
+    /**
+     * OAM indexes of the sprites on `line`, see SpriteIndex::lookup
+     */
+    int  get_line_sprites(int line, bool tall_sprites, u8 (&out)[MAX_SPRITES_PER_LINE]);
+    void rebuild_sprite_index();
+
     void request_interrupt(Interrupt i);
 
     void set_dmg_compat_mode(bool compat_mode);
@@ -112,15 +163,69 @@ public:
 
         u8 SVBK;
         u8 IE;
-    } registers;
+    };
+
+    // lives in the core's machine_state_t
+    io_registers_t &registers;
+
+    /**
+     * VRAM change tracking for the debug viewers. Every VRAM write bumps `generation` and sets the bit of the tile or
+     * map entry it landed in, Core::refreshVRAMView() consumes the bits.
+     */
+    struct vram_dirty_t {
+        static constexpr u32 tiles_per_bank = 0x1800 / 16;
+        static constexpr u32 map_entries    = 0x800; // both maps, bank 1 holds the attributes of the same entries
+
+        u64                  generation     = 0;
+        u64                  tiles[2][tiles_per_bank / 64] = {};
+        u64                  map[map_entries / 64]         = {};
+
+        /**
+         * @param offset from the start of VRAM
+         */
+        __force_inline void  mark(u16 offset, bool bank1) {
+            generation++;
+            if(offset < 0x1800) {
+                tiles[bank1][offset >> 10] |= 1ull << ((offset >> 4) & 63);
+            } else {
+                offset -= 0x1800;
+                map[offset >> 6] |= 1ull << (offset & 63);
+            }
+        }
+
+        void mark_all() {
+            generation++;
+            memset(tiles, 0xFF, sizeof(tiles));
+            memset(map, 0xFF, sizeof(map));
+        }
+
+        void clear() {
+            memset(tiles, 0, sizeof(tiles));
+            memset(map, 0, sizeof(map));
+        }
+    };
+
+    // maintained by write_vram and write_vram_block
+    vram_dirty_t    vram_dirty;
 
 private:
     gb_device_t     device;
 
     u16             bank_offset;
 
-    std::vector<u8> work_ram;
-    std::vector<u8> high_ram;
-    std::vector<u8> ppu_ram;
-    std::vector<u8> oam_ram;
+    // views into the core's machine_state_t, sized for the current device
+    std::span<u8>   work_ram;
+    std::span<u8>   high_ram;
+    std::span<u8>   ppu_ram;
+    std::span<u8>   oam_ram;
+
+    // derived from oam_ram, maintained by write_oam
+    SpriteIndex     sprite_index;
+
+    // in-flight OAM DMA, see begin_oam_dma
+    const u8       *oam_dma_src         = nullptr;
+    u8              oam_dma_copied      = 0;
+    u8              oam_dma_transferred = 0;
+
+    void            flush_oam_dma();
 };
\ No newline at end of file
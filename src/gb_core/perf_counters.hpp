@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+
+#include "util/flags.hpp"
+#include "util/types/primitives.hpp"
+
+/**
+ * Hot-path performance counters. Only built when SILVER_PERF_COUNTERS is defined (Debug builds, or any build with
+ * BUILD_WITH_PERF_COUNTERS on), otherwise every PerfCount() compiles to nothing and Core::getPerfCounters() returns
+ * zeros.
+ */
+#if defined(SILVER_PERF_COUNTERS)
+inline constexpr bool perf_counters_enabled = true;
+
+#define PerfCount(counters, expr) \
+    do { \
+        if(counters) { \
+            (counters)->expr; \
+        } \
+    } while(0)
+#else
+inline constexpr bool perf_counters_enabled = false;
+
+#define PerfCount(counters, expr) \
+    do { \
+    } while(0)
+#endif
+
+enum mem_region_t : u8 {
+    MEM_REGION_ROM,
+    MEM_REGION_VRAM,
+    MEM_REGION_SRAM,
+    MEM_REGION_WRAM,
+    MEM_REGION_ECHO,
+    MEM_REGION_OAM, // including the unusable area after it
+    MEM_REGION_IO,  // including IE
+    MEM_REGION_HRAM,
+    MEM_REGION_COUNT
+};
+
+inline constexpr const char *mem_region_names[MEM_REGION_COUNT]
+        = {"ROM", "VRAM", "SRAM", "WRAM", "Echo", "OAM", "IO", "HRAM"};
+
+constexpr mem_region_t mem_region_of(u16 addr) {
+    switch(addr >> 13) {
+    case 0:
+    case 1:
+    case 2:
+    case 3: return MEM_REGION_ROM;
+    case 4: return MEM_REGION_VRAM;
+    case 5: return MEM_REGION_SRAM;
+    case 6: return MEM_REGION_WRAM;
+    default:
+        if(addr < 0xFE00) {
+            return MEM_REGION_ECHO;
+        } else if(addr < 0xFF00) {
+            return MEM_REGION_OAM;
+        } else if(addr < 0xFF80 || addr == 0xFFFF) {
+            return MEM_REGION_IO;
+        }
+        return MEM_REGION_HRAM;
+    }
+}
+
+struct perf_counters_t {
+    // per frame
+    u64    cpu_ns;      // host time, estimated from a sample of clocks, see PerfSampler
+    u64    ppu_ns;
+    u64    apu_ns;
+    u64    instructions;
+    u64    mem_reads[MEM_REGION_COUNT];
+    u64    mem_writes[MEM_REGION_COUNT];
+    u64    dma_bytes;   // OAM DMA and GDMA/HDMA
+    u64    lines_rendered;
+
+    // since the core was created
+    u64    frames;
+    u64    audio_underflows;
+
+    // right now
+    size_t audio_queue_fill; // buffers waiting for the audio callback
+};
+
+/**
+ * Times one clock out of every `period` and scales it up, reading the host clock on every emulated clock would cost
+ * more than the work being measured
+ */
+class PerfSampler {
+public:
+    static constexpr u32 period = 64;
+
+    __force_inline void  begin() {
+        if constexpr(perf_counters_enabled) {
+            timing = ++cntr == period;
+            if(timing) {
+                cntr = 0;
+                last = now();
+            }
+        }
+    }
+
+    /**
+     * Charge the time since begin() or the last lap to `ns`
+     */
+    __force_inline void lap(u64 &ns) {
+        if constexpr(perf_counters_enabled) {
+            if(timing) {
+                u64 t = now();
+                ns += (t - last) * period;
+                last = t;
+            }
+        }
+    }
+
+private:
+    static u64 now() {
+        using Clock = std::chrono::steady_clock;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    u32  cntr   = 0;
+    bool timing = false;
+    u64  last   = 0;
+};
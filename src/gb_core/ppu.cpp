@@ -1,5 +1,6 @@
 #include "ppu.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <cstring>
@@ -185,34 +186,51 @@ constexpr PPU::palette_t compat_palettes[] = {
 // clang-format on
 #undef rgb
 
-PPU::PPU(Cartridge *cart, Memory *mem, gb_device_t device, bool bootrom_enabled = false) :
-    cart(cart), mem(mem), device(device) {
-    pixBuf = std::vector<Silver::Pixel>(PPU::native_pixel_count);
+PPU::PPU(Cartridge *cart, Memory *mem, state_t *state, gb_device_t device, bool bootrom_enabled, output_mode_t output) :
+    cart(cart), mem(mem), device(device), output(output), state(state) {
+    *state                   = {};
+    state->vram_fetch_step   = IDLE;
+    state->pause_bg_fifo     = true;
+    state->obj_priority_mode = true;
+
+    if(output.format == output_mode_t::RGBA) {
+        pixBuf = std::vector<Silver::Pixel>(PPU::native_pixel_count);
+        for(u32 line = 0; line < native_height; line++) {
+            hash_line(line);
+        }
+    } else {
+        this->output.x_step = std::max<u8>(1, output.x_step);
+        this->output.y_step = std::max<u8>(1, output.y_step);
+        outBuf              = std::vector<u8>(this->output.width() * this->output.height());
+        for(u32 line = 0; line < native_height; line++) {
+            hash_output_line(line);
+        }
+    }
 
     // TODO: demagic
 
     // Set object priority defaults, GBC will flip this later for dmg-compat mode if applicable
     // or we'll do it if there emulating the bootrom
     if(dev_is_GB(device)) {
-        obj_priority_mode = true;
+        state->obj_priority_mode = true;
     } else if(this->isGBCAllowed()) {
-        obj_priority_mode = false;
+        state->obj_priority_mode = false;
     }
 
     if(!bootrom_enabled) {
         LogWarn("PPU") << "Starting PPU without bootrom not fully supported!";
 
         if(dev_is_GB(device)) {
-            bg_palettes[0]  = gb_palette;
-            obj_palettes[0] = gb_palette;
+            state->bg_palettes[0]  = gb_palette;
+            state->obj_palettes[0] = gb_palette;
         } else if(this->isGBCAllowed()) {
             if(cart->isCGBCart()) {
-                for(auto &bg_palette : bg_palettes) {
+                for(auto &bg_palette : state->bg_palettes) {
                     bg_palette = {0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF};
                 }
             } else {
                 // set dmg-style object priority
-                obj_priority_mode = true;
+                state->obj_priority_mode = true;
                 mem->set_dmg_compat_mode(true);
 
                 /**
@@ -266,28 +284,28 @@ PPU::PPU(Cartridge *cart, Memory *mem, gb_device_t device, bool bootrom_enabled
                 switch(shuffle_flags & 0x3) {
                 // remember, OBP0 = 0, OBP1 = 1 in both the triplet and the obj_palette, BGP = 2 in the triplet.
                 case 0b000:
-                    obj_palettes[0] = compat_palettes[(*triplet)[2]]; // same as BGP
-                    obj_palettes[1] = compat_palettes[(*triplet)[2]]; // same as BGP
+                    state->obj_palettes[0] = compat_palettes[(*triplet)[2]]; // same as BGP
+                    state->obj_palettes[1] = compat_palettes[(*triplet)[2]]; // same as BGP
                     break;
                 case 0b001:
-                    obj_palettes[0] = compat_palettes[(*triplet)[0]];
-                    obj_palettes[1] = compat_palettes[(*triplet)[2]]; // same as BGP
+                    state->obj_palettes[0] = compat_palettes[(*triplet)[0]];
+                    state->obj_palettes[1] = compat_palettes[(*triplet)[2]]; // same as BGP
                     break;
                 case 0b010:
-                    obj_palettes[0] = compat_palettes[(*triplet)[2]]; // same as BGP
-                    obj_palettes[1] = compat_palettes[(*triplet)[0]]; // same as OBP0
+                    state->obj_palettes[0] = compat_palettes[(*triplet)[2]]; // same as BGP
+                    state->obj_palettes[1] = compat_palettes[(*triplet)[0]]; // same as OBP0
                     break;
                 case 0b011:
-                    obj_palettes[0] = compat_palettes[(*triplet)[0]];
-                    obj_palettes[1] = compat_palettes[(*triplet)[0]]; // same as OBP0
+                    state->obj_palettes[0] = compat_palettes[(*triplet)[0]];
+                    state->obj_palettes[1] = compat_palettes[(*triplet)[0]]; // same as OBP0
                     break;
                 case 0b100:
-                    obj_palettes[0] = compat_palettes[(*triplet)[2]]; // same as BGP
-                    obj_palettes[1] = compat_palettes[(*triplet)[1]];
+                    state->obj_palettes[0] = compat_palettes[(*triplet)[2]]; // same as BGP
+                    state->obj_palettes[1] = compat_palettes[(*triplet)[1]];
                     break;
                 case 0b101:
-                    obj_palettes[0] = compat_palettes[(*triplet)[0]];
-                    obj_palettes[1] = compat_palettes[(*triplet)[1]];
+                    state->obj_palettes[0] = compat_palettes[(*triplet)[0]];
+                    state->obj_palettes[1] = compat_palettes[(*triplet)[1]];
                     break;
                 // these cases don't appear be used.
                 case 0b110:
@@ -296,27 +314,32 @@ PPU::PPU(Cartridge *cart, Memory *mem, gb_device_t device, bool bootrom_enabled
                 }
 
                 // BGP never changes from the 3rd offset
-                bg_palettes[0] = compat_palettes[(*triplet)[2]];
+                state->bg_palettes[0] = compat_palettes[(*triplet)[2]];
 
                 LogDebug("PPU") << "compat palletes chosen:";
-                LogDebug("PPU") << "BGP: " << bg_palettes[0].to_rgb24_string();
-                LogDebug("PPU") << "OBP0: " << obj_palettes[0].to_rgb24_string();
-                LogDebug("PPU") << "OBP1: " << obj_palettes[1].to_rgb24_string();
+                LogDebug("PPU") << "BGP: " << state->bg_palettes[0].to_rgb24_string();
+                LogDebug("PPU") << "OBP0: " << state->obj_palettes[0].to_rgb24_string();
+                LogDebug("PPU") << "OBP1: " << state->obj_palettes[1].to_rgb24_string();
             }
         }
     }
 
-    new_frame         = true;
-    first_frame       = true;
+    state->new_frame         = true;
+    state->first_frame       = true;
 
-    frame_clock_count = 0;
+    state->frame_clock_count = 0;
 }
 
-PPU::~PPU() {
-    delete bg_fifo;
-    delete sp_fifo;
+PPU::PPU(PPU const &other, Cartridge *cart, Memory *mem, state_t *state) :
+    PPU(other) {
+    this->cart  = cart;
+    this->mem   = mem;
+    this->state = state;
+    this->perf  = nullptr;
 }
 
+PPU::~PPU() { }
+
 void PPU::set_color_data(u8 *reg, palette_t *palette_mem, u8 data) {
     /**
      * (O/B)CPS Register Bit Format
@@ -337,7 +360,7 @@ void PPU::set_color_data(u8 *reg, palette_t *palette_mem, u8 data) {
     }
 
     // Deny color write if in mode 3
-    if(process_step != SCANLINE_VRAM) {
+    if(state->process_step != SCANLINE_VRAM) {
         u16 *color = &palette_mem[palette_idx].colors[color_idx];
 
         if(high_byte) {
@@ -358,23 +381,128 @@ u8 PPU::get_color_data(u8 *reg, palette_t *palette_mem) {
     return (palette.colors[color_idx] >> (8 * byte_idx)) & 0xFF;
 }
 
-void PPU::write_bg_color_data(u8 data) { set_color_data(&reg(BCPS), bg_palettes, data); }
+void PPU::write_bg_color_data(u8 data) { set_color_data(&reg(BCPS), state->bg_palettes, data); }
 
-u8   PPU::read_bg_color_data() { return get_color_data(&reg(BCPS), bg_palettes); }
+u8   PPU::read_bg_color_data() { return get_color_data(&reg(BCPS), state->bg_palettes); }
 
-void PPU::write_obj_color_data(u8 data) { set_color_data(&reg(OCPS), obj_palettes, data); }
+void PPU::write_obj_color_data(u8 data) { set_color_data(&reg(OCPS), state->obj_palettes, data); }
 
-u8   PPU::read_obj_color_data() { return get_color_data(&reg(OCPS), obj_palettes); }
+u8   PPU::read_obj_color_data() { return get_color_data(&reg(OCPS), state->obj_palettes); }
 
 void PPU::set_obj_priority(bool obj_has_priority) {
     // true on DMG and CGB Compat Mode
     //  false on CGB
     // TODO: we don't currently use this flag. fix that
-    obj_priority_mode = obj_has_priority;
+    state->obj_priority_mode = obj_has_priority;
 }
 
 const std::vector<Silver::Pixel> &PPU::getPixelBuffer() { return this->pixBuf; }
 
+namespace {
+    // xor-multiply over 64 bit words, meant for spotting changes rather than resisting collisions
+    constexpr u64 hash_seed       = 0xcbf29ce484222325;
+    constexpr u64 hash_multiplier = 0x9e3779b97f4a7c15;
+
+    __force_inline u64 hash_word(u64 hash, u64 word) {
+        hash = (hash ^ word) * hash_multiplier;
+        return hash ^ (hash >> 32);
+    }
+
+    // hashed words are put together little-endian with shifts so the hashes are the same on any host, compilers
+    // turn them into plain loads on little-endian ones
+    __force_inline u32 pixel_word(Silver::Pixel const &pixel) {
+        return pixel.r | pixel.g << 8 | pixel.b << 16 | u32(pixel.a) << 24;
+    }
+
+    __force_inline u64 bytes_word(const u8 *bytes, u32 count) {
+        u64 word = 0;
+        for(u32 i = 0; i < count; i++) {
+            word |= u64(bytes[i]) << (i * 8);
+        }
+        return word;
+    }
+
+    // BT.601 weights in 8.8 fixed point, with the 5 bit channels scaled up to 8
+    __force_inline u8 luminance(u16 color) {
+        u32 r = color & 0x1F, g = (color >> 5) & 0x1F, b = (color >> 10) & 0x1F;
+        return ((77 * r + 150 * g + 29 * b) * 255 / 31) >> 8;
+    }
+} // namespace
+
+void PPU::hash_line(u32 line) {
+    static_assert(native_width % 2 == 0);
+
+    const Silver::Pixel *pixels = &pixBuf[line * native_width];
+    u64                  hash   = hash_seed;
+    for(u32 x = 0; x < native_width; x += 2) {
+        hash = hash_word(hash, pixel_word(pixels[x]) | u64(pixel_word(pixels[x + 1])) << 32);
+    }
+    line_hashes[line] = hash;
+}
+
+void PPU::hash_output_line(u32 line) {
+    u64 hash = hash_seed;
+    if(line % output.y_step == 0) {
+        u32       width = output.width();
+        const u8 *row   = &outBuf[(line / output.y_step) * width];
+        for(u32 x = 0; x < width; x += 8) {
+            hash = hash_word(hash, bytes_word(&row[x], std::min<u32>(8, width - x)));
+        }
+    }
+    line_hashes[line] = hash;
+}
+
+__force_inline void PPU::output_compact(fifo_color_t color) {
+    if(out_x_phase == 0 && out_y_phase == 0 && out_pos < outBuf.size()) {
+        outBuf[out_pos++] = output.format == output_mode_t::Luminance
+                                  ? luminance(resolve_color(color))
+                                  : color.bits & (fifo_color_t::OBJ_FLAG | fifo_color_t::PALETTE_MASK
+                                                  | fifo_color_t::COLOR_MASK);
+    }
+    if(++out_x_phase == output.x_step) {
+        out_x_phase = 0;
+    }
+}
+
+u64 PPU::getFrameHash() const {
+    u64 hash = hash_seed;
+    for(u64 line_hash: line_hashes) {
+        hash = hash_word(hash, line_hash);
+    }
+    return hash;
+}
+
+void PPU::resync_output() {
+    current_pixel = 0;
+    out_pos       = 0;
+    out_x_phase   = 0;
+    out_y_phase   = 0;
+    if(state->frame_disable) {
+        return;
+    }
+
+    // past the last line everything has been written, same as the start of line 144
+    u32 line = state->y_cntr, pix = state->pix_clock_count;
+    if(line >= native_height) {
+        line = native_height;
+        pix  = 0;
+    }
+
+    current_pixel = line * native_width + pix;
+
+    // bytes of the lines kept so far, then of this line if it's kept
+    u32 x_step  = output.x_step, y_step = output.y_step;
+    out_pos     = (line + y_step - 1) / y_step * output.width();
+    out_pos    += line % y_step == 0 ? (pix + x_step - 1) / x_step : 0;
+    out_x_phase = pix == native_width ? 0 : pix % x_step;
+    out_y_phase = (pix == native_width ? line + 1 : line) % y_step;
+}
+
+u16               PPU::resolve_color(fifo_color_t color) const {
+    const palette_t *palettes = color.is_obj() ? state->obj_palettes : state->bg_palettes;
+    return palettes[color.palette_idx()].colors[color.color_idx()];
+}
+
 bool              PPU::isGBCAllowed() { return dev_is_GBC(this->device) && !mem->get_dmg_compat_mode(); }
 
 /**
@@ -393,34 +521,25 @@ PPU::obj_sprite_t PPU::oam_fetch_sprite(int index) {
 }
 
 void PPU::process_tile_line(std::array<fifo_color_t, 8> &arr, u8 byte_1, u8 byte_2, u8 bg_attr) {
+    bool gbc         = this->isGBCAllowed();
+    bool x_flip      = gbc && BG_X_FLIP(bg_attr);
+    bool priority    = gbc && BG_PRIORITY(bg_attr);
+    u8   palette_idx = gbc ? BG_PALETTE(bg_attr) : 0;
+
     for(int i = 0; i < 8; i++) {
-        u8 x_pixel  = (this->isGBCAllowed() && BG_X_FLIP(bg_attr)) ? (i) : (7 - i);
+        u8 x_pixel  = x_flip ? (i) : (7 - i);
 
         u8 tile_idx = ((byte_1 >> x_pixel) & 1);
         tile_idx |= ((byte_2 >> x_pixel) & 1) << 1;
 
-        fifo_color_t color {};
-        u8           palette_idx;
-        if(this->isGBCAllowed()) {
-            color.priority  = BG_PRIORITY(bg_attr);
-            palette_idx     = BG_PALETTE(bg_attr);
-            color.color_idx = tile_idx & 0x3_u8;
-        } else {
-            tile_idx <<= 1;
-            color.priority  = false;
-            palette_idx     = 0;
-            color.color_idx = (reg(BGP) >> tile_idx) & 0x3_u8;
-        }
-
-        color.palette        = &bg_palettes[palette_idx];
-        color.is_transparent = false;
+        u8 color_idx = gbc ? tile_idx : (reg(BGP) >> (tile_idx << 1)) & 0x3_u8;
 
-        arr[i] = color;
+        arr[i]       = fifo_color_t::make(color_idx, palette_idx, false, priority, false);
     }
 }
 
 void PPU::enqueue_sprite_data(PPU::obj_sprite_t const &curr_sprite) {
-    s8 pixel_line = y_cntr - (curr_sprite.pos_y - 16);
+    s8 pixel_line = state->y_cntr - (curr_sprite.pos_y - 16);
     u8 tile_num   = curr_sprite.tile_num & (LCDC_BIG_SPRITES ? ~1 : ~0);
 
     if(OBJ_Y_FLIP(curr_sprite)) {
@@ -428,93 +547,82 @@ void PPU::enqueue_sprite_data(PPU::obj_sprite_t const &curr_sprite) {
     }
 
     u16  addr          = 0x8000 | (tile_num << 4) | (pixel_line << 1);
-    bool bank1         = this->isGBCAllowed() && OBJ_GBC_VRAM_BANK(curr_sprite);
+    bool gbc           = this->isGBCAllowed();
+    bool bank1         = gbc && OBJ_GBC_VRAM_BANK(curr_sprite);
     u8   sprite_tile_1 = mem->read_vram(addr, true, bank1), sprite_tile_2 = mem->read_vram(addr + 1, true, bank1);
-    u8   palette = !OBJ_GB_PALETTE(curr_sprite) ? reg(OBP0) : reg(OBP1);
+    u8   palette       = !OBJ_GB_PALETTE(curr_sprite) ? reg(OBP0) : reg(OBP1);
+    u8   palette_idx   = gbc ? OBJ_GBC_PALETTE(curr_sprite) : 0;
+    bool priority      = !OBJ_PRIORITY(curr_sprite);
+
+    // pad the FIFO out to a full tile with transparent pixels so the merge below doesn't have to care how much of the
+    // previous sprite is left
+    while(state->sp_fifo.size() < 8) {
+        state->sp_fifo.push(fifo_color_t {fifo_color_t::TRANSPARENT_FLAG});
+    }
 
     for(int i = 0; i < 8; i++) {
-        u8 pix_idx = i;
-        if(OBJ_X_FLIP(curr_sprite)) {
-            pix_idx = 7 - pix_idx;
-        }
+        u8 pix_idx  = OBJ_X_FLIP(curr_sprite) ? 7 - i : i;
 
         u8 tile_idx = ((sprite_tile_1 >> (7 - pix_idx)) & 1);
         tile_idx |= ((sprite_tile_2 >> (7 - pix_idx)) & 1) << 1;
 
-        fifo_color_t color {};
-        u8           palette_idx;
-        if(this->isGBCAllowed()) {
-            palette_idx     = OBJ_GBC_PALETTE(curr_sprite);
-            color.color_idx = tile_idx;
-        } else {
-            tile_idx <<= 1;
-            palette_idx     = 0;
-            color.color_idx = static_cast<u8>((palette >> tile_idx) & 0x3_u8);
-        }
-        color.palette        = &obj_palettes[palette_idx];
-        color.is_transparent = tile_idx == 0;
-        color.priority       = !OBJ_PRIORITY(curr_sprite);
-
-        if(sp_fifo->size() > i) {
-            // lower idx sprites have priority, only replace pixels
-            //  if one is transparent
-            if(!color.is_transparent && sp_fifo->at(i).is_transparent) {
-                sp_fifo->replace(i, color);
-            }
-        } else {
-            sp_fifo->enqueue(color);
-        }
+        u8           color_idx = gbc ? tile_idx : (palette >> (tile_idx << 1)) & 0x3_u8;
+        fifo_color_t color     = fifo_color_t::make(color_idx, palette_idx, true, priority, tile_idx == 0);
+
+        // lower idx sprites have priority, only replace pixels that are transparent.
+        //  keep = 0xFF if the queued pixel is opaque, 0x00 if it's transparent
+        u8 &queued = state->sp_fifo.at(i).bits;
+        u8  keep   = ((queued >> fifo_color_t::TRANSPARENT_SHIFT) & 1) - 1;
+        queued     = (queued & keep) | (color.bits & ~keep);
     }
 }
 
 void PPU::ppu_tick_oam() {
-    switch(oam_fetch_step) {
+    // the sprite search itself is a lookup in Memory's sprite index, we only keep the mode's 2 clocks per entry timing
+    switch(state->oam_fetch_step) {
     // oam clk 1
-    case OAM_0:
-        current_sprite = oam_fetch_sprite(sprite_counter);
-
-        oam_fetch_step = OAM_1;
-        break;
+    case OAM_0: state->oam_fetch_step = OAM_1; break;
 
     // oam clk 2
     case OAM_1:
-        if(active_sprites.size() < 10 && current_sprite.pos_x > 0 && y_cntr + 16 >= current_sprite.pos_y
-           && y_cntr + 16 < current_sprite.pos_y + ((LCDC_BIG_SPRITES) ? 16 : 8)) {
-            active_sprites.push_back(current_sprite);
-        }
-
-        sprite_counter++;
-        oam_fetch_step = OAM_0;
+        state->sprite_counter++;
+        state->oam_fetch_step = OAM_0;
         break;
     }
 
     // quit after scanning all 40 sprites
-    if(sprite_counter == 40) {
+    if(state->sprite_counter == OAM_SPRITE_COUNT) {
+        u8 line_sprites[MAX_SPRITES_PER_LINE];
+
+        state->active_sprite_count = mem->get_line_sprites(state->y_cntr, LCDC_BIG_SPRITES, line_sprites);
+        for(int i = 0; i < state->active_sprite_count; i++) {
+            state->active_sprites[i] = oam_fetch_sprite(line_sprites[i]);
+        }
+
         // reuse sprite_counter for rendering
-        sprite_counter = 0;
-        process_step   = SCANLINE_VRAM;
+        state->sprite_counter = 0;
+        state->process_step   = SCANLINE_VRAM;
 
         // calculate background map address
-        bg_map_addr
-                = (0x9800) | ((LCDC_BG_TILE_MAP) ? 0x0400 : 0) | (((y_cntr + reg(SCY)) & 0xf8) << 2) | (reg(SCX) >> 3);
+        state->bg_map_addr = (0x9800) | ((LCDC_BG_TILE_MAP) ? 0x0400 : 0) | (((state->y_cntr + reg(SCY)) & 0xf8) << 2)
+                           | (reg(SCX) >> 3);
     }
 }
 
 void PPU::ppu_tick_vram() {
-    if(skip_sprite_clock) {
-        skip_sprite_clock = false;
+    if(state->skip_sprite_clock) {
+        state->skip_sprite_clock = false;
         return;
     }
 
-    if(pause_bg_fifo) {
-        if(!displayed_sprites.empty()) {
-            enqueue_sprite_data(displayed_sprites.front());
-            displayed_sprites.pop_front();
+    if(state->pause_bg_fifo) {
+        if(state->displayed_head != state->displayed_tail) {
+            enqueue_sprite_data(state->displayed_sprites[state->displayed_head++]);
         } else {
-            pause_bg_fifo = false;
+            state->pause_bg_fifo = false;
         }
 
-        skip_sprite_clock = true;
+        state->skip_sprite_clock = true;
         return;
     }
 
@@ -523,108 +631,108 @@ void PPU::ppu_tick_vram() {
      *
      * to simplify logic, we use 2 enums per section
      */
-    switch(vram_fetch_step) {
+    switch(state->vram_fetch_step) {
     // Background map clk 1
     case BM_0:
-        bg_map_byte = mem->read_vram(bg_map_addr, true, false);      // read from bank 0
+        state->bg_map_byte = mem->read_vram(state->bg_map_addr, true, false);             // read from bank 0
 
         if(this->isGBCAllowed()) {
-            attr_byte     = mem->read_vram(bg_map_addr, true, true); // read from bank 1
-            bg_map_bank_1 = BG_VRAM_BANK(attr_byte);
+            state->attr_byte     = mem->read_vram(state->bg_map_addr, true, true);        // read from bank 1
+            state->bg_map_bank_1 = BG_VRAM_BANK(state->attr_byte);
         } else {
-            bg_map_bank_1 = false;
+            state->bg_map_bank_1 = false;
         }
 
         // increment bg_map_addr, but only the bottom 5 bits.
         //  this will wrap around the edge of the tile map
-        if(!skip_fetch) {
-            bg_map_addr = (bg_map_addr & 0xFFE0) | ((bg_map_addr + 1) & 0x001F);
+        if(!state->skip_fetch) {
+            state->bg_map_addr = (state->bg_map_addr & 0xFFE0) | ((state->bg_map_addr + 1) & 0x001F);
         }
-        skip_fetch      = false;
+        state->skip_fetch      = false;
 
-        vram_fetch_step = BM_1;
+        state->vram_fetch_step = BM_1;
         break;
 
     // Background map clk 2
     case BM_1:
-        tile_addr = 0x8000;
-        if(Bit::test(bg_map_byte, 7)) {
-            tile_addr += 0x0800;
+        state->tile_addr = 0x8000;
+        if(Bit::test(state->bg_map_byte, 7)) {
+            state->tile_addr += 0x0800;
         } else if(!LCDC_BG_WND_TILE_DATA) {
-            tile_addr += 0x1000;
+            state->tile_addr += 0x1000;
         }
 
-        tile_y_line = ((y_cntr + reg(SCY)) & 0x7);
-        if(this->isGBCAllowed() && BG_Y_FLIP(attr_byte)) {
-            tile_y_line = (7 - tile_y_line);
+        state->tile_y_line = ((state->y_cntr + reg(SCY)) & 0x7);
+        if(this->isGBCAllowed() && BG_Y_FLIP(state->attr_byte)) {
+            state->tile_y_line = (7 - state->tile_y_line);
         }
 
-        tile_addr += ((bg_map_byte & 0x7F) << 4) | (tile_y_line << 1);
+        state->tile_addr += ((state->bg_map_byte & 0x7F) << 4) | (state->tile_y_line << 1);
 
-        vram_fetch_step = TD_0_0;
+        state->vram_fetch_step = TD_0_0;
         break;
 
     // window map clk 1
     case WM_0:
-        wnd_map_byte = mem->read_vram(wnd_map_addr, true, false);     // read from bank 0
+        state->wnd_map_byte = mem->read_vram(state->wnd_map_addr, true, false);           // read from bank 0
 
         if(this->isGBCAllowed()) {
-            attr_byte     = mem->read_vram(wnd_map_addr, true, true); // read from bank 1
-            bg_map_bank_1 = BG_VRAM_BANK(attr_byte);
+            state->attr_byte     = mem->read_vram(state->wnd_map_addr, true, true);       // read from bank 1
+            state->bg_map_bank_1 = BG_VRAM_BANK(state->attr_byte);
         } else {
-            bg_map_bank_1 = false;
+            state->bg_map_bank_1 = false;
         }
 
-        wnd_map_addr++;
+        state->wnd_map_addr++;
 
-        vram_fetch_step = WM_1;
+        state->vram_fetch_step = WM_1;
         break;
 
     // window map clk 2
     case WM_1:
-        tile_addr = 0x8000;
-        if(Bit::test(wnd_map_byte, 7)) {
-            tile_addr += 0x0800;
+        state->tile_addr = 0x8000;
+        if(Bit::test(state->wnd_map_byte, 7)) {
+            state->tile_addr += 0x0800;
         } else if(!LCDC_BG_WND_TILE_DATA) {
-            tile_addr += 0x1000;
+            state->tile_addr += 0x1000;
         }
 
-        tile_y_line = (wnd_y_cntr & 0x7);
-        if(this->isGBCAllowed() && BG_Y_FLIP(attr_byte)) {
-            tile_y_line = (7 - tile_y_line);
+        state->tile_y_line = (state->wnd_y_cntr & 0x7);
+        if(this->isGBCAllowed() && BG_Y_FLIP(state->attr_byte)) {
+            state->tile_y_line = (7 - state->tile_y_line);
         }
 
-        tile_addr += ((wnd_map_byte & 0x7F) << 4) | (tile_y_line << 1);
+        state->tile_addr += ((state->wnd_map_byte & 0x7F) << 4) | (state->tile_y_line << 1);
 
-        vram_fetch_step = TD_0_0;
+        state->vram_fetch_step = TD_0_0;
         break;
 
     // tile data 1 clk 1
     case TD_0_0:
-        tile_byte_1 = mem->read_vram(tile_addr, true, bg_map_bank_1);
-        tile_addr++;
+        state->tile_byte_1 = mem->read_vram(state->tile_addr, true, state->bg_map_bank_1);
+        state->tile_addr++;
 
-        vram_fetch_step = TD_0_1;
+        state->vram_fetch_step = TD_0_1;
         break;
 
     // tile data 1 clk 2
     case TD_0_1:
         // Do nothing
-        vram_fetch_step = TD_1_0;
+        state->vram_fetch_step = TD_1_0;
         break;
 
     // tile data 2 clk 1
     case TD_1_0:
-        tile_byte_2 = mem->read_vram(tile_addr, true, bg_map_bank_1);
-        tile_addr++;
+        state->tile_byte_2 = mem->read_vram(state->tile_addr, true, state->bg_map_bank_1);
+        state->tile_addr++;
 
-        vram_fetch_step = TD_1_1;
+        state->vram_fetch_step = TD_1_1;
         break;
 
     // tile data 2 clk 2
     case TD_1_1:
         // Do nothing
-        vram_fetch_step = IDLE;
+        state->vram_fetch_step = IDLE;
         break;
 
     // Idle Clocking
@@ -634,81 +742,97 @@ void PPU::ppu_tick_vram() {
         // should be disabled until the sprite fetches are done
         // TODO: this should be moved out of the idle clocking as it makes
         // the first fetch 2 clock cycles too long
-        if(bg_fifo->size() == 0) {
-            std::array<fifo_color_t, 8> arr = { 0 };
-            this->process_tile_line(arr, tile_byte_1, tile_byte_2, attr_byte);
+        if(state->bg_fifo.empty()) {
+            std::array<fifo_color_t, 8> arr;
+            this->process_tile_line(arr, state->tile_byte_1, state->tile_byte_2, state->attr_byte);
             for(const fifo_color_t pixel : arr) {
-                bg_fifo->enqueue(pixel);
+                state->bg_fifo.push(pixel);
             }
 
-            if(in_window) {
-                vram_fetch_step = WM_0;
+            if(state->in_window) {
+                state->vram_fetch_step = WM_0;
             } else {
-                vram_fetch_step = BM_0;
+                state->vram_fetch_step = BM_0;
             }
         }
         break;
 
     default:
         // invalid VRAM fetch step
-        LogFatal("PPU") << "vram step error" << vram_fetch_step;
+        LogFatal("PPU") << "vram step error" << state->vram_fetch_step;
         assert(false);
     }
 
     /**
      * Actual PPU logic
      */
-    if(bg_fifo->size() > 0) {
-        fifo_color_t bg_color {};
-        bg_fifo->dequeue(bg_color);
+    if(!state->bg_fifo.empty()) {
+        fifo_color_t bg_color = state->bg_fifo.pop();
 
         // if background is disabled, force write a 0
         if(!LCDC_BG_ENABLED && !this->isGBCAllowed()) {
-            bg_color.color_idx = 0;
+            bg_color.bits &= ~fifo_color_t::COLOR_MASK;
         }
 
         // if drawing a sprite, dequeue a sprite pixel
-        if(sp_fifo->size() > 0) {
-            fifo_color_t s_color {};
-            sp_fifo->dequeue(s_color);
+        if(!state->sp_fifo.empty()) {
+            fifo_color_t s_color     = state->sp_fifo.pop();
 
-            bool bg_has_priority     = this->isGBCAllowed() && bg_color.priority && LCDC_CGB_BG_PRIORITY;
-            bool sprite_has_priority = s_color.priority && !bg_has_priority;
-            bool should_draw_sprite  = bg_color.color_idx == 0 || sprite_has_priority;
+            bool bg_has_priority     = this->isGBCAllowed() && bg_color.priority() && LCDC_CGB_BG_PRIORITY;
+            bool sprite_has_priority = s_color.priority() && !bg_has_priority;
+            bool should_draw_sprite  = bg_color.color_idx() == 0 || sprite_has_priority;
 
-            if(!s_color.is_transparent && should_draw_sprite) {
+            if(!s_color.is_transparent() && should_draw_sprite) {
                 bg_color = s_color;
             }
         }
 
         // skip first 8 pixels and first pixels of partially offscreen tiles
-        if(x_cntr >= 8 + (reg(SCX) % 8)) {
-            pix_clock_count++;
+        if(state->x_cntr >= 8 + (reg(SCX) % 8)) {
+            state->pix_clock_count++;
 
             // if frame is disabled, don't draw pixel data
-            if(!frame_disable) {
-                auto pixel                 = Silver::Pixel::makeFromRGB15(bg_color.palette->colors[bg_color.color_idx]);
-                pixBuf.at(current_pixel++) = pixel;
+            if(!state->frame_disable) {
+                if(output.format == output_mode_t::RGBA) {
+                    auto pixel                 = Silver::Pixel::makeFromRGB15(resolve_color(bg_color));
+                    pixBuf.at(current_pixel++) = pixel;
+                } else {
+                    output_compact(bg_color);
+                }
             }
         }
 
         // if we finish the line, move to hblank and increment the window counter *if we're windowing*
-        if(pix_clock_count == 160) {
-            if(in_window) {
-                wnd_y_cntr++;
+        if(state->pix_clock_count == 160) {
+            if(!state->frame_disable && state->y_cntr < native_height) {
+                if(output.format == output_mode_t::RGBA) {
+                    hash_line(state->y_cntr);
+                } else {
+                    hash_output_line(state->y_cntr);
+                    out_x_phase = 0;
+                    if(++out_y_phase == output.y_step) {
+                        out_y_phase = 0;
+                    }
+                }
+            }
+            if(state->in_window) {
+                state->wnd_y_cntr++;
             }
-            process_step = HBLANK;
+            state->process_step = HBLANK;
+            PerfCount(perf, lines_rendered++);
         }
 
         // rest of this cycle is prepping for next one
-        x_cntr++;
+        state->x_cntr++;
 
         // Check Active Sprites to see if we should start displaying them
         if(LCDC_OBJ_ENABLED) {
-            for(const auto &sprite : active_sprites) {
-                if(x_cntr - (reg(SCX) % 8) == sprite.pos_x) {
-                    pause_bg_fifo = true;
-                    displayed_sprites.push_back(sprite);
+            for(int i = 0; i < state->active_sprite_count; i++) {
+                // SCX changing mid-line could match a sprite twice, don't overrun the queue if it does
+                if(state->x_cntr - (reg(SCX) % 8) == state->active_sprites[i].pos_x
+                   && state->displayed_tail < MAX_SPRITES_PER_LINE) {
+                    state->pause_bg_fifo                              = true;
+                    state->displayed_sprites[state->displayed_tail++] = state->active_sprites[i];
                 }
             }
         }
@@ -716,11 +840,11 @@ void PPU::ppu_tick_vram() {
         // Check if we should switch to Window Rendering
         // I don't know where this +1 comes from... without it the window renders 1 pixel too early
         // TODO: just like...figure out why?
-        if(!in_window && LCDC_WINDOW_ENABLED && x_cntr >= (reg(WX) + 1) && y_cntr >= reg(WY)) {
-            in_window       = true;
-            vram_fetch_step = WM_0;
-            bg_fifo->clear();
-            wnd_map_addr = 0x9800 | ((LCDC_WINDOW_TILE_MAP) ? 0x0400 : 0) | (wnd_y_cntr & 0xf8) << 2;
+        if(!state->in_window && LCDC_WINDOW_ENABLED && state->x_cntr >= (reg(WX) + 1) && state->y_cntr >= reg(WY)) {
+            state->in_window       = true;
+            state->vram_fetch_step = WM_0;
+            state->bg_fifo.clear();
+            state->wnd_map_addr = 0x9800 | ((LCDC_WINDOW_TILE_MAP) ? 0x0400 : 0) | (state->wnd_y_cntr & 0xf8) << 2;
         }
     }
 }
@@ -735,89 +859,113 @@ bool PPU::tick() {
      */
 
     if(!LCDC_LCD_ENABLED) {
+        // switched off partway through a line, the pixels it got to are on screen but the line was never hashed
+        if(!state->new_frame && !state->frame_disable && state->y_cntr < native_height) {
+            if(output.format == output_mode_t::RGBA) {
+                hash_line(state->y_cntr);
+            } else {
+                hash_output_line(state->y_cntr);
+            }
+        }
+
         // TODO: detail any further behavior?
         reg(LY) = 0;
         reg(STAT) &= ~STAT_MODE_FLAG; // clear mode bits
 
-        new_frame         = true;
-        first_frame       = true;
+        state->new_frame         = true;
+        state->first_frame       = true;
 
-        frame_clock_count = 0;
+        state->frame_clock_count = 0;
 
         return false;
     }
 
-    if(Bit::risen(old_LCDC, reg(LCDC), LCDC_WINDOW_ENABLED_BIT)) {
-        wnd_map_addr = 0x9800 | ((LCDC_WINDOW_TILE_MAP) ? 0x0400 : 0) | wnd_y_cntr << 2;
+    if(Bit::risen(state->old_LCDC, reg(LCDC), LCDC_WINDOW_ENABLED_BIT)) {
+        state->wnd_map_addr = 0x9800 | ((LCDC_WINDOW_TILE_MAP) ? 0x0400 : 0) | state->wnd_y_cntr << 2;
     }
-    old_LCDC = reg(LCDC);
+    state->old_LCDC = reg(LCDC);
 
     /**
      * Occurs on Every Frame
      */
-    if(new_frame) {
-        new_frame = false;
+    if(state->new_frame) {
+        state->new_frame = false;
 
-        if(first_frame) {
-            first_frame   = false;
-            frame_disable = true;
+        if(state->first_frame) {
+            state->first_frame   = false;
+            state->frame_disable = true;
 
             // clear the screen to white
-            auto pixel    = Silver::Pixel::makeFromRGB15(gb_palette.colors[0]);
-            std::fill(pixBuf.begin(), pixBuf.end(), pixel);
+            if(output.format == output_mode_t::RGBA) {
+                auto pixel = Silver::Pixel::makeFromRGB15(gb_palette.colors[0]);
+                std::fill(pixBuf.begin(), pixBuf.end(), pixel);
+                for(u32 line = 0; line < native_height; line++) {
+                    hash_line(line);
+                }
+            } else {
+                u8 white = output.format == output_mode_t::Luminance ? luminance(gb_palette.colors[0]) : 0;
+                std::fill(outBuf.begin(), outBuf.end(), white);
+                for(u32 line = 0; line < native_height; line++) {
+                    hash_output_line(line);
+                }
+            }
         } else {
-            frame_disable = false;
+            state->frame_disable = false;
         }
 
-        current_pixel        = 0;
+        current_pixel               = 0;
+        out_pos                     = 0;
+        out_x_phase                 = 0;
+        out_y_phase                 = 0;
 
-        wnd_y_cntr           = 0;
+        state->wnd_y_cntr           = 0;
         // this is incremented to zero at the start of the first line
-        y_cntr               = -1;
-        new_line             = true;
+        state->y_cntr               = -1;
+        state->new_line             = true;
 
-        vblank_int_requested = false;
+        state->vblank_int_requested = false;
     }
 
     /**
      * Occurs on Every line
      */
-    if(new_line) {
-        new_line   = false;
-        skip_fetch = true;
+    if(state->new_line) {
+        state->new_line   = false;
+        state->skip_fetch = true;
 
-        y_cntr++;
+        state->y_cntr++;
 
-        x_cntr           = 0;
-        pix_clock_count  = 0;
-        line_clock_count = 0;
+        state->x_cntr           = 0;
+        state->pix_clock_count  = 0;
+        state->line_clock_count = 0;
 
-        sprite_counter   = 0;
-        active_sprites.clear();
-        displayed_sprites.clear();
+        state->sprite_counter      = 0;
+        state->active_sprite_count = 0;
+        state->displayed_head      = 0;
+        state->displayed_tail      = 0;
 
-        bg_fifo->clear();
-        pause_bg_fifo = false;
+        state->bg_fifo.clear();
+        state->pause_bg_fifo = false;
 
-        in_window     = false;
+        state->in_window     = false;
 
-        reg(LY)       = y_cntr; // set LY
+        reg(LY)              = state->y_cntr; // set LY
 
-        if(y_cntr < 144) {
-            process_step    = SCANLINE_OAM;
-            oam_fetch_step  = OAM_0;
-            vram_fetch_step = BM_0;
-        } else if(y_cntr < 154) {
-            process_step = VBLANK;
+        if(state->y_cntr < 144) {
+            state->process_step    = SCANLINE_OAM;
+            state->oam_fetch_step  = OAM_0;
+            state->vram_fetch_step = BM_0;
+        } else if(state->y_cntr < 154) {
+            state->process_step = VBLANK;
         } else {
-            LogError("PPU") << "y_cntr OOB: " << y_cntr;
+            LogError("PPU") << "y_cntr OOB: " << state->y_cntr;
         }
     }
 
     /**
      * Occurs on every clock
      */
-    if(frame_disable && y_cntr == 0 && process_step == SCANLINE_OAM) {
+    if(state->frame_disable && state->y_cntr == 0 && state->process_step == SCANLINE_OAM) {
         // frame disable is true for the first frame after the LCD is reenabled.
 
         /**
@@ -829,7 +977,7 @@ bool PPU::tick() {
          **/
         reg(STAT) &= ~STAT_MODE_FLAG;
     } else {
-        reg(STAT) = (reg(STAT) & ~STAT_MODE_FLAG) | process_step; // set current mode
+        reg(STAT) = (reg(STAT) & ~STAT_MODE_FLAG) | state->process_step; // set current mode
     }
 
     /**
@@ -842,54 +990,55 @@ bool PPU::tick() {
         Bit::reset(&reg(STAT), STAT_COIN_BIT);
     }
 
-    bool coin_int = Bit::test(reg(STAT), STAT_COIN_INT_BIT) && Bit::test(reg(STAT), STAT_COIN_BIT) && !coin_bit_signal
-                 && old_LY != reg(LY);
-    old_LY          = reg(LY);
-    coin_bit_signal = Bit::test(reg(STAT), STAT_COIN_BIT);
-
-    bool mode2_int  = (Bit::test(reg(STAT), STAT_MODE_2_INT_BIT) && process_step == SCANLINE_OAM),
-         mode1_int  = (Bit::test(reg(STAT), STAT_MODE_1_INT_BIT) && process_step == VBLANK),
-         mode0_int  = (Bit::test(reg(STAT), STAT_MODE_0_INT_BIT) && process_step == HBLANK),
-         throw_stat = coin_int || (mode2_int && (mode2_int != old_mode2_int))
-                   || (mode1_int && (mode1_int != old_mode1_int)) || (mode0_int && (mode0_int != old_mode0_int));
-    old_mode2_int = mode2_int;
-    old_mode1_int = mode1_int;
-    old_mode0_int = mode0_int;
+    bool coin_int = Bit::test(reg(STAT), STAT_COIN_INT_BIT) && Bit::test(reg(STAT), STAT_COIN_BIT)
+                 && !state->coin_bit_signal && state->old_LY != reg(LY);
+    state->old_LY          = reg(LY);
+    state->coin_bit_signal = Bit::test(reg(STAT), STAT_COIN_BIT);
+
+    bool mode2_int  = (Bit::test(reg(STAT), STAT_MODE_2_INT_BIT) && state->process_step == SCANLINE_OAM),
+         mode1_int  = (Bit::test(reg(STAT), STAT_MODE_1_INT_BIT) && state->process_step == VBLANK),
+         mode0_int  = (Bit::test(reg(STAT), STAT_MODE_0_INT_BIT) && state->process_step == HBLANK),
+         throw_stat = coin_int || (mode2_int && (mode2_int != state->old_mode2_int))
+                   || (mode1_int && (mode1_int != state->old_mode1_int))
+                   || (mode0_int && (mode0_int != state->old_mode0_int));
+    state->old_mode2_int = mode2_int;
+    state->old_mode1_int = mode1_int;
+    state->old_mode0_int = mode0_int;
     if(throw_stat) {
         mem->request_interrupt(Memory::Interrupt::LCD_STAT_INT);
     }
 
-    if(process_step == SCANLINE_OAM) {
+    if(state->process_step == SCANLINE_OAM) {
         ppu_tick_oam();
-    } else if(process_step == SCANLINE_VRAM) {
+    } else if(state->process_step == SCANLINE_VRAM) {
         ppu_tick_vram();
-    } else if(process_step == HBLANK) {
-        if(line_clock_count >= 455) {
-            new_line = true;
+    } else if(state->process_step == HBLANK) {
+        if(state->line_clock_count >= 455) {
+            state->new_line = true;
         }
-    } else if(process_step == VBLANK) {
-        if(!vblank_int_requested) {
-            vblank_int_requested = true;
+    } else if(state->process_step == VBLANK) {
+        if(!state->vblank_int_requested) {
+            state->vblank_int_requested = true;
             mem->request_interrupt(Memory::Interrupt::VBLANK_INT);
         }
         // clock_count checker below will reset the frame
 
-        if(line_clock_count >= 456) {
+        if(state->line_clock_count >= 456) {
             // TODO: supposedly the first VBLANK is shorter than the rest? refer to TCAGBD and confirm
-            new_line = true;
+            state->new_line = true;
         }
     } else {
-        LogError("PPU") << "process_step error: " << as_hex((int)process_step);
+        LogError("PPU") << "process_step error: " << as_hex((int)state->process_step);
     }
 
-    line_clock_count++; // used in HBLANK and VBLANK
-    frame_clock_count++;
+    state->line_clock_count++; // used in HBLANK and VBLANK
+    state->frame_clock_count++;
 
-    if(frame_clock_count < TICKS_PER_FRAME) {
+    if(state->frame_clock_count < TICKS_PER_FRAME) {
         return false;
     } else {
-        frame_clock_count = 0;
-        new_frame         = true;
+        state->frame_clock_count = 0;
+        state->new_frame         = true;
         return true;
     }
 }
@@ -1,13 +1,13 @@
 #pragma once
 
-#include <deque>
 #include <ratio>
+#include <span>
 #include <sstream>
 #include <type_traits>
 #include <vector>
 
 #include "util/bit.hpp"
-#include "util/types/circular_queue.hpp"
+#include "util/types/inline_fifo.hpp"
 #include "util/types/pixel.hpp"
 #include "util/types/primitives.hpp"
 #include "util/util.hpp"
@@ -15,6 +15,7 @@
 #include "cart.hpp"
 #include "defs.hpp"
 #include "mem.hpp"
+#include "perf_counters.hpp"
 
 class PPU {
 public:
@@ -59,12 +60,45 @@ public:
         }
     } palette_t;
 
+    /**
+     * A pixel in the BG/OBJ FIFOs, packed into a single byte
+     *
+     *  7   6   5   4-2   1-0
+     *  T   P   O   PAL   COL
+     *
+     *  T   - transparent (OBJ color 0)
+     *  P   - priority
+     *  O   - color comes from the OBJ palettes rather than the BG palettes
+     *  PAL - palette number
+     *  COL - color index within the palette
+     */
     struct fifo_color_t {
-        u8         color_idx;
-        palette_t *palette;
-        bool       is_transparent;
-        bool       priority;
+        static constexpr u8 COLOR_MASK        = 0x03;
+        static constexpr u8 PALETTE_SHIFT     = 2;
+        static constexpr u8 PALETTE_MASK      = 0x1C;
+        static constexpr u8 OBJ_FLAG          = 0x20;
+        static constexpr u8 PRIO_FLAG         = 0x40;
+        static constexpr u8 TRANSPARENT_FLAG  = 0x80;
+        static constexpr u8 TRANSPARENT_SHIFT = 7;
+
+        u8                  bits;
+
+        static constexpr fifo_color_t make(u8 color_idx, u8 palette_idx, bool obj, bool priority, bool transparent) {
+            return {(u8)((color_idx & COLOR_MASK) | ((palette_idx << PALETTE_SHIFT) & PALETTE_MASK)
+                         | (obj ? OBJ_FLAG : 0) | (priority ? PRIO_FLAG : 0) | (transparent ? TRANSPARENT_FLAG : 0))};
+        }
+
+        u8   color_idx() const { return bits & COLOR_MASK; }
+
+        u8   palette_idx() const { return (bits & PALETTE_MASK) >> PALETTE_SHIFT; }
+
+        bool is_obj() const { return bits & OBJ_FLAG; }
+
+        bool priority() const { return bits & PRIO_FLAG; }
+
+        bool is_transparent() const { return bits & TRANSPARENT_FLAG; }
     };
+    static_assert(sizeof(fifo_color_t) == 1);
 
     // TODO: make this user-configurable
     // http://www.budmelvin.com/dev/15bitconverter.html
@@ -82,12 +116,118 @@ public:
         0x1081, // black
     };
 
-    PPU(Cartridge *cart, Memory *mem, gb_device_t device, bool bootrom_enabled);
+    /**
+     * What the PPU writes out for each pixel. The compact formats skip the pixel buffer and the RGB conversion for
+     * consumers that only look at the screen (bots, tests), see getOutputBuffer()
+     */
+    struct output_mode_t {
+        enum format_t : u8 {
+            RGBA,         // the pixel buffer, see getPixelBuffer()
+            Luminance,    // a byte per pixel, BT.601 luma of the palette color
+            PaletteIndex, // a byte per pixel, O/PAL/COL of fifo_color_t. DMG colors are already through BGP/OBPx
+        };
+
+        format_t format = RGBA;
+
+        // compact formats only keep every x_step'th pixel of every y_step'th line
+        u8       x_step = 1;
+        u8       y_step = 1;
+
+        u32      width() const { return (native_width + x_step - 1) / x_step; }
+        u32      height() const { return (native_height + y_step - 1) / y_step; }
+    };
+
+    enum __OAM_fetch_steps { OAM_0, OAM_1 };
+
+    enum __VRAM_fetch_steps {
+        BM_0,   // Background Map clk 1
+        BM_1,   // Background Map clk 2
+
+        WM_0,   // Window Map clk 1
+        WM_1,   // Window Map clk 2;
+
+        TD_0_0, // Tile Data byte 1 clk 1
+        TD_0_1, // Tile Data byte 1 clk 2
+
+        TD_1_0, // Tile Data byte 2 clk 1
+        TD_1_1, // Tile Data byte 2 clk 2
+
+        IDLE,   // Idle Clock
+    };
+
+    /**
+     * The pixel pipeline, palettes and interrupt edges, everything a snapshot of the PPU needs. What's been drawn so
+     * far lives outside, see resync_output(). Set up by the constructor
+     */
+    struct state_t {
+        // both FIFOs hold at most a single tile's worth of pixels
+        InlineFifo<fifo_color_t, 16> bg_fifo;
+        InlineFifo<fifo_color_t, 16> sp_fifo;
+        u8                           process_step;
+
+        int                          frame_clock_count; // count of clocks in a frame
+        int                          line_clock_count;  // count of clocks in a line
+        int                          pix_clock_count;   // pixels clocked in currenrt line
+
+        __OAM_fetch_steps            oam_fetch_step;
+        __VRAM_fetch_steps           vram_fetch_step;
+
+        u8                           old_LY;
+        bool                         coin_bit_signal, pause_bg_fifo, skip_sprite_clock, obj_priority_mode;
+
+        u8   old_LCDC;
+
+        u16  bg_map_addr,                                 // addr of the current tile in the bg  tile map
+                wnd_map_addr,                             // addr of the current tile in the wnd tile map
+                tile_addr;                                // relative addr of the current tile data to fetch
+
+        u8 attr_byte,                                     // GBC attributes of bg_map_byte and wnd_map_byte
+                bg_map_byte,                              // byte from the current tile in the bg tile map
+                wnd_map_byte,                             // byte from the current tile in the wnd tile map
+                tile_byte_1,                              // 1st byte from the current tile fetched
+                tile_byte_2;                              // 1st byte from the current tile fetched
+
+        bool bg_map_bank_1;                               // is the tile data for the bg tile data in bank 0 or 1;
+
+        u8   tile_y_line,                                 // GBC tile y pixel counter
+                wnd_y_cntr,                               // window y counter
+                y_cntr,                                   // y counter
+                x_cntr;                                   // x counter
+
+        bool first_frame,                                 // first frame after lcd enable
+                frame_disable,                            // disable pixel output for current frame(see first_frame)
+                new_frame,                                // the first clock tick of a new frame
+                new_line,                                 // the first clock tick of a new line
+                skip_fetch,                               // the first VRAM access of a new line
+                in_window;                                // are we in window mode
+
+        int          sprite_counter;
+
+        // sprites selected for the current line by the mode 2 search
+        obj_sprite_t active_sprites[MAX_SPRITES_PER_LINE];
+        u8           active_sprite_count;
+
+        // sprites the pixel pipeline has reached and still needs to fetch, each is queued at most once a line
+        obj_sprite_t displayed_sprites[MAX_SPRITES_PER_LINE];
+        u8           displayed_head, displayed_tail;
+
+        bool         vblank_int_requested, old_mode2_int, old_mode1_int, old_mode0_int;
+
+        palette_t    bg_palettes[8];
+        palette_t    obj_palettes[8];
+    };
+
+    PPU(Cartridge *cart, Memory *mem, state_t *state, gb_device_t device, bool bootrom_enabled, output_mode_t output);
+    /**
+     * Fork of `other` mid-frame, attached to the forked core's cart, memory and state
+     */
+    PPU(PPU const &other, Cartridge *cart, Memory *mem, state_t *state);
     ~PPU();
 
     bool         tick();
     obj_sprite_t oam_fetch_sprite(int index);
     void         process_tile_line(std::array<fifo_color_t, 8> &arr, u8 byte_1, u8 byte_2, u8 bg_attr);
+    u16          resolve_color(fifo_color_t color) const;
     void         write_bg_color_data(u8 data);
     u8           read_bg_color_data();
     void         write_obj_color_data(u8 data);
@@ -95,17 +235,44 @@ public:
 
     void         set_obj_priority(bool obj_has_priority);
 
+    void         set_perf_counters(perf_counters_t *counters) { perf = counters; }
+
+    /**
+     * Empty unless the output mode is RGBA
+     */
     const std::vector<Silver::Pixel> &getPixelBuffer();
 
-    // public because core needs access
-    // TODO: befriend core maybe?
-    palette_t                         bg_palettes[8];
-    palette_t                         obj_palettes[8];
+    /**
+     * The screen in a compact output mode, getOutputMode().width() by height() bytes. Empty in RGBA mode
+     */
+    std::span<const u8>               getOutputBuffer() const { return outBuf; }
+    output_mode_t const              &getOutputMode() const { return output; }
+
+    /**
+     * Hash of each line of the pixel buffer (or the output buffer, lines a compact mode skips all hash the same),
+     * updated as each line is finished. Consumers can keep the hashes they last drew and only redraw the lines that
+     * differ.
+     */
+    std::span<const u64, native_height> getLineHashes() const { return line_hashes; }
+
+    /**
+     * Hash of the whole pixel buffer, equal across runs and hosts for identical frames
+     */
+    u64                               getFrameHash() const;
+
+    /**
+     * Bring the output position back in line with the beam after the state was swapped out under the PPU. Lines
+     * already drawn are left as they were
+     */
+    void                              resync_output();
 
 private:
     void                         enqueue_sprite_data(PPU::obj_sprite_t const &curr_sprite);
 
     void                         ppu_tick_oam();
+    void                         hash_line(u32 line);
+    void                         hash_output_line(u32 line);
+    void                         output_compact(fifo_color_t color);
     void                         ppu_tick_vram();
 
     bool                         isGBCAllowed();
@@ -114,77 +281,18 @@ private:
 
     Cartridge                   *cart;
     Memory                      *mem;
+    perf_counters_t             *perf = nullptr;
 
     gb_device_t                  device;
     std::vector<Silver::Pixel>   pixBuf;
+    u64                          line_hashes[native_height];
 
-    int                          curr_mode;
-
-    /**
-     * PPU Variables
-     */
-    CircularQueue<fifo_color_t> *bg_fifo = new CircularQueue<fifo_color_t>(160);
-    CircularQueue<fifo_color_t> *sp_fifo = new CircularQueue<fifo_color_t>(160);
-    u8                           process_step;
-
-    int                          frame_clock_count = 0; // count of clocks in a frame
-    int                          line_clock_count  = 0; // count of clocks in a line
-    int                          pix_clock_count   = 0; // pixels clocked in currenrt line
-
-    enum __OAM_fetch_steps { OAM_0, OAM_1 } oam_fetch_step;
-
-    enum __VRAM_fetch_steps {
-        BM_0,   // Background Map clk 1
-        BM_1,   // Background Map clk 2
-
-        WM_0,   // Window Map clk 1
-        WM_1,   // Window Map clk 2;
-
-        TD_0_0, // Tile Data byte 1 clk 1
-        TD_0_1, // Tile Data byte 1 clk 2
-
-        TD_1_0, // Tile Data byte 2 clk 1
-        TD_1_1, // Tile Data byte 2 clk 2
-
-        IDLE,   // Idle Clock
-    };
-    __VRAM_fetch_steps vram_fetch_step = IDLE;
-
-    u8                 old_LY          = 0;
-    bool coin_bit_signal = false, pause_bg_fifo = true, skip_sprite_clock = false, obj_priority_mode = true;
-
-    u8   old_LCDC;
-
-    u16  bg_map_addr,                                 // addr of the current tile in the bg  tile map
-            wnd_map_addr,                             // addr of the current tile in the wnd tile map
-            tile_addr;                                // relative addr of the current tile data to fetch
-
-    u8 attr_byte,                                     // GBC attributes of bg_map_byte and wnd_map_byte
-            bg_map_byte,                              // byte from the current tile in the bg tile map
-            wnd_map_byte,                             // byte from the current tile in the wnd tile map
-            tile_byte_1,                              // 1st byte from the current tile fetched
-            tile_byte_2;                              // 1st byte from the current tile fetched
-
-    bool bg_map_bank_1;                               // is the tile data for the bg tile data in bank 0 or 1;
-
-    u8   tile_y_line,                                 // GBC tile y pixel counter
-            wnd_y_cntr,                               // window y counter
-            y_cntr,                                   // y counter
-            x_cntr;                                   // x counter
-
-    bool first_frame                         = false, // first frame after lcd enable
-            frame_disable                    = false, // disable pixel output for current frame(used with first frame)
-            new_frame                        = false, // the first clock tick of a new frame
-            new_line                         = false, // the first clock tick of a new line
-            skip_fetch                       = false, // the first VRAM access of a new line
-            in_window                        = false; // are we in window mode
-
-    int                       sprite_counter = 0;
-    obj_sprite_t              current_sprite;
-    std::vector<obj_sprite_t> active_sprites;
-    std::deque<obj_sprite_t>  displayed_sprites;
+    output_mode_t                output;
+    std::vector<u8>              outBuf;
+    u32                          out_pos     = 0;
+    u8                           out_x_phase = 0, out_y_phase = 0; // position within x_step/y_step, 0 is kept
 
-    u32                       current_pixel = 0;
+    state_t                     *state; // lives in the core's machine_state_t
 
-    bool vblank_int_requested = false, old_mode2_int = false, old_mode1_int = false, old_mode0_int = false;
-};
+    u32                          current_pixel = 0;
+};
\ No newline at end of file
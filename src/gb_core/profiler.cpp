@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+
+#include "opcodes.hpp"
+#include "profiler.hpp"
+
+const char *const Profiler::interrupt_names[interrupt_count] = {
+        "isr_vblank", "isr_stat", "isr_timer", "isr_serial", "isr_joypad"};
+
+// deeper than any sane guest call chain, past this the stack has been lost track of (SP reloaded, jump tables using
+// push/ret, ...) so start over from the root
+static constexpr size_t max_stack_depth = 256;
+
+Profiler::Profiler(Cartridge *cart): cart(cart) {
+    s32 rom_size = cart->getROMSize();
+    rom_slots    = std::max<s32>(rom_size, 0x8000);
+
+    instr_counts.resize(rom_slots + non_rom_slots);
+    cycle_counts.resize(rom_slots + non_rom_slots);
+
+    reset();
+}
+
+void Profiler::reset() {
+    std::fill(instr_counts.begin(), instr_counts.end(), 0);
+    std::fill(cycle_counts.begin(), cycle_counts.end(), 0);
+    std::fill(std::begin(isr_cycles), std::end(isr_cycles), 0);
+    std::fill(std::begin(isr_entries), std::end(isr_entries), 0);
+
+    executed_cycles  = 0;
+    isr_entry_cycles = 0;
+    idle_cycles      = 0;
+
+    nodes.clear();
+    children.clear();
+    stack.clear();
+
+    nodes.push_back({root_node, 0, 0});
+}
+
+u32 Profiler::slot_of(u16 pc) {
+    if(pc >= 0x8000) {
+        return rom_slots + (pc - 0x8000);
+    }
+    return slot_of(pc, cart->getROMBank(pc));
+}
+
+u32 Profiler::slot_of(u16 pc, u16 bank) const {
+    u32 slot = ((u32)bank << 14) | (pc & 0x3FFF);
+    // MBCs mask the bank number to the ROM size, do the same for headers that lie about it
+    return slot < rom_slots ? slot : slot % rom_slots;
+}
+
+void Profiler::on_instruction(u16 pc, u8 op, u8 clocks, u16 new_pc, u16 sp) {
+    u32 slot = slot_of(pc);
+    instr_counts[slot]++;
+    cycle_counts[slot] += clocks;
+    executed_cycles += clocks;
+
+    if(stack.empty()) {
+        nodes[root_node].cycles += clocks;
+    } else {
+        frame_t const &top = stack.back();
+        nodes[top.node].cycles += clocks;
+        if(top.interrupt >= 0) {
+            isr_cycles[top.interrupt] += clocks;
+        }
+    }
+
+    opcode_info_t const &info  = opcode_table[op];
+    bool                 taken = !info.conditional() || clocks == info.clocks_taken;
+
+    switch(info.flow) {
+    case FLOW_CALL:
+    case FLOW_RESTART:
+        if(taken) {
+            push_frame(slot_of(new_pc), sp);
+        }
+        break;
+    case FLOW_RETURN:
+        if(taken) {
+            pop_frames(sp);
+        }
+        break;
+    default: break;
+    }
+}
+
+void Profiler::on_interrupt(u8 int_bit, u16 sp, u8 clocks) {
+    s8 interrupt = (s8)std::countr_zero(int_bit);
+    if(interrupt >= interrupt_count) {
+        return;
+    }
+
+    isr_entries[interrupt]++;
+    isr_entry_cycles += clocks;
+
+    push_frame(isr_func_base | (u32)interrupt, sp);
+    stack.back().interrupt = interrupt;
+
+    nodes[stack.back().node].cycles += clocks;
+    isr_cycles[interrupt] += clocks;
+}
+
+u32 Profiler::child_of(u32 node, u32 func) {
+    u64  key = ((u64)node << 32) | func;
+    auto it  = children.find(key);
+    if(it != children.end()) {
+        return it->second;
+    }
+
+    u32 child = (u32)nodes.size();
+    nodes.push_back({node, func, 0});
+    children.emplace(key, child);
+    return child;
+}
+
+void Profiler::push_frame(u32 func, u16 sp) {
+    if(stack.size() >= max_stack_depth) {
+        stack.clear();
+    }
+
+    u32 parent    = stack.empty() ? root_node : stack.back().node;
+    s8  interrupt = stack.empty() ? (s8)-1 : stack.back().interrupt;
+    stack.push_back({child_of(parent, func), sp, interrupt});
+}
+
+void Profiler::pop_frames(u16 sp) {
+    // a return leaves SP just above the return address it popped, unwind every frame pushed below that so frames
+    // skipped by stack manipulation (pop of a return address, SP reloads, ...) don't linger
+    while(!stack.empty() && stack.back().sp < sp) {
+        stack.pop_back();
+    }
+}
+
+std::string Profiler::slot_name(u32 slot) const {
+    char buf[16];
+    if(slot >= rom_slots) {
+        snprintf(buf, sizeof(buf), "ram:%04X", 0x8000 + (slot - rom_slots));
+    } else {
+        u16 bank = slot >> 14;
+        u16 addr = (slot & 0x3FFF) | (bank ? 0x4000 : 0);
+        snprintf(buf, sizeof(buf), "%02X:%04X", bank, addr);
+    }
+    return buf;
+}
+
+std::string Profiler::func_name(u32 func) const {
+    if((func & isr_func_base) == isr_func_base) {
+        return interrupt_names[func & 0xFF];
+    }
+    return slot_name(func);
+}
+
+void Profiler::write_flat(std::ostream &out, size_t limit) const {
+    std::vector<u32> slots;
+    for(u32 i = 0; i < cycle_counts.size(); i++) {
+        if(cycle_counts[i]) {
+            slots.push_back(i);
+        }
+    }
+    std::sort(slots.begin(), slots.end(), [this](u32 a, u32 b) { return cycle_counts[a] > cycle_counts[b]; });
+    if(limit && slots.size() > limit) {
+        slots.resize(limit);
+    }
+
+    double total = (double)std::max<u64>(total_cycles(), 1);
+    char   pct[16];
+
+    out << "addr\tinstructions\tcycles\tpercent\n";
+    for(u32 slot: slots) {
+        snprintf(pct, sizeof(pct), "%.2f", 100.0 * cycle_counts[slot] / total);
+        out << slot_name(slot) << '\t' << instr_counts[slot] << '\t' << cycle_counts[slot] << '\t' << pct << '\n';
+    }
+
+    for(int i = 0; i < interrupt_count; i++) {
+        if(isr_entries[i]) {
+            snprintf(pct, sizeof(pct), "%.2f", 100.0 * isr_cycles[i] / total);
+            out << interrupt_names[i] << '\t' << isr_entries[i] << '\t' << isr_cycles[i] << '\t' << pct << '\n';
+        }
+    }
+
+    snprintf(pct, sizeof(pct), "%.2f", 100.0 * idle_cycles / total);
+    out << "halt\t0\t" << idle_cycles << '\t' << pct << '\n';
+}
+
+void Profiler::write_folded(std::ostream &out) const {
+    // nodes are only ever appended after their parent, so each path can be built from the parent's
+    std::vector<std::string> paths(nodes.size());
+    paths[root_node] = "main";
+
+    for(u32 i = 0; i < nodes.size(); i++) {
+        if(i != root_node) {
+            paths[i] = paths[nodes[i].parent] + ';' + func_name(nodes[i].func);
+        }
+        if(nodes[i].cycles) {
+            out << paths[i] << ' ' << nodes[i].cycles << '\n';
+        }
+    }
+
+    if(idle_cycles) {
+        out << "halt " << idle_cycles << '\n';
+    }
+}
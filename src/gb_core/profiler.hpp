@@ -0,0 +1,109 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "util/flags.hpp"
+#include "util/types/primitives.hpp"
+
+#include "cart.hpp"
+
+/**
+ * Exact (non-sampling) profiler for guest code.
+ *
+ * Every executed instruction is counted against its (bank, PC) in flat arrays indexed by bank << 14 | offset, which for
+ * cartridge ROM is simply the offset into the ROM image. Code running out of VRAM/WRAM/HRAM gets its own 32KiB of
+ * slots after the ROM.
+ *
+ * On top of that a call tree is kept by watching CALL/RST/RET/RETI and interrupt dispatch, so time can be exported as
+ * folded stacks for flamegraph tools. Interrupt handlers show up as their own frames and their totals are kept
+ * separately per interrupt source.
+ */
+class Profiler {
+public:
+    explicit Profiler(Cartridge *cart);
+
+    /**
+     * Account one executed instruction
+     * @param pc address the opcode was fetched from
+     * @param op opcode
+     * @param clocks clocks the instruction took
+     * @param new_pc PC after executing it
+     * @param sp SP after executing it
+     */
+    void                      on_instruction(u16 pc, u8 op, u8 clocks, u16 new_pc, u16 sp);
+
+    /**
+     * Account an interrupt dispatch, called once PC is at the vector and the return address has been pushed
+     * @param int_bit bit of the interrupt in IF/IE
+     */
+    void                      on_interrupt(u8 int_bit, u16 sp, u8 clocks);
+
+    __force_inline void       on_idle(u8 clocks) { idle_cycles += clocks; }
+
+    void                      reset();
+
+    /**
+     * Flat per-(bank, PC) report sorted by cycles, tab separated: bank:pc, instructions, cycles, % of cycles
+     * @param limit maximum number of rows, 0 for all
+     */
+    void                      write_flat(std::ostream &out, size_t limit = 0) const;
+
+    /**
+     * Folded stacks, one line per unique call path: `frame;frame;frame cycles`
+     * Suitable for flamegraph.pl, inferno, speedscope, etc
+     */
+    void                      write_folded(std::ostream &out) const;
+
+    u64                       total_cycles() const { return executed_cycles + isr_entry_cycles + idle_cycles; }
+
+    static constexpr int      interrupt_count = 5;
+
+    static const char *const  interrupt_names[interrupt_count];
+
+    // everything spent in each interrupt source's handler, including the dispatch and any calls it makes
+    u64                       isr_cycles[interrupt_count] = {0};
+    u64                       isr_entries[interrupt_count] = {0};
+
+private:
+    static constexpr u32      non_rom_slots = 0x8000; // 0x8000-0xFFFF
+    static constexpr u32      root_node     = 0;
+    static constexpr u32      isr_func_base = 0xFFFFFF00; // isr_func_base | interrupt index
+
+    u32                       slot_of(u16 pc);
+    u32                       slot_of(u16 pc, u16 bank) const;
+    std::string               slot_name(u32 slot) const;
+    std::string               func_name(u32 func) const;
+
+    u32                       child_of(u32 node, u32 func);
+    void                      push_frame(u32 func, u16 sp);
+    void                      pop_frames(u16 sp);
+
+    Cartridge                *cart;
+    u32                       rom_slots;
+
+    std::vector<u32>          instr_counts;
+    std::vector<u64>          cycle_counts;
+
+    u64                       executed_cycles  = 0;
+    u64                       isr_entry_cycles = 0;
+    u64                       idle_cycles      = 0;
+
+    struct node_t {
+        u32 parent;
+        u32 func; // slot of the function's entry point, or isr_func_base | interrupt
+        u64 cycles;
+    };
+
+    struct frame_t {
+        u32 node;
+        u16 sp; // SP right after the return address was pushed
+        s8  interrupt;
+    };
+
+    std::vector<node_t>            nodes;
+    std::unordered_map<u64, u32>   children; // parent << 32 | func -> node
+    std::vector<frame_t>           stack;
+};
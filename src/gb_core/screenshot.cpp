@@ -0,0 +1,151 @@
+#include "screenshot.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "util/log.hpp"
+
+namespace {
+    // how long the worker sleeps between passes over the queue
+    constexpr auto worker_period = std::chrono::milliseconds(10);
+} // namespace
+
+namespace Silver {
+    Screenshots::Screenshots(std::string prefix) :
+        prefix(std::move(prefix)), pool(std::make_unique<shot_t[]>(pool_size)) {
+        for(u8 i = 0; i < pool_size; i++) {
+            free_shots.insert(i);
+        }
+        decoded.resize(Core::vram_view_t::map_size * Core::vram_view_t::map_size);
+        worker = std::thread([this]() { worker_main(); });
+    }
+
+    Screenshots::~Screenshots() { stop(); }
+
+    void Screenshots::stop() {
+        if(!worker.joinable()) {
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+
+    void Screenshots::request(u32 frames, u8 views) {
+        burst_views.store(views, std::memory_order_relaxed);
+        burst_frames.store(frames, std::memory_order_release);
+    }
+
+    void Screenshots::frame(Core &core) {
+        u64 index = frame_count++;
+        if(!worker.joinable()) {
+            return;
+        }
+
+        u32 left = burst_frames.load(std::memory_order_acquire);
+        while(left && !burst_frames.compare_exchange_weak(left, left - 1, std::memory_order_acquire)) {
+        }
+        if(!left) {
+            return;
+        }
+
+        u8 slot;
+        if(!free_shots.remove(slot)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        shot_t &shot = pool[slot];
+        shot.frame   = index;
+        shot.views   = burst_views.load(std::memory_order_relaxed);
+
+        // empty while the PPU writes one of the compact output modes instead
+        auto const &screen = core.getPixelBuffer();
+        if(screen.size() == Core::native_pixel_count) {
+            std::copy(screen.begin(), screen.end(), shot.screen);
+        } else {
+            shot.views &= ~Screen;
+        }
+        if(shot.views & (BGMap | Tiles)) {
+            core.snapshotVRAM(shot.vram);
+        }
+
+        // can't be full, there are only pool_size shots
+        queued.insert(slot);
+    }
+
+    Screenshots::stats_t Screenshots::stats() const {
+        return {
+            .written = written.load(std::memory_order_relaxed),
+            .dropped = dropped.load(std::memory_order_relaxed),
+            .failed  = failed.load(std::memory_order_relaxed),
+        };
+    }
+
+    void Screenshots::worker_main() {
+        std::unique_lock lock(mutex);
+        while(true) {
+            wake.wait_for(lock, worker_period, [this]() { return stopping; });
+            bool stop = stopping;
+
+            lock.unlock();
+            drain();
+            lock.lock();
+
+            if(stop) {
+                return;
+            }
+        }
+    }
+
+    void Screenshots::drain() {
+        using vram_view_t = Core::vram_view_t;
+
+        u8 slot;
+        while(queued.remove(slot)) {
+            shot_t const &shot = pool[slot];
+
+            if(shot.views & Screen) {
+                write(shot, "", shot.screen, Core::native_width, Core::native_height);
+            }
+            if(shot.views & BGMap) {
+                Core::decodeBGMap(shot.vram, decoded.data());
+                write(shot, "_bg", decoded.data(), vram_view_t::map_size, vram_view_t::map_size);
+            }
+            if(shot.views & Tiles) {
+                for(int bank = 0; bank < (shot.vram.gbc ? 2 : 1); bank++) {
+                    Core::decodeTiles(shot.vram, bank, decoded.data());
+                    write(shot, bank ? "_tiles1" : "_tiles0", decoded.data(), vram_view_t::tiles_width,
+                          vram_view_t::tiles_height);
+                }
+            }
+
+            free_shots.insert(slot);
+        }
+    }
+
+    void Screenshots::write(shot_t const &shot, const char *suffix, const Pixel *pixels, u32 width, u32 height) {
+        path.resize(prefix.size() + 64);
+        path.resize(snprintf(path.data(), path.size(), "%s_%06llu%s.png", prefix.c_str(),
+                             (unsigned long long)shot.frame, suffix));
+
+        bool                ok  = false;
+        std::span<const u8> png = encoder.encode(pixels, width, height);
+        if(FILE *f = png.empty() ? nullptr : fopen(path.c_str(), "wb")) {
+            ok = fwrite(png.data(), 1, png.size(), f) == png.size();
+            ok = fclose(f) == 0 && ok;
+        }
+
+        if(ok) {
+            written.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            failed.fetch_add(1, std::memory_order_relaxed);
+            LogError("Screenshots") << "failed to write " << path;
+        }
+    }
+} // namespace Silver
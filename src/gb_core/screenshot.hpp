@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/png.hpp"
+#include "util/types/pixel.hpp"
+#include "util/types/primitives.hpp"
+#include "util/types/ringbuffer.hpp"
+
+#include "core.hpp"
+
+namespace Silver {
+
+    /**
+     * Screenshots and frame dumps as PNG, for bug reports.
+     *
+     * request() arms the next `frames` frames, from any thread. The emulation thread calls frame() after every
+     * finished frame and while armed that copies the screen, plus a VRAM snapshot if debug views are asked for, into
+     * a buffer from a fixed pool. A worker thread draws the views, encodes and writes the PNGs and hands the buffer
+     * back. When the worker falls behind the pool runs dry and frames are dropped and counted rather than waited for.
+     *
+     * Files are named `<prefix>_<frame>.png`, with `_bg`, `_tiles0` and `_tiles1` appended for the views, where
+     * `frame` counts the frame() calls since the Screenshots was created.
+     */
+    class Screenshots {
+    public:
+        enum View : u8 {
+            Screen = 1 << 0,
+            BGMap  = 1 << 1, // the 256x256 BG map LCDC selects
+            Tiles  = 1 << 2, // tile data, bank 1 too on a CGB
+        };
+
+        struct stats_t {
+            u64 written;
+            u64 dropped; // frames, the pool was empty
+            u64 failed;  // couldn't be encoded or written
+        };
+
+        explicit Screenshots(std::string prefix);
+        ~Screenshots();
+
+        Screenshots(const Screenshots &)             = delete;
+        Screenshots &operator= (const Screenshots &) = delete;
+
+        /**
+         * Take the next `frames` frames, replacing any burst still running. Any thread
+         * @param views View bits
+         */
+        void    request(u32 frames = 1, u8 views = Screen);
+
+        /**
+         * Take the core's current frame if one is requested, never blocks. Call after each finished frame
+         */
+        void    frame(Core &core);
+
+        /**
+         * Write out everything already taken and stop the worker, nothing is taken after this
+         */
+        void    stop();
+
+        stats_t stats() const;
+
+    private:
+        static constexpr size_t pool_size = 16;
+
+        // each thread owns one end, so the indices get a cache line apiece
+        using index_queue_t = jnk0le::Ringbuffer<u8, pool_size, false, 64>;
+
+        struct shot_t {
+            Pixel                 screen[Core::native_pixel_count];
+            Core::vram_snapshot_t vram;
+            u64                   frame;
+            u8                    views;
+        };
+
+        void                               worker_main();
+        void                               drain();
+        void                               write(shot_t const &shot, const char *suffix, const Pixel *pixels, u32 width,
+                                                 u32 height);
+
+        std::string                        prefix;
+
+        // shots move between the two by index, the emulation thread takes from `free_shots` and queues on `queued`
+        std::unique_ptr<shot_t[]>          pool;
+        index_queue_t                      queued;
+        index_queue_t                      free_shots;
+
+        std::atomic<u32>                   burst_frames {0};
+        std::atomic<u8>                    burst_views {0};
+        u64                                frame_count = 0; // emulation thread only
+
+        std::atomic<u64>                   written {0}, dropped {0}, failed {0};
+
+        // worker thread only
+        PNG::Encoder                       encoder;
+        std::vector<Pixel>                 decoded;
+        std::string                        path;
+
+        std::mutex                         mutex;
+        std::condition_variable            wake;
+        bool                               stopping = false;
+        std::thread                        worker;
+    };
+} // namespace Silver
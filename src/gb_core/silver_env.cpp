@@ -0,0 +1,79 @@
+#include <memory>
+#include <vector>
+
+#include "util/file.hpp"
+#include "util/log.hpp"
+
+#include "env_batch.hpp"
+#include "silver_env.h"
+
+struct silver_env {
+    std::unique_ptr<Silver::EnvBatch>    batch;
+    std::vector<Joypad::button_states_t> actions; // decoded into on every step, sized once
+};
+
+uint32_t silver_env_abi_version(void) { return SILVER_ENV_ABI_VERSION; }
+
+silver_env *silver_env_create(const char *rom_path, const silver_env_config *config) {
+    if(!rom_path || !config || !config->count || (config->ram_count && !config->ram_addrs)) {
+        return nullptr;
+    }
+
+    auto rom = std::shared_ptr<Silver::File>(Silver::File::openReadOnly(rom_path));
+    if(!rom) {
+        LogError("silver_env") << "failed to open " << rom_path;
+        return nullptr;
+    }
+
+    Silver::EnvBatch::config_t batch_config;
+    batch_config.count      = config->count;
+    batch_config.frame_skip = config->frame_skip;
+    batch_config.obs_width  = config->obs_width ? config->obs_width : Silver::Core::native_width;
+    batch_config.obs_height = config->obs_height ? config->obs_height : Silver::Core::native_height;
+    batch_config.grayscale  = config->grayscale;
+    batch_config.ram_addrs.assign(config->ram_addrs, config->ram_addrs + config->ram_count);
+    batch_config.threads  = config->threads;
+    batch_config.device   = config->cgb ? device_GBC : device_GB;
+    batch_config.decimate = config->decimate;
+
+    // nothing may unwind into the caller's C frames
+    try {
+        auto env   = std::make_unique<silver_env>();
+        env->batch = std::make_unique<Silver::EnvBatch>(rom, std::move(batch_config));
+        env->actions.resize(config->count);
+        return env.release();
+    } catch(std::exception const &e) {
+        LogError("silver_env") << "create failed: " << e.what();
+        return nullptr;
+    }
+}
+
+void   silver_env_destroy(silver_env *env) { delete env; }
+
+size_t silver_env_obs_size(const silver_env *env) { return env->batch->obs_size(); }
+
+size_t silver_env_ram_size(const silver_env *env) { return env->batch->ram_size(); }
+
+void   silver_env_reset(silver_env *env, uint32_t index) {
+    if(index < env->batch->count()) {
+        env->batch->reset(index);
+    }
+}
+
+void silver_env_observe(silver_env *env, uint8_t *obs, uint8_t *ram) { env->batch->observe(obs, ram); }
+
+void silver_env_step(silver_env *env, const uint8_t *actions, uint8_t *obs, uint8_t *ram) {
+    for(size_t i = 0; i < env->actions.size(); i++) {
+        u8                       bits  = actions[i];
+        Joypad::button_states_t &state = env->actions[i];
+        state.a                        = bits & SILVER_BUTTON_A;
+        state.b                        = bits & SILVER_BUTTON_B;
+        state.select                   = bits & SILVER_BUTTON_SELECT;
+        state.start                    = bits & SILVER_BUTTON_START;
+        state.right                    = bits & SILVER_BUTTON_RIGHT;
+        state.left                     = bits & SILVER_BUTTON_LEFT;
+        state.up                       = bits & SILVER_BUTTON_UP;
+        state.down                     = bits & SILVER_BUTTON_DOWN;
+    }
+    env->batch->step(env->actions.data(), obs, ram);
+}
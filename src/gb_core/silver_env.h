@@ -0,0 +1,72 @@
+#ifndef SILVER_ENV_H
+#define SILVER_ENV_H
+
+/*
+ * C interface to Silver::EnvBatch for training code in other languages, built as the silver_env shared library.
+ *
+ * Buffers are owned by the caller and written in place: observations as [count][height][width][channels] bytes
+ * (1 channel grayscale, 3 RGB) and RAM as [count][ram_count] bytes. Actions are one byte per environment with the
+ * SILVER_BUTTON_* bits set for the buttons held.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define SILVER_ENV_API __declspec(dllexport)
+#else
+#define SILVER_ENV_API __attribute__((visibility("default")))
+#endif
+
+#define SILVER_ENV_ABI_VERSION 2
+
+enum {
+    SILVER_BUTTON_A      = 1 << 0,
+    SILVER_BUTTON_B      = 1 << 1,
+    SILVER_BUTTON_SELECT = 1 << 2,
+    SILVER_BUTTON_START  = 1 << 3,
+    SILVER_BUTTON_RIGHT  = 1 << 4,
+    SILVER_BUTTON_LEFT   = 1 << 5,
+    SILVER_BUTTON_UP     = 1 << 6,
+    SILVER_BUTTON_DOWN   = 1 << 7,
+};
+
+typedef struct silver_env silver_env;
+
+typedef struct silver_env_config {
+    uint32_t        count;
+    uint32_t        frame_skip; /* frames each action is held for */
+    uint32_t        obs_width;  /* 0 for the native 160 */
+    uint32_t        obs_height; /* 0 for the native 144 */
+    uint32_t        grayscale;
+    const uint16_t *ram_addrs;
+    uint32_t        ram_count;
+    uint32_t        threads;    /* 0 for the hardware threads */
+    uint32_t        cgb;        /* run as a Game Boy Color */
+    uint32_t        decimate;   /* grayscale only, drop lines and columns instead of averaging them, see EnvBatch */
+} silver_env_config;
+
+SILVER_ENV_API uint32_t    silver_env_abi_version(void);
+
+/* NULL if the ROM couldn't be opened or the config is invalid */
+SILVER_ENV_API silver_env *silver_env_create(const char *rom_path, const silver_env_config *config);
+SILVER_ENV_API void        silver_env_destroy(silver_env *env);
+
+/* bytes per environment in the observation and RAM buffers */
+SILVER_ENV_API size_t      silver_env_obs_size(const silver_env *env);
+SILVER_ENV_API size_t      silver_env_ram_size(const silver_env *env);
+
+SILVER_ENV_API void        silver_env_reset(silver_env *env, uint32_t index);
+/* obs and ram may be NULL */
+SILVER_ENV_API void        silver_env_observe(silver_env *env, uint8_t *obs, uint8_t *ram);
+SILVER_ENV_API void        silver_env_step(silver_env *env, const uint8_t *actions, uint8_t *obs, uint8_t *ram);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "util/bit.hpp"
+#include "util/types/primitives.hpp"
+
+#include "defs.hpp"
+
+#define OAM_SPRITE_COUNT     40
+#define MAX_SPRITES_PER_LINE 10
+
+/**
+ * Per-scanline index of which OAM entries cover each visible line.
+ *
+ * Kept up to date by Memory as sprite Y bytes are written (by the CPU or OAM DMA) so the PPU's mode 2 search becomes a
+ * lookup instead of re-reading all 40 entries every line. Lines are 40-bit masks in OAM order, one table each for 8px
+ * and 16px tall sprites since LCDC.2 can change between writes.
+ */
+class SpriteIndex {
+public:
+    static constexpr int visible_lines = 144;
+
+    void                 clear() {
+        for(int i = 0; i < visible_lines; i++) {
+            lines_8[i]  = 0;
+            lines_16[i] = 0;
+        }
+    }
+
+    /**
+     * Rebuild the whole index from an OAM image, used after anything writes OAM behind our back (init, state restore)
+     */
+    void rebuild(const u8 *oam) {
+        clear();
+        for(int i = 0; i < OAM_SPRITE_COUNT; i++) {
+            add(i, oam[i * 4]);
+        }
+    }
+
+    /**
+     * Move sprite `sprite` from old_y to new_y
+     */
+    void update(int sprite, u8 old_y, u8 new_y) {
+        if(old_y == new_y) {
+            return;
+        }
+        remove(sprite, old_y);
+        add(sprite, new_y);
+    }
+
+    /**
+     * Select the sprites shown on `line`, in OAM order, applying the 10 per line limit
+     * @param oam OAM image, used to skip sprites at X=0
+     * @param out OAM indexes of the selected sprites
+     * @return number of sprites selected
+     */
+    int lookup(int line, bool tall_sprites, const u8 *oam, u8 (&out)[MAX_SPRITES_PER_LINE]) const {
+        if(line < 0 || line >= visible_lines) {
+            return 0;
+        }
+
+        u64 mask  = tall_sprites ? lines_16[line] : lines_8[line];
+        int count = 0;
+        while(mask != 0 && count < MAX_SPRITES_PER_LINE) {
+            int i = Bit::ctz(mask);
+            mask &= mask - 1;
+
+            if(oam[i * 4 + 1] > 0) {
+                out[count++] = (u8)i;
+            }
+        }
+        return count;
+    }
+
+private:
+    // sprite Y is the bottom edge of a 16px sprite, so Y=16 puts the top row on line 0
+    void add(int sprite, u8 y) { set_range(sprite, y, true); }
+
+    void remove(int sprite, u8 y) { set_range(sprite, y, false); }
+
+    void set_range(int sprite, u8 y, bool set) {
+        u64 bit = 1ull << sprite;
+        for(int row = 0; row < 16; row++) {
+            int line = (int)y - 16 + row;
+            if(line < 0 || line >= visible_lines) {
+                continue;
+            }
+
+            if(set) {
+                lines_16[line] |= bit;
+                if(row < 8) {
+                    lines_8[line] |= bit;
+                }
+            } else {
+                lines_16[line] &= ~bit;
+                lines_8[line] &= ~bit;
+            }
+        }
+    }
+
+    u64 lines_8[visible_lines]  = {0};
+    u64 lines_16[visible_lines] = {0};
+};
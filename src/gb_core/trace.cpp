@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "trace.hpp"
+
+TraceBuffer::TraceBuffer(size_t capacity) {
+    entries.resize(std::bit_ceil(std::max<size_t>(capacity, 1)));
+    mask = entries.size() - 1;
+}
+
+void TraceBuffer::snapshot(std::vector<trace_entry_t> &out) const {
+    u64 end   = written.load(std::memory_order_acquire);
+    u64 start = end > entries.size() ? end - entries.size() : 0;
+
+    out.resize(end - start);
+    for(u64 i = start; i < end; i++) {
+        out[i - start] = entries[i & mask];
+    }
+
+    // anything the writer has lapped since `end` may be torn, including the slot it might be writing right now
+    u64 after = written.load(std::memory_order_acquire);
+    if(after + 1 > start + entries.size()) {
+        u64 lapped = std::min<u64>(after + 1 - entries.size() - start, out.size());
+        out.erase(out.begin(), out.begin() + lapped);
+    }
+}
+
+bool TraceBuffer::dump(const std::string &path) const {
+    std::vector<trace_entry_t> snap;
+    snapshot(snap);
+
+    FILE *f = fopen(path.c_str(), "wb");
+    if(!f) {
+        return false;
+    }
+
+    file_header_t header {};
+    memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version    = file_version;
+    header.entry_size = sizeof(trace_entry_t);
+    header.count      = snap.size();
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+           && fwrite(snap.data(), sizeof(trace_entry_t), snap.size(), f) == snap.size();
+    return fclose(f) == 0 && ok;
+}
+
+namespace {
+    bool write_all(int fd, const void *data, size_t size) {
+        auto *bytes = static_cast<const u8 *>(data);
+        while(size) {
+#if defined(_WIN32)
+            auto done = _write(fd, bytes, unsigned(std::min<size_t>(size, INT32_MAX)));
+#else
+            auto done = write(fd, bytes, size);
+#endif
+            if(done < 0 && errno == EINTR) {
+                continue;
+            }
+            if(done <= 0) {
+                return false;
+            }
+            bytes += done;
+            size  -= done;
+        }
+        return true;
+    }
+} // namespace
+
+bool TraceBuffer::dump_to_fd(int fd) const {
+    u64 end   = written.load(std::memory_order_acquire);
+    u64 start = end > entries.size() ? end - entries.size() : 0;
+
+    file_header_t header {};
+    memcpy(header.magic, file_magic, sizeof(file_magic));
+    header.version    = file_version;
+    header.entry_size = sizeof(trace_entry_t);
+    header.count      = end - start;
+
+    // oldest first, from `start` to the end of the vector and then whatever wrapped around to the front
+    u64 first = std::min<u64>(end - start, entries.size() - (start & mask));
+    return write_all(fd, &header, sizeof(header))
+        && write_all(fd, &entries[start & mask], first * sizeof(trace_entry_t))
+        && write_all(fd, entries.data(), (end - start - first) * sizeof(trace_entry_t));
+}
+
+bool TraceBuffer::read_file(const std::string &path, std::vector<trace_entry_t> &out) {
+    FILE *f = fopen(path.c_str(), "rb");
+    if(!f) {
+        return false;
+    }
+
+    file_header_t header {};
+    bool          ok = fread(&header, sizeof(header), 1, f) == 1;
+    ok = ok && !memcmp(header.magic, file_magic, sizeof(file_magic)) && header.version == file_version
+      && header.entry_size == sizeof(trace_entry_t);
+    if(ok) {
+        out.resize(header.count);
+        ok = fread(out.data(), sizeof(trace_entry_t), out.size(), f) == out.size();
+    }
+
+    fclose(f);
+    return ok;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "util/flags.hpp"
+#include "util/types/primitives.hpp"
+
+/**
+ * One executed instruction, registers are as they were right before it ran
+ */
+struct trace_entry_t {
+    u64 clock;    // cpu_state_t::clocks at the fetch
+    u16 PC, AF, BC, DE, HL, SP;
+    u16 bank;     // ROM bank mapped at PC
+    u8  bytes[3]; // opcode and the two bytes after it, operands or not
+    u8  flags;
+    u8  reserved[6];
+};
+
+static_assert(sizeof(trace_entry_t) == 32, "trace files store trace_entry_t as is");
+
+#define TRACE_FLAG_INTERRUPT 0x01 // an interrupt was dispatched right before this instruction
+
+/**
+ * Fixed-size ring of the last N executed instructions, in a binary form cheap enough to leave on.
+ *
+ * Written by the emulation thread only, which never blocks or allocates. Other threads can take a consistent
+ * snapshot of it at any point: entries overwritten while they were being copied are dropped from the snapshot.
+ */
+class TraceBuffer {
+public:
+    /**
+     * @param capacity number of entries kept, rounded up to a power of two
+     */
+    explicit TraceBuffer(size_t capacity);
+
+    __force_inline void record(trace_entry_t const &entry) {
+        u64 pos             = written.load(std::memory_order_relaxed);
+        entries[pos & mask] = entry;
+        written.store(pos + 1, std::memory_order_release);
+    }
+
+    size_t capacity() const { return entries.size(); }
+
+    /**
+     * Total number of entries ever recorded, including the ones that have been overwritten
+     */
+    u64    total() const { return written.load(std::memory_order_acquire); }
+
+    void   clear() { written.store(0, std::memory_order_release); }
+
+    /**
+     * Copy out the entries still in the ring, oldest first
+     */
+    void   snapshot(std::vector<trace_entry_t> &out) const;
+
+    /**
+     * Write a snapshot to a trace file, see read_file()
+     * @return false if the file couldn't be written
+     */
+    bool   dump(const std::string &path) const;
+
+    /**
+     * Write the ring as a trace file to an already open fd, straight from the entries with write(2) only so it can
+     * be called from a signal handler. An entry the emulation thread was recording when it was interrupted is
+     * written as it stands
+     * @return false if a write failed
+     */
+    bool   dump_to_fd(int fd) const;
+
+    /**
+     * Load a trace file written by dump()
+     * @return false if the file couldn't be read or isn't a trace file
+     */
+    static bool read_file(const std::string &path, std::vector<trace_entry_t> &out);
+
+private:
+    struct file_header_t {
+        char magic[8];
+        u32  version;
+        u32  entry_size;
+        u64  count;
+    };
+
+    static constexpr char       file_magic[8] = {'S', 'G', 'B', 'T', 'R', 'A', 'C', 'E'};
+    static constexpr u32        file_version  = 1;
+
+    std::vector<trace_entry_t> entries;
+    u64                        mask;
+    std::atomic<u64>           written = 0;
+};
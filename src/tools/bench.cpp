@@ -0,0 +1,658 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gb_core/apu.hpp"
+#include "gb_core/core.hpp"
+#include "gb_core/joy.hpp"
+
+#include "util/file.hpp"
+#include "util/log.hpp"
+#include "util/types/pixel.hpp"
+#include "util/types/ringbuffer.hpp"
+
+/**
+ * Micro benchmarks of the core's hot paths and whole-frame runs of small generated ROMs.
+ *
+ * Every input comes from a fixed seed so runs are comparable across commits. Each benchmark is warmed up once, then
+ * timed `reps` times and reported as the median, min and max time per operation.
+ */
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [options]\n", argv0);
+    fprintf(stderr, "  --filter text  only run benchmarks whose name contains `text`\n");
+    fprintf(stderr, "  --reps n       timed repetitions per benchmark (default 9)\n");
+    fprintf(stderr, "  --frames n     frames per repetition of the ROM benchmarks (default 120)\n");
+    fprintf(stderr, "  --rom file     also run `file` as a ROM benchmark, can be given more than once\n");
+    fprintf(stderr, "  --json file    write the results to `file` as JSON\n");
+    fprintf(stderr, "  --label text   stored in the JSON output, e.g. the commit being measured\n");
+}
+
+namespace {
+    constexpr u32 bench_seed = 0x5117e6b;
+
+    // results are folded in here so the optimizer can't drop the work being timed
+    volatile u64  sink;
+
+    void write_json_string(FILE *f, std::string const &str) {
+        fputc('"', f);
+        for(char c: str) {
+            if(c == '"' || c == '\\') {
+                fputc('\\', f);
+            }
+            fputc(c, f);
+        }
+        fputc('"', f);
+    }
+
+    struct result_t {
+        std::string         name;
+        const char         *unit; // what one operation is
+        u64                 ops;  // per repetition
+        std::vector<double> ns_per_op;
+
+        double              median() const {
+            std::vector<double> sorted = ns_per_op;
+            std::sort(sorted.begin(), sorted.end());
+            return sorted[sorted.size() / 2];
+        }
+
+        double min() const { return *std::min_element(ns_per_op.begin(), ns_per_op.end()); }
+
+        double max() const { return *std::max_element(ns_per_op.begin(), ns_per_op.end()); }
+    };
+
+    struct options_t {
+        std::string              filter;
+        int                      reps   = 9;
+        int                      frames = 120;
+        std::vector<std::string> roms;
+        const char              *json_path = nullptr;
+        const char              *label     = nullptr;
+    };
+
+    class Runner {
+    public:
+        explicit Runner(options_t const &options) :
+            options(options) { }
+
+        bool wanted(std::string const &name) const {
+            return options.filter.empty() || name.find(options.filter) != std::string::npos;
+        }
+
+        /**
+         * Time `body(ops)`, which has to carry out `ops` operations
+         */
+        void run(std::string const &name, const char *unit, u64 ops, std::function<void(u64)> const &body) {
+            using Clock = std::chrono::steady_clock;
+
+            result_t result {name, unit, ops, {}};
+            body(ops);
+            for(int rep = 0; rep < options.reps; rep++) {
+                auto start = Clock::now();
+                body(ops);
+                double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+                result.ns_per_op.push_back(ns / ops);
+            }
+
+            printf("%-32s %12.2f ns/%-12s (min %.2f, max %.2f)\n",
+                   name.c_str(),
+                   result.median(),
+                   unit,
+                   result.min(),
+                   result.max());
+            fflush(stdout);
+            results.push_back(std::move(result));
+        }
+
+        bool writeJSON() const {
+            FILE *f = fopen(options.json_path, "w");
+            if(!f) {
+                fprintf(stderr, "%s: failed to open\n", options.json_path);
+                return false;
+            }
+
+            fprintf(f, "{\n  \"label\": ");
+            write_json_string(f, options.label ? options.label : "");
+            fprintf(f, ",\n  \"reps\": %d,\n  \"frames\": %d,\n  \"benchmarks\": [\n", options.reps, options.frames);
+            for(size_t i = 0; i < results.size(); i++) {
+                result_t const &r = results[i];
+                fprintf(f, "    {\"name\": ");
+                write_json_string(f, r.name);
+                fprintf(f,
+                        ", \"unit\": \"%s\", \"ops\": %llu, "
+                        "\"median_ns\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f}%s\n",
+                        r.unit,
+                        (unsigned long long)r.ops,
+                        r.median(),
+                        r.min(),
+                        r.max(),
+                        i + 1 < results.size() ? "," : "");
+            }
+            fprintf(f, "  ]\n}\n");
+            fclose(f);
+            return true;
+        }
+
+        options_t const &options;
+
+    private:
+        std::vector<result_t> results;
+    };
+
+    /**
+     * Cartridge header around a program at 0x150, 32KB and ROM only unless the cart type is changed
+     */
+    struct RomBuilder {
+        std::vector<u8> rom = std::vector<u8>(0x8000, 0);
+        u16             pc  = 0x150;
+
+        RomBuilder() {
+            at(0x100).emit({0x00, 0xC3, 0x50, 0x01}); // nop; jp 0x150
+            memcpy(&rom[0x134], "SILVERBENCH", 11);
+            at(0x150);
+        }
+
+        RomBuilder &at(u16 addr) {
+            pc = addr;
+            return *this;
+        }
+
+        RomBuilder &emit(std::initializer_list<u8> bytes) {
+            for(u8 b: bytes) {
+                rom[pc++] = b;
+            }
+            return *this;
+        }
+
+        RomBuilder &cartType(u8 type) {
+            rom[0x147] = type;
+            return *this;
+        }
+
+        // header byte, 0x02 for 8KB. Ignored unless the cart type has RAM
+        RomBuilder &ramSize(u8 size) {
+            rom[0x149] = size;
+            return *this;
+        }
+
+        u16         here() const { return pc; }
+
+        // jr/jr cc back to `target`
+        RomBuilder &jr(u8 op, u16 target) { return emit({op, static_cast<u8>(target - (pc + 2))}); }
+
+        std::shared_ptr<Silver::File> build(const char *name) {
+            u8 checksum = 0;
+            for(u16 addr = 0x134; addr <= 0x14C; addr++) {
+                checksum = checksum - rom[addr] - 1;
+            }
+            rom[0x14D] = checksum;
+            return std::shared_ptr<Silver::File>(Silver::File::fromBuffer(name, rom));
+        }
+    };
+
+    /**
+     * The components wired up the way Core does it, for poking at one of them directly
+     */
+    struct Machine {
+        explicit Machine(u8 cart_type = 0x00, gb_device_t device = device_GBC, PPU::output_mode_t output = {}) {
+            rom   = RomBuilder().cartType(cart_type).ramSize(0x02).emit({0x18, 0xFE}).build("idle.gb"); // jr -2
+            state = new machine_state_t {};
+            cart  = new Cartridge(rom, state->cart_ram, &state->mbc);
+            mem   = new Memory(state, device, false);
+            apu   = new APU(&state->apu, false);
+            ppu   = new PPU(cart, mem, &state->ppu, device, false, output);
+            joy   = new Joypad(mem, &state->joypad);
+            io    = new IO_Bus(mem, apu, ppu, joy, cart, &state->bus, device);
+            cpu   = new CPU(mem, io, &state->cpu, &breakpoints, device, false);
+        }
+
+        ~Machine() {
+            delete cpu;
+            delete io;
+            delete joy;
+            delete ppu;
+            delete apu;
+            delete mem;
+            delete cart;
+            delete state;
+        }
+
+        void fill(u16 addr, std::vector<u8> const &bytes) {
+            for(u8 b: bytes) {
+                io->write(addr++, b, true);
+            }
+        }
+
+        std::shared_ptr<Silver::File> rom;
+        machine_state_t              *state;
+        BreakpointSet                 breakpoints;
+        Cartridge                    *cart;
+        Memory                       *mem;
+        APU                          *apu;
+        PPU                          *ppu;
+        Joypad                       *joy;
+        IO_Bus                       *io;
+        CPU                          *cpu;
+    };
+
+    std::vector<u8> random_bytes(std::mt19937 &rng, size_t count) {
+        std::vector<u8> bytes(count);
+        for(u8 &b: bytes) {
+            b = static_cast<u8>(rng());
+        }
+        return bytes;
+    }
+
+    /**
+     * A stream of instructions from one of the mixes below, ending in a jump back to its start. Instructions that
+     * change HL, BC or SP are left out of the mixes that address memory through them, so every access stays in WRAM.
+     */
+    std::vector<u8> instruction_mix(std::string const &mix, u16 base, size_t size) {
+        std::mt19937    rng(bench_seed);
+        std::vector<u8> code;
+        auto            pick = [&](std::vector<u8> const &from) { return from[rng() % from.size()]; };
+
+        std::vector<u8> choices;
+        if(mix == "alu") {
+            // register to register loads and arithmetic, inc/dec, immediate arithmetic
+            for(int op = 0x40; op < 0xC0; op++) {
+                if((op & 7) != 6 && (op < 0x70 || op >= 0x78)) {
+                    choices.push_back(op);
+                }
+            }
+            for(u8 op: {0x04, 0x05, 0x0C, 0x0D, 0x14, 0x15, 0x1C, 0x1D, 0x24, 0x25, 0x2C, 0x2D, 0x3C, 0x3D}) {
+                choices.push_back(op);
+            }
+            for(u8 op: {0xC6, 0xCE, 0xD6, 0xDE, 0xE6, 0xEE, 0xF6, 0xFE}) {
+                choices.push_back(op);
+            }
+        } else if(mix == "memory") {
+            // (hl), (bc), (nn) and ldh loads and stores, push/pop pairs
+            choices = {0x56, 0x5E, 0x7E, 0x70, 0x71, 0x72, 0x73, 0x77, 0x0A, 0x02, 0xFA, 0xEA, 0xF0, 0xE0, 0xC5};
+        } else if(mix == "cb") {
+            // every CB op on every operand but H and L, so (hl) stays put
+            for(int op = 0; op < 0x100; op++) {
+                if((op & 7) != 4 && (op & 7) != 5) {
+                    choices.push_back(op);
+                }
+            }
+        } else if(mix == "branch") {
+            // jr/jp/call to the next instruction, taken or not
+            choices = {0x18, 0x20, 0x28, 0x30, 0x38, 0xC3, 0xCD};
+        }
+
+        while(code.size() < size) {
+            u8  op   = pick(choices);
+            u16 next = base + code.size();
+            if(mix == "cb") {
+                code.insert(code.end(), {0xCB, op});
+            } else if(op == 0xFA || op == 0xEA) {
+                code.insert(code.end(), {op, static_cast<u8>(rng() & 0xFF), 0xCE});
+            } else if(op == 0xF0 || op == 0xE0) {
+                code.insert(code.end(), {op, static_cast<u8>(0x80 | (rng() & 0x3F))});
+            } else if(op == 0xC5) {
+                code.insert(code.end(), {0xC5, 0xC1}); // push bc; pop bc
+            } else if(op == 0xC3) {
+                next += 3;
+                code.insert(code.end(), {op, static_cast<u8>(next), static_cast<u8>(next >> 8)});
+            } else if(op == 0xCD) {
+                next += 3;
+                code.insert(code.end(), {op, static_cast<u8>(next), static_cast<u8>(next >> 8), 0xE8, 0x02});
+            } else if(mix == "branch" || (mix == "alu" && op >= 0xC0)) {
+                // jr +0, or an immediate operand
+                code.insert(code.end(), {op, static_cast<u8>(mix == "alu" ? rng() : 0)});
+            } else {
+                code.push_back(op);
+            }
+        }
+
+        code.insert(code.end(), {0xC3, static_cast<u8>(base), static_cast<u8>(base >> 8)});
+        return code;
+    }
+
+    void bench_cpu(Runner &runner) {
+        for(const char *mix: {"alu", "memory", "cb", "branch"}) {
+            std::string name = std::string("cpu.decode/") + mix;
+            if(!runner.wanted(name)) {
+                continue;
+            }
+
+            Machine machine;
+            machine.fill(0xC000, instruction_mix(mix, 0xC000, 0x700));
+            // code in the first 2KB of WRAM, everything the mixes address in the last 1KB of bank 0
+            machine.cpu->setRegisters({0x0000, 0xCD00, 0xCE00, 0xCC00, 0xCFF0, 0xC000});
+
+            // there's no public fetch, so each operation is a fetch through the bus plus the decode
+            runner.run(name, "instruction", 1 << 20, [&](u64 ops) {
+                CPU *cpu = machine.cpu;
+                for(u64 i = 0; i < ops; i++) {
+                    CPU::registers_t regs = cpu->getRegisters();
+                    u8               op   = machine.io->read(regs.PC);
+                    regs.PC++;
+                    cpu->setRegisters(regs);
+                    cpu->decode(op);
+                }
+            });
+        }
+    }
+
+    void bench_bus(Runner &runner) {
+        struct region_t {
+            const char     *name;
+            std::vector<u16> read_addrs, write_addrs;
+        };
+
+        auto range = [](u16 start, u16 end) {
+            std::vector<u16> addrs;
+            for(u32 addr = start; addr <= end; addr++) {
+                addrs.push_back(addr);
+            }
+            return addrs;
+        };
+
+        // IO is limited to registers games poll or rewrite every frame, writes with side effects (DMA, LCDC, sound
+        // triggers, ...) would measure those instead
+        region_t regions[] = {
+            {"ROM", range(0x0000, 0x7FFF), range(0x2000, 0x3FFF)},
+            {"VRAM", range(0x8000, 0x9FFF), range(0x8000, 0x9FFF)},
+            {"SRAM", range(0xA000, 0xBFFF), range(0xA000, 0xBFFF)},
+            {"WRAM", range(0xC000, 0xDFFF), range(0xC000, 0xDFFF)},
+            {"Echo", range(0xE000, 0xFDFF), range(0xE000, 0xFDFF)},
+            {"OAM", range(0xFE00, 0xFE9F), range(0xFE00, 0xFE9F)},
+            {"IO", {0xFF00, 0xFF04, 0xFF05, 0xFF0F, 0xFF26, 0xFF40, 0xFF41, 0xFF44}, {0xFF42, 0xFF43, 0xFF47, 0xFF4A}},
+            {"HRAM", range(0xFF80, 0xFFFE), range(0xFF80, 0xFFFE)},
+        };
+
+        // MBC1+RAM, so ROM writes are bank selects rather than errors and SRAM is real RAM. No battery, which would
+        // leave a save file behind
+        Machine machine(0x02);
+        machine.io->write(0x0000, 0x0A); // enable SRAM
+        // LCD off so VRAM and OAM are always accessible
+        machine.mem->registers.LCDC = 0x00;
+
+        for(region_t const &region: regions) {
+            std::string read_name = std::string("io.read/") + region.name;
+            if(runner.wanted(read_name)) {
+                runner.run(read_name, "access", 1 << 20, [&](u64 ops) {
+                    u64    sum   = 0;
+                    size_t count = region.read_addrs.size();
+                    for(u64 i = 0; i < ops; i++) {
+                        sum += machine.io->read(region.read_addrs[i % count]);
+                    }
+                    sink = sum;
+                });
+            }
+
+            std::string write_name = std::string("io.write/") + region.name;
+            if(runner.wanted(write_name)) {
+                runner.run(write_name, "access", 1 << 20, [&](u64 ops) {
+                    size_t count = region.write_addrs.size();
+                    // keep selecting ROM bank 1 so the mapping doesn't change
+                    bool   rom   = region.name == std::string("ROM");
+                    for(u64 i = 0; i < ops; i++) {
+                        machine.io->write(region.write_addrs[i % count], rom ? 1 : static_cast<u8>(i));
+                    }
+                });
+            }
+        }
+    }
+
+    void bench_ppu(Runner &runner) {
+        std::mt19937 rng(bench_seed);
+
+        std::pair<const char *, PPU::output_mode_t> frame_modes[] = {
+                {"ppu.frame", {}},
+                {"ppu.frame.luminance", {PPU::output_mode_t::Luminance}},
+                {"ppu.frame.luminance_2x", {PPU::output_mode_t::Luminance, 2, 2}},
+        };
+        for(auto const &[name, output]: frame_modes) {
+            if(!runner.wanted(name)) {
+                continue;
+            }
+            Machine      machine(0x00, device_GBC, output);
+            std::mt19937 scene_rng = rng; // the same scene in every mode
+
+            // tiles, BG map and sprites all random, written with the LCD off, then BG and OBJ on
+            machine.mem->registers.LCDC = 0x00;
+            machine.fill(0x8000, random_bytes(scene_rng, 0x2000));
+            std::vector<u8> oam = random_bytes(scene_rng, 0xA0);
+            for(int i = 0; i < 40; i++) {
+                oam[i * 4 + 0] = 16 + (i * 37) % 144; // y
+                oam[i * 4 + 1] = 8 + (i * 53) % 160;  // x
+            }
+            machine.fill(0xFE00, oam);
+            machine.fill(0xFF47, {0xE4, 0xE4, 0x1B});
+            machine.io->write(0xFF40, 0x93, true);
+
+            // the first frame after enabling the LCD isn't drawn
+            while(!machine.ppu->tick()) { }
+
+            runner.run(name, "frame", 60, [&](u64 ops) {
+                for(u64 i = 0; i < ops; i++) {
+                    while(!machine.ppu->tick()) { }
+                }
+                sink = machine.ppu->getFrameHash();
+            });
+        }
+
+        if(runner.wanted("ppu.process_tile_line")) {
+            Machine                            machine;
+            std::vector<u8>                    bytes = random_bytes(rng, 4096);
+            std::array<PPU::fifo_color_t, 8> arr;
+
+            runner.run("ppu.process_tile_line", "line", 1 << 20, [&](u64 ops) {
+                u64 sum = 0;
+                for(u64 i = 0; i < ops; i++) {
+                    size_t at = (i * 3) % (bytes.size() - 2);
+                    machine.ppu->process_tile_line(arr, bytes[at], bytes[at + 1], bytes[at + 2]);
+                    sum += arr[i & 7].bits;
+                }
+                sink = sum;
+            });
+        }
+
+        if(runner.wanted("pixel.encode_rgb")) {
+            std::vector<Silver::Pixel> pixels(Silver::Core::native_pixel_count);
+            for(Silver::Pixel &p: pixels) {
+                p = Silver::Pixel::makeFromRGB15(rng() & 0x7FFF);
+            }
+            std::vector<u8> out(Silver::Core::native_pixel_count * 3);
+
+            runner.run("pixel.encode_rgb", "frame", 2000, [&](u64 ops) {
+                for(u64 i = 0; i < ops; i++) {
+                    Silver::PixelBufferEncoder<u8>::encodePixelBuffer<Silver::PixelFormat::RGB>(
+                            out.data(), out.size(), pixels);
+                }
+                sink = out[0];
+            });
+        }
+    }
+
+    void bench_audio(Runner &runner) {
+        if(runner.wanted("apu.tick+sample")) {
+            std::mt19937 rng(bench_seed);
+            Machine      machine;
+
+            // every channel playing
+            machine.fill(0xFF26, {0x80});
+            machine.fill(0xFF24, {0x77, 0xFF});
+            machine.fill(0xFF30, random_bytes(rng, 16));
+            machine.fill(0xFF10, {0x00, 0x80, 0xF0, 0x00, 0x87});
+            machine.fill(0xFF16, {0x40, 0xF0, 0x80, 0x86});
+            machine.fill(0xFF1A, {0x80, 0x00, 0x20, 0x40, 0x87});
+            machine.fill(0xFF20, {0x00, 0xF0, 0x55, 0x80});
+
+            // one output sample's worth of clocks, at Core's sampling interval
+            runner.run("apu.tick+sample", "sample", 1 << 16, [&](u64 ops) {
+                float left = 0, right = 0, sum = 0;
+                for(u64 i = 0; i < ops; i++) {
+                    for(int clock = 0; clock < 88; clock++) {
+                        machine.apu->tick();
+                    }
+                    machine.apu->sample(&left, &right);
+                    sum += left + right;
+                }
+                sink = static_cast<u64>(sum);
+            });
+        }
+
+        if(runner.wanted("audio.ringbuffer")) {
+            // the core's audio queue, a buffer in and out again
+            using AudioBuffer = std::array<float, 2048>;
+            auto        queue = std::make_unique<jnk0le::Ringbuffer<AudioBuffer, 4>>();
+            AudioBuffer in {}, out {};
+
+            runner.run("audio.ringbuffer", "buffer", 1 << 16, [&](u64 ops) {
+                for(u64 i = 0; i < ops; i++) {
+                    in[i & 2047] = static_cast<float>(i);
+                    queue->insert(&in);
+                    queue->remove(out);
+                }
+                sink = static_cast<u64>(out[0]);
+            });
+        }
+    }
+
+    /**
+     * Small generated programs standing in for typical game workloads
+     */
+    std::shared_ptr<Silver::File> build_rom(std::string const &kind) {
+        RomBuilder b;
+
+        if(kind == "rom.cpu_loop") {
+            // arithmetic over all of WRAM with the screen on
+            b.emit({0x21, 0x00, 0xC0});        //       ld hl, 0xC000
+            u16 loop = b.here();
+            b.emit({0x78, 0x81, 0xAA, 0x22});  // loop: ld a, b; add c; xor d; ld (hl+), a
+            b.emit({0xCB, 0xAC, 0x04, 0x0D});  //       res 5, h; inc b; dec c
+            b.jr(0x18, loop);                  //       jr loop
+        } else if(kind == "rom.vram_writes") {
+            // constantly rewriting tile data and the BG map
+            b.emit({0x21, 0x00, 0x80});        //       ld hl, 0x8000
+            u16 loop = b.here();
+            b.emit({0x7D, 0xAC, 0x22, 0xCB, 0xAC}); // loop: ld a, l; xor h; ld (hl+), a; res 5, h
+            b.jr(0x18, loop);                  //       jr loop
+        } else if(kind == "rom.halt") {
+            // a menu waiting for input, halted between VBlanks
+            b.at(0x40).emit({0xD9});           // vblank: reti
+            b.at(0x150);
+            b.emit({0x3E, 0x01, 0xE0, 0xFF});  //       ld a, 1; ldh (IE), a
+            b.emit({0xFB});                    //       ei
+            u16 loop = b.here();
+            b.emit({0x76});                    // loop: halt
+            b.jr(0x18, loop);                  //       jr loop
+        } else if(kind == "rom.sprites") {
+            // 40 sprites moved every frame and copied in by OAM DMA from VBlank
+            b.at(0x40).emit({0xCD, 0x80, 0xFF, 0xD9}); // vblank: call 0xFF80; reti
+
+            // OAM DMA routine, copied to HRAM
+            b.at(0x200).emit({0x3E, 0xC0, 0xE0, 0x46, 0x3E, 0x28, 0x3D, 0x20, 0xFD, 0xC9});
+
+            b.at(0x150);
+            b.emit({0x21, 0x00, 0xC0, 0x06, 0x28});   //       ld hl, 0xC000; ld b, 40
+            b.emit({0x0E, 0x10, 0x1E, 0x08, 0x16, 0x00}); //   ld c, 16; ld e, 8; ld d, 0
+            u16 init = b.here();
+            b.emit({0x71, 0x2C, 0x73, 0x2C, 0x72, 0x2C}); // init: ld (hl), c/e/d for y, x, tile
+            b.emit({0x36, 0x00, 0x2C});               //       ld (hl), 0 for attributes
+            b.emit({0x79, 0xC6, 0x03, 0x4F});         //       c += 3
+            b.emit({0x7B, 0xC6, 0x04, 0x5F});         //       e += 4
+            b.emit({0x14, 0x05});                     //       inc d; dec b
+            b.jr(0x20, init);                         //       jr nz, init
+
+            b.emit({0x21, 0x00, 0x02, 0x0E, 0x80, 0x06, 0x0A}); // ld hl, 0x200; ld c, 0x80; ld b, 10
+            u16 copy = b.here();
+            b.emit({0x2A, 0xE2, 0x0C, 0x05});         // copy: ld a, (hl+); ldh (c), a; inc c; dec b
+            b.jr(0x20, copy);                         //       jr nz, copy
+
+            b.emit({0x3E, 0x93, 0xE0, 0x40});         //       ld a, 0x93; ldh (LCDC), a
+            b.emit({0x3E, 0x01, 0xE0, 0xFF, 0xFB});   //       ld a, 1; ldh (IE), a; ei
+            u16 frame = b.here();
+            b.emit({0x76, 0x21, 0x01, 0xC0, 0x06, 0x28}); // frame: halt; ld hl, 0xC001; ld b, 40
+            u16 move = b.here();
+            b.emit({0x34, 0x7D, 0xC6, 0x04, 0x6F, 0x05}); // move: inc (hl); l += 4; dec b
+            b.jr(0x20, move);                         //       jr nz, move
+            b.jr(0x18, frame);                        //       jr frame
+        }
+
+        return b.build((kind + ".gb").c_str());
+    }
+
+    void bench_roms(Runner &runner) {
+        std::vector<std::pair<std::string, std::shared_ptr<Silver::File>>> roms;
+        for(const char *kind: {"rom.cpu_loop", "rom.vram_writes", "rom.halt", "rom.sprites"}) {
+            if(runner.wanted(kind)) {
+                roms.emplace_back(kind, build_rom(kind));
+            }
+        }
+        for(std::string const &path: runner.options.roms) {
+            std::string name = "rom." + path.substr(path.find_last_of("/\\") + 1);
+            if(!runner.wanted(name)) {
+                continue;
+            }
+
+            auto rom = std::shared_ptr<Silver::File>(Silver::File::openReadOnly(path));
+            if(!rom) {
+                fprintf(stderr, "%s: failed to open\n", path.c_str());
+                continue;
+            }
+            roms.emplace_back(name, rom);
+        }
+
+        for(auto &[name, rom]: roms) {
+            Silver::Core core(rom, std::nullopt, device_GBC);
+            runner.run(name, "frame", runner.options.frames, [&](u64 ops) {
+                for(u64 i = 0; i < ops; i++) {
+                    core.tick_frame();
+                }
+                sink = core.getFrameHash();
+            });
+        }
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    options_t options;
+
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "--filter") && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if(!strcmp(argv[i], "--reps") && i + 1 < argc) {
+            options.reps = std::max(1l, strtol(argv[++i], nullptr, 10));
+        } else if(!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            options.frames = std::max(1l, strtol(argv[++i], nullptr, 10));
+        } else if(!strcmp(argv[i], "--rom") && i + 1 < argc) {
+            options.roms.push_back(argv[++i]);
+        } else if(!strcmp(argv[i], "--json") && i + 1 < argc) {
+            options.json_path = argv[++i];
+        } else if(!strcmp(argv[i], "--label") && i + 1 < argc) {
+            options.label = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    // the cores complain about starting without a boot ROM
+    Silver::getLogger().setLogLevel(Silver::Logger::LogLevel::Error);
+
+    Runner runner(options);
+    bench_cpu(runner);
+    bench_bus(runner);
+    bench_ppu(runner);
+    bench_audio(runner);
+    bench_roms(runner);
+
+    if(options.json_path && !runner.writeJSON()) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,304 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gb_core/core.hpp"
+
+#include "util/bit.hpp"
+#include "util/file.hpp"
+#include "util/log.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+    enum result_t { Pass, Fail, Timeout, Error };
+
+    const char *result_names[] = {"PASS", "FAIL", "TIMEOUT", "ERROR"};
+
+    struct rom_t {
+        std::string path;
+        u64         expected_hash = 0; // from the pass-list, the ROM passes once its screen shows this frame
+        bool        listed        = false;
+
+        result_t    result        = Error;
+        long        frames        = 0;
+        u64         last_hash     = 0;
+        std::string detail;
+    };
+
+    struct options_t {
+        long                       max_frames = 120 * 60;
+        std::optional<gb_device_t> device;
+    };
+
+    void usage(const char *argv0) {
+        fprintf(stderr, "usage: %s [options] rom-or-dir...\n", argv0);
+        fprintf(stderr, "  runs test ROMs headlessly in parallel and reports which pass\n");
+        fprintf(stderr, "  -j n            worker threads (default: hardware threads)\n");
+        fprintf(stderr, "  --timeout secs  emulated seconds before a ROM times out (default 120)\n");
+        fprintf(stderr, "  --dmg, --cgb    force the device instead of picking it from the cartridge header\n");
+        fprintf(stderr, "  --list file     pass-list, exits non-zero if a listed ROM no longer passes\n");
+        fprintf(stderr, "  --update        rewrite the pass-list with every ROM that passes now\n");
+        fprintf(stderr, "\n");
+        fprintf(stderr, "A ROM passes when it prints \"Passed\" over the serial port (Blargg), leaves the Fibonacci\n");
+        fprintf(stderr, "numbers 3/5/8/13/21/34 in B/C/D/E/H/L (Mooneye) or, for pass-list entries written as\n");
+        fprintf(stderr, "`path hash`, shows the screen with that frame hash (see gb_headless).\n");
+    }
+
+    bool is_rom(fs::path const &path) {
+        auto ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+        return ext == ".gb" || ext == ".gbc";
+    }
+
+    void collect_roms(std::vector<std::string> const &args, std::vector<std::string> &out) {
+        for(auto const &arg: args) {
+            std::error_code ec;
+            if(fs::is_directory(arg, ec)) {
+                for(auto const &entry: fs::recursive_directory_iterator(arg, ec)) {
+                    if(entry.is_regular_file() && is_rom(entry.path())) {
+                        out.push_back(entry.path().generic_string());
+                    }
+                }
+            } else {
+                out.push_back(fs::path(arg).generic_string());
+            }
+        }
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    /**
+     * One entry per line, `path` or `path hash` with the hash in hex, # starts a comment
+     */
+    bool read_pass_list(const char *path, std::map<std::string, u64> &out) {
+        std::ifstream in(path);
+        if(!in) {
+            return false;
+        }
+
+        std::string line;
+        while(std::getline(in, line)) {
+            line = line.substr(0, line.find('#'));
+
+            std::istringstream fields(line);
+            std::string        rom, hash;
+            if(fields >> rom) {
+                fields >> hash;
+                out[rom] = hash.empty() ? 0 : strtoull(hash.c_str(), nullptr, 16);
+            }
+        }
+        return true;
+    }
+
+    bool write_pass_list(const char *path, std::vector<rom_t> const &roms) {
+        FILE *f = fopen(path, "w");
+        if(!f) {
+            return false;
+        }
+
+        fprintf(f, "# test ROMs expected to pass, see gb_conformance --help\n");
+        for(auto const &rom: roms) {
+            if(rom.result != Pass) {
+                continue;
+            }
+            if(rom.expected_hash) {
+                fprintf(f, "%s %016llx\n", rom.path.c_str(), (unsigned long long)rom.expected_hash);
+            } else {
+                fprintf(f, "%s\n", rom.path.c_str());
+            }
+        }
+        fclose(f);
+        return true;
+    }
+
+    bool mooneye_passed(CPU::registers_t const &r) {
+        return r.BC == 0x0305 && r.DE == 0x080D && r.HL == 0x1522;
+    }
+
+    bool mooneye_failed(CPU::registers_t const &r) {
+        return r.BC == 0x4242 && r.DE == 0x4242 && r.HL == 0x4242;
+    }
+
+    void run_rom(rom_t &rom, options_t const &opts) {
+        auto file = std::shared_ptr<Silver::File>(Silver::File::openReadOnly(rom.path));
+        if(!file || file->getSize() < 0x150) {
+            rom.result = Error;
+            rom.detail = "failed to open";
+            return;
+        }
+
+        // CGB flag in the header, both CGB-only and CGB-enhanced carts run as a CGB
+        gb_device_t  device = opts.device.value_or(Bit::test(file->getByte(0x143), 7) ? device_GBC : device_GB);
+        Silver::Core core(file, std::nullopt, device);
+
+        size_t       scanned = 0;
+        for(rom.frames = 1; rom.frames <= opts.max_frames; rom.frames++) {
+            core.tick_frame();
+            rom.last_hash = core.getFrameHash();
+
+            // only look at what arrived since the last frame, and a little before in case the word was split
+            std::string const &serial = core.getSerialOutput();
+            size_t             from   = scanned > 8 ? scanned - 8 : 0;
+            scanned                   = serial.size();
+            if(serial.find("Passed", from) != std::string::npos) {
+                rom.result = Pass;
+                return;
+            }
+            if(serial.find("Failed", from) != std::string::npos) {
+                rom.result = Fail;
+                rom.detail = serial.substr(serial.rfind('\n', serial.find("Failed", from)) + 1, 64);
+                rom.detail = rom.detail.substr(0, rom.detail.find('\n'));
+                return;
+            }
+
+            auto regs = core.getRegistersFromCPU();
+            if(mooneye_passed(regs)) {
+                rom.result = Pass;
+                return;
+            }
+            if(mooneye_failed(regs)) {
+                rom.result = Fail;
+                return;
+            }
+
+            if(rom.expected_hash && rom.last_hash == rom.expected_hash) {
+                rom.result = Pass;
+                return;
+            }
+        }
+
+        rom.frames = opts.max_frames;
+        rom.result = Timeout;
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> args;
+    options_t                opts;
+    const char              *list_path = nullptr;
+    bool                     update    = false;
+    unsigned                 jobs      = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-j") && i + 1 < argc) {
+            jobs = std::max(1l, strtol(argv[++i], nullptr, 10));
+        } else if(!strcmp(argv[i], "--timeout") && i + 1 < argc) {
+            opts.max_frames = std::max(1l, strtol(argv[++i], nullptr, 10)) * 60;
+        } else if(!strcmp(argv[i], "--dmg")) {
+            opts.device = device_GB;
+        } else if(!strcmp(argv[i], "--cgb")) {
+            opts.device = device_GBC;
+        } else if(!strcmp(argv[i], "--list") && i + 1 < argc) {
+            list_path = argv[++i];
+        } else if(!strcmp(argv[i], "--update")) {
+            update = true;
+        } else if(argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            args.push_back(argv[i]);
+        }
+    }
+
+    if(args.empty() || (update && !list_path)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::map<std::string, u64> pass_list;
+    if(list_path && !read_pass_list(list_path, pass_list) && !update) {
+        fprintf(stderr, "%s: failed to open\n", list_path);
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+    collect_roms(args, paths);
+
+    std::vector<rom_t> roms(paths.size());
+    for(size_t i = 0; i < paths.size(); i++) {
+        roms[i].path = paths[i];
+        if(auto it = pass_list.find(paths[i]); it != pass_list.end()) {
+            roms[i].listed        = true;
+            roms[i].expected_hash = it->second;
+        }
+    }
+
+    // the cores log from every worker, only keep what points at an emulator bug
+    Silver::getLogger().setLogLevel(Silver::Logger::LogLevel::Fatal);
+
+    std::atomic<size_t>      next = 0;
+    std::mutex               print_mutex;
+    std::vector<std::thread> workers;
+    auto                     start = std::chrono::steady_clock::now();
+    for(unsigned t = 0; t < std::min<size_t>(jobs, roms.size()); t++) {
+        workers.emplace_back([&]() {
+            for(size_t i; (i = next.fetch_add(1)) < roms.size();) {
+                rom_t &rom = roms[i];
+                run_rom(rom, opts);
+
+                std::lock_guard lock(print_mutex);
+                printf("%-7s %s (%ld frames, %016llx)%s%s\n",
+                       result_names[rom.result],
+                       rom.path.c_str(),
+                       rom.frames,
+                       (unsigned long long)rom.last_hash,
+                       rom.detail.empty() ? "" : ": ",
+                       rom.detail.c_str());
+                fflush(stdout);
+            }
+        });
+    }
+    for(auto &worker: workers) {
+        worker.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int passed = 0, regressions = 0, new_passes = 0;
+    for(auto const &rom: roms) {
+        passed += rom.result == Pass;
+        if(rom.listed && rom.result != Pass) {
+            regressions++;
+            fprintf(stderr, "regression: %s %s\n", rom.path.c_str(), result_names[rom.result]);
+        } else if(list_path && !rom.listed && rom.result == Pass) {
+            new_passes++;
+            printf("new pass: %s\n", rom.path.c_str());
+        }
+    }
+    for(auto const &[path, hash]: pass_list) {
+        if(std::none_of(roms.begin(), roms.end(), [&](rom_t const &rom) { return rom.path == path; })) {
+            regressions++;
+            fprintf(stderr, "regression: %s is on the pass-list but wasn't found\n", path.c_str());
+        }
+    }
+
+    printf("%d/%zu passed in %.1f s", passed, roms.size(), secs);
+    if(list_path) {
+        printf(", %d regressions, %d new passes", regressions, new_passes);
+    }
+    printf("\n");
+
+    if(update) {
+        if(!write_pass_list(list_path, roms)) {
+            fprintf(stderr, "%s: failed to write\n", list_path);
+            return 1;
+        }
+        printf("%s updated\n", list_path);
+        return 0;
+    }
+    return regressions ? 2 : 0;
+}
@@ -0,0 +1,482 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "gb_core/arena.hpp"
+#include "gb_core/breakpoints.hpp"
+#include "gb_core/cpu.hpp"
+#include "gb_core/io.hpp"
+#include "gb_core/joy.hpp"
+#include "gb_core/mem.hpp"
+
+#include "util/log.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+    void usage(const char *argv0) {
+        fprintf(stderr, "usage: %s [options] dir-or-file...\n", argv0);
+        fprintf(stderr, "  runs the SM83 single-step test vectors (one JSON file per opcode) against the CPU alone\n");
+        fprintf(stderr, "  -j n          worker threads (default: hardware threads)\n");
+        fprintf(stderr, "  --diffs n     failing tests to describe per opcode (default 3)\n");
+        fprintf(stderr, "  --no-cycles   don't compare bus accesses, only the final state and cycle count\n");
+    }
+
+    /**
+     * Just enough JSON for the test vectors: no escapes beyond \" and \\, numbers are kept as doubles
+     */
+    struct json_t {
+        enum kind_t : u8 { Null, Bool, Number, String, Array, Object } kind = Null;
+
+        double                                      number = 0;
+        std::string                                 string;
+        std::vector<json_t>                         items;
+        std::vector<std::pair<std::string, json_t>> members;
+
+        json_t const *get(std::string_view key) const {
+            for(auto const &[name, value]: members) {
+                if(name == key) {
+                    return &value;
+                }
+            }
+            return nullptr;
+        }
+
+        u32 as_u32() const { return (u32)number; }
+    };
+
+    class JsonParser {
+    public:
+        explicit JsonParser(std::string_view text) : text(text) { }
+
+        bool parse(json_t &out) {
+            return value(out) && (skip_ws(), pos == text.size());
+        }
+
+        size_t offset() const { return pos; }
+
+    private:
+        void skip_ws() {
+            while(pos < text.size() && isspace((unsigned char)text[pos])) {
+                pos++;
+            }
+        }
+
+        bool literal(std::string_view word) {
+            if(text.substr(pos, word.size()) != word) {
+                return false;
+            }
+            pos += word.size();
+            return true;
+        }
+
+        bool string(std::string &out) {
+            if(text[pos++] != '"') {
+                return false;
+            }
+            while(pos < text.size() && text[pos] != '"') {
+                if(text[pos] == '\\' && pos + 1 < text.size()) {
+                    pos++;
+                }
+                out.push_back(text[pos++]);
+            }
+            return pos++ < text.size();
+        }
+
+        bool value(json_t &out) {
+            skip_ws();
+            if(pos >= text.size()) {
+                return false;
+            }
+
+            switch(text[pos]) {
+            case '{':
+                out.kind = json_t::Object;
+                pos++;
+                skip_ws();
+                if(pos < text.size() && text[pos] == '}') {
+                    pos++;
+                    return true;
+                }
+                while(true) {
+                    auto &member = out.members.emplace_back();
+                    skip_ws();
+                    if(pos >= text.size() || !string(member.first)) {
+                        return false;
+                    }
+                    skip_ws();
+                    if(pos >= text.size() || text[pos++] != ':' || !value(member.second)) {
+                        return false;
+                    }
+                    skip_ws();
+                    if(pos >= text.size()) {
+                        return false;
+                    }
+                    char c = text[pos++];
+                    if(c == '}') {
+                        return true;
+                    } else if(c != ',') {
+                        return false;
+                    }
+                }
+            case '[':
+                out.kind = json_t::Array;
+                pos++;
+                skip_ws();
+                if(pos < text.size() && text[pos] == ']') {
+                    pos++;
+                    return true;
+                }
+                while(true) {
+                    if(!value(out.items.emplace_back())) {
+                        return false;
+                    }
+                    skip_ws();
+                    if(pos >= text.size()) {
+                        return false;
+                    }
+                    char c = text[pos++];
+                    if(c == ']') {
+                        return true;
+                    } else if(c != ',') {
+                        return false;
+                    }
+                }
+            case '"': out.kind = json_t::String; return string(out.string);
+            case 'n': out.kind = json_t::Null; return literal("null");
+            case 't':
+                out.kind   = json_t::Bool;
+                out.number = 1;
+                return literal("true");
+            case 'f': out.kind = json_t::Bool; return literal("false");
+            default:
+                {
+                    char       *end;
+                    std::string number(text.substr(pos, 32));
+                    out.kind   = json_t::Number;
+                    out.number = strtod(number.c_str(), &end);
+                    if(end == number.c_str()) {
+                        return false;
+                    }
+                    pos += end - number.c_str();
+                    return true;
+                }
+            }
+        }
+
+        std::string_view text;
+        size_t           pos = 0;
+    };
+
+    struct file_result_t {
+        std::string              name;
+        size_t                   total = 0, failed = 0;
+        std::vector<std::string> diffs;
+        std::string              error;
+    };
+
+    /**
+     * A CPU on its own, wired to a flat_bus_t instead of a cartridge and the rest of the machine
+     */
+    class Machine {
+    public:
+        Machine() :
+            state(std::make_unique<machine_state_t>()), flat(std::make_unique<flat_bus_t>()),
+            mem(state.get(), device_GB, false), joy(&mem, &state->joypad), io(&mem, &joy, &state->bus, flat.get()),
+            cpu(&mem, &io, &state->cpu, &breakpoints, device_GB, false) { }
+
+        /**
+         * Run one test vector
+         * @return a description of every mismatch, empty if the test passed
+         */
+        std::string run(json_t const &test, bool compare_cycles) {
+            json_t const *initial = test.get("initial"), *final = test.get("final"), *cycles = test.get("cycles");
+            if(!initial || !final || !cycles) {
+                return "malformed test";
+            }
+
+            load(*initial);
+            flat->log.clear();
+
+            // the first clock fetches and executes the whole instruction, the rest only count down its clocks
+            u32 clocks = 1;
+            while(!cpu.tick()) {
+                clocks++;
+            }
+
+            std::ostringstream diff;
+            compare_state(*final, diff);
+
+            if(clocks != cycles->items.size() * 4) {
+                diff << " cycles: got " << clocks / 4 << " want " << cycles->items.size() << ";";
+            } else if(compare_cycles) {
+                compare_accesses(*cycles, diff);
+            }
+
+            unload(*initial);
+            return diff.str();
+        }
+
+    private:
+        cpu_state_t &regs() { return state->cpu; }
+
+        void         load(json_t const &initial) {
+            cpu_state_t &r = regs();
+            r.inst_clocks  = 0;
+            r.is_halted    = false;
+            r.is_stopped   = false;
+            r.halt_bug     = false;
+
+            for(auto const &[name, value]: initial.members) {
+                if(value.kind == json_t::Array) {
+                    continue;
+                }
+                if(u8 *reg = reg8(name)) {
+                    *reg = value.as_u32();
+                } else if(name == "pc") {
+                    r.PC = value.as_u32();
+                } else if(name == "sp") {
+                    r.SP = value.as_u32();
+                } else if(name == "ime") {
+                    r.IME = value.as_u32();
+                } else if(name == "ie") {
+                    mem.registers.IE = value.as_u32();
+                }
+            }
+            r.ei_ime_enable = initial.get("ei") && initial.get("ei")->as_u32();
+            mem.registers.IF = 0;
+
+            if(auto ram = initial.get("ram")) {
+                for(auto const &cell: ram->items) {
+                    flat->ram[cell.items[0].as_u32() & 0xFFFF] = cell.items[1].as_u32();
+                }
+            }
+        }
+
+        // put the RAM back to all zeroes without clearing the whole 64KB for every test
+        void unload(json_t const &initial) {
+            if(auto ram = initial.get("ram")) {
+                for(auto const &cell: ram->items) {
+                    flat->ram[cell.items[0].as_u32() & 0xFFFF] = 0;
+                }
+            }
+            for(auto const &access: flat->log) {
+                flat->ram[access.addr] = 0;
+            }
+        }
+
+        u8 *reg8(std::string const &name) {
+            cpu_state_t &r = regs();
+            if(name.size() != 1) {
+                return nullptr;
+            }
+            switch(name[0]) {
+            case 'a': return &r.AF.b_AF.A;
+            case 'f': return &r.AF.b_AF.F;
+            case 'b': return &r.BC.b_BC.B;
+            case 'c': return &r.BC.b_BC.C;
+            case 'd': return &r.DE.b_DE.D;
+            case 'e': return &r.DE.b_DE.E;
+            case 'h': return &r.HL.b_HL.H;
+            case 'l': return &r.HL.b_HL.L;
+            default:  return nullptr;
+            }
+        }
+
+        void compare_state(json_t const &final, std::ostringstream &diff) {
+            cpu_state_t &r     = regs();
+            auto         check = [&](const char *name, u32 got, u32 want) {
+                if(got != want) {
+                    diff << " " << name << ": got " << std::hex << got << " want " << want << std::dec << ";";
+                }
+            };
+
+            for(auto const &[name, value]: final.members) {
+                if(u8 *reg = reg8(name)) {
+                    check(name.c_str(), *reg, value.as_u32());
+                } else if(name == "pc") {
+                    check("pc", r.PC, value.as_u32());
+                } else if(name == "sp") {
+                    check("sp", r.SP, value.as_u32());
+                } else if(name == "ime") {
+                    check("ime", r.IME, value.as_u32());
+                } else if(name == "ei") {
+                    check("ei", r.ei_ime_enable, value.as_u32());
+                } else if(name == "ram") {
+                    for(auto const &cell: value.items) {
+                        u16  addr = cell.items[0].as_u32();
+                        char label[16];
+                        snprintf(label, sizeof(label), "[%04x]", addr);
+                        check(label, flat->ram[addr], cell.items[1].as_u32());
+                    }
+                }
+            }
+        }
+
+        // each cycle is [addr, data, "rwm"], internal cycles have no access or are null altogether
+        void compare_accesses(json_t const &cycles, std::ostringstream &diff) {
+            size_t next = 0;
+            for(auto const &cycle: cycles.items) {
+                if(cycle.kind != json_t::Array || cycle.items.size() < 3 || cycle.items[2].string.size() < 2) {
+                    continue;
+                }
+
+                std::string const &kind = cycle.items[2].string;
+                bool               read = kind[0] == 'r', write = kind[1] == 'w';
+                if(!read && !write) {
+                    continue;
+                }
+
+                u16 addr = cycle.items[0].as_u32();
+                u8  data = cycle.items[1].as_u32();
+                if(next >= flat->log.size()) {
+                    diff << " bus: missing " << (write ? "write " : "read ") << std::hex << addr << std::dec << ";";
+                    return;
+                }
+
+                auto const &access = flat->log[next++];
+                if(access.write != write || access.addr != addr || access.data != data) {
+                    diff << " bus " << next - 1 << ": got " << (access.write ? "write " : "read ") << std::hex
+                         << access.addr << "=" << (u32)access.data << " want " << (write ? "write " : "read ") << addr
+                         << "=" << (u32)data << std::dec << ";";
+                    return;
+                }
+            }
+            if(next < flat->log.size()) {
+                diff << " bus: " << flat->log.size() - next << " extra accesses;";
+            }
+        }
+
+        std::unique_ptr<machine_state_t> state;
+        std::unique_ptr<flat_bus_t>      flat;
+        BreakpointSet                    breakpoints;
+        Memory                           mem;
+        Joypad                           joy;
+        IO_Bus                           io;
+        CPU                              cpu;
+    };
+
+    void run_file(std::string const &path, file_result_t &result, size_t max_diffs, bool compare_cycles) {
+        result.name = fs::path(path).stem().string();
+
+        std::ifstream in(path, std::ios::binary);
+        if(!in) {
+            result.error = "failed to open";
+            return;
+        }
+        std::stringstream contents;
+        contents << in.rdbuf();
+        std::string text = contents.str();
+
+        json_t      tests;
+        JsonParser  parser(text);
+        if(!parser.parse(tests) || tests.kind != json_t::Array) {
+            result.error = "malformed JSON near offset " + std::to_string(parser.offset());
+            return;
+        }
+
+        Machine machine;
+        for(auto const &test: tests.items) {
+            std::string diff = machine.run(test, compare_cycles);
+            result.total++;
+            if(diff.empty()) {
+                continue;
+            }
+
+            result.failed++;
+            if(result.diffs.size() < max_diffs) {
+                auto name = test.get("name");
+                result.diffs.push_back((name ? name->string : "?") + ":" + diff);
+            }
+        }
+    }
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> paths;
+    size_t                   max_diffs      = 3;
+    bool                     compare_cycles = true;
+    unsigned                 jobs           = std::max(1u, std::thread::hardware_concurrency());
+
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-j") && i + 1 < argc) {
+            jobs = std::max(1l, strtol(argv[++i], nullptr, 10));
+        } else if(!strcmp(argv[i], "--diffs") && i + 1 < argc) {
+            max_diffs = strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--no-cycles")) {
+            compare_cycles = false;
+        } else if(argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else if(std::error_code ec; fs::is_directory(argv[i], ec)) {
+            for(auto const &entry: fs::directory_iterator(argv[i], ec)) {
+                if(entry.is_regular_file() && entry.path().extension() == ".json") {
+                    paths.push_back(entry.path().string());
+                }
+            }
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+
+    if(paths.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::sort(paths.begin(), paths.end());
+
+    // invalid opcodes log as fatal, anything below that is noise here
+    Silver::getLogger().setLogLevel(Silver::Logger::LogLevel::Fatal);
+
+    std::vector<file_result_t> results(paths.size());
+    std::atomic<size_t>        next = 0;
+    std::vector<std::thread>   workers;
+    auto                       start = std::chrono::steady_clock::now();
+    for(unsigned t = 0; t < std::min<size_t>(jobs, paths.size()); t++) {
+        workers.emplace_back([&]() {
+            for(size_t i; (i = next.fetch_add(1)) < paths.size();) {
+                run_file(paths[i], results[i], max_diffs, compare_cycles);
+            }
+        });
+    }
+    for(auto &worker: workers) {
+        worker.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t tests = 0, failed = 0, failed_files = 0;
+    for(auto const &result: results) {
+        tests  += result.total;
+        failed += result.failed;
+        if(!result.error.empty()) {
+            failed_files++;
+            printf("ERROR %s: %s\n", result.name.c_str(), result.error.c_str());
+        } else if(result.failed) {
+            failed_files++;
+            printf("FAIL  %s: %zu/%zu failed\n", result.name.c_str(), result.failed, result.total);
+            for(auto const &diff: result.diffs) {
+                printf("      %s\n", diff.c_str());
+            }
+        }
+    }
+
+    printf("%zu/%zu opcodes passed, %zu/%zu tests passed in %.2f s\n",
+           results.size() - failed_files,
+           results.size(),
+           tests - failed,
+           tests,
+           secs);
+    return failed_files ? 2 : 0;
+}
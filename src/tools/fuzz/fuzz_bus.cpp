@@ -0,0 +1,47 @@
+#include <cstddef>
+
+#include "gb_core/core.hpp"
+
+#include "fuzz_rom.hpp"
+
+/**
+ * Drive the bus directly: after the ROM config, every 4 bytes are one command. This reaches the MBC registers, IO
+ * registers and HDMA sources with values a CPU running fuzzed code would take a long time to line up.
+ *
+ *   op & 3 == 0: write value to addr
+ *   op & 3 == 1: read addr
+ *   op & 3 == 2: run value + 1 clocks
+ *   op & 3 == 3: run value + 1 instructions
+ */
+extern "C" int LLVMFuzzerInitialize(int *, char ***) {
+    fuzz::quiet_logs();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const u8 *data, size_t size) {
+    // the commands double as the ROM's code
+    auto         config = fuzz::make_rom(data, size);
+    Silver::Core core(fuzz::open_rom(config), std::nullopt, config.device);
+
+    for(size_t i = fuzz::config_size; i + 4 <= size; i += 4) {
+        u8  op    = data[i];
+        u16 addr  = data[i + 1] | data[i + 2] << 8;
+        u8  value = data[i + 3];
+
+        switch(op & 3) {
+        case 0: core.setByteInIO(addr, value); break;
+        case 1: core.getByteFromIO(addr); break;
+        case 2:
+            for(int n = 0; n <= value; n++) {
+                core.tick_once();
+            }
+            break;
+        case 3:
+            for(int n = 0; n <= value; n++) {
+                core.tick_instr();
+            }
+            break;
+        }
+    }
+    return 0;
+}
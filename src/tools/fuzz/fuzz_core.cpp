@@ -0,0 +1,24 @@
+#include <cstddef>
+
+#include "gb_core/core.hpp"
+
+#include "fuzz_rom.hpp"
+
+/**
+ * Boot a core on a fuzzed ROM and run a few frames. Crashes show up through ASAN, runaway frames through libFuzzer's
+ * -timeout.
+ */
+extern "C" int LLVMFuzzerInitialize(int *, char ***) {
+    fuzz::quiet_logs();
+    return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const u8 *data, size_t size) {
+    auto         config = fuzz::make_rom(data, size);
+    Silver::Core core(fuzz::open_rom(config), std::nullopt, config.device);
+
+    for(int i = 0; i < 4; i++) {
+        core.tick_frame();
+    }
+    return 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "gb_core/cart.hpp"
+
+#include "util/file.hpp"
+#include "util/log.hpp"
+#include "util/types/primitives.hpp"
+
+/**
+ * Shared by the fuzz entry points: turns fuzzer bytes into a cartridge the core will accept.
+ *
+ * The first config_size bytes pick the mapper, ROM and RAM sizes and the device, so the fuzzer never wastes time on
+ * headers the cartridge code refuses outright (unsupported mappers assert). Battery-backed types are left out, they
+ * would load and save .sav files next to the ROM.
+ */
+namespace fuzz {
+    constexpr size_t config_size = 4;
+
+    constexpr u8     cart_types[] = {
+            0x00, // ROM ONLY
+            0x08, // ROM+RAM
+            0x01, // MBC1
+            0x02, // MBC1+RAM
+            0x11, // MBC3
+            0x12, // MBC3+RAM
+            0x19, // MBC5
+            0x1A, // MBC5+RAM
+            0x1C, // MBC5+RUMBLE
+            0x1D, // MBC5+RUMBLE+RAM
+    };
+
+    struct config_t {
+        gb_device_t     device;
+        std::vector<u8> rom;
+    };
+
+    /**
+     * Build a ROM from `data`, the bytes after the config are laid out from the entry point on and repeated to fill the
+     * rest of the ROM
+     */
+    inline config_t make_rom(const u8 *data, size_t size) {
+        u8 config[config_size] = {};
+        std::copy_n(data, std::min(size, config_size), config);
+        data += std::min(size, config_size);
+        size -= std::min(size, config_size);
+
+        u8       rom_size_code = config[1] & 0x3; // 32KB to 256KB keeps every iteration cheap
+        config_t out;
+        out.device = (config[3] & 1) ? device_GBC : device_GB;
+        out.rom.resize(Cartridge_Constants::ROM_SZ_32K << rom_size_code);
+
+        for(size_t i = 0; size && i < out.rom.size() - 0x100; i++) {
+            out.rom[0x100 + i] = data[i % size];
+        }
+
+        out.rom[Cartridge_Constants::CART_TYPE_OFFSET] = cart_types[config[0] % std::size(cart_types)];
+        out.rom[Cartridge_Constants::ROM_SIZE_OFFSET]  = rom_size_code;
+        out.rom[Cartridge_Constants::RAM_SIZE_OFFSET]  = config[2] % 6;
+        out.rom[Cartridge_Constants::CGB_FLAG]         = config[3] & 0x80;
+        return out;
+    }
+
+    inline std::shared_ptr<Silver::File> open_rom(config_t const &config) {
+        return std::shared_ptr<Silver::File>(Silver::File::fromBuffer("fuzz.gb", config.rom));
+    }
+
+    /**
+     * Call from LLVMFuzzerInitialize, malformed ROMs log on nearly every access
+     */
+    inline void quiet_logs() { Silver::getLogger().setLogLevel(Silver::Logger::LogLevel::Fatal); }
+} // namespace fuzz
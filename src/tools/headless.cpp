@@ -0,0 +1,398 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#define dup  _dup
+#define dup2 _dup2
+#else
+#include <unistd.h>
+#endif
+
+#include "gb_core/capture.hpp"
+#include "gb_core/core.hpp"
+#include "gb_core/cpu_disassem.hpp"
+#include "gb_core/screenshot.hpp"
+
+#include "util/file.hpp"
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [options] rom\n", argv0);
+    fprintf(stderr, "  runs a ROM with no UI, optionally recording its video and audio\n");
+    fprintf(stderr, "  -n frames     number of frames to run (default 600)\n");
+    fprintf(stderr, "  --dmg         run as a DMG instead of a CGB\n");
+    fprintf(stderr, "  --perf file   write per-frame performance counters to `file` as CSV\n");
+    fprintf(stderr, "  --hashes file write each frame's hash to `file`, one per line\n");
+    fprintf(stderr, "  --verify file compare each frame's hash against a file written by --hashes\n");
+    fprintf(stderr, "  --lockstep instr|frame\n");
+    fprintf(stderr, "                run a second core on the accurate path next to the fast one and stop at the\n");
+    fprintf(stderr, "                first divergence, checking registers every instruction and everything else\n");
+    fprintf(stderr, "                every frame, or everything once per frame\n");
+    fprintf(stderr, "  --window n    instructions of trace to show from each core on a divergence (default 16)\n");
+    fprintf(stderr, "  --video file  record the frames to `file` as Y4M\n");
+    fprintf(stderr, "  --video-raw file|-|fd:n\n");
+    fprintf(stderr, "                write the frames as raw 160x144 RGBA to `file`, stdout or an inherited\n");
+    fprintf(stderr, "                descriptor, for piping into an encoder\n");
+    fprintf(stderr, "  --wav file    record the audio to `file` as mono float WAV\n");
+    fprintf(stderr, "  --screenshot prefix\n");
+    fprintf(stderr, "                save the last frame as `prefix`_<frame>.png\n");
+    fprintf(stderr, "  --dump first,count\n");
+    fprintf(stderr, "                save `count` frames from frame `first` instead, with --screenshot's prefix\n");
+    fprintf(stderr, "  --debug-views save the BG map and tile data next to each frame\n");
+}
+
+static void write_perf_header(FILE *f) {
+    fprintf(f, "frame,cpu_ns,ppu_ns,apu_ns,instructions,dma_bytes,lines_rendered");
+    for(int i = 0; i < MEM_REGION_COUNT; i++) {
+        fprintf(f, ",reads_%s,writes_%s", mem_region_names[i], mem_region_names[i]);
+    }
+    fprintf(f, "\n");
+}
+
+static void write_perf_row(FILE *f, perf_counters_t const &c) {
+    fprintf(f,
+            "%llu,%llu,%llu,%llu,%llu,%llu,%llu",
+            (unsigned long long)c.frames,
+            (unsigned long long)c.cpu_ns,
+            (unsigned long long)c.ppu_ns,
+            (unsigned long long)c.apu_ns,
+            (unsigned long long)c.instructions,
+            (unsigned long long)c.dma_bytes,
+            (unsigned long long)c.lines_rendered);
+    for(int i = 0; i < MEM_REGION_COUNT; i++) {
+        fprintf(f, ",%llu,%llu", (unsigned long long)c.mem_reads[i], (unsigned long long)c.mem_writes[i]);
+    }
+    fprintf(f, "\n");
+}
+
+enum lockstep_t { LOCKSTEP_OFF, LOCKSTEP_INSTR, LOCKSTEP_FRAME };
+
+/**
+ * Name the region of `state` a byte offset falls in. The offsets are taken from the instance, machine_state_t isn't
+ * standard-layout so offsetof isn't guaranteed to work on it
+ * @return the region's name, `offset` is made relative to its start
+ */
+static const char *state_region(machine_state_t const &state, size_t &offset) {
+    auto start = [&](auto const &region) {
+        return size_t(reinterpret_cast<const u8 *>(&region) - state.bytes().data());
+    };
+    const struct {
+        size_t      start;
+        const char *name;
+    } regions[] = {
+            {start(state.cart_ram), "cart ram"},
+            {start(state.ppu_ram), "vram"},
+            {start(state.work_ram), "wram"},
+            {start(state.oam_ram), "oam"},
+            {start(state.high_ram), "hram"},
+            {start(state.mbc), "mbc"},
+            {start(state.joypad), "joypad"},
+            {start(state.apu), "apu"},
+            {start(state.ppu), "ppu"},
+            {start(state.bus), "timers/dma"},
+            {start(state.io), "io registers"},
+            {start(state.cpu), "cpu"},
+    };
+
+    for(auto const &region: regions) {
+        if(offset >= region.start) {
+            offset -= region.start;
+            return region.name;
+        }
+    }
+    return "?";
+}
+
+/**
+ * Compare the two cores, registers only or the whole machine state
+ * @return a description of the first difference, empty if they match
+ */
+static std::string compare_cores(Silver::Core &fast, Silver::Core &accurate, bool everything) {
+    char what[128];
+
+    auto a = fast.getRegistersFromCPU(), b = accurate.getRegistersFromCPU();
+    if(memcmp(&a, &b, sizeof(a))) {
+        snprintf(what, sizeof(what),
+                 "registers AF=%04X/%04X BC=%04X/%04X DE=%04X/%04X HL=%04X/%04X SP=%04X/%04X PC=%04X/%04X",
+                 a.AF, b.AF, a.BC, b.BC, a.DE, b.DE, a.HL, b.HL, a.SP, b.SP, a.PC, b.PC);
+        return what;
+    }
+
+    auto io_a    = fast.getregistersfromIO(), io_b = accurate.getregistersfromIO();
+    auto bytes_a = reinterpret_cast<const u8 *>(&io_a), bytes_b = reinterpret_cast<const u8 *>(&io_b);
+    for(size_t i = 0; i < sizeof(io_a); i++) {
+        if(bytes_a[i] != bytes_b[i]) {
+            snprintf(what, sizeof(what), "io register byte %zu: %02X/%02X", i, bytes_a[i], bytes_b[i]);
+            return what;
+        }
+    }
+
+    if(everything && fast.getState().diff(accurate.getState())) {
+        auto        state_a = fast.getState().bytes(), state_b = accurate.getState().bytes();
+        size_t      first   = std::mismatch(state_a.begin(), state_a.end(), state_b.begin()).first - state_a.begin();
+        size_t      offset  = first;
+        const char *region  = state_region(fast.getState(), offset);
+        snprintf(what, sizeof(what), "%s byte 0x%zX: %02X/%02X", region, offset, state_a[first], state_b[first]);
+        return what;
+    }
+
+    return {};
+}
+
+static void print_trace_window(const char *label, Silver::Core &core, size_t window) {
+    std::vector<trace_entry_t> entries;
+    core.getTrace()->snapshot(entries);
+
+    printf("%s, last %zu instructions:\n", label, std::min(window, entries.size()));
+    for(size_t i = entries.size() > window ? entries.size() - window : 0; i < entries.size(); i++) {
+        trace_entry_t const &e = entries[i];
+
+        char op[32];
+        disassemble(e.PC, e.bytes, op, sizeof(op));
+        printf("  %12llu  %02X:%04X  %-22s AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X%s\n",
+               (unsigned long long)e.clock, e.bank, e.PC, op, e.AF, e.BC, e.DE, e.HL, e.SP,
+               e.flags & TRACE_FLAG_INTERRUPT ? " (interrupt)" : "");
+    }
+}
+
+int main(int argc, char **argv) {
+    const char                  *rom_path     = nullptr;
+    const char                  *perf_path    = nullptr;
+    const char                  *hashes_path  = nullptr;
+    const char                  *verify_path  = nullptr;
+    const char                  *video_path   = nullptr;
+    const char                  *wav_path     = nullptr;
+    Silver::Capture::VideoFormat video_format = Silver::Capture::VideoFormat::Y4M;
+    const char                  *shots_prefix = nullptr;
+    long                         shots_first  = -1; // the last frame
+    u32                          shots_count  = 1;
+    u8                           shots_views  = Silver::Screenshots::Screen;
+    long                         frames       = 600;
+    gb_device_t                  device       = device_GBC;
+    lockstep_t                   lockstep     = LOCKSTEP_OFF;
+    size_t                       window       = 16;
+
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+            frames = strtol(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--dmg")) {
+            device = device_GB;
+        } else if(!strcmp(argv[i], "--perf") && i + 1 < argc) {
+            perf_path = argv[++i];
+        } else if(!strcmp(argv[i], "--hashes") && i + 1 < argc) {
+            hashes_path = argv[++i];
+        } else if(!strcmp(argv[i], "--verify") && i + 1 < argc) {
+            verify_path = argv[++i];
+        } else if(!strcmp(argv[i], "--lockstep") && i + 1 < argc) {
+            i++;
+            if(!strcmp(argv[i], "instr")) {
+                lockstep = LOCKSTEP_INSTR;
+            } else if(!strcmp(argv[i], "frame")) {
+                lockstep = LOCKSTEP_FRAME;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else if(!strcmp(argv[i], "--window") && i + 1 < argc) {
+            window = strtoul(argv[++i], nullptr, 10);
+        } else if(!strcmp(argv[i], "--video") && i + 1 < argc) {
+            video_path   = argv[++i];
+            video_format = Silver::Capture::VideoFormat::Y4M;
+        } else if(!strcmp(argv[i], "--video-raw") && i + 1 < argc) {
+            video_path   = argv[++i];
+            video_format = Silver::Capture::VideoFormat::Raw;
+        } else if(!strcmp(argv[i], "--wav") && i + 1 < argc) {
+            wav_path = argv[++i];
+        } else if(!strcmp(argv[i], "--screenshot") && i + 1 < argc) {
+            shots_prefix = argv[++i];
+        } else if(!strcmp(argv[i], "--dump") && i + 1 < argc) {
+            char *end;
+            shots_first = strtol(argv[++i], &end, 10);
+            shots_count = *end == ',' ? strtoul(end + 1, nullptr, 10) : 1;
+        } else if(!strcmp(argv[i], "--debug-views")) {
+            shots_views |= Silver::Screenshots::BGMap | Silver::Screenshots::Tiles;
+        } else if(argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            rom_path = argv[i];
+        }
+    }
+
+    if(!rom_path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    auto rom = std::shared_ptr<Silver::File>(Silver::File::openReadOnly(rom_path));
+    if(!rom) {
+        fprintf(stderr, "%s: failed to open\n", rom_path);
+        return 1;
+    }
+
+    FILE *perf_file = nullptr;
+    if(perf_path) {
+        if(!perf_counters_enabled) {
+            fprintf(stderr, "performance counters are compiled out of this build, --perf ignored\n");
+        } else if(!(perf_file = fopen(perf_path, "w"))) {
+            fprintf(stderr, "%s: failed to open\n", perf_path);
+            return 1;
+        } else {
+            write_perf_header(perf_file);
+        }
+    }
+
+    FILE *hashes_file = nullptr;
+    if(hashes_path && !(hashes_file = fopen(hashes_path, "w"))) {
+        fprintf(stderr, "%s: failed to open\n", hashes_path);
+        return 1;
+    }
+
+    FILE *verify_file = nullptr;
+    if(verify_path && !(verify_file = fopen(verify_path, "r"))) {
+        fprintf(stderr, "%s: failed to open\n", verify_path);
+        return 1;
+    }
+
+    // the log writes to stdout, move it onto stderr and keep the real stdout for the frames
+    char stdout_video[16];
+    if(video_path && !strcmp(video_path, "-")) {
+        fflush(stdout);
+        snprintf(stdout_video, sizeof(stdout_video), "fd:%d", dup(fileno(stdout)));
+        dup2(fileno(stderr), fileno(stdout));
+        video_path = stdout_video;
+    }
+
+    Silver::Core core(rom, std::nullopt, device);
+
+    // an encoder that exits early should show up as a failed write, not kill the run
+#if !defined(_WIN32)
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    Silver::Capture capture;
+    if(video_path || wav_path) {
+        if(!capture.start(video_path, video_format, wav_path, Silver::Core::audio_sample_rate)) {
+            return 1;
+        }
+        core.setCapture(&capture);
+    }
+
+    std::unique_ptr<Silver::Screenshots> shots;
+    if(shots_prefix) {
+        shots = std::make_unique<Silver::Screenshots>(shots_prefix);
+        if(shots_first < 0) {
+            shots_first = frames - 1;
+        }
+    }
+
+    // the reference for --lockstep, both keep a trace to show what led up to a divergence
+    std::unique_ptr<Silver::Core> accurate;
+    if(lockstep != LOCKSTEP_OFF) {
+        accurate = std::make_unique<Silver::Core>(rom, std::nullopt, device);
+        accurate->setExecPath(Silver::Core::ExecPath::Accurate);
+        // with room to spare, a snapshot can drop the oldest entries
+        core.setTracingEnabled(true, window * 2 + 1);
+        accurate->setTracingEnabled(true, window * 2 + 1);
+    }
+
+    long         mismatch = -1, ran = 0;
+    bool         diverged = false;
+    u64          instrs   = 0;
+    auto         start    = std::chrono::steady_clock::now();
+    for(long i = 0; i < frames && !diverged; i++, ran++) {
+        std::string divergence;
+        if(shots && i == shots_first) {
+            shots->request(shots_count, shots_views);
+        }
+
+        if(lockstep == LOCKSTEP_INSTR) {
+            do {
+                core.tick_instr();
+                accurate->tick_instr();
+                instrs++;
+                divergence = compare_cores(core, *accurate, false);
+            } while(divergence.empty() && !core.is_frame_ready());
+        } else {
+            core.tick_frame();
+            if(accurate) {
+                accurate->tick_frame();
+            }
+        }
+
+        if(shots) {
+            shots->frame(core);
+        }
+
+        if(accurate && divergence.empty()) {
+            divergence = compare_cores(core, *accurate, true);
+        }
+        if(!divergence.empty()) {
+            diverged = true;
+            if(lockstep == LOCKSTEP_INSTR) {
+                printf("diverged in frame %ld after %llu instructions: %s\n", i, (unsigned long long)instrs,
+                       divergence.c_str());
+            } else {
+                printf("diverged by the end of frame %ld: %s\n", i, divergence.c_str());
+            }
+            print_trace_window("fast", core, window);
+            print_trace_window("accurate", *accurate, window);
+        }
+
+        if(perf_file) {
+            write_perf_row(perf_file, core.getPerfCounters());
+        }
+
+        u64 hash = core.getFrameHash();
+        if(hashes_file) {
+            fprintf(hashes_file, "%016llx\n", (unsigned long long)hash);
+        }
+
+        unsigned long long expected;
+        if(verify_file && mismatch < 0 && fscanf(verify_file, "%llx", &expected) == 1 && expected != hash) {
+            mismatch = i;
+            fprintf(stderr, "frame %ld: hash %016llx, expected %016llx\n", i, (unsigned long long)hash, expected);
+        }
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    core.setCapture(nullptr);
+    capture.stop();
+
+    if(shots) {
+        shots->stop();
+    }
+
+    for(FILE *f: {perf_file, hashes_file, verify_file}) {
+        if(f) {
+            fclose(f);
+        }
+    }
+
+    printf("%ld frames in %.3f s, %.1f fps\n", ran, secs, secs > 0 ? ran / secs : 0.0);
+    printf("last frame hash %016llx\n", (unsigned long long)core.getFrameHash());
+    if(video_path || wav_path) {
+        auto stats = capture.stats();
+        printf("captured %llu frames (%llu dropped and repeated), %llu samples (%llu dropped)%s%s\n",
+               (unsigned long long)stats.frames_written, (unsigned long long)stats.frames_dropped,
+               (unsigned long long)stats.samples_written, (unsigned long long)stats.samples_dropped,
+               stats.video_failed ? ", video write failed" : "", stats.audio_failed ? ", audio write failed" : "");
+    }
+    if(shots) {
+        auto stats = shots->stats();
+        printf("saved %llu screenshots (%llu dropped, %llu failed)\n", (unsigned long long)stats.written,
+               (unsigned long long)stats.dropped, (unsigned long long)stats.failed);
+    }
+    if(diverged) {
+        return 3;
+    }
+    return mismatch < 0 ? 0 : 2;
+}
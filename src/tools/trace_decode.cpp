@@ -0,0 +1,56 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "gb_core/cpu_disassem.hpp"
+#include "gb_core/trace.hpp"
+
+static void usage(const char *argv0) {
+    fprintf(stderr, "usage: %s [-n last_count] trace.bin\n", argv0);
+    fprintf(stderr, "  decodes a trace written by TraceBuffer::dump() into one line per instruction\n");
+}
+
+int main(int argc, char **argv) {
+    const char *path = nullptr;
+    size_t      last = 0;
+
+    for(int i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-n") && i + 1 < argc) {
+            last = strtoull(argv[++i], nullptr, 10);
+        } else if(argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if(!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<trace_entry_t> entries;
+    if(!TraceBuffer::read_file(path, entries)) {
+        fprintf(stderr, "%s: not a readable trace file\n", path);
+        return 1;
+    }
+
+    size_t start = last && last < entries.size() ? entries.size() - last : 0;
+    for(size_t i = start; i < entries.size(); i++) {
+        trace_entry_t const &e = entries[i];
+
+        if(e.flags & TRACE_FLAG_INTERRUPT) {
+            printf("%12llu  -- interrupt --\n", (unsigned long long)e.clock);
+        }
+
+        char op[32];
+        disassemble(e.PC, e.bytes, op, sizeof(op));
+        printf("%12llu  %02X:%04X  %02X %02X %02X  %-22s AF=%04X BC=%04X DE=%04X HL=%04X SP=%04X\n",
+               (unsigned long long)e.clock, e.bank, e.PC, e.bytes[0], e.bytes[1], e.bytes[2], op, e.AF, e.BC,
+               e.DE, e.HL, e.SP);
+    }
+
+    return 0;
+}
@@ -5,12 +5,19 @@
 #include <utility>
 
 #include "util/log.hpp"
+#include "util/timeline.hpp"
 
 #include "portaudio.h"
 
+// created in init_audio(), the callback itself must not allocate
+Silver::Timeline::Track *audio_track = nullptr;
+
 int _audio_callback(
         const void *inputBuffer, void *outputBuffer, unsigned long nBufferFrames,
         const PaStreamCallbackTimeInfo *timeInfo, PaStreamCallbackFlags statusFlags, void *userData) {
+    Silver::Timeline::useTrack(audio_track);
+    TimelineSpan("_audio_callback");
+
     // NOTE: nBufferFrames is equal to
     //  buff_size / channel_count / sizeof(float)
     static_cast<Silver::Core *>(userData)->do_audio_callback((float *)outputBuffer, nBufferFrames);
@@ -27,6 +34,10 @@ Silver::AudioManager *Silver::AudioManager::init_audio(std::shared_ptr<Silver::C
         return nullptr;
     }
 
+    if(!audio_track) {
+        audio_track = Silver::Timeline::createTrack("audio");
+    }
+
     auto audio_manager       = new AudioManager();
     audio_manager->core      = std::move(core);
     audio_manager->audio_dev = nullptr;
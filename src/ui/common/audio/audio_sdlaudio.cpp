@@ -7,6 +7,7 @@
 #include "gb_core/core.hpp"
 
 #include "util/log.hpp"
+#include "util/timeline.hpp"
 
 SDL_AudioSpec desired = {
     .format   = SDL_AUDIO_F32,
@@ -20,7 +21,14 @@ struct SDLAudioManagerContext {
 };
 
 std::vector<u8> stream_buf;
+
+// created in init_audio(), the callback itself must not allocate
+Silver::Timeline::Track *audio_track = nullptr;
+
 extern "C" void _audio_callback(void *userdata, SDL_AudioStream *stream, int additional, int total) {
+    Silver::Timeline::useTrack(audio_track);
+    TimelineSpan("_audio_callback");
+
     auto core = static_cast<Silver::Core *>(userdata);
 
     if(stream_buf.max_size() < additional * 4) {
@@ -39,6 +47,10 @@ Silver::AudioManager::AudioManager() :
     audio_dev(nullptr) { }
 
 Silver::AudioManager *Silver::AudioManager::init_audio(std::shared_ptr<Silver::Core> core) {
+    if(!audio_track) {
+        audio_track = Silver::Timeline::createTrack("audio");
+    }
+
     auto audio_manager            = new AudioManager();
     audio_manager->core           = std::move(core);
     audio_manager->audio_dev      = new SDLAudioManagerContext {0, nullptr};
@@ -1,17 +1,60 @@
 #include "app.hpp"
 
 #include <argparse/argparse.hpp>
+#include <atomic>
 #include <chrono>
+#include <csignal>
+#include <fcntl.h>
 #include <memory>
 #include <optional>
+#include <unistd.h>
 
 #include "util/log.hpp"
+#include "util/timeline.hpp"
 
 #include "gui/gui.hpp"
 #include "gui/settings_window.hpp"
 #include "imgui_internal.h"
 #include "platform.hpp"
 
+#define TRACE_DUMP_PATH       "trace.bin"
+#define CRASH_TRACE_DUMP_PATH "crash_trace.bin"
+#define TIMELINE_DUMP_PATH    "timeline.json"
+#define CAPTURE_VIDEO_PATH    "capture.y4m"
+#define CAPTURE_AUDIO_PATH    "capture.wav"
+#define SCREENSHOT_PREFIX     "screenshot"
+#define FRAME_DUMP_FRAMES     60
+
+// what dumpTraceOnCrash writes and where, set up outside the handler since it can't open files or allocate
+static std::atomic<const TraceBuffer *> crash_trace    = nullptr;
+static int                              crash_trace_fd = -1;
+
+/**
+ * Point the crash dump at `trace`, opening the dump file the first time there is one
+ */
+static void armCrashTrace(const TraceBuffer *trace) {
+    if(trace && crash_trace_fd < 0) {
+        crash_trace_fd = open(CRASH_TRACE_DUMP_PATH, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if(crash_trace_fd < 0) {
+            LogError("App") << "Failed to open " << CRASH_TRACE_DUMP_PATH << ", crashes won't dump the trace";
+        }
+    }
+    crash_trace.store(trace, std::memory_order_release);
+}
+
+/**
+ * Save the instruction trace before going down, so whatever led up to the crash can be decoded with trace_decode
+ */
+static void dumpTraceOnCrash(int sig) {
+    const TraceBuffer *trace = crash_trace.load(std::memory_order_acquire);
+    if(trace && crash_trace_fd >= 0 && ftruncate(crash_trace_fd, 0) == 0 && lseek(crash_trace_fd, 0, SEEK_SET) == 0) {
+        trace->dump_to_fd(crash_trace_fd);
+    }
+
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+
 /**
  * Called as early as possible when the app starts
  * @param argc command-line argument array length
@@ -32,6 +75,15 @@ void Silver::Application::onInit(int argc, const char *argv[]) {
 
     program.add_argument("-e", "--emu-bios").help("use eumlated bios").default_value(false).implicit_value(true);
 
+    program.add_argument("-t", "--trace")
+            .help("record an instruction trace, dumped on breakpoints and crashes")
+            .default_value(false)
+            .implicit_value(true);
+
+    program.add_argument("-g", "--gdb")
+            .help("wait for a GDB remote debugger on a local TCP port or Unix socket path")
+            .default_value(std::string(""));
+
     /**
      * Argument Parsing
      */
@@ -44,6 +96,20 @@ void Silver::Application::onInit(int argc, const char *argv[]) {
     }
 
     Silver::getLogger().setLogLevel(program.get<std::string>("--log-level"));
+    Silver::Timeline::setThreadName("main");
+
+    this->app_state.debug.trace = program.get<bool>("--trace");
+    for(int sig: {SIGSEGV, SIGABRT, SIGFPE, SIGILL}) {
+        std::signal(sig, dumpTraceOnCrash);
+    }
+
+    auto gdb_address = program.get<std::string>("--gdb");
+    if(!gdb_address.empty()) {
+        this->gdb_stub = std::make_shared<Silver::GdbStub>();
+        if(!this->gdb_stub->listen(gdb_address)) {
+            this->gdb_stub.reset();
+        }
+    }
 
     this->config         = std::make_shared<Config>();
     this->binding        = std::make_shared<Binding::Tracker>();
@@ -66,7 +132,7 @@ void Silver::Application::makeMenuBar(Silver::Menu *menubar) {
     fileMenu.addItem<CallbackMenuItem>("Open file", [this](const CallbackMenuItem &, void *) {
         Platform::openFileDialog(
                 "Open Rom",
-                "Supported Roms:gb,gbc,bin;Gameboy ROM:gb;Gameboy Color ROM:gbc;bin",
+                "Supported Roms:gb,gbc,bin,gz,zip;Gameboy ROM:gb;Gameboy Color ROM:gbc;Compressed ROM:gz,zip;bin",
                 [this](const std::string &filepath) { this->onLoadRomFile(filepath); });
     });
 
@@ -96,6 +162,7 @@ void Silver::Application::makeMenuBar(Silver::Menu *menubar) {
             "Reset",
             [this](const CallbackMenuItem &, void *) {
                 // TODO: not sure this is safe
+                armCrashTrace(nullptr);
                 this->core = std::make_shared<Silver::Core>(
                         this->rom_file,
                         this->bootrom_file == nullptr ? std::nullopt : std::make_optional(this->bootrom_file));
@@ -106,6 +173,39 @@ void Silver::Application::makeMenuBar(Silver::Menu *menubar) {
             [this](const ToggleMenuItem &, bool new_state, void *) { this->app_state.game.running = !new_state; },
             nullptr,
             false);
+    emulationMenu.addItem<ToggleMenuItem>(
+            "Record Video",
+            [this](const ToggleMenuItem &, bool new_state, void *) {
+                if(new_state) {
+                    this->capture = std::make_shared<Silver::Capture>();
+                    if(!this->capture->start(CAPTURE_VIDEO_PATH, Silver::Capture::VideoFormat::Y4M,
+                                             CAPTURE_AUDIO_PATH, Silver::Core::audio_sample_rate)) {
+                        this->capture.reset();
+                    }
+                    return;
+                }
+
+                if(!this->capture) {
+                    return;
+                }
+                if(this->core) {
+                    this->core->setCapture(nullptr);
+                }
+                this->capture->stop();
+
+                auto stats = this->capture->stats();
+                LogInfo("App") << "Recorded " << stats.frames_written << " frames to " << CAPTURE_VIDEO_PATH << " ("
+                               << stats.frames_dropped << " dropped) and " << stats.samples_written
+                               << " samples to " << CAPTURE_AUDIO_PATH << " (" << stats.samples_dropped
+                               << " dropped)";
+                this->capture.reset();
+            },
+            nullptr,
+            false);
+    emulationMenu.addItem<CallbackMenuItem>(
+            "Screenshot",
+            [this](const CallbackMenuItem &, void *) { this->requestScreenshots(1, Silver::Screenshots::Screen); },
+            nullptr);
     menubar->addItem<Silver::SubMenuItem>("Emulation", emulationMenu);
 
     /**
@@ -121,9 +221,52 @@ void Silver::Application::makeMenuBar(Silver::Menu *menubar) {
      */
     auto debugMenu = Menu();
     debugMenu.addItem<ToggleMenuItem>("Debug Mode", &this->app_state.debug.enabled);
+    debugMenu.addItem<ToggleMenuItem>("Instruction Trace", &this->app_state.debug.trace);
+    debugMenu.addItem<ToggleMenuItem>(
+            "Record Timeline",
+            [](const ToggleMenuItem &, bool new_state, void *) {
+                if(new_state) {
+                    Silver::Timeline::clear();
+                    Silver::Timeline::setEnabled(true);
+                    return;
+                }
+
+                Silver::Timeline::setEnabled(false);
+                if(Silver::Timeline::writeChromeTrace(TIMELINE_DUMP_PATH)) {
+                    LogInfo("App") << "Timeline written to " << TIMELINE_DUMP_PATH;
+                } else {
+                    LogError("App") << "Failed to write timeline to " << TIMELINE_DUMP_PATH;
+                }
+            },
+            nullptr,
+            false);
+    debugMenu.addItem<CallbackMenuItem>(
+            "Dump Frames",
+            [this](const CallbackMenuItem &, void *) {
+                this->requestScreenshots(
+                        FRAME_DUMP_FRAMES,
+                        Silver::Screenshots::Screen | Silver::Screenshots::BGMap | Silver::Screenshots::Tiles);
+            },
+            nullptr);
     menubar->addItem<Silver::SubMenuItem>("Debug", debugMenu);
 }
 
+void Silver::Application::requestScreenshots(u32 frames, u8 views) {
+    if(!this->core) {
+        return;
+    }
+    if(!this->screenshots) {
+        this->screenshots = std::make_shared<Silver::Screenshots>(SCREENSHOT_PREFIX);
+    }
+
+    this->screenshots->request(frames, views);
+    if(!this->app_state.game.running) {
+        // no frame is coming, take the one on screen
+        this->screenshots->frame(*this->core);
+    }
+    LogInfo("App") << "Saving " << frames << " frames as " << SCREENSHOT_PREFIX << "_<frame>.png";
+}
+
 void Silver::Application::onLoadRomFile(const std::string &filePath) {
     if(filePath.empty()) {
         return;
@@ -135,11 +278,12 @@ void Silver::Application::onLoadRomFile(const std::string &filePath) {
 
     if(this->rom_file != nullptr) {
         this->app_state.game.running = false;
+        armCrashTrace(nullptr);
         this->core.reset();
         this->rom_file.reset();
     }
 
-    auto file = Silver::File::openFile(filePath);
+    auto file = Silver::File::openReadOnly(filePath);
     if(file == nullptr) {
         LogError("App") << "Failed to open file: " << filePath;
         return;
@@ -179,7 +323,17 @@ float get_calc_fps() {
     return 1000000.0f / (float)rollingDeltaMicroseconds;
 }
 
+BreakReason Silver::Application::tickFrame() {
+    BreakReason reason = this->core->tick_frame();
+    if(this->screenshots && this->core->is_frame_ready()) {
+        this->screenshots->frame(*this->core);
+    }
+    return reason;
+}
+
 void Silver::Application::onUpdate() {
+    TimelineSpan("Application::onUpdate");
+
     float fps = get_calc_fps();
 
     // run periodic updates
@@ -196,13 +350,26 @@ void Silver::Application::onUpdate() {
         Joypad::button_states_t buttonsState {};
         binding->getButtonStates(buttonsState);
         this->core->set_input_state(buttonsState);
+        // the buffer may be replaced, don't leave the handler pointing at a freed one in between
+        armCrashTrace(nullptr);
+        this->core->setTracingEnabled(this->app_state.debug.trace);
+        armCrashTrace(this->core->getTrace());
+        // set every frame, Reset and loading a ROM replace the core
+        this->core->setCapture(this->capture.get());
+
+        if(this->gdb_stub && this->gdb_stub->isAttached()) {
+            // the debugger decides when the core runs
+            this->gdb_stub->service(*this->core);
+        } else if(this->app_state.game.running && this->tickFrame() != BreakReason::None) {
+            this->app_state.game.running = false;
 
-        try {
-            if(this->app_state.game.running) {
-                this->core->tick_frame();
+            if(this->core->getTrace()) {
+                if(this->core->getTrace()->dump(TRACE_DUMP_PATH)) {
+                    LogInfo("App") << "Instruction trace written to " << TRACE_DUMP_PATH;
+                } else {
+                    LogError("App") << "Failed to write instruction trace to " << TRACE_DUMP_PATH;
+                }
             }
-        } catch(breakpoint_exception &e) {
-            this->app_state.game.running = false;
         }
     }
 
@@ -214,7 +381,7 @@ void Silver::Application::onUpdate() {
     }
 
     if(this->app_state.ui.show_fps) {
-        buildFpsWindow(fps);
+        buildFpsWindow(fps, this->core.get());
     }
 
     if(this->app_state.debug.enabled) {
@@ -2,7 +2,10 @@
 
 #include <argparse/argparse.hpp>
 
+#include "gb_core/capture.hpp"
 #include "gb_core/core.hpp"
+#include "gb_core/gdb_stub.hpp"
+#include "gb_core/screenshot.hpp"
 
 #include "audio/audio.hpp"
 #include "binding.hpp"
@@ -23,6 +26,9 @@ namespace Silver {
         std::shared_ptr<Binding::Tracker> binding;
         std::shared_ptr<GamepadManager>   gamepadManager;
         std::shared_ptr<Silver::File>     rom_file, bootrom_file;
+        std::shared_ptr<Silver::GdbStub>  gdb_stub;
+        std::shared_ptr<Silver::Capture>  capture; // while Emulation > Record Video is on
+        std::shared_ptr<Screenshots>      screenshots;
 
         RecentFiles                       recent_files;
 
@@ -41,15 +47,21 @@ namespace Silver {
             struct {
                 bool enabled          = false;
                 bool drawToBackground = true;
+                bool trace            = false;
             } debug;
         } app_state;
 
-        void onInit(int argc, const char **argv);
-        void makeMenuBar(Silver::Menu *menubar);
-        void onLoadRomFile(const std::string &filePath);
-        void onLoadBootRomFile(const std::string &filePath);
-        void onUpdate();
-        void onClose();
+        void        onInit(int argc, const char **argv);
+        void        makeMenuBar(Silver::Menu *menubar);
+        void        onLoadRomFile(const std::string &filePath);
+        void        onLoadBootRomFile(const std::string &filePath);
+        /**
+         * Save the next `frames` frames as PNGs, see Screenshots. While paused the frame on screen is saved
+         */
+        void        requestScreenshots(u32 frames, u8 views);
+        BreakReason tickFrame();
+        void        onUpdate();
+        void        onClose();
     };
 
     Application *getApp();
@@ -1,6 +1,7 @@
 #include "gui.hpp"
 
 #include <cmath>
+#include <cstdlib>
 
 #include "imgui.h"
 
@@ -47,7 +48,7 @@ void buildScreenView(Silver::Application *app) {
     }
 }
 
-void buildFpsWindow(float fps) {
+void buildFpsWindow(float fps, Silver::Core *core) {
     namespace im = ImGui;
 
     im::PushStyleVar(ImGuiStyleVar_WindowRounding, 2.0f);
@@ -62,6 +63,26 @@ void buildFpsWindow(float fps) {
 
     im::Text("%0.1f", fps);
 
+    if(perf_counters_enabled && core) {
+        perf_counters_t counters = core->getPerfCounters();
+        u64             reads = 0, writes = 0;
+        for(int i = 0; i < MEM_REGION_COUNT; i++) {
+            reads  += counters.mem_reads[i];
+            writes += counters.mem_writes[i];
+        }
+
+        im::Text("CPU %5.2f ms", counters.cpu_ns / 1e6);
+        im::Text("PPU %5.2f ms", counters.ppu_ns / 1e6);
+        im::Text("APU %5.2f ms", counters.apu_ns / 1e6);
+        im::Text("instrs %llu", (unsigned long long)counters.instructions);
+        im::Text("reads %llu writes %llu", (unsigned long long)reads, (unsigned long long)writes);
+        im::Text("dma %llu B", (unsigned long long)counters.dma_bytes);
+        im::Text("lines %llu", (unsigned long long)counters.lines_rendered);
+        im::Text("audio %zu queued, %llu underflows",
+                 counters.audio_queue_fill,
+                 (unsigned long long)counters.audio_underflows);
+    }
+
     auto viewport_width = im::GetMainViewport()->Size.x;
     auto window_width   = im::GetWindowWidth();
 
@@ -499,13 +520,18 @@ void buildBreakpointWindow(Silver::Core *core) {
         InputText("##", buf, 5, ImGuiInputTextFlags_CallbackCharFilter, text_func);
         PopItemWidth();
 
+        u16  addr               = (u16)strtoul(buf, nullptr, 16);
         bool breakpoint_enabled = false;
-        if(core) {
-            breakpoint_enabled = core->get_bp_active();
+        if(core && buf[0] != '\0') {
+            breakpoint_enabled = core->getBreakpoints().has_breakpoint(addr);
         }
 
-        if(Checkbox("##", &breakpoint_enabled) && core) {
-            core->set_bp_active(breakpoint_enabled);
+        if(Checkbox("##", &breakpoint_enabled) && core && buf[0] != '\0') {
+            if(breakpoint_enabled) {
+                core->getBreakpoints().add_breakpoint(addr);
+            } else {
+                core->getBreakpoints().remove_breakpoint(addr);
+            }
         }
     }
     End();
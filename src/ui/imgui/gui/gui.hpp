@@ -12,7 +12,7 @@ namespace Silver {
 #define DMG_BIOS_CRC 0x59c8598e
 
 void buildScreenView(Silver::Application *app);
-void buildFpsWindow(float fps);
+void buildFpsWindow(float fps, Silver::Core *core);
 void buildDebugWindow(Silver::Application *app);
 void buildCPURegisterWindow(Silver::Core *core);
 void buildIORegisterWindow(Silver::Core *core);
@@ -23,6 +23,7 @@
 #include "gb_core/core.hpp"
 
 #include "util/log.hpp"
+#include "util/timeline.hpp"
 
 #include "binding.hpp"
 #include "imgui/backends/imgui_impl_opengl3.h"
@@ -302,6 +303,8 @@ u8   debug_buffer[256 * 256 * 3]                         = {0};
 
 // serves as our run-loop
 bool GtkApp::render(const Glib::RefPtr<Gdk::GLContext> & /* context */) {
+    TimelineSpan("GtkApp::render");
+
     try {
         this->gl_area->throw_if_error();
 
@@ -315,9 +318,12 @@ bool GtkApp::render(const Glib::RefPtr<Gdk::GLContext> & /* context */) {
 
         ImGui::NewFrame();
         this->app->onUpdate();
-        ImGui::Render();
+        {
+            TimelineSpan("ImGui::Render");
+            ImGui::Render();
 
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        }
 
         return true;
     } catch(const Gdk::GLError &gle) {
@@ -1,9 +1,42 @@
 #include "textures.hpp"
 
+#include <algorithm>
+#include <bit>
+
 #include <epoxy/gl.h>
 
 #include "gb_core/core.hpp"
 
+#include "util/timeline.hpp"
+
+/**
+ * Upload the 8 pixel tall rows of tiles flagged in `rows` from `pixels` into the bound texture, bit x of a row's mask
+ * is the x'th tile across. Only the span between the first and last changed tile of each row is sent.
+ */
+template<typename Mask>
+static void uploadChangedTileRows(Mask const *rows, int rowCount, Silver::Pixel const *pixels, int pitch) {
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, pitch);
+    for(int row = 0; row < rowCount; row++) {
+        if(!rows[row]) {
+            continue;
+        }
+
+        int first = std::countr_zero(rows[row]);
+        int last  = std::bit_width(rows[row]);
+        glTexSubImage2D(
+                GL_TEXTURE_2D,
+                0,
+                first * 8,
+                row * 8,
+                (last - first) * 8,
+                8,
+                GL_RGBA,
+                GL_UNSIGNED_BYTE,
+                &pixels[row * 8 * pitch + first * 8]);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
 struct ScreenTexture: public GenericTexture {
     ScreenTexture() {
         glGenTextures(1, &this->screen_texture);
@@ -24,33 +57,46 @@ struct ScreenTexture: public GenericTexture {
     SizeType getSize() override { return {Silver::Core::native_width, Silver::Core::native_height}; }
 
     void     update(GtkApp *gtkApp) override {
+        TimelineSpan("ScreenTexture::update");
+
         // core isn't guaranteed to exist here
         if(!gtkApp->app->core) {
             return;
         }
 
-        // this type and format must match the texture pixel format
-        Silver::PixelBufferEncoder<u8>::encodePixelBuffer<Silver::PixelFormat::RGB>(
-                screen_buffer, Silver::Core::native_pixel_count * 4, gtkApp->app->core->getPixelBuffer());
+        // only the lines that changed since the last upload, nothing at all for a repeated frame
+        auto const &core   = gtkApp->app->core;
+        auto        hashes = core->getLineHashes();
+        u32         first  = 0, last = Silver::Core::native_height;
+        while(first < last && hashes[first] == uploaded_hashes[first]) {
+            first++;
+        }
+        while(last > first && hashes[last - 1] == uploaded_hashes[last - 1]) {
+            last--;
+        }
+        if(first == last) {
+            return;
+        }
+        std::copy(hashes.begin(), hashes.end(), uploaded_hashes);
 
-        // draw screen to texture
+        // Pixel is laid out as RGBA bytes, the texture drops the alpha
         glBindTexture(GL_TEXTURE_2D, this->screen_texture);
         glTexSubImage2D(
                 GL_TEXTURE_2D,
                 0,
                 0,
-                0,
+                first,
                 Silver::Core::native_width,
-                Silver::Core::native_height,
-                GL_RGB,
+                last - first,
+                GL_RGBA,
                 GL_UNSIGNED_BYTE,
-                screen_buffer);
+                &core->getPixelBuffer()[first * Silver::Core::native_width]);
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
 private:
-    GLuint screen_texture                                      = 0;
-    u8     screen_buffer[Silver::Core::native_pixel_count * 4] = {0};
+    GLuint screen_texture                               = 0;
+    u64    uploaded_hashes[Silver::Core::native_height] = {0};
 };
 
 struct BackgroundDebugTexture: public GenericTexture {
@@ -63,8 +109,6 @@ struct BackgroundDebugTexture: public GenericTexture {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
         glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, 256, 256);
         glBindTexture(GL_TEXTURE_2D, 0);
-
-        pixelBuf.reserve(256 * 256);
     }
 
     void *getTextureId() override {
@@ -75,26 +119,24 @@ struct BackgroundDebugTexture: public GenericTexture {
     SizeType getSize() override { return {256, 256}; }
 
     void     update(GtkApp *gtkApp) override {
+        TimelineSpan("BackgroundDebugTexture::update");
+
         // core isn't guaranteed to exist here
         if(!gtkApp->app->core) {
             return;
         }
 
-        pixelBuf.clear();
-        gtkApp->app->core->getBGBuffer(pixelBuf);
-        Silver::PixelBufferEncoder<u8>::encodePixelBuffer<Silver::PixelFormat::RGB>(
-                debug_buffer, 256 * 256 * 3, pixelBuf);
+        using vram_view_t       = Silver::Core::vram_view_t;
+        vram_view_t const &view = gtkApp->app->core->getVRAMView();
 
-        // draw screen to texture
+        // only the map entries refreshVRAMView() redrew
         glBindTexture(GL_TEXTURE_2D, this->bg_debug_texture);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 256, GL_RGB, GL_UNSIGNED_BYTE, debug_buffer);
+        uploadChangedTileRows(view.changed_map_rows, vram_view_t::map_size / 8, view.map.data(), vram_view_t::map_size);
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
 private:
-    GLuint                     bg_debug_texture            = 0;
-    u8                         debug_buffer[256 * 256 * 3] = {0};
-    std::vector<Silver::Pixel> pixelBuf;
+    GLuint bg_debug_texture = 0;
 };
 
 struct VRAMTileDebugTexture: public GenericTexture {
@@ -108,8 +150,6 @@ struct VRAMTileDebugTexture: public GenericTexture {
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
         glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGB8, 128, 64);
         glBindTexture(GL_TEXTURE_2D, 0);
-
-        pixelBuf.reserve(128 * 64);
     }
 
     void *getTextureId() override {
@@ -120,29 +160,30 @@ struct VRAMTileDebugTexture: public GenericTexture {
     SizeType getSize() override { return {128, 64}; }
 
     void     update(GtkApp *gtkApp) override {
+        TimelineSpan("VRAMTileDebugTexture::update");
+
         // core isn't guaranteed to exist here
         if(!gtkApp->app->core) {
             return;
         }
 
-        pixelBuf.clear();
-        gtkApp->app->core->getVRAMBuffer(pixelBuf, sectionIdx, bank1);
-        Silver::PixelBufferEncoder<u8>::encodePixelBuffer<Silver::PixelFormat::RGB>(
-                debug_buffer, 128 * 64 * 3, pixelBuf);
+        using vram_view_t       = Silver::Core::vram_view_t;
+        vram_view_t const &view = gtkApp->app->core->getVRAMView();
+
+        // this section is 8 rows of 16 tiles out of the bank's atlas
+        int                  first = sectionIdx * 8;
+        Silver::Pixel const *atlas = view.tiles[bank1].data() + first * 8 * vram_view_t::tiles_width;
 
-        // draw screen to texture
         glBindTexture(GL_TEXTURE_2D, this->vram_debug_texture);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 128, 64, GL_RGB, GL_UNSIGNED_BYTE, debug_buffer);
+        uploadChangedTileRows(&view.changed_tile_rows[bank1][first], 8, atlas, vram_view_t::tiles_width);
         glBindTexture(GL_TEXTURE_2D, 0);
     }
 
 private:
-    u8                         sectionIdx;
-    bool                       bank1;
+    u8     sectionIdx;
+    bool   bank1;
 
-    GLuint                     vram_debug_texture         = 0;
-    u8                         debug_buffer[128 * 64 * 3] = {0};
-    std::vector<Silver::Pixel> pixelBuf;
+    GLuint vram_debug_texture = 0;
 };
 
 void buildTextures(GtkApp *gtkApp) {
@@ -162,7 +203,15 @@ void buildTextures(GtkApp *gtkApp) {
 }
 
 void updateTextures(GtkApp *gtkApp) {
+    TimelineSpan("updateTextures");
+
     gtkApp->screenTex->update(gtkApp);
+
+    // the debug views are only redrawn where VRAM changed, and not at all while nobody is looking at them
+    if(!gtkApp->app->app_state.debug.enabled || !gtkApp->app->core || !gtkApp->app->core->refreshVRAMView()) {
+        return;
+    }
+
     gtkApp->backgroundDebugTex->update(gtkApp);
 
     for(int i = 0; i < 3; i++) {
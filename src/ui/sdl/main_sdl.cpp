@@ -108,6 +108,7 @@ int main(int argc, char *argv[]) {
     u8                     *buf       = (u8 *)malloc(256 * 256 * 3);
 
     bool                    isRunning = true;
+    u64                     drawnHash = 0;
     SDL_Event               event;
     auto                    start  = std::chrono::steady_clock::now();
     int                     frames = 0;
@@ -147,13 +148,18 @@ int main(int argc, char *argv[]) {
             core->set_input_state(button_state);
             core->tick_frame();
 
-            void *screen_dest;
-            int   screen_pitch;
-            SDL_LockTexture(screen_texture, nullptr, &screen_dest, &screen_pitch);
-            Silver::PixelBufferEncoder<u8>::encodePixelBuffer<Silver::PixelFormat::RGB>(
-                    (u8 *)screen_dest, Silver::Core::native_pixel_count * 4, core->getPixelBuffer());
+            // the texture keeps the last frame, repeated frames don't need encoding again
+            if(core->getFrameHash() != drawnHash) {
+                drawnHash = core->getFrameHash();
 
-            SDL_UnlockTexture(screen_texture);
+                void *screen_dest;
+                int   screen_pitch;
+                SDL_LockTexture(screen_texture, nullptr, &screen_dest, &screen_pitch);
+                Silver::PixelBufferEncoder<u8>::encodePixelBuffer<Silver::PixelFormat::RGB>(
+                        (u8 *)screen_dest, Silver::Core::native_pixel_count * 4, core->getPixelBuffer());
+
+                SDL_UnlockTexture(screen_texture);
+            }
             SDL_RenderCopy(renderer_screen, screen_texture, nullptr, nullptr);
         }
 
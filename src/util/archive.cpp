@@ -0,0 +1,357 @@
+#include "archive.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <nowide/fstream.hpp>
+#include <zlib.h>
+
+#include "crc.hpp"
+#include "log.hpp"
+
+namespace Silver::Archive {
+    namespace {
+        constexpr u32    GZIP_MAGIC           = 0x00088B1F; // ID1, ID2, CM=deflate
+        constexpr u32    ZIP_LOCAL_HEADER_SIG = 0x04034B50;
+        constexpr u32    ZIP_CENTRAL_DIR_SIG  = 0x02014B50;
+        constexpr u32    ZIP_END_OF_DIR_SIG   = 0x06054B50;
+
+        constexpr u32    ZIP_LOCAL_HEADER_LEN = 30;
+        constexpr u32    ZIP_CENTRAL_DIR_LEN  = 46;
+        constexpr u32    ZIP_END_OF_DIR_LEN   = 22;
+        constexpr u32    ZIP_MAX_COMMENT_LEN  = 0xFFFF;
+
+        constexpr u16    ZIP_METHOD_STORED    = 0;
+        constexpr u16    ZIP_METHOD_DEFLATE   = 8;
+
+        // largest cartridge we know how to map is 8MiB, anything claiming more is a corrupt header
+        constexpr u32    MAX_ROM_SIZE         = 8 * 1024 * 1024;
+
+        constexpr size_t CHUNK_SIZE           = 16 * 1024;
+
+        __force_inline u16 le16(const u8 *p) { return (u16)(p[0] | (p[1] << 8)); }
+
+        __force_inline u32 le32(const u8 *p) {
+            return (u32)p[0] | ((u32)p[1] << 8) | ((u32)p[2] << 16) | ((u32)p[3] << 24);
+        }
+
+        bool readAt(nowide::ifstream &in, u64 offset, void *buf, size_t len) {
+            in.clear();
+            in.seekg((std::streamoff)offset, std::ios_base::beg);
+            in.read((char *)buf, (std::streamsize)len);
+            return (size_t)in.gcount() == len;
+        }
+
+        u64 streamSize(nowide::ifstream &in) {
+            in.clear();
+            in.seekg(0, std::ios_base::end);
+            return (u64)in.tellg();
+        }
+
+        bool hasRomExtension(std::string const &name) {
+            auto ext = name.find_last_of('.');
+            if(ext == std::string::npos) {
+                return false;
+            }
+
+            std::string e = name.substr(ext + 1);
+            std::transform(e.begin(), e.end(), e.begin(), [](unsigned char c) { return std::tolower(c); });
+            return e == "gb" || e == "gbc" || e == "sgb";
+        }
+
+        /**
+         * Feed compressed bytes from in (starting at offset, at most in_len bytes) through an already initialised
+         * z_stream until out is full or the stream ends
+         */
+        bool inflateInto(z_stream &zs, nowide::ifstream &in, u64 offset, u64 in_len, std::vector<u8> &out) {
+            u8  chunk[CHUNK_SIZE];
+            int ret      = Z_OK;
+
+            zs.next_out  = out.data();
+            zs.avail_out = (uInt)out.size();
+
+            in.clear();
+            in.seekg((std::streamoff)offset, std::ios_base::beg);
+
+            while(ret != Z_STREAM_END && in_len > 0) {
+                in.read((char *)chunk, (std::streamsize)std::min<u64>(CHUNK_SIZE, in_len));
+                auto got = (uInt)in.gcount();
+                if(got == 0) {
+                    break;
+                }
+                in_len -= got;
+
+                zs.next_in  = chunk;
+                zs.avail_in = got;
+
+                ret         = inflate(&zs, Z_NO_FLUSH);
+                if(ret != Z_OK && ret != Z_STREAM_END) {
+                    LogError("Archive") << "inflate failed: " << (zs.msg ? zs.msg : "unknown error");
+                    return false;
+                }
+
+                // the header lied about the size, refuse rather than grow the buffer
+                if(zs.avail_out == 0 && ret != Z_STREAM_END && zs.avail_in != 0) {
+                    LogError("Archive") << "inflated data larger than the archive header claims";
+                    return false;
+                }
+            }
+
+            if(ret != Z_STREAM_END) {
+                LogError("Archive") << "compressed stream truncated";
+                return false;
+            }
+
+            return zs.total_out == out.size();
+        }
+
+        bool extractGZip(std::string const &filename, nowide::ifstream &in, std::vector<u8> &out) {
+            u64 size = streamSize(in);
+            u8  trailer[4];
+
+            if(size < 18 || !readAt(in, size - 4, trailer, 4)) {
+                LogError("Archive") << filename << ": truncated gzip stream";
+                return false;
+            }
+
+            // ISIZE is the uncompressed length modulo 2^32, which is exact for anything we'd load
+            u32 isize = le32(trailer);
+            if(isize == 0 || isize > MAX_ROM_SIZE) {
+                LogError("Archive") << filename << ": implausible uncompressed size " << isize;
+                return false;
+            }
+
+            out.resize(isize);
+
+            z_stream zs {};
+            if(inflateInit2(&zs, 16 + MAX_WBITS) != Z_OK) {
+                return false;
+            }
+
+            bool ok = inflateInto(zs, in, 0, size, out);
+            inflateEnd(&zs);
+            return ok;
+        }
+
+        bool readZipDirectory(nowide::ifstream &in, std::vector<Entry> &entries) {
+            u64 size = streamSize(in);
+            if(size < ZIP_END_OF_DIR_LEN) {
+                return false;
+            }
+
+            // the end-of-central-directory record sits in the last 22 + comment bytes of the file
+            u64             tail_len = std::min<u64>(size, ZIP_END_OF_DIR_LEN + ZIP_MAX_COMMENT_LEN);
+            std::vector<u8> tail(tail_len);
+            if(!readAt(in, size - tail_len, tail.data(), tail_len)) {
+                return false;
+            }
+
+            const u8 *eocd = nullptr;
+            for(s64 i = (s64)tail_len - ZIP_END_OF_DIR_LEN; i >= 0; i--) {
+                if(le32(&tail[i]) == ZIP_END_OF_DIR_SIG) {
+                    eocd = &tail[i];
+                    break;
+                }
+            }
+
+            if(eocd == nullptr) {
+                return false;
+            }
+
+            u16             count   = le16(eocd + 10);
+            u32             cd_size = le32(eocd + 12);
+            u32             cd_off  = le32(eocd + 16);
+
+            std::vector<u8> cd(cd_size);
+            if(!readAt(in, cd_off, cd.data(), cd_size)) {
+                return false;
+            }
+
+            entries.reserve(count);
+            for(u32 pos = 0, i = 0; i < count; i++) {
+                if(pos + ZIP_CENTRAL_DIR_LEN > cd_size || le32(&cd[pos]) != ZIP_CENTRAL_DIR_SIG) {
+                    return false;
+                }
+
+                const u8 *h        = &cd[pos];
+                u16       name_len = le16(h + 28);
+                u16       xtra_len = le16(h + 30);
+                u16       cmnt_len = le16(h + 32);
+
+                if(pos + ZIP_CENTRAL_DIR_LEN + name_len > cd_size) {
+                    return false;
+                }
+
+                Entry e;
+                e.method              = le16(h + 10);
+                e.crc                 = le32(h + 16);
+                e.compressed_size     = le32(h + 20);
+                e.uncompressed_size   = le32(h + 24);
+                e.local_header_offset = le32(h + 42);
+                e.name.assign((const char *)h + ZIP_CENTRAL_DIR_LEN, name_len);
+                entries.push_back(e);
+
+                pos += ZIP_CENTRAL_DIR_LEN + name_len + xtra_len + cmnt_len;
+            }
+
+            return true;
+        }
+
+        bool extractZip(
+                std::string const &filename, nowide::ifstream &in, std::vector<u8> &out, std::string *entry_name) {
+            std::vector<Entry> entries;
+            if(!readZipDirectory(in, entries)) {
+                LogError("Archive") << filename << ": malformed zip central directory";
+                return false;
+            }
+
+            int idx = findRomEntry(entries);
+            if(idx < 0) {
+                LogError("Archive") << filename << ": no loadable entry";
+                return false;
+            }
+
+            Entry const &e = entries[idx];
+            if(e.uncompressed_size == 0 || e.uncompressed_size > MAX_ROM_SIZE) {
+                LogError("Archive") << filename << ": implausible uncompressed size " << e.uncompressed_size;
+                return false;
+            }
+
+            // the local header repeats name/extra with possibly different lengths, so skip by its own fields
+            u8 lh[ZIP_LOCAL_HEADER_LEN];
+            if(!readAt(in, e.local_header_offset, lh, ZIP_LOCAL_HEADER_LEN) || le32(lh) != ZIP_LOCAL_HEADER_SIG) {
+                LogError("Archive") << filename << ": bad local header for " << e.name;
+                return false;
+            }
+            u64 data_off = (u64)e.local_header_offset + ZIP_LOCAL_HEADER_LEN + le16(lh + 26) + le16(lh + 28);
+
+            out.resize(e.uncompressed_size);
+
+            bool ok = false;
+            if(e.method == ZIP_METHOD_STORED) {
+                ok = e.compressed_size == e.uncompressed_size && readAt(in, data_off, out.data(), out.size());
+            } else if(e.method == ZIP_METHOD_DEFLATE) {
+                z_stream zs {};
+                if(inflateInit2(&zs, -MAX_WBITS) != Z_OK) {
+                    return false;
+                }
+                ok = inflateInto(zs, in, data_off, e.compressed_size, out);
+                inflateEnd(&zs);
+            } else {
+                LogError("Archive") << filename << ": unsupported compression method " << e.method << " for "
+                                    << e.name;
+                return false;
+            }
+
+            if(!ok) {
+                LogError("Archive") << filename << ": failed to extract " << e.name;
+                return false;
+            }
+
+            // unlike gzip, raw deflate carries no checksum of its own
+            if(crc::update(crc::begin(), out.data(), out.size()) != e.crc) {
+                LogError("Archive") << filename << ": crc mismatch for " << e.name;
+                return false;
+            }
+
+            if(entry_name) {
+                *entry_name = e.name;
+            }
+            return true;
+        }
+    } // namespace
+
+    Format detectFormat(std::string const &filename) {
+        nowide::ifstream in(filename, nowide::ifstream::binary);
+        u8               magic[4];
+
+        if(!in || !readAt(in, 0, magic, 4)) {
+            return Format::None;
+        }
+
+        if((le32(magic) & 0x00FFFFFF) == GZIP_MAGIC) {
+            return Format::GZip;
+        }
+
+        if(le32(magic) == ZIP_LOCAL_HEADER_SIG) {
+            return Format::Zip;
+        }
+
+        return Format::None;
+    }
+
+    std::vector<Entry> listEntries(std::string const &filename) {
+        std::vector<Entry> entries;
+        nowide::ifstream   in(filename, nowide::ifstream::binary);
+
+        if(!in) {
+            return entries;
+        }
+
+        switch(detectFormat(filename)) {
+        case Format::Zip:
+            if(!readZipDirectory(in, entries)) {
+                entries.clear();
+            }
+            break;
+        case Format::GZip: {
+            u64 size = streamSize(in);
+            u8  trailer[8];
+            if(size >= 18 && readAt(in, size - 8, trailer, 8)) {
+                auto        slash = filename.find_last_of("/\\");
+                std::string name  = filename.substr(slash == std::string::npos ? 0 : slash + 1);
+                if(name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0) {
+                    name.erase(name.size() - 3);
+                }
+                entries.push_back({name, (u32)(size - 18), le32(trailer + 4), le32(trailer), 0, ZIP_METHOD_DEFLATE});
+            }
+            break;
+        }
+        case Format::None:
+            break;
+        }
+
+        return entries;
+    }
+
+    int findRomEntry(std::vector<Entry> const &entries) {
+        int first_file = -1;
+        for(int i = 0; i < (int)entries.size(); i++) {
+            auto const &name = entries[i].name;
+            if(name.empty() || name.back() == '/') {
+                continue; // directory
+            }
+
+            if(hasRomExtension(name)) {
+                return i;
+            }
+
+            if(first_file < 0) {
+                first_file = i;
+            }
+        }
+        return first_file;
+    }
+
+    bool extractRom(std::string const &filename, std::vector<u8> &out, std::string *entry_name) {
+        nowide::ifstream in(filename, nowide::ifstream::binary);
+        if(!in) {
+            LogError("Archive") << filename << " could not be opened";
+            return false;
+        }
+
+        switch(detectFormat(filename)) {
+        case Format::GZip:
+            if(entry_name) {
+                *entry_name = filename;
+            }
+            return extractGZip(filename, in, out);
+        case Format::Zip:
+            return extractZip(filename, in, out, entry_name);
+        case Format::None:
+            break;
+        }
+
+        LogError("Archive") << filename << " is not a supported archive";
+        return false;
+    }
+} // namespace Silver::Archive
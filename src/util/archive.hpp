@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "types/primitives.hpp"
+
+namespace Silver::Archive {
+    enum class Format {
+        None, // not an archive (or not one we understand)
+        GZip, // single-member .gz stream
+        Zip,  // PKZIP, stored or deflate entries only
+    };
+
+    struct Entry {
+        std::string name;
+        u32         compressed_size;
+        u32         uncompressed_size;
+        u32         crc;
+        u32         local_header_offset;
+        u16         method;
+    };
+
+    /**
+     * Sniff the archive format of a file from its magic bytes
+     */
+    Format             detectFormat(std::string const &filename);
+
+    /**
+     * List the entries of a zip archive (a .gz stream yields a single entry named after the file)
+     */
+    std::vector<Entry> listEntries(std::string const &filename);
+
+    /**
+     * Pick the entry that looks most like a ROM: the first .gb, .gbc or .sgb file, otherwise the first file
+     * @return index into entries, or -1 if there is nothing to load
+     */
+    int                findRomEntry(std::vector<Entry> const &entries);
+
+    /**
+     * Inflate the ROM contained in an archive straight into out.
+     * out is sized once from the archive header (gzip ISIZE trailer or zip central directory), no temp files are
+     * written and the compressed data is streamed through a fixed-size buffer.
+     * @param entry_name receives the name of the entry that was loaded, may be null
+     */
+    bool               extractRom(std::string const &filename, std::vector<u8> &out, std::string *entry_name = nullptr);
+} // namespace Silver::Archive
@@ -1,8 +1,12 @@
 #include "file.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <nowide/iostream.hpp>
 
+#include "archive.hpp"
 #include "crc.hpp"
+#include "log.hpp"
 #include "util.hpp"
 
 namespace Silver {
@@ -69,6 +73,28 @@ namespace Silver {
         }
     }
 
+    File *File::openReadOnly(std::string filename) {
+        if(Archive::detectFormat(filename) == Archive::Format::None) {
+            return openFile(filename);
+        }
+
+        std::vector<u8> data;
+        std::string     entry;
+        if(!Archive::extractRom(filename, data, &entry)) {
+            return nullptr;
+        }
+
+        LogInfo("File") << "inflated " << entry << " from " << filename << " (" << data.size() << " bytes)";
+        return fromBuffer(filename, std::move(data));
+    }
+
+    File *File::fromBuffer(std::string filename, std::vector<u8> data) {
+        auto ret        = new File(filename);
+        ret->mem_buffer = std::make_shared<const std::vector<u8>>(std::move(data));
+        ret->in_memory  = true;
+        return ret;
+    }
+
     bool File::fileExists(std::string filename) { return (bool)nowide::ifstream(filename); }
 
     u32  File::getCRC() {
@@ -89,28 +115,47 @@ namespace Silver {
     }
 
     u32 File::getSize() {
+        if(in_memory) {
+            return (u32)mem_buffer->size();
+        }
+
         file.seekg(0, std::ios_base::end);
         return (u32)file.tellg();
     }
 
     u8 File::getByte(u32 offset) {
+        if(in_memory) {
+            return offset < mem_buffer->size() ? (*mem_buffer)[offset] : 0xFF;
+        }
+
         seekFile_g(offset);
         return (u8)file.get();
     }
 
     size_t File::getBuffer(u32 offset, void *buf, size_t len) {
+        if(in_memory) {
+            if(offset >= mem_buffer->size()) {
+                return 0;
+            }
+            len = std::min(len, mem_buffer->size() - offset);
+            std::memcpy(buf, mem_buffer->data() + offset, len);
+            return len;
+        }
+
         seekFile_g(offset);
         file.read((char *)buf, len);
         return this->file.gcount();
     }
 
     void File::setByte(u32 offset, u8 data) {
+        assert(!in_memory && "archive-backed files are read-only");
         seekFile_p(offset);
         file.put(data);
         file.flush();
     }
 
     void File::setBuffer(u32 offset, void *buf, size_t len) {
+        assert(!in_memory && "archive-backed files are read-only");
         seekFile_p(offset);
         file.write((char *)buf, len);
         file.flush();
@@ -122,6 +167,10 @@ namespace Silver {
 
     std::string  File::getFilename() { return filename; }
 
+    bool         File::isInMemory() const { return in_memory; }
+
+    std::shared_ptr<const std::vector<u8>> File::getSharedBuffer() const { return mem_buffer; }
+
     /**
      * Private
      */
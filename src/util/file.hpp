@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <iterator>
+#include <memory>
 #include <nowide/fstream.hpp>
 #include <nowide/iostream.hpp>
 #include <vector>
@@ -52,6 +53,17 @@ namespace Silver {
 
         static File *createFile(std::string filename);
 
+        /**
+         * Open a file for reading, transparently inflating .gz/.zip archives into memory.
+         * Archive-backed files are read-only and report the archive's filename.
+         */
+        static File *openReadOnly(std::string filename);
+
+        /**
+         * Wrap a buffer as a read-only file, `filename` is only reported back by getFilename()
+         */
+        static File *fromBuffer(std::string filename, std::vector<u8> data);
+
         static bool  fileExists(std::string);
 
         template<typename T>
@@ -78,10 +90,21 @@ namespace Silver {
 
         std::string  getFilename();
 
+        bool         isInMemory() const;
+
+        /**
+         * The contents of an in-memory file, for holding on to without a copy. Null for files on disk
+         */
+        std::shared_ptr<const std::vector<u8>> getSharedBuffer() const;
+
     private:
         nowide::fstream file;
         std::string     filename;
 
+        // backing store for archive-backed files, the stream above is unused when this is in use
+        std::shared_ptr<const std::vector<u8>> mem_buffer;
+        bool                                   in_memory = false;
+
         explicit File(std::string const &filename);
 
         void seekFile_g(u32 offset);
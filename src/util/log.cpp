@@ -1,5 +1,304 @@
 #include "log.hpp"
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+namespace {
+    // how long the writer sleeps when nobody asks for a flush
+    constexpr auto writer_period = std::chrono::milliseconds(10);
+
+    // messages from one call site beyond `site_burst` in `site_window_ns` are counted instead of written
+    constexpr u32  site_burst     = 10;
+    constexpr u64  site_window_ns = 1000000000;
+
+    u64            now_ns() {
+        using Clock = std::chrono::steady_clock;
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    }
+} // namespace
+
+/**
+ * Single-producer single-consumer queue of one thread's messages, only the owning thread moves `head` and only the
+ * writer thread moves `tail`
+ */
+struct Silver::Logger::Ring {
+    static constexpr u64 capacity = 256;
+
+    log_record_t         records[capacity];
+    std::atomic<u64>     head {0};
+    std::atomic<u64>     tail {0};
+    std::atomic<u64>     dropped {0};
+    u64                  reportedDropped = 0; // writer thread only
+};
+
+thread_local std::shared_ptr<Silver::Logger::Ring> Silver::Logger::threadRing;
+
+Silver::Logger::Logger(LogLevel minLevel) :
+    minLevel(minLevel) {
+    this->writer = std::thread([this]() { this->writerMain(); });
+}
+
+Silver::Logger::~Logger() {
+    {
+        std::lock_guard lock(this->writerMutex);
+        this->stopping = true;
+    }
+    this->writerWake.notify_one();
+    this->writer.join();
+}
+
+void Silver::Logger::setLogLevel(const std::string &levelStr) {
+    auto caseInsEquals = [](const std::string &a, const std::string &b) {
+        auto caseInsentiveCompare = [](char a, char b) {
+            return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+        };
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), caseInsentiveCompare);
+    };
+
+    if(caseInsEquals(levelStr, "Debug")) {
+        setLogLevel(LogLevel::Debug);
+    } else if(caseInsEquals(levelStr, "Info")) {
+        setLogLevel(LogLevel::Info);
+    } else if(caseInsEquals(levelStr, "Warn")) {
+        setLogLevel(LogLevel::Warn);
+    } else if(caseInsEquals(levelStr, "Error")) {
+        setLogLevel(LogLevel::Error);
+    } else if(caseInsEquals(levelStr, "Fatal")) {
+        setLogLevel(LogLevel::Fatal);
+    } else {
+        LogError("Logger") << "Invalid log level: " << levelStr;
+    }
+
+    LogInfo("Logger") << "Set log level to " << getLogLevelName(this->minLevel);
+    if(!isCompiledIn(this->minLevel)) {
+        LogWarn("Logger") << "Messages below " << getLogLevelName(compiledMinLevel)
+                          << " are compiled out of this build";
+    }
+}
+
+Silver::Logger::Ring *Silver::Logger::getThreadRing() {
+    if(!threadRing) {
+        threadRing = std::make_shared<Ring>();
+
+        std::lock_guard lock(this->ringsMutex);
+        this->rings.push_back(threadRing);
+    }
+    return threadRing.get();
+}
+
+void Silver::Logger::submit(log_record_t const &record) {
+    if(!this->writerRunning.load(std::memory_order_acquire)) {
+        // the writer is gone, nothing would ever drain the ring
+        std::lock_guard lock(this->writerMutex);
+        this->write(record);
+        nowide::cout.flush();
+        return;
+    }
+
+    Ring *ring = this->getThreadRing();
+    u64   head = ring->head.load(std::memory_order_relaxed);
+    if(head - ring->tail.load(std::memory_order_acquire) >= Ring::capacity) {
+        ring->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    memcpy(&ring->records[head % Ring::capacity], &record, offsetof(log_record_t, args) + record.args_size);
+    ring->head.store(head + 1, std::memory_order_release);
+
+    if(record.level == LogLevel::Fatal) {
+        this->flush();
+    }
+}
+
+void Silver::Logger::flush() {
+    std::unique_lock lock(this->writerMutex);
+    if(this->stopping) {
+        return;
+    }
+
+    // the pass after the one that might be running now is guaranteed to see everything submitted before this
+    u64 wanted     = this->passesStarted + 1;
+    this->flushing = true;
+    this->writerWake.notify_one();
+    this->writerDone.wait(lock, [&]() { return this->passesDone >= wanted || this->stopping; });
+}
+
+void Silver::Logger::writerMain() {
+    std::unique_lock lock(this->writerMutex);
+    while(true) {
+        this->writerWake.wait_for(lock, writer_period, [this]() { return this->stopping || this->flushing; });
+
+        bool stop      = this->stopping;
+        this->flushing = false;
+        this->passesStarted++;
+
+        lock.unlock();
+        this->drain();
+        lock.lock();
+
+        this->passesDone++;
+        this->writerDone.notify_all();
+
+        if(stop) {
+            // anything logged after the last pass gets written synchronously by submit()
+            this->writerRunning.store(false, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+void Silver::Logger::drain() {
+    std::vector<std::shared_ptr<Ring>> snapshot;
+    {
+        std::lock_guard lock(this->ringsMutex);
+        snapshot = this->rings;
+    }
+
+    for(auto &ring: snapshot) {
+        u64 tail = ring->tail.load(std::memory_order_relaxed);
+        u64 head = ring->head.load(std::memory_order_acquire);
+        for(; tail != head; tail++) {
+            this->write(ring->records[tail % Ring::capacity]);
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        u64 dropped = ring->dropped.load(std::memory_order_relaxed);
+        if(dropped != ring->reportedDropped) {
+            this->writePrefix(LogLevel::Warn, "Logger");
+            nowide::cout << dropped - ring->reportedDropped << " messages dropped, a thread logged faster than they "
+                         << "could be written\n";
+            ring->reportedDropped = dropped;
+        }
+    }
+
+    // report call sites that went quiet after being rate limited
+    u64 now = now_ns();
+    for(auto &[key, site]: this->sites) {
+        if(site.suppressed && now - site.windowStart >= site_window_ns) {
+            this->reportSuppressed(site, key.first, key.second);
+        }
+    }
+
+    nowide::cout.flush();
+
+    // rings whose thread has exited and that have nothing left in them
+    snapshot.clear();
+    std::lock_guard lock(this->ringsMutex);
+    std::erase_if(this->rings, [](std::shared_ptr<Ring> const &ring) {
+        return ring.use_count() == 1
+            && ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+    });
+}
+
+void Silver::Logger::reportSuppressed(Site &site, const char *file, u32 line) {
+    this->writePrefix(site.level, site.id);
+    nowide::cout << site.suppressed << " similar messages from " << file << ":" << line << " suppressed\n";
+    site.suppressed = 0;
+}
+
+void Silver::Logger::writePrefix(LogLevel level, const char *id) {
+    switch(level) {
+    case LogLevel::Debug: nowide::cout << Colors::fgGreen << "[" << "Debug"; break;
+    case LogLevel::Info:  nowide::cout << Colors::fgBlue << "[" << "Info"; break;
+    case LogLevel::Warn:  nowide::cout << Colors::fgYellow << "[" << "Warn"; break;
+    case LogLevel::Error: nowide::cout << Colors::fgRed << "[" << "Error"; break;
+    case LogLevel::Fatal: nowide::cout << Colors::fgMagenta << "[" << "Fatal"; break;
+    default:              unreachable();
+    }
+
+    nowide::cout << "] " << id << Colors::fgDefault << ": ";
+}
+
+void Silver::Logger::write(log_record_t const &record) {
+    auto level = static_cast<LogLevel>(record.level);
+
+    if(level != LogLevel::Fatal) {
+        u64   now  = now_ns();
+        Site &site = this->sites[{record.file, record.line}];
+        if(now - site.windowStart >= site_window_ns) {
+            if(site.suppressed) {
+                this->reportSuppressed(site, record.file, record.line);
+            }
+            site.id          = record.id;
+            site.level       = level;
+            site.windowStart = now;
+            site.count       = 0;
+        }
+
+        if(++site.count > site_burst) {
+            site.suppressed++;
+            return;
+        }
+    }
+
+    this->writePrefix(level, record.id);
+
+    std::ostream           &out   = nowide::cout;
+    std::ios_base::fmtflags flags = out.flags();
+
+    for(size_t pos = 0; pos < record.args_size;) {
+        auto get = [&]<typename T>(T &value) {
+            memcpy(&value, &record.args[pos], sizeof(T));
+            pos += sizeof(T);
+        };
+
+        u8 type = record.args[pos++];
+        switch(type) {
+        case log_record_t::ARG_BOOL: {
+            bool value;
+            get(value);
+            out << value;
+            break;
+        }
+        case log_record_t::ARG_CHAR: {
+            char value;
+            get(value);
+            out << value;
+            break;
+        }
+        case log_record_t::ARG_INT: {
+            s64 value;
+            get(value);
+            out << value;
+            break;
+        }
+        case log_record_t::ARG_UINT: {
+            u64 value;
+            get(value);
+            out << value;
+            break;
+        }
+        case log_record_t::ARG_DOUBLE: {
+            double value;
+            get(value);
+            out << value;
+            break;
+        }
+        case log_record_t::ARG_STRING: {
+            u16 len;
+            get(len);
+            out.write(reinterpret_cast<const char *>(&record.args[pos]), len);
+            pos += len;
+            break;
+        }
+        case log_record_t::ARG_MANIP: {
+            std::ios_base &(*manip)(std::ios_base &);
+            get(manip);
+            out << manip;
+            break;
+        }
+        default: unreachable();
+        }
+    }
+
+    if(record.truncated) {
+        out << "...";
+    }
+    out << "\n";
+    out.flags(flags);
+}
+
 Silver::Logger &Silver::getLogger() {
     static Silver::Logger global_logger = Silver::Logger();
 
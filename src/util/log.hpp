@@ -1,10 +1,30 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <cctype>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "flags.hpp"
 #include "nowide/iostream.hpp"
+#include "types/primitives.hpp"
+
+/**
+ * Lowest level that gets compiled in, 0 (Debug) through 4 (Fatal)
+ */
+#if !defined(SILVER_LOG_MIN_LEVEL)
+#define SILVER_LOG_MIN_LEVEL 0
+#endif
 
 // borrowed from chromium
 class VoidifyStream {
@@ -25,21 +45,28 @@ namespace Silver {
     struct Logger;
     struct LogMessageStream;
 
-    namespace {
-        extern Logger *global_logger;
-
-        // https://stackoverflow.com/a/46455079
-        class NullStream: public std::ostream {
-            class NullBuffer: public std::streambuf {
-            public:
-                int overflow(int c) { return c; }
-            } m_nb;
-
-        public:
-            NullStream() :
-                std::ostream(&m_nb) { }
+    /**
+     * One captured message, arguments are packed into `args` as a type byte followed by the value
+     */
+    struct log_record_t {
+        enum arg_type_t : u8 {
+            ARG_BOOL,
+            ARG_CHAR,
+            ARG_INT,    // s64
+            ARG_UINT,   // u64
+            ARG_DOUBLE,
+            ARG_STRING, // u16 length, then the characters
+            ARG_MANIP,  // std::ios_base &(*)(std::ios_base &), applied to the rest of the message
         };
-    } // namespace
+
+        const char *id;
+        const char *file;
+        u32         line;
+        u8          level;
+        bool        truncated;
+        u16         args_size;
+        u8          args[232];
+    };
 
     namespace Colors {
 #define AnsiColor(str) \
@@ -73,101 +100,220 @@ namespace Silver {
 
         static constexpr const char *logLevelNames[] = {"Debug", "Info", "Warn", "Error", "Fatal"};
 
+        /**
+         * Messages below this level are removed at compile time, see SILVER_LOG_MIN_LEVEL
+         */
+        static constexpr LogLevel    compiledMinLevel = static_cast<LogLevel>(SILVER_LOG_MIN_LEVEL);
+
+        static constexpr bool        isCompiledIn(LogLevel level) { return level >= compiledMinLevel; }
+
         static const char           *getLogLevelName(LogLevel level) {
-            assert(level >= LogLevel::Debug && level < LogLevel::Fatal);
+            assert(level >= LogLevel::Debug && level <= LogLevel::Fatal);
             return logLevelNames[static_cast<int>(level)];
         }
 
-        Logger(LogLevel minLevel = LogLevel::Warn) :
-            minLevel(minLevel) { }
-
-        void setLogLevel(LogLevel minLevel) { this->minLevel = minLevel; }
-
-        void setLogLevel(const std::string &levelStr) {
-            auto caseInsEquals = [](const std::string &a, const std::string &b) {
-                auto caseInsentiveCompare = [](char a, char b) {
-                    return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
-                };
-                return std::equal(a.begin(), a.end(), b.begin(), b.end(), caseInsentiveCompare);
-            };
-
-            if(caseInsEquals(levelStr, "Debug")) {
-                setLogLevel(LogLevel::Debug);
-            } else if(caseInsEquals(levelStr, "Info")) {
-                setLogLevel(LogLevel::Info);
-            } else if(caseInsEquals(levelStr, "Warn")) {
-                setLogLevel(LogLevel::Warn);
-            } else if(caseInsEquals(levelStr, "Error")) {
-                setLogLevel(LogLevel::Error);
-            } else if(caseInsEquals(levelStr, "Fatal")) {
-                setLogLevel(LogLevel::Fatal);
-            } else {
-                this->log(LogLevel::Error, "Logger") << "Invalid log level: " << levelStr;
-            }
+        Logger(LogLevel minLevel = LogLevel::Warn);
+        ~Logger();
 
-            this->log(LogLevel::Info, "Logger") << "Set log level to " << getLogLevelName(this->minLevel) << std::endl;
-        }
+        bool isEnabled(LogLevel level) const { return level >= this->minLevel.load(std::memory_order_relaxed); }
 
-        std::ostream &log(LogLevel level, const char *id) {
-            if(level < this->minLevel) {
-                return nullStream;
-            }
+        void setLogLevel(LogLevel minLevel) { this->minLevel.store(minLevel, std::memory_order_relaxed); }
 
-            switch(level) {
-            case LogLevel::Debug: nowide::cout << Colors::fgGreen << "[" << "Debug"; break;
-            case LogLevel::Info:  nowide::cout << Colors::fgBlue << "[" << "Info"; break;
-            case LogLevel::Warn:  nowide::cout << Colors::fgYellow << "[" << "Warn"; break;
-            case LogLevel::Error: nowide::cout << Colors::fgRed << "[" << "Error"; break;
-            case LogLevel::Fatal: nowide::cout << Colors::fgMagenta << "[" << "Fatal"; break;
-            default:              unreachable();
-            }
+        void setLogLevel(const std::string &levelStr);
 
-            return nowide::cout << "] " << id << Colors::fgDefault << ": ";
-        }
+        /**
+         * Queue a captured message on the calling thread's ring, never blocks. If the ring is full the message is
+         * dropped and counted.
+         */
+        void submit(log_record_t const &record);
+
+        /**
+         * Block until everything submitted so far has been written
+         */
+        void flush();
 
     private:
-        LogLevel   minLevel;
-        NullStream nullStream;
+        struct Ring;
+
+        // rate limiting state for one LogX() call site
+        struct Site {
+            const char *id;
+            LogLevel    level;
+            u64         windowStart = 0; // ns
+            u32         count       = 0;
+            u32         suppressed  = 0;
+        };
+
+        Ring *getThreadRing();
+        void  writerMain();
+        void  drain();
+        void  write(log_record_t const &record);
+        void  writePrefix(LogLevel level, const char *id);
+        void  reportSuppressed(Site &site, const char *file, u32 line);
+
+        static thread_local std::shared_ptr<Ring> threadRing;
+
+        std::atomic<LogLevel>                     minLevel;
+
+        // rings are shared so a thread's unwritten messages survive it exiting
+        std::mutex                                ringsMutex;
+        std::vector<std::shared_ptr<Ring>>        rings;
+
+        std::mutex                                writerMutex;
+        std::condition_variable                   writerWake;
+        std::condition_variable                   writerDone;
+        u64                                       passesStarted = 0;
+        u64                                       passesDone    = 0;
+        bool                                      stopping      = false;
+        bool                                      flushing      = false;
+        std::atomic<bool>                         writerRunning {true};
+        std::thread                               writer;
+
+        // only touched by the writer thread
+        std::map<std::pair<const char *, u32>, Site> sites;
     };
 
     Logger &getLogger();
 
+    /**
+     * Captures `<<` arguments in binary form, formatting happens later on the logger's thread.
+     * Strings are copied, anything that isn't a string, number or ios manipulator is formatted here through its
+     * operator<< and kept as a string.
+     */
     struct LogMessageStream {
-        const char   *id;
-        std::ostream &_stream;
+        LogMessageStream(Logger::LogLevel level, const char *id, const char *file, u32 line) {
+            record.id        = id;
+            record.file      = file;
+            record.line      = line;
+            record.level     = level;
+            record.truncated = false;
+            record.args_size = 0;
+        }
+
+        ~LogMessageStream() { submit(); }
+
+        LogMessageStream(const LogMessageStream &)             = delete;
+        LogMessageStream &operator= (const LogMessageStream &) = delete;
+
+        template<typename T>
+            requires(!std::is_function_v<T>)
+        LogMessageStream &operator<< (T const &value) {
+            using V = std::remove_cvref_t<T>;
+            if constexpr(std::is_same_v<V, bool>) {
+                putValue(log_record_t::ARG_BOOL, value);
+            } else if constexpr(std::is_same_v<V, char> || std::is_same_v<V, signed char>
+                                || std::is_same_v<V, unsigned char>) {
+                // ostreams print these as characters, keep doing that
+                putValue(log_record_t::ARG_CHAR, static_cast<char>(value));
+            } else if constexpr(std::is_integral_v<V> && std::is_signed_v<V>) {
+                putValue(log_record_t::ARG_INT, static_cast<s64>(value));
+            } else if constexpr(std::is_integral_v<V>) {
+                putValue(log_record_t::ARG_UINT, static_cast<u64>(value));
+            } else if constexpr(std::is_floating_point_v<V>) {
+                putValue(log_record_t::ARG_DOUBLE, static_cast<double>(value));
+            } else if constexpr(std::is_pointer_v<std::decay_t<V>>
+                                && std::is_convertible_v<std::decay_t<V>, const char *>) {
+                const char *str = value;
+                putString(str ? std::string_view(str) : std::string_view("(null)"));
+            } else if constexpr(std::is_convertible_v<V const &, std::string_view>) {
+                putString(std::string_view(value));
+            } else {
+                std::ostringstream formatted;
+                formatted << value;
+                putString(formatted.str());
+            }
+            return *this;
+        }
 
-        LogMessageStream(Logger::LogLevel level, const char *id) :
-            id(id), _stream(getLogger().log(level, id)) { };
+        LogMessageStream &operator<< (std::ios_base &(*manip)(std::ios_base &)) {
+            putValue(log_record_t::ARG_MANIP, manip);
+            return *this;
+        }
 
-        ~LogMessageStream() { stream() << std::endl; }
+        // every message is already a line, std::endl and std::flush have nothing left to do
+        LogMessageStream &operator<< (std::ostream &(*)(std::ostream &)) { return *this; }
 
-        std::ostream &stream() const { return _stream; }
+        /**
+         * Hand the message to the logger, only the first call does anything
+         */
+        void submit() {
+            if(!submitted) {
+                submitted = true;
+                getLogger().submit(record);
+            }
+        }
 
+    private:
         template<typename T>
-        std::ostream &operator<< (T &&streamed_type) {
-            return stream() << streamed_type;
+        void putValue(u8 type, T const &value) {
+            if(!reserve(1 + sizeof(T))) {
+                return;
+            }
+            record.args[record.args_size++] = type;
+            memcpy(&record.args[record.args_size], &value, sizeof(T));
+            record.args_size += sizeof(T);
+        }
+
+        void putString(std::string_view str) {
+            if(!reserve(1 + sizeof(u16))) {
+                return;
+            }
+
+            size_t room = sizeof(record.args) - record.args_size - 1 - sizeof(u16);
+            if(str.size() > room) {
+                str              = str.substr(0, room);
+                record.truncated = true;
+            }
+
+            u16 len = static_cast<u16>(str.size());
+            putValue(log_record_t::ARG_STRING, len);
+            memcpy(&record.args[record.args_size], str.data(), len);
+            record.args_size += len;
+        }
+
+        bool reserve(size_t n) {
+            if(record.args_size + n > sizeof(record.args)) {
+                record.truncated = true;
+                return false;
+            }
+            return true;
         }
+
+        log_record_t record;
+        bool         submitted = false;
     };
 
     // stripped-down version of chromium's CheckError
     struct DebugCheckError: public LogMessageStream {
-        DebugCheckError(const char *expr) :
-            LogMessageStream(Silver::Logger::LogLevel::Fatal, "DebugCheck") {
-            stream() << "Check failed: " << expr;
+        DebugCheckError(const char *expr, const char *file, u32 line) :
+            LogMessageStream(Silver::Logger::LogLevel::Fatal, "DebugCheck", file, line) {
+            *this << "Check failed: " << expr;
         };
 
         ~DebugCheckError() {
-            // crash
+            // the message has to be out before we crash
+            submit();
             assert(false);
         }
     };
 } // namespace Silver
 
-#define LogDebug(id) Silver::LogMessageStream(Silver::Logger::LogLevel::Debug, id)
-#define LogInfo(id)  Silver::LogMessageStream(Silver::Logger::LogLevel::Info, id)
-#define LogWarn(id)  Silver::LogMessageStream(Silver::Logger::LogLevel::Warn, id)
-#define LogError(id) Silver::LogMessageStream(Silver::Logger::LogLevel::Error, id)
-#define LogFatal(id) Silver::LogMessageStream(Silver::Logger::LogLevel::Fatal, id)
+// levels below SILVER_LOG_MIN_LEVEL are compiled out along with their arguments, levels below the logger's runtime
+// level skip capturing their arguments
+#define SilverLog(level, id) \
+    switch(0) \
+    case 0: \
+    default: \
+        if constexpr(!Silver::Logger::isCompiledIn(level)) { \
+        } else if(!Silver::getLogger().isEnabled(level)) { \
+        } else \
+            Silver::LogMessageStream(level, id, __FILE__, __LINE__)
+
+#define LogDebug(id) SilverLog(Silver::Logger::LogLevel::Debug, id)
+#define LogInfo(id)  SilverLog(Silver::Logger::LogLevel::Info, id)
+#define LogWarn(id)  SilverLog(Silver::Logger::LogLevel::Warn, id)
+#define LogError(id) SilverLog(Silver::Logger::LogLevel::Error, id)
+#define LogFatal(id) SilverLog(Silver::Logger::LogLevel::Fatal, id)
 
 #if defined(_DEBUG)
   // borrowed from chromium
@@ -176,8 +322,8 @@ namespace Silver {
     case 0: \
     default: \
         if((expr)) { \
-        } else
-Silver::DebugCheckError(#expr)
+        } else \
+            Silver::DebugCheckError(#expr, __FILE__, __LINE__)
 #else
 #define DebugCheck(expr) EAT_CHECK_STREAM_PARAMS(!(expr))
 #endif
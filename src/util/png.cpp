@@ -0,0 +1,132 @@
+#include "png.hpp"
+
+#include <cstdlib>
+#include <iterator>
+#include <zlib.h>
+
+#include "crc.hpp"
+
+namespace Silver::PNG {
+    namespace {
+        constexpr u8 SIGNATURE[8]    = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+        constexpr u8 COLOR_TYPE_RGB  = 2;
+        constexpr u8 BYTES_PER_PIXEL = 3;
+
+        // filter type of each entry in Encoder::candidates
+        constexpr u8 FILTER_TYPES[4] = {0 /* None */, 1 /* Sub */, 2 /* Up */, 4 /* Paeth */};
+
+        void put_be32(std::vector<u8> &out, u32 value) {
+            out.push_back(value >> 24);
+            out.push_back(value >> 16);
+            out.push_back(value >> 8);
+            out.push_back(value);
+        }
+
+        u8 paeth(u8 a, u8 b, u8 c) {
+            int p  = a + b - c;
+            int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+            if(pa <= pb && pa <= pc) {
+                return a;
+            }
+            return pb <= pc ? b : c;
+        }
+    } // namespace
+
+    std::span<const u8> Encoder::encode(const Pixel *pixels, u32 width, u32 height) {
+        u32 stride = width * BYTES_PER_PIXEL;
+
+        filtered.clear();
+        filtered.reserve(size_t(stride + 1) * height);
+        rows[0].resize(stride);
+        rows[1].assign(stride, 0);
+
+        for(u32 y = 0; y < height; y++) {
+            u8          *row  = rows[y & 1].data();
+            u8 const    *prev = rows[(y + 1) & 1].data();
+            Pixel const *in   = pixels + size_t(y) * width;
+            for(u32 x = 0; x < width; x++) {
+                row[x * 3 + 0] = in[x].r;
+                row[x * 3 + 1] = in[x].g;
+                row[x * 3 + 2] = in[x].b;
+            }
+            filter_row(row, prev, stride);
+        }
+
+        uLongf compressed_size = compressBound(filtered.size());
+        compressed.resize(compressed_size);
+        if(compress2(compressed.data(), &compressed_size, filtered.data(), filtered.size(), Z_DEFAULT_COMPRESSION)
+           != Z_OK) {
+            return {};
+        }
+
+        png.clear();
+        png.insert(png.end(), std::begin(SIGNATURE), std::end(SIGNATURE));
+
+        u8 header[13];
+        for(int i = 0; i < 4; i++) {
+            header[i]     = width >> (24 - i * 8);
+            header[4 + i] = height >> (24 - i * 8);
+        }
+        header[8]  = 8; // bit depth
+        header[9]  = COLOR_TYPE_RGB;
+        header[10] = 0; // deflate
+        header[11] = 0; // adaptive filtering
+        header[12] = 0; // not interlaced
+        put_chunk("IHDR", header, sizeof(header));
+        put_chunk("IDAT", compressed.data(), compressed_size);
+        put_chunk("IEND", nullptr, 0);
+
+        return png;
+    }
+
+    void Encoder::filter_row(const u8 *row, const u8 *prev, u32 stride) {
+        for(auto &candidate: candidates) {
+            candidate.resize(stride);
+        }
+
+        u8 *none = candidates[0].data();
+        u8 *sub  = candidates[1].data();
+        u8 *up   = candidates[2].data();
+        u8 *pae  = candidates[3].data();
+        for(u32 x = 0; x < stride; x++) {
+            u8 left    = x >= BYTES_PER_PIXEL ? row[x - BYTES_PER_PIXEL] : 0;
+            u8 up_left = x >= BYTES_PER_PIXEL ? prev[x - BYTES_PER_PIXEL] : 0;
+            none[x]    = row[x];
+            sub[x]     = row[x] - left;
+            up[x]      = row[x] - prev[x];
+            pae[x]     = row[x] - paeth(left, prev[x], up_left);
+        }
+
+        // the usual heuristic, smallest sum of the residuals taken as signed
+        int best     = 0;
+        u64 best_sum = UINT64_MAX;
+        for(int i = 0; i < 4; i++) {
+            u64 sum = 0;
+            for(u8 b: candidates[i]) {
+                sum += std::abs(static_cast<s8>(b));
+            }
+            if(sum < best_sum) {
+                best     = i;
+                best_sum = sum;
+            }
+        }
+
+        filtered.push_back(FILTER_TYPES[best]);
+        filtered.insert(filtered.end(), candidates[best].begin(), candidates[best].end());
+    }
+
+    void Encoder::put_chunk(const char *type, const u8 *data, u32 size) {
+        put_be32(png, size);
+        png.insert(png.end(), type, type + 4);
+        if(size) {
+            png.insert(png.end(), data, data + size);
+        }
+
+        u32 chunk_crc = crc::update(crc::begin(), type, 4);
+        if(size) {
+            chunk_crc = crc::update(chunk_crc, data, size);
+        }
+        put_be32(png, chunk_crc);
+    }
+} // namespace Silver::PNG
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <span>
+#include <vector>
+
+#include "types/pixel.hpp"
+#include "types/primitives.hpp"
+
+namespace Silver::PNG {
+    /**
+     * Encodes pixel buffers as 8-bit RGB PNGs, alpha is dropped. Each row gets whichever of the None/Sub/Up/Paeth
+     * filters leaves the smallest residuals, and the result is deflated with zlib.
+     *
+     * The buffers are kept between calls, so after the first image of a given size encoding doesn't allocate. Not
+     * thread safe, give each thread its own.
+     */
+    class Encoder {
+    public:
+        /**
+         * @return the PNG file's bytes, valid until the next call. Empty if deflate failed
+         */
+        std::span<const u8> encode(const Pixel *pixels, u32 width, u32 height);
+
+    private:
+        void            filter_row(const u8 *row, const u8 *prev, u32 stride);
+        void            put_chunk(const char *type, const u8 *data, u32 size);
+
+        std::vector<u8> filtered;      // filter byte + row, for every row
+        std::vector<u8> rows[2];       // this row and the one above as RGB, the one above starts out zero
+        std::vector<u8> candidates[4]; // a row under each filter, the smallest goes to `filtered`
+        std::vector<u8> compressed;
+        std::vector<u8> png;
+    };
+} // namespace Silver::PNG
@@ -0,0 +1,163 @@
+#include "timeline.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Silver::Timeline {
+    namespace {
+        struct span_t {
+            const char *name;
+            u64         start_ns;
+            u64         end_ns;
+        };
+    } // namespace
+
+    /**
+     * One thread's spans, written only by the thread using it
+     */
+    struct Track {
+        static constexpr size_t capacity = 1 << 16;
+
+        std::vector<span_t>       spans = std::vector<span_t>(capacity);
+        std::atomic<u64>          written {0};
+        std::atomic<u64>          cleared {0}; // value of `written` at the last clear()
+        std::atomic<const char *> name {nullptr};
+        u32                       tid = 0;
+
+        void                      push(span_t const &span) {
+            u64 pos                     = written.load(std::memory_order_relaxed);
+            spans[pos & (capacity - 1)] = span;
+            written.store(pos + 1, std::memory_order_release);
+        }
+
+        /**
+         * Copy out what's still in the ring, dropping anything the owning thread lapped during the copy
+         */
+        void snapshot(std::vector<span_t> &out) const {
+            u64 end   = written.load(std::memory_order_acquire);
+            u64 start = std::max<u64>(end > capacity ? end - capacity : 0, cleared.load(std::memory_order_relaxed));
+
+            out.resize(end - start);
+            for(u64 i = start; i < end; i++) {
+                out[i - start] = spans[i & (capacity - 1)];
+            }
+
+            u64 after = written.load(std::memory_order_acquire);
+            if(after + 1 > start + capacity) {
+                u64 lapped = std::min<u64>(after + 1 - capacity - start, out.size());
+                out.erase(out.begin(), out.begin() + lapped);
+            }
+        }
+    };
+
+    namespace {
+        // tracks are never freed, so they outlive the threads that wrote them
+        std::mutex                          registry_mutex;
+        std::vector<std::unique_ptr<Track>> registry;
+
+        thread_local Track                 *local_track = nullptr;
+
+        /**
+         * Span names are our own string literals, only quotes and backslashes would break the JSON
+         */
+        void writeJsonString(FILE *f, const char *s) {
+            fputc('"', f);
+            for(; *s; s++) {
+                if(*s == '"' || *s == '\\') {
+                    fputc('\\', f);
+                }
+                fputc(*s, f);
+            }
+            fputc('"', f);
+        }
+    } // namespace
+
+    namespace detail {
+        std::atomic<bool> enabled {false};
+
+        u64               now_ns() {
+            using Clock = std::chrono::steady_clock;
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+        }
+
+        void record(const char *name, u64 start_ns, u64 end_ns) {
+            if(local_track) {
+                local_track->push({name, start_ns, end_ns});
+            }
+        }
+    } // namespace detail
+
+    void setEnabled(bool enable) { detail::enabled.store(enable, std::memory_order_relaxed); }
+
+    void setThreadName(const char *name) {
+        if(local_track) {
+            local_track->name.store(name, std::memory_order_relaxed);
+        } else {
+            local_track = createTrack(name);
+        }
+    }
+
+    Track *createTrack(const char *name) {
+        auto track = std::make_unique<Track>();
+        track->name.store(name, std::memory_order_relaxed);
+
+        std::lock_guard lock(registry_mutex);
+        track->tid = (u32)registry.size() + 1;
+        return registry.emplace_back(std::move(track)).get();
+    }
+
+    void useTrack(Track *track) { local_track = track; }
+
+    void clear() {
+        std::lock_guard lock(registry_mutex);
+        for(auto &track: registry) {
+            // only the owner may move `written`, so remember where the ring was instead of resetting it
+            track->cleared.store(track->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+        }
+    }
+
+    bool writeChromeTrace(const std::string &path) {
+        FILE *f = fopen(path.c_str(), "w");
+        if(!f) {
+            return false;
+        }
+
+        std::vector<Track *> tracks;
+        {
+            std::lock_guard lock(registry_mutex);
+            for(auto &track: registry) {
+                tracks.push_back(track.get());
+            }
+        }
+
+        std::vector<span_t> spans;
+        bool                first = true;
+        fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", f);
+
+        for(Track *track: tracks) {
+            if(const char *name = track->name.load(std::memory_order_relaxed)) {
+                fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                        first ? "" : ",\n", track->tid);
+                writeJsonString(f, name);
+                fputs("}}", f);
+                first = false;
+            }
+
+            track->snapshot(spans);
+            for(span_t const &span: spans) {
+                fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+                writeJsonString(f, span.name);
+                fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", track->tid,
+                        span.start_ns / 1000.0, (span.end_ns - span.start_ns) / 1000.0);
+                first = false;
+            }
+        }
+
+        fputs("\n]}\n", f);
+        return fclose(f) == 0;
+    }
+} // namespace Silver::Timeline
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "flags.hpp"
+#include "types/primitives.hpp"
+
+namespace Silver::Timeline {
+    /**
+     * Scoped-span timeline for looking at frame pacing across threads, exported as Chrome trace JSON (loads in
+     * chrome://tracing and ui.perfetto.dev).
+     *
+     * Each thread records into its own fixed-size ring, a Track, so recording a span is two clock reads and a store
+     * with no locks or allocation. A thread gets its track from setThreadName(), or one made up front with
+     * createTrack() for threads that must never allocate, like audio callbacks. Spans on threads without a track are
+     * dropped, the oldest spans are overwritten once a ring is full.
+     */
+
+    namespace detail {
+        extern std::atomic<bool> enabled;
+
+        u64                      now_ns();
+        void                     record(const char *name, u64 start_ns, u64 end_ns);
+    } // namespace detail
+
+    void setEnabled(bool enable);
+
+    __force_inline bool isEnabled() { return detail::enabled.load(std::memory_order_relaxed); }
+
+    struct Track;
+
+    /**
+     * Name the calling thread in the export and give it a track if it has none yet, `name` must outlive the timeline
+     */
+    void   setThreadName(const char *name);
+
+    /**
+     * Allocate a track named `name` for useTrack(), from any thread
+     */
+    Track *createTrack(const char *name);
+
+    /**
+     * Record the calling thread's spans into `track`, no allocation or locks. Only one thread may record into a track
+     * at a time
+     */
+    void   useTrack(Track *track);
+
+    /**
+     * Drop everything recorded so far
+     */
+    void clear();
+
+    /**
+     * Write every thread's spans as a Chrome trace JSON file, can be called while other threads keep recording
+     * @return false if the file couldn't be written
+     */
+    bool writeChromeTrace(const std::string &path);
+
+    class ScopedSpan {
+    public:
+        /**
+         * @param name must be a string literal or otherwise outlive the timeline, only the pointer is stored
+         */
+        explicit ScopedSpan(const char *name) :
+            name(isEnabled() ? name : nullptr), start(this->name ? detail::now_ns() : 0) { }
+
+        ~ScopedSpan() {
+            if(name) {
+                detail::record(name, start, detail::now_ns());
+            }
+        }
+
+        ScopedSpan(const ScopedSpan &)             = delete;
+        ScopedSpan &operator= (const ScopedSpan &) = delete;
+
+    private:
+        const char *name;
+        u64         start;
+    };
+} // namespace Silver::Timeline
+
+#define TIMELINE_CONCAT_(a, b) a##b
+#define TIMELINE_CONCAT(a, b)  TIMELINE_CONCAT_(a, b)
+#define TimelineSpan(name)     Silver::Timeline::ScopedSpan TIMELINE_CONCAT(_timeline_span_, __LINE__)(name)
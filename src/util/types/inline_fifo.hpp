@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+
+#include "util/log.hpp"
+
+#include "primitives.hpp"
+
+/**
+ * Fixed-capacity FIFO stored inline in its owner.
+ *
+ * Capacity is a power of two so positions wrap with a mask instead of a compare, and head/tail are free-running
+ * counters so full and empty don't need a spare slot. No bounds checks outside of debug builds: callers are expected to
+ * know how many elements they've queued.
+ */
+template<typename T, size_t N>
+class InlineFifo {
+    static_assert(N != 0 && (N & (N - 1)) == 0, "InlineFifo capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity = N;
+
+    size_t                  size() const { return tail - head; }
+
+    bool                    empty() const { return tail == head; }
+
+    void                    clear() { head = tail = 0; }
+
+    void                    push(T elem) {
+        DebugCheck(size() < N) << "InlineFifo overflow";
+        buf[tail++ & mask] = elem;
+    }
+
+    T pop() {
+        DebugCheck(!empty()) << "InlineFifo underflow";
+        return buf[head++ & mask];
+    }
+
+    T   &at(size_t idx) { return buf[(head + idx) & mask]; }
+
+    T    at(size_t idx) const { return buf[(head + idx) & mask]; }
+
+private:
+    static constexpr size_t mask = N - 1;
+
+    T                       buf[N] {};
+    size_t                  head = 0, tail = 0;
+};